@@ -43,6 +43,13 @@
   NSArray *allFontNames;
   NSMutableDictionary *allFontFamilies;
   NSArray *allFontDescriptors;
+  /* Indexes over the enumerated fonts, built together with
+     allFontDescriptors. */
+  NSMutableDictionary *fontDescriptorsByName;
+  NSMutableDictionary *fontDescriptorsByFamily;
+  NSMutableDictionary *fontDescriptorsByFace;
+  NSMutableDictionary *fontDescriptorsByTraits;
+  NSMutableDictionary *fontNamesByFamilyStyle;
 }
 
 + (void) setDefaultClass: (Class)defaultClass;
@@ -59,6 +66,14 @@
                                  inclusion: (NSArray *)queryDescriptors
                                  exculsion: (NSArray *)exclusionDescriptors;
 
+/* Indexed lookups used by NSFontManager. fontNameForFamily:weight:traits:
+returns the font of the family with exactly this weight and traits, or nil. */
+- (NSFontDescriptor *) fontDescriptorForFontName: (NSString *)fontName;
+- (NSArray *) availableFontNamesWithTraits: (NSFontTraitMask)traits;
+- (NSString *) fontNameForFamily: (NSString *)family
+                          weight: (int)weight
+                          traits: (NSFontTraitMask)traits;
+
 /* Note that these are only called once. NSFont will remember the returned
 values. Backends may override these. */
 - (NSString *) defaultSystemFontName;
@@ -93,6 +108,7 @@ values. Backends may override these. */
   unsigned numberOfGlyphs;
   NSCharacterSet *coveredCharacterSet;
   NSFontDescriptor *fontDescriptor;
+  NSGlyph **glyphPages;
 }
 
 + (GSFontInfo*) fontInfoForFontName: (NSString*)fontName 
@@ -154,6 +170,9 @@ values. Backends may override these. */
 - (CGFloat) widthOfString: (NSString*)string;
 - (CGFloat) xHeight;
 - (NSGlyph) glyphForCharacter: (unichar)theChar;
+/* Returns the same as -glyphForCharacter:, but remembers the answer so that
+the backend is only asked once per character. */
+- (NSGlyph) cachedGlyphForCharacter: (unichar)theChar;
 - (NSFontDescriptor*) fontDescriptor;
 
 @end
@@ -72,6 +72,25 @@
   unsigned int cache_base, cache_size, cache_length;
   BOOL at_end;
 
+  /*
+    The layout manager and its edit generation the cache was left valid
+    for by the last call, and the glyph that call stopped at. A call for
+    the same layout manager and generation starting at or after that glyph
+    keeps the cache (see -layoutGlyphsInLayoutManager:...).
+   */
+  GSLayoutManager *cache_layout_manager;
+  unsigned int cache_generation, cache_next_glyph;
+
+  /*
+    Line break opportunities for the characters in break_range (see
+    -_cacheBreaksFrom:to:). Bit i of breaks is set if a line may be broken
+    before character break_range.location + i, bit i of spaces if that
+    character is a space.
+   */
+  uint32_t *breaks, *spaces;
+  unsigned int break_words;
+  NSRange break_range;
+
 
   struct GSHorizontalTypesetter_line_frag_s *line_frags;
   int line_frags_num, line_frags_size;
@@ -70,6 +70,7 @@ enum {
   BOOL backgroundLayoutEnabled;
   BOOL showsInvisibleCharacters;
   BOOL showsControlCharacters;
+  BOOL typesetsParagraphsConcurrently;
 
   GSTypesetter *typesetter;
 
@@ -109,6 +110,12 @@ how it's supposed to work. It's functional and correct, but it isn't fast. */
   */
   struct GSLayoutManager_glyph_run_s *cached_run;
   unsigned int cached_pos, cached_cpos;
+
+  /*
+  Changes whenever the glyphs or the text they were generated from might
+  have changed (see -_editGeneration).
+  */
+  unsigned int edit_generation;
 }
 
 
@@ -136,6 +143,15 @@ how it's supposed to work. It's functional and correct, but it isn't fast. */
 - (void) setShowsControlCharacters: (BOOL)flag;
 - (BOOL) showsControlCharacters;
 
+/*
+GNUstep extension. If set, typesetters may lay out whole paragraphs in
+parallel on worker threads where this gives the same result as laying
+them out one after another, ie. for simple rectangular text containers of
+unlimited height. The default is NO.
+*/
+- (void) setTypesetsParagraphsConcurrently: (BOOL)flag;
+- (BOOL) typesetsParagraphsConcurrently;
+
 
 /** Font handling **/
 
@@ -386,6 +402,15 @@ layout information.
 -(unsigned int) _softInvalidateFirstGlyphInTextContainer: (NSTextContainer *)textContainer;
 -(unsigned int) _softInvalidateNumberOfLineFragsInTextContainer: (NSTextContainer *)textContainer;
 
+/*
+Returns a number that changes whenever glyphs are invalidated or replaced,
+or the text storage is edited or replaced. No two layout managers share a
+value, so a typesetter that gets the same layout manager and the same value
+as last time may keep what it has cached about the glyphs and attributes.
+The value is never 0.
+*/
+-(unsigned int) _editGeneration;
+
 @end
 
 
@@ -215,6 +215,7 @@ typedef struct GSLayoutManager_textcontainer_s
 
 -(void) _initGlyphs;
 -(void) _freeGlyphs;
+-(void) _bumpEditGeneration;
 
 -(void) _glyphDumpRuns;
 -(void) _sanityChecks;
@@ -156,6 +156,7 @@ APPKIT_EXPORT NSString *NSImageEXIFData; // No GNUstep support yet; for reading
 #else
   unsigned int    _format;
 #endif
+  id _loader;
 }
 
 //
@@ -267,6 +268,26 @@ APPKIT_EXPORT NSString *NSImageEXIFData; // No GNUstep support yet; for reading
 
 @interface NSBitmapImageRep (GNUstepExtension)
 + (NSArray*) imageRepsWithFile: (NSString *)filename;
+
+/** Returns a newly allocated NSBitmapImageRep for the first image in
+ * imageData, decoded to at most size pixels.  See
+ * -initWithData:maximumPixelSize:.
+ */
++ (id) imageRepWithData: (NSData *)imageData
+       maximumPixelSize: (NSSize)size;
+
+/** <p>Loads the first image in imageData, shrinking it while it is
+ * decoded so that it is no more than size.width pixels wide and
+ * size.height pixels high.  The aspect ratio is kept and the size of
+ * the representation in points stays that of the full image, so it
+ * draws in the same place.  Images smaller than size are not changed,
+ * and a zero width or height means no limit.</p>
+ * <p>JPEG images are scaled by the decoder itself and PNG images as
+ * their rows are read, so only the shrunk image is held in memory.
+ * Other formats get decoded in full first.</p>
+ */
+- (id) initWithData: (NSData *)imageData
+   maximumPixelSize: (NSSize)size;
 @end
 
 #endif // _GNUstep_H_NSBitmapImageRep
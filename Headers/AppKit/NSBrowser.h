@@ -81,6 +81,7 @@ typedef NSUInteger NSBrowserColumnResizingType;
   BOOL _acceptsAlphaNumericalKeys;
   BOOL _sendsActionOnAlphaNumericalKeys;
   BOOL _prefersAllColumnUserResizing;
+  BOOL _loadsColumnsLazily;
 
   BOOL _passiveDelegate;
   id _browserDelegate;
@@ -310,6 +311,8 @@ typedef NSUInteger NSBrowserColumnResizingType;
 - (void) setAcceptsAlphaNumericalKeys: (BOOL)flag;
 - (BOOL) sendsActionOnAlphaNumericalKeys;
 - (void) setSendsActionOnAlphaNumericalKeys: (BOOL)flag;
+- (BOOL) loadsColumnsLazily;
+- (void) setLoadsColumnsLazily: (BOOL)flag;
 @end
 
 //
@@ -34,6 +34,7 @@
 #import <AppKit/NSView.h>
 
 @class NSNotification;
+@class NSCachedImageRep;
 @class NSCursor;
 @class NSColor;
 
@@ -46,6 +47,12 @@
   BOOL _copiesOnScroll;
   /* Cached */
   BOOL _isOpaque;
+  /* Prepared content */
+  NSCachedImageRep *_preparedContent;
+  NSRect _preparedRect;
+  NSPoint _preparedOrigin;
+  NSRect _staleRect;
+  BOOL _exposing;
 }
 
 /* Setting the document view */
@@ -79,6 +86,12 @@
 - (BOOL)drawsBackground;
 #endif
 
+#if OS_API_VERSION(GS_API_NONE, GS_API_NONE)
+/* Keeping content around the visible rect */
+- (void)setPreparesContent:(BOOL)flag;
+- (BOOL)preparesContent;
+#endif
+
 @end
 
 #endif /* _GNUstep_H_NSClipView */
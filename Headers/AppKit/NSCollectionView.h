@@ -37,6 +37,7 @@
 
 @class NSCollectionViewItem;
 @class NSCollectionView;
+@class NSMutableIndexSet;
 
 enum
 {  
@@ -77,6 +78,9 @@ namesOfPromisedFilesDroppedAtDestination:(NSURL *)dropURL
   NSArray *_content;
   IBOutlet NSCollectionViewItem *itemPrototype;
   NSMutableArray *_items;
+  NSMutableIndexSet *_loadedIndexes;
+  NSMutableArray *_reusableItems;
+  BOOL _reusesItems;
   
   BOOL _allowsMultipleSelection;
   BOOL _isSelectable;
@@ -149,6 +153,10 @@ namesOfPromisedFilesDroppedAtDestination:(NSURL *)dropURL
                                    withEvent: (NSEvent *)event
                                       offset: (NSPointPointer)dragImageOffset;
 
+#if OS_API_VERSION(GS_API_NONE, GS_API_NONE)
+- (BOOL) reusesItems;
+- (void) setReusesItems: (BOOL)flag;
+#endif
 
 @end
 
@@ -110,8 +110,10 @@ typedef enum _NSSaveOperationType {
         unsigned int has_undo_manager:1;
         unsigned int permanently_modified:1;
         unsigned int autosave_permanently_modified:1;
-        unsigned int RESERVED:28;
+        unsigned int autosave_changed:1;	// changed during a concurrent autosave
+        unsigned int RESERVED:27;
     } _doc_flags;
+    id			_autosave_operation;	// concurrent autosave in progress
     void 		*_reserved1;
 }
 
@@ -366,6 +368,32 @@ originalContentsURL:(NSURL *)orig
          contextInfo:(void *)context;
 - (NSError *)willPresentError:(NSError *)error;
 #endif
+
+#if OS_API_VERSION(MAC_OS_X_VERSION_10_7, GS_API_LATEST)
+- (BOOL)canAsynchronouslyWriteToURL:(NSURL *)url
+                             ofType:(NSString *)type
+                   forSaveOperation:(NSSaveOperationType)op;
+#endif
 @end
 
+#if OS_API_VERSION(GS_API_NONE, GS_API_NONE)
+@interface NSDocument (GNUstepExtensions)
+/** Returns a snapshot of the document's contents for a concurrent
+ * autosave, see -canAsynchronouslyWriteToURL:ofType:forSaveOperation:.
+ * This is called on the main thread, and the document cannot be edited
+ * until it returns, so it should do as little work as possible.  The
+ * default implementation returns the result of -dataOfType:error:.
+ */
+- (id)snapshotOfType:(NSString *)type error:(NSError **)error;
+/** Returns the data to write for a snapshot made by
+ * -snapshotOfType:error:.  This is called on a background thread and
+ * must not touch the document's contents.  The default implementation
+ * returns snapshot, which must be an NSData instance.
+ */
+- (NSData *)dataOfSnapshot:(id)snapshot
+                    ofType:(NSString *)type
+                     error:(NSError **)error;
+@end
+#endif
+
 #endif // _GNUstep_H_NSDocument
@@ -53,6 +53,7 @@ enum {
   NSArray *_colors;
   CGFloat *_locations;
   NSInteger _numberOfColorStops;
+  void *_lut;
 }
 
 - (NSColorSpace *) colorSpace; 
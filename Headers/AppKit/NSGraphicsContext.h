@@ -47,6 +47,7 @@
 @class NSWindow;
 @class NSFont;
 @class NSSet;
+@class NSShadow;
 @class NSBitmapImageRep;
 @class NSGradient;
 
@@ -187,6 +188,8 @@ typedef enum _GSColorSpace
   void *_graphicsPort;
   BOOL _isFlipped;
   NSCompositingOperation _compositingOperation;
+  NSShadow *_shadow;
+  NSMutableArray *_shadowStack;
 }
 
 + (BOOL) currentContextDrawingToScreen;
@@ -259,6 +262,11 @@ APPKIT_EXPORT NSGraphicsContext	*GSCurrentContext(void);
 - (void) lockFocusView: (NSView*)aView inRect: (NSRect)rect;
 - (void) unlockFocusView: (NSView*)aView needsFlush: (BOOL)flush;
 
+/* The shadow set with -[NSShadow set], saved and restored along with
+   the graphics state by -saveGraphicsState and -restoreGraphicsState. */
+- (NSShadow *) GSCurrentShadow;
+- (void) GSSetShadow: (NSShadow *)shadow;
+
 /* Private methods for printing */
 - (void) useFont: (NSString *)fontName;
 - (void) resetUsedFonts;
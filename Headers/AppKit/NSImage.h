@@ -141,12 +141,16 @@ APPKIT_EXTERN NSString *const NSImageNameFolder;
     unsigned	cacheSeparately: 1;
     unsigned	unboundedCacheDepth: 1;
     unsigned	syncLoad: 1;
+    unsigned	reloadable: 1;
+    unsigned	cacheModified: 1;
   } _flags;
   NSMutableArray	*_reps;
   NSColor		*_color;
   NSView                *_lockedView;
   id		        _delegate;
   NSImageCacheMode      _cacheMode;
+  NSData                *_data;
+  NSSize                _maximumPixelSize;
 }
 
 //
@@ -493,6 +497,62 @@ APPKIT_EXTERN NSString *const NSImageNameFolder;
 #endif
 @end
 
+#if OS_API_VERSION(GS_API_NONE, GS_API_NONE)
+/**
+ * <p>All images share a memory budget for their decoded bitmaps and
+ * for the caches they draw from.  Representations that can be
+ * recreated are tracked in the order the images were last drawn, and
+ * once the budget is exceeded those of the least recently drawn images
+ * are released.  Caches get redrawn and bitmaps loaded from a file, or
+ * from data kept by images with -isDataRetained set, get decoded again
+ * the next time the image is used.  Images that were given
+ * representations or drawn into are never unloaded.</p>
+ * <p>The budget is taken from the GSImageCacheLimit user default, in
+ * megabytes, and is 64 MB unless set.</p>
+ */
+@interface NSImage (GNUstepExtensions)
+/** Returns the number of bytes held by the representations the image
+ * cache may release.
+ */
++ (NSUInteger) imageCacheSize;
+
+/** Returns the budget of the image cache in bytes.
+ */
++ (NSUInteger) imageCacheLimit;
+
+/** Sets the budget of the image cache to limit bytes, releasing
+ * representations if the cache now holds more.
+ */
++ (void) setImageCacheLimit: (NSUInteger)limit;
+
+/** Initialises the receiver with the image in data, with bitmap images
+ * shrunk while they are decoded to at most size pixels.  See
+ * -[NSBitmapImageRep initWithData:maximumPixelSize:].
+ */
+- (id) initWithData: (NSData *)data
+   maximumPixelSize: (NSSize)size;
+
+/** Loads the image in the file at path on a background thread, then
+ * sends selector to target on the main thread with the image as its
+ * argument, or nil if the file could not be loaded.  Bitmap images get
+ * decoded to at most size pixels, NSZeroSize loads the full image.
+ * Images are decoded by a shared pool of threads, one per processor.
+ */
++ (void) loadImageWithContentsOfFile: (NSString *)path
+                    maximumPixelSize: (NSSize)size
+                              target: (id)target
+                            selector: (SEL)selector;
+
+/** Like +loadImageWithContentsOfFile:maximumPixelSize:target:selector:
+ * for an image in data.
+ */
++ (void) loadImageWithData: (NSData *)data
+          maximumPixelSize: (NSSize)size
+                    target: (id)target
+                  selector: (SEL)selector;
+@end
+#endif
+
 @interface NSBundle (NSImageAdditions)
 
 - (NSString*) pathForImageResource: (NSString*)name;
@@ -75,9 +75,15 @@ typedef enum _NSPrintingPageOrder {
       unsigned int show_print_panel:1;
       unsigned int show_progress_panel:1;
       unsigned int can_spawn_separate_thread:1;
-      unsigned int RESERVED:29;
+      unsigned int thread_done:1;
+      unsigned int thread_succeeded:1;
+      unsigned int cancelled:1;
+      unsigned int modal_thread:1;
+      unsigned int RESERVED:25;
   } _flags;
   int  _currentPage;
+  id _progress_panel;
+  id _output_sink;
 }
 
 //
@@ -215,6 +221,13 @@ typedef enum _NSPrintingPageOrder {
              toData:(NSMutableData *)data
           printInfo:(NSPrintInfo *)aPrintInfo;
 
+/* Returns a path for the print context to write to, whose output ends
+   up in the data of the receiver, and -_collectDataOutput to call from
+   -deliverResult once the context is gone.  Returns nil if this is not
+   possible and the output has to go through a file. */
+- (NSString *) _dataOutputPath;
+- (BOOL) _collectDataOutput;
+
 @end
 
 
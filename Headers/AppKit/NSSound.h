@@ -43,9 +43,7 @@
 @class NSPasteboard;
 @class NSString;
 @class NSURL;
-@class NSThread;
-@class NSConditionLock;
-@class NSLock;
+@class GSSoundVoice;
 
 /** Function used to retrieve all available playback devices.
  *  <p>This function is the only way to retrieve possible playback
@@ -58,16 +56,15 @@ NSArray *PlaybackDeviceIdentifiers (void);
 {		
   NSString *_name;
   NSData   *_data;
-  NSString *_playbackDeviceIdentifier; // Currently unused
-  NSArray  *_channelMapping; // Currently unused
+  NSString *_playbackDeviceIdentifier;
+  NSArray  *_channelMapping;
   BOOL     _onlyReference;
   id       _delegate;
   
   id<GSSoundSource> _source;
-  id<GSSoundSink>   _sink;
-  NSConditionLock   *_readLock;
-  NSLock            * _playbackLock;
-  BOOL _shouldStop;
+  NSData            *_pcm;
+  GSSoundVoice      *_voice;
+  float             _volume;
   BOOL _shouldLoop;
 }
 
@@ -116,7 +113,8 @@ NSArray *PlaybackDeviceIdentifiers (void);
  *  and YES if receiver was successfully paused.</p>
  */
 - (BOOL)pause;
-/** Start audio playback.  Playback is done asynchronously.
+/** Start audio playback.  Playback is done asynchronously, all sounds
+ *  are mixed by a single thread into one shared playback device.
  *  <p>Returns NO if receiver is already playing or if an error occurred, and
  *  YES if receiver was started successfully.</p>
  */
@@ -128,7 +126,8 @@ NSArray *PlaybackDeviceIdentifiers (void);
 - (BOOL)resume;
 /** Stop audio playback.
  *  <p>Return YES if receiver was successfully stopped.</p>
- *  <p>This method will close the playback device.</p>
+ *  <p>The shared playback device is closed once no sound has been
+ *  playing for a few seconds.</p>
  */
 - (BOOL)stop;
 /* Returns YES if receiver is playing and NO otherwise.
@@ -203,8 +202,16 @@ NSArray *PlaybackDeviceIdentifiers (void);
 - (void)setLoops: (BOOL)loops;
 
 - (NSString *)playbackDeviceIdentifier;
+/** Sets the device the receiver is played on.
+ *  <p>GNUstep mixes all sounds into a single output, so the device (and
+ *  the channel mapping) of the sound which was started or changed last
+ *  is used for every sound playing.</p>
+ */
 - (void)setPlaybackDeviceIdentifier: (NSString *)playbackDeviceIdentifier;
 - (NSArray *)channelMapping;
+/** Sets the channel mapping used when the receiver is played.  See
+ *  -setPlaybackDeviceIdentifier: for how it applies to other sounds.
+ */
 - (void)setChannelMapping: (NSArray *)channelMapping;
 #endif
 
@@ -181,6 +181,16 @@ extern NSString *NSSpeechDictionaryEntryPhonemes;
 - (void) speechSynthesizer: (NSSpeechSynthesizer *)sender 
              willSpeakWord: (NSRange)range 
                   ofString: (NSString *)string;
+
+#if OS_API_VERSION(GS_API_NONE, GS_API_NONE)
+/**
+ * GNUstep extension, sent to the delegate when the synthesizer starts
+ * speaking the sentence at range in string.
+ */
+- (void) speechSynthesizer: (NSSpeechSynthesizer *)sender
+         willSpeakSentence: (NSRange)range
+                  ofString: (NSString *)string;
+#endif
 @end
 
 #endif // _GNUstep_H_NSSpeechSynthesizer
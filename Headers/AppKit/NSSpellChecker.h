@@ -59,6 +59,8 @@ enum
   id _serverProxy;
   NSString *_language;
   NSMutableDictionary *_ignoredWords;
+  NSMutableDictionary *_wordCaches;
+  id _cacheLock;
 
   // Variables to keep state...
   int _position; 
@@ -141,6 +143,38 @@ enum
 
 @end
 
+#if OS_API_VERSION(GS_API_NONE, GS_API_NONE)
+/**
+ * <p>Methods checking all of a piece of text at once.  The words in it
+ * are looked up in a cache for the spell document first, which holds
+ * the words the spell server has accepted or rejected before, so only
+ * new words are sent to the server.  The cache is emptied when the
+ * language changes or a word is learned or forgotten.</p>
+ */
+@interface NSSpellChecker (GNUstepExtensions)
+/** Returns the ranges of all misspelled words of stringToCheck within
+ * range, as NSValue objects in the order they appear.  The range is
+ * taken to start and end at word boundaries.
+ */
+- (NSArray *) misspelledRangesInString: (NSString *)stringToCheck
+                                 range: (NSRange)range
+                inSpellDocumentWithTag: (NSInteger)tag;
+
+/** Checks range of stringToCheck like
+ * -misspelledRangesInString:range:inSpellDocumentWithTag:, but on a
+ * background thread.  Once done, selector is sent to target on the main
+ * thread with a dictionary holding the text checked under @"String",
+ * range under @"Range" and the misspelled ranges under @"Ranges".
+ * Callers should check that the text did not change meanwhile.
+ */
+- (void) requestMisspelledRangesInString: (NSString *)stringToCheck
+                                   range: (NSRange)range
+                  inSpellDocumentWithTag: (NSInteger)tag
+                                  target: (id)target
+                                selector: (SEL)selector;
+@end
+#endif
+
 typedef NSInteger NSCorrectionResponse;
 enum
 {
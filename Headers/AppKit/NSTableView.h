@@ -36,6 +36,7 @@
 
 @class NSArray;
 @class NSIndexSet;
+@class NSMapTable;
 @class NSMutableIndexSet;
 @class NSTableColumn;
 @class NSTableHeaderView;
@@ -149,6 +150,14 @@ typedef enum _NSTableViewAnimationOptions
   /* YES if _dataSource responds to
      tableView:setObjectValue:forTableColumn:row: */
   BOOL   _dataSource_editable;
+  /* YES if _dataSource responds to tableView:prefetchRowsWithIndexes:.
+     The object values of the rows around the visible ones are then
+     cached until the data is reloaded. */
+  BOOL   _dataSource_prefetches;
+  NSMapTable *_objectValueCache;
+  NSMutableIndexSet *_prefetchedRows;
+  NSRange _prefetchVisibleRows;
+  NSTimeInterval _prefetchTime;
 
   /*
    * We cache column origins (precisely, the x coordinate of the left
@@ -439,6 +448,28 @@ writeRowsWithIndexes: (NSIndexSet*)rows
 namesOfPromisedFilesDroppedAtDestination: (NSURL *)dropDestination
 forDraggedRowsWithIndexes: (NSIndexSet *)indexSet;
 #endif
+
+#if OS_API_VERSION(GS_API_NONE, GS_API_NONE)
+/**
+ * Tells the data source that the rows in <em>rows</em> are likely to be
+ * displayed soon, so that it can start loading them.  The rows are
+ * chosen ahead of the visible ones in the direction the table is being
+ * scrolled, and further ahead the faster it scrolls.  A data source
+ * implementing this method has the object values of the rows around
+ * the visible ones cached by the table view, so it must call
+ * -reloadData or -reloadDataForRowIndexes:columnIndexes: when its data
+ * changes.
+ */
+- (void) tableView: (NSTableView *)aTableView
+prefetchRowsWithIndexes: (NSIndexSet *)rows;
+/**
+ * Tells the data source that rows passed to
+ * -tableView:prefetchRowsWithIndexes: are no longer needed soon, because
+ * the table was scrolled elsewhere.
+ */
+- (void) tableView: (NSTableView *)aTableView
+cancelPrefetchingForRowsWithIndexes: (NSIndexSet *)rows;
+#endif
 @end
 
 APPKIT_EXPORT NSString *NSTableViewColumnDidMoveNotification;
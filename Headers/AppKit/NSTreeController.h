@@ -37,6 +37,7 @@
 
 @class NSString;
 @class NSArray;
+@class NSMutableArray;
 @class NSIndexPath;
 @class NSTreeNode;
 
@@ -46,6 +47,8 @@
   NSString *_countKeyPath;
   NSString *_leafKeyPath;
   NSArray *_sortDescriptors;
+  NSTreeNode *_arrangedObjects;
+  NSMutableArray *_selectedNodes;
   BOOL _alwaysUsesMultipleValuesMarker;
   BOOL _avoidsEmptySelection;
   BOOL _preservesSelection;
@@ -165,6 +165,9 @@ PACKAGE_SCOPE
     unsigned	has_tooltips:1;		/* The view has tooltips set.	*/
     unsigned	ignores_backing:1;      /* The view does not trigger    */
                                         /* backing flush when drawn     */
+    unsigned	has_prepared_rect:1;	/* preparedContentRect was set.	*/
+    unsigned	prepares_content:1;	/* Clip view keeps the content	*/
+					/* around its visible rect.	*/
   } _rFlags;
 
   BOOL _is_rotated_from_base;
@@ -382,6 +385,14 @@ PACKAGE_SCOPE
 - (void) getRectsExposedDuringLiveResize: (NSRect[4])exposedRects count: (NSInteger *)count;
 - (NSRect) rectPreservedDuringLiveResize;
 #endif
+#if OS_API_VERSION(MAC_OS_X_VERSION_10_9, GS_API_LATEST)
+/*
+ * Responsive scrolling
+ */
+- (NSRect) preparedContentRect;
+- (void) setPreparedContentRect: (NSRect)rect;
+- (void) prepareContentInRect: (NSRect)rect;
+#endif
 
 
 /*
@@ -34,6 +34,7 @@
 
 #import "GSGuiPrivate.h"
 #import "AppKit/NSApplication.h"
+#import "AppKit/NSBezierPath.h"
 #import "AppKit/NSBitmapImageRep.h"
 #import "AppKit/NSNibLoading.h"
 #import "AppKit/NSEvent.h"
@@ -694,6 +695,13 @@ void NSRectClipList(const NSRect *rects, NSInteger count)
 void NSRectFill(NSRect aRect)
 {
   NSGraphicsContext *ctxt = GSCurrentContext();
+
+  if ([ctxt GSCurrentShadow] != nil)
+    {
+      // Let NSBezierPath draw the shadow.
+      [[NSBezierPath bezierPathWithRect: aRect] fill];
+      return;
+    }
   DPSrectfill(ctxt, NSMinX(aRect), NSMinY(aRect), 
 	      NSWidth(aRect), NSHeight(aRect));
 }
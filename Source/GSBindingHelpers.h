@@ -83,6 +83,8 @@
 {
   NSArray *_array;
 }
+- (void) _insertObjects: (NSArray *)objects atIndexes: (NSIndexSet *)indexes;
+- (void) _removeObjectsAtIndexes: (NSIndexSet *)indexes;
 @end
 
 #endif //_GS_BINDING_HELPER_H
@@ -66,14 +66,6 @@
                   insideRect: rect
                       toData: data
                    printInfo: aPrintInfo];
-                   
-  _path = [NSTemporaryDirectory() stringByAppendingPathComponent: @"GSPrint-"];
-  
-  _path = [_path stringByAppendingString: 
-		               [[NSProcessInfo processInfo] globallyUniqueString]];
-           
-  _path = [_path stringByAppendingPathExtension: @"ps"];
-  RETAIN(_path); 
   return self;
 }
 
@@ -118,6 +110,10 @@
 
 - (BOOL)deliverResult
 {
+  if ([self _collectDataOutput])
+    {
+      return YES;
+    }
   if (_data != nil && _path != nil)
     {
       NSString	*eps;
@@ -133,13 +129,30 @@
 - (NSGraphicsContext*)createContext
 {
   NSMutableDictionary *info;
+  NSString *output;
 
   if (_context)
     return _context;
 
+  output = _path;
+  if (output == nil)
+    {
+      /* Write straight into the data if we can */
+      output = [self _dataOutputPath];
+    }
+  if (output == nil)
+    {
+      _path = [NSTemporaryDirectory() stringByAppendingPathComponent: @"GSPrint-"];
+      _path = [_path stringByAppendingString: 
+                       [[NSProcessInfo processInfo] globallyUniqueString]];
+      _path = [_path stringByAppendingPathExtension: @"ps"];
+      RETAIN(_path);
+      output = _path;
+    }
+
   info = [[self printInfo] dictionary];
   
-  [info setObject: _path 
+  [info setObject: output
            forKey: @"NSOutputFile"];
   
   [info setObject: NSGraphicsContextPSFormat
@@ -31,6 +31,7 @@
 */
 
 #include <math.h>
+#include <stdlib.h>
 
 #import <Foundation/NSAffineTransform.h>
 #import <Foundation/NSArray.h>
@@ -38,6 +39,7 @@
 #import <Foundation/NSDictionary.h>
 #import <Foundation/NSEnumerator.h>
 #import <Foundation/NSException.h>
+#import <Foundation/NSLock.h>
 #import <Foundation/NSSet.h>
 #import <Foundation/NSString.h>
 #import <Foundation/NSValue.h>
@@ -51,6 +53,52 @@ static Class fontInfoClass = Nil;
 
 static GSFontEnumerator *sharedEnumerator = nil;
 
+/* The character to glyph cache of a font is split into pages of
+   GLYPH_PAGE_SIZE characters, which are only allocated when a character
+   in them is first looked up. */
+#define GLYPH_PAGE_SHIFT 8
+#define GLYPH_PAGE_SIZE (1 << GLYPH_PAGE_SHIFT)
+#define GLYPH_PAGE_COUNT (0x10000 >> GLYPH_PAGE_SHIFT)
+/* Marks cache entries which have not been looked up yet */
+#define GSUncachedGlyph ((NSGlyph)0xffffffff)
+/* Fonts are shared between threads laying out text, so glyph cache pages
+   are allocated with this lock held. */
+static NSLock *glyphPageLock = nil;
+
+/* Append object to the array stored under key in index, creating the
+   array on first use. */
+static void
+addToIndex(NSMutableDictionary *index, id key, id object)
+{
+  NSMutableArray *entries;
+
+  if (key == nil)
+    {
+      return;
+    }
+  entries = [index objectForKey: key];
+  if (entries == nil)
+    {
+      entries = [[NSMutableArray alloc] initWithCapacity: 4];
+      [index setObject: entries forKey: key];
+      RELEASE(entries);
+    }
+  [entries addObject: object];
+}
+
+static inline NSNumber *
+traitsKey(NSFontTraitMask traits)
+{
+  return [NSNumber numberWithUnsignedInt: traits];
+}
+
+static inline NSNumber *
+styleKey(int weight, NSFontTraitMask traits)
+{
+  return [NSNumber numberWithUnsignedLongLong:
+    ((unsigned long long)(unsigned int)weight << 32) | traits];
+}
+
 @implementation GSFontEnumerator
 
 + (void) setDefaultClass: (Class)defaultClass
@@ -70,6 +118,12 @@ static GSFontEnumerator *sharedEnumerator = nil;
 {
   RELEASE(allFontNames);
   RELEASE(allFontFamilies);
+  TEST_RELEASE(allFontDescriptors);
+  TEST_RELEASE(fontDescriptorsByName);
+  TEST_RELEASE(fontDescriptorsByFamily);
+  TEST_RELEASE(fontDescriptorsByFace);
+  TEST_RELEASE(fontDescriptorsByTraits);
+  TEST_RELEASE(fontNamesByFamilyStyle);
   [super dealloc];
 }
 
@@ -106,6 +160,11 @@ static GSFontEnumerator *sharedEnumerator = nil;
   return [allFontFamilies objectForKey: family];
 }
 
+/*
+ * Builds the font descriptors for all enumerated fonts together with the
+ * indexes used by the matching methods below. This happens once, on first
+ * use after -enumerateFontsAndFamilies has filled in allFontFamilies.
+ */
 - (NSArray*) availableFontDescriptors
 {
   if (allFontDescriptors == nil)
@@ -115,13 +174,22 @@ static GSFontEnumerator *sharedEnumerator = nil;
       NSString *family;
 
       fontDescriptors = [[NSMutableArray alloc] init];
-      keyEnumerator = [allFontFamilies keyEnumerator];
+      fontDescriptorsByName = [[NSMutableDictionary alloc] init];
+      fontDescriptorsByFamily = [[NSMutableDictionary alloc] init];
+      fontDescriptorsByFace = [[NSMutableDictionary alloc] init];
+      fontDescriptorsByTraits = [[NSMutableDictionary alloc] init];
+      fontNamesByFamilyStyle = [[NSMutableDictionary alloc] init];
+      keyEnumerator = [[self availableFontFamilies] objectEnumerator];
       while ((family = [keyEnumerator nextObject]) != nil)
         {
           NSArray *fontDefs = [allFontFamilies objectForKey: family];
+          NSMutableDictionary *styles;
           NSEnumerator *fdEnumerator;
           NSArray *fontDef;
 
+          styles = [[NSMutableDictionary alloc] init];
+          [fontNamesByFamilyStyle setObject: styles forKey: family];
+          RELEASE(styles);
           fdEnumerator = [fontDefs objectEnumerator];
           while ((fontDef = [fdEnumerator nextObject]) != nil)
             {
@@ -130,6 +198,7 @@ static GSFontEnumerator *sharedEnumerator = nil;
               NSNumber *weight = [fontDef objectAtIndex: 2];
               NSNumber *traits = [fontDef objectAtIndex: 3];
               NSDictionary *fontTraits;
+              NSNumber *key;
               float fweight = ([weight intValue] - 6) / 6.0;
 
               fontTraits = [NSDictionary dictionaryWithObjectsAndKeys:
@@ -146,6 +215,21 @@ static GSFontEnumerator *sharedEnumerator = nil;
               fd = [[NSFontDescriptor alloc] initWithFontAttributes: attributes];
 
               [fontDescriptors addObject: fd];
+              if ([fontDescriptorsByName objectForKey:
+                                           [fontDef objectAtIndex: 0]] == nil)
+                {
+                  [fontDescriptorsByName setObject: fd
+                                            forKey: [fontDef objectAtIndex: 0]];
+                }
+              addToIndex(fontDescriptorsByFamily, family, fd);
+              addToIndex(fontDescriptorsByFace, [fontDef objectAtIndex: 1], fd);
+              addToIndex(fontDescriptorsByTraits,
+                         traitsKey([traits unsignedIntValue]), fd);
+              key = styleKey([weight intValue], [traits unsignedIntValue]);
+              if ([styles objectForKey: key] == nil)
+                {
+                  [styles setObject: [fontDef objectAtIndex: 0] forKey: key];
+                }
               RELEASE(fd);
             }
         }
@@ -246,6 +330,45 @@ static GSFontEnumerator *sharedEnumerator = nil;
   return match;
 }
 
+/*
+ * Returns the smallest set of font descriptors that may match attributes,
+ * using the most selective index for which a value is given.
+ */
+- (NSArray *) _candidateFontDescriptorsFor: (NSDictionary *)attributes
+{
+  NSArray *all = [self availableFontDescriptors];
+  NSNumber *traits;
+  id value;
+
+  // A subclass may have provided its own descriptors without indexes
+  if (fontDescriptorsByName == nil)
+    {
+      return all;
+    }
+  if ((value = [attributes objectForKey: NSFontNameAttribute]) != nil)
+    {
+      NSFontDescriptor *fd = [fontDescriptorsByName objectForKey: value];
+
+      return (fd != nil) ? [NSArray arrayWithObject: fd] : [NSArray array];
+    }
+  if ((value = [attributes objectForKey: NSFontFamilyAttribute]) != nil)
+    {
+      all = [fontDescriptorsByFamily objectForKey: value];
+    }
+  else if ((value = [attributes objectForKey: NSFontFaceAttribute]) != nil)
+    {
+      all = [fontDescriptorsByFace objectForKey: value];
+    }
+  else if ((traits = [[attributes objectForKey: NSFontTraitsAttribute]
+                        objectForKey: NSFontSymbolicTrait]) != nil)
+    {
+      all = [fontDescriptorsByTraits objectForKey:
+                                       traitsKey([traits unsignedIntValue])];
+    }
+
+  return (all != nil) ? all : [NSArray array];
+}
+
 - (NSArray *) matchingFontDescriptorsFor: (NSDictionary *)attributes
 {
   NSMutableArray *found;
@@ -253,8 +376,9 @@ static GSFontEnumerator *sharedEnumerator = nil;
   NSFontDescriptor *fd;
 
   found = [NSMutableArray arrayWithCapacity: 3];
-  // Get an enumerator for all available font descriptors
-  fdEnumerator = [[self availableFontDescriptors] objectEnumerator];
+  // Only check the descriptors the indexes could not rule out
+  fdEnumerator = [[self _candidateFontDescriptorsFor: attributes]
+                   objectEnumerator];
   while ((fd = [fdEnumerator nextObject]) != nil)
     {
       if ([self _fontDescriptor: fd matches: attributes])
@@ -295,18 +419,18 @@ static GSFontEnumerator *sharedEnumerator = nil;
                                  exculsion: (NSArray *)exclusionDescriptors
 {
   NSMutableArray *r = [NSMutableArray arrayWithCapacity: 50];
-  NSEnumerator *en = [[self availableFontDescriptors] objectEnumerator];
+  NSArray *candidates = [self availableFontDescriptors];
+  NSEnumerator *en;
   NSFontDescriptor *fd;
 
+  // Restrict the search to the family if one is given
+  if (family != nil)
+    {
+      candidates = [fontDescriptorsByFamily objectForKey: family];
+    }
+  en = [candidates objectEnumerator];
   while ((fd = [en nextObject]) != nil)
     {
-      // Check if the font descriptor matches the family value if one is given
-      if ((family != nil) &&
-          ![[fd objectForKey: NSFontFamilyAttribute] isEqualToString: family])
-        {
-          continue;
-        }
-
       // Check if the font descriptor matches any of the query descriptors
       if (![self _fontDescriptor: fd matchesAny: queryDescriptors])
         {
@@ -326,6 +450,38 @@ static GSFontEnumerator *sharedEnumerator = nil;
   return r;
 }
 
+- (NSFontDescriptor *) fontDescriptorForFontName: (NSString *)fontName
+{
+  [self availableFontDescriptors];
+  return [fontDescriptorsByName objectForKey: fontName];
+}
+
+- (NSArray *) availableFontNamesWithTraits: (NSFontTraitMask)traits
+{
+  NSMutableArray *fontNames = [NSMutableArray array];
+  NSEnumerator *fdEnumerator;
+  NSFontDescriptor *fd;
+
+  [self availableFontDescriptors];
+  fdEnumerator = [[fontDescriptorsByTraits objectForKey: traitsKey(traits)]
+                   objectEnumerator];
+  while ((fd = [fdEnumerator nextObject]) != nil)
+    {
+      [fontNames addObject: [fd objectForKey: NSFontNameAttribute]];
+    }
+
+  return fontNames;
+}
+
+- (NSString *) fontNameForFamily: (NSString *)family
+                          weight: (int)weight
+                          traits: (NSFontTraitMask)traits
+{
+  [self availableFontDescriptors];
+  return [[fontNamesByFamilyStyle objectForKey: family]
+           objectForKey: styleKey(weight, traits)];
+}
+
 - (NSString *) defaultSystemFontName
 {
   return @"Helvetica";
@@ -351,6 +507,14 @@ static GSFontEnumerator *sharedEnumerator = nil;
 
 @implementation GSFontInfo
 
++ (void) initialize
+{
+  if (self == [GSFontInfo class])
+    {
+      glyphPageLock = [NSLock new];
+    }
+}
+
 + (void) setDefaultClass: (Class)defaultClass
 {
   fontInfoClass = defaultClass;
@@ -451,6 +615,16 @@ static GSFontEnumerator *sharedEnumerator = nil;
 
 - (void) dealloc
 {
+  if (glyphPages != NULL)
+    {
+      unsigned int i;
+
+      for (i = 0; i < GLYPH_PAGE_COUNT; i++)
+        {
+          free(glyphPages[i]);
+        }
+      free(glyphPages);
+    }
   RELEASE(coveredCharacterSet);
   RELEASE(fontDictionary);
   RELEASE(fontName);
@@ -473,6 +647,7 @@ static GSFontEnumerator *sharedEnumerator = nil;
       copy->familyName = [familyName copyWithZone: zone];
       copy->encodingScheme = [encodingScheme copyWithZone: zone];
       copy->fontDescriptor = [fontDescriptor copyWithZone: zone];
+      copy->glyphPages = NULL;
     }
   return copy;
 }
@@ -488,6 +663,7 @@ static GSFontEnumerator *sharedEnumerator = nil;
   copy->familyName = [familyName copyWithZone: zone];
   copy->encodingScheme = [encodingScheme copyWithZone: zone];
   copy->fontDescriptor = [fontDescriptor copyWithZone: zone];
+  copy->glyphPages = NULL;
   return copy;
 }
 
@@ -831,6 +1007,51 @@ static GSFontEnumerator *sharedEnumerator = nil;
     return NSNullGlyph;
 }
 
+- (NSGlyph) cachedGlyphForCharacter: (unichar)theChar
+{
+  NSGlyph *page = NULL;
+  NSGlyph glyph;
+
+  if (glyphPages != NULL)
+    {
+      page = glyphPages[theChar >> GLYPH_PAGE_SHIFT];
+    }
+  if (page == NULL)
+    {
+      /* Look again with the lock held, another thread may have just
+         allocated the page.  A page is filled in before it is stored,
+         so threads reading it without the lock never see it unset.
+         Entries are single words, written with the same value by any
+         thread looking them up. */
+      [glyphPageLock lock];
+      if (glyphPages == NULL)
+        {
+          glyphPages = calloc(GLYPH_PAGE_COUNT, sizeof(NSGlyph *));
+        }
+      page = glyphPages[theChar >> GLYPH_PAGE_SHIFT];
+      if (page == NULL)
+        {
+          unsigned int i;
+
+          page = malloc(GLYPH_PAGE_SIZE * sizeof(NSGlyph));
+          for (i = 0; i < GLYPH_PAGE_SIZE; i++)
+            {
+              page[i] = GSUncachedGlyph;
+            }
+          glyphPages[theChar >> GLYPH_PAGE_SHIFT] = page;
+        }
+      [glyphPageLock unlock];
+    }
+
+  glyph = page[theChar & (GLYPH_PAGE_SIZE - 1)];
+  if (glyph == GSUncachedGlyph)
+    {
+      glyph = [self glyphForCharacter: theChar];
+      page[theChar & (GLYPH_PAGE_SIZE - 1)] = glyph;
+    }
+  return glyph;
+}
+
 - (NSFontDescriptor*) fontDescriptor
 {
   if (fontDescriptor == nil)
@@ -28,14 +28,19 @@
 
 #include <math.h>
 
+#import <Foundation/NSArray.h>
+#import <Foundation/NSAutoreleasePool.h>
 #import <Foundation/NSDebug.h>
 #import <Foundation/NSException.h>
 #import <Foundation/NSGeometry.h>
 #import <Foundation/NSLock.h>
+#import <Foundation/NSOperation.h>
+#import <Foundation/NSProcessInfo.h>
 #import <Foundation/NSThread.h>
 #import <Foundation/NSValue.h>
 
 #import "AppKit/NSAttributedString.h"
+#import "AppKit/NSFont.h"
 #import "AppKit/NSParagraphStyle.h"
 #import "AppKit/NSTextAttachment.h"
 #import "AppKit/NSTextContainer.h"
@@ -52,8 +57,366 @@ cache fairly aggressively without having to worry about memory consumption.
 */
 
 
+/*
+Concurrent paragraph typesetting.
+
+In a simple rectangular text container of unlimited height, the layout of
+a paragraph only depends on the paragraph itself and the vertical position
+it starts at, and moving it down is a plain offset. If the layout manager
+asks for it (-typesetsParagraphsConcurrently), we thus take a snapshot of
+each paragraph's glyphs and text, lay the paragraphs out at y=0 on the
+threads of an operation queue (each with its thread's shared typesetter
+instance), and then replay the recorded layout into the real layout
+manager one paragraph after the other, moving each down to where the
+previous one ended.
+
+A GSParagraphLayoutRecorder stands in for the layout manager (and its text
+storage) of the worker typesetter. It only implements the methods
+GSHorizontalTypesetter uses. Fonts and their backend font info objects
+aren't safe to use from several threads, so the recorder hands out
+GSRecordedFont objects instead, which hold the few metrics the typesetter
+asks for, read on the main thread. For the same reason each worker gets
+its own copy of the text container.
+*/
+
+/* Don't bother with less text than this. */
+#define CONCURRENT_MIN_CHARACTERS 16384
+/* Amount of text snapshotted and laid out in one go. */
+#define CONCURRENT_BATCH_CHARACTERS 65536
+
+typedef enum
+{
+  GSLayoutRecordTextContainer,
+  GSLayoutRecordLineFragment,
+  GSLayoutRecordDrawsOutside,
+  GSLayoutRecordNotShown,
+  GSLayoutRecordLocation,
+  GSLayoutRecordAttachmentSize
+} GSLayoutRecordType;
+
+typedef struct
+{
+  GSLayoutRecordType type;
+  NSRange range; /* glyphs, relative to the paragraph */
+  NSRect rect;
+  NSRect used;   /* also the location or attachment size */
+} layout_record_t;
+
+@interface GSRecordedFont : NSObject
+{
+  CGFloat ascender;
+  CGFloat descender;
+  CGFloat defaultLineHeight;
+  CGFloat xHeight;
+}
+- (id) initWithFont: (NSFont *)font;
+- (CGFloat) ascender;
+- (CGFloat) descender;
+- (CGFloat) defaultLineHeightForFont;
+- (CGFloat) xHeight;
+@end
+
+@interface GSParagraphLayoutRecorder : NSObject
+{
+@public
+  NSAttributedString *text;
+  NSRange glyphRange; /* in the real layout manager */
+  NSRange characterRange;
+  unsigned int num_glyphs;
+  NSGlyph *glyphs;
+  unsigned int *characters; /* relative to the paragraph */
+  NSSize *advancements;
+
+  unsigned int num_font_runs, font_run;
+  GSRecordedFont **fonts;
+  unsigned int *font_run_ends;
+
+  layout_record_t *records;
+  unsigned int num_records, size_records;
+  CGFloat height;
+  BOOL failed;
+}
+- (id) initWithLayoutManager: (GSLayoutManager *)layoutManager
+                  glyphRange: (NSRange)aGlyphRange
+              characterRange: (NSRange)charRange;
+- (void) replayInLayoutManager: (GSLayoutManager *)layoutManager
+                 textContainer: (NSTextContainer *)textContainer
+                       yOffset: (CGFloat)dy;
+@end
+
+@interface GSParagraphLayoutOperation : NSOperation
+{
+  GSParagraphLayoutRecorder *recorder;
+  NSTextContainer *textContainer;
+}
+- (id) initWithRecorder: (GSParagraphLayoutRecorder *)aRecorder
+          textContainer: (NSTextContainer *)aTextContainer;
+- (GSParagraphLayoutRecorder *) recorder;
+@end
+
+static NSOperationQueue *typesetQueue = nil;
+static NSLock *typesetQueueLock = nil;
+
+
+/*
+Line breaking, following the pair table algorithm of UAX #14 (Unicode
+Line Breaking Algorithm) for a subset of its classes. Classes we don't
+distinguish are folded into the closest one we do (CP into CL, WJ into GL,
+B2 into BA, H2/H3/JL/JV/JT and the ideographs outside the BMP into ID,
+everything unlisted into AL).
+*/
+typedef enum
+{
+  LB_OP, LB_CL, LB_QU, LB_GL, LB_NS, LB_EX, LB_SY, LB_IS,
+  LB_PR, LB_PO, LB_NU, LB_AL, LB_ID, LB_HY, LB_BA, LB_BB,
+  /* These are handled outside the pair table. */
+  LB_ZW, LB_CM, LB_SP, LB_BK
+} GSLineBreakClass;
+
+/*
+Rows are the class before, columns the class after a position:
+  _  direct break
+  %  indirect break, only if there are spaces in between
+  ^  no break, even with spaces in between
+*/
+static const char *lineBreakPairs[16] = {
+/*  OP CL QU GL NS EX SY IS PR PO NU AL ID HY BA BB */
+  "^^^^^^^^^^^^^^^^", /* OP */
+  "_^%%^^^^%%___%%_", /* CL */
+  "^^%%%^^^%%%%%%%%", /* QU */
+  "%^%%%^^^%%%%%%%%", /* GL */
+  "_^%%%^^^_____%%_", /* NS */
+  "_^%%%^^^_____%%_", /* EX */
+  "_^%%%^^^__%__%%_", /* SY */
+  "_^%%%^^^__%%_%%_", /* IS */
+  "%^%%%^^^__%%%%%_", /* PR */
+  "%^%%%^^^__%%_%%_", /* PO */
+  "%^%%%^^^%%%%_%%_", /* NU */
+  "%^%%%^^^%%%%_%%_", /* AL */
+  "_^%%%^^^_%___%%_", /* ID */
+  "_^%_%^^^__%__%%_", /* HY */
+  "_^%_%^^^_____%%_", /* BA */
+  "%^%%%^^^%%%%%%%%", /* BB */
+};
+
+static const struct
+{
+  unichar first, last;
+  unsigned char cls;
+} lineBreakRanges[] = {
+  {0x0000, 0x0008, LB_CM}, {0x0009, 0x0009, LB_BA}, {0x000A, 0x000D, LB_BK},
+  {0x000E, 0x001F, LB_CM}, {0x0020, 0x0020, LB_SP}, {0x0021, 0x0021, LB_EX},
+  {0x0022, 0x0022, LB_QU}, {0x0024, 0x0024, LB_PR}, {0x0025, 0x0025, LB_PO},
+  {0x0027, 0x0027, LB_QU}, {0x0028, 0x0028, LB_OP}, {0x0029, 0x0029, LB_CL},
+  {0x002B, 0x002B, LB_PR}, {0x002C, 0x002C, LB_IS}, {0x002D, 0x002D, LB_HY},
+  {0x002E, 0x002E, LB_IS}, {0x002F, 0x002F, LB_SY}, {0x0030, 0x0039, LB_NU},
+  {0x003A, 0x003B, LB_IS}, {0x003F, 0x003F, LB_EX}, {0x005B, 0x005B, LB_OP},
+  {0x005C, 0x005C, LB_PR}, {0x005D, 0x005D, LB_CL}, {0x007B, 0x007B, LB_OP},
+  {0x007C, 0x007C, LB_BA}, {0x007D, 0x007D, LB_CL}, {0x007F, 0x0084, LB_CM},
+  {0x0085, 0x0085, LB_BK}, {0x0086, 0x009F, LB_CM}, {0x00A0, 0x00A0, LB_GL},
+  {0x00A1, 0x00A1, LB_OP}, {0x00A2, 0x00A2, LB_PO}, {0x00A3, 0x00A5, LB_PR},
+  {0x00AB, 0x00AB, LB_QU}, {0x00AD, 0x00AD, LB_BA}, {0x00B0, 0x00B0, LB_PO},
+  {0x00B1, 0x00B1, LB_PR}, {0x00B4, 0x00B4, LB_BB}, {0x00BB, 0x00BB, LB_QU},
+  {0x00BF, 0x00BF, LB_OP}, {0x0300, 0x036F, LB_CM}, {0x0483, 0x0489, LB_CM},
+  {0x0591, 0x05BD, LB_CM}, {0x05BF, 0x05BF, LB_CM}, {0x05C1, 0x05C2, LB_CM},
+  {0x05C4, 0x05C5, LB_CM}, {0x05C7, 0x05C7, LB_CM}, {0x0610, 0x061A, LB_CM},
+  {0x064B, 0x065F, LB_CM}, {0x0670, 0x0670, LB_CM}, {0x06D6, 0x06DC, LB_CM},
+  {0x06DF, 0x06E4, LB_CM}, {0x06E7, 0x06E8, LB_CM}, {0x06EA, 0x06ED, LB_CM},
+  {0x0900, 0x0903, LB_CM}, {0x093A, 0x094F, LB_CM}, {0x0951, 0x0957, LB_CM},
+  {0x0962, 0x0963, LB_CM}, {0x0964, 0x0965, LB_BA}, {0x0F0B, 0x0F0B, LB_BA},
+  {0x1100, 0x11FF, LB_ID}, {0x1680, 0x1680, LB_BA}, {0x1AB0, 0x1AFF, LB_CM},
+  {0x1DC0, 0x1DFF, LB_CM}, {0x2000, 0x2006, LB_BA}, {0x2007, 0x2007, LB_GL},
+  {0x2008, 0x200A, LB_BA}, {0x200B, 0x200B, LB_ZW}, {0x200C, 0x200F, LB_CM},
+  {0x2010, 0x2010, LB_BA}, {0x2011, 0x2011, LB_GL}, {0x2012, 0x2014, LB_BA},
+  {0x2018, 0x2019, LB_QU}, {0x201A, 0x201A, LB_OP}, {0x201B, 0x201D, LB_QU},
+  {0x201E, 0x201E, LB_OP}, {0x201F, 0x201F, LB_QU}, {0x2027, 0x2027, LB_BA},
+  {0x2028, 0x2029, LB_BK}, {0x202A, 0x202E, LB_CM}, {0x202F, 0x202F, LB_GL},
+  {0x2030, 0x2037, LB_PO}, {0x2039, 0x203A, LB_QU}, {0x203C, 0x203D, LB_NS},
+  {0x2044, 0x2044, LB_IS}, {0x2045, 0x2045, LB_OP}, {0x2046, 0x2046, LB_CL},
+  {0x2047, 0x2049, LB_NS}, {0x2060, 0x2060, LB_GL}, {0x2061, 0x206F, LB_CM},
+  {0x207D, 0x207D, LB_OP}, {0x207E, 0x207E, LB_CL}, {0x208D, 0x208D, LB_OP},
+  {0x208E, 0x208E, LB_CL}, {0x20A0, 0x20CF, LB_PR}, {0x20D0, 0x20FF, LB_CM},
+  {0x2103, 0x2103, LB_PO}, {0x2109, 0x2109, LB_PO}, {0x2116, 0x2116, LB_PR},
+  {0x2E80, 0x2FFF, LB_ID}, {0x3000, 0x3000, LB_BA}, {0x3001, 0x3002, LB_CL},
+  {0x3003, 0x3004, LB_ID}, {0x3005, 0x3005, LB_NS}, {0x3006, 0x3007, LB_ID},
+  {0x3008, 0x3008, LB_OP}, {0x3009, 0x3009, LB_CL}, {0x300A, 0x300A, LB_OP},
+  {0x300B, 0x300B, LB_CL}, {0x300C, 0x300C, LB_OP}, {0x300D, 0x300D, LB_CL},
+  {0x300E, 0x300E, LB_OP}, {0x300F, 0x300F, LB_CL}, {0x3010, 0x3010, LB_OP},
+  {0x3011, 0x3011, LB_CL}, {0x3012, 0x3013, LB_ID}, {0x3014, 0x3014, LB_OP},
+  {0x3015, 0x3015, LB_CL}, {0x3016, 0x3016, LB_OP}, {0x3017, 0x3017, LB_CL},
+  {0x3018, 0x3018, LB_OP}, {0x3019, 0x3019, LB_CL}, {0x301A, 0x301A, LB_OP},
+  {0x301B, 0x301B, LB_CL}, {0x301C, 0x301C, LB_NS}, {0x301D, 0x301D, LB_OP},
+  {0x301E, 0x301F, LB_CL}, {0x3020, 0x3029, LB_ID}, {0x302A, 0x302F, LB_CM},
+  {0x3030, 0x303A, LB_ID}, {0x303B, 0x303C, LB_NS}, {0x303D, 0x3098, LB_ID},
+  {0x3099, 0x309A, LB_CM}, {0x309B, 0x309E, LB_NS}, {0x309F, 0x309F, LB_ID},
+  {0x30A0, 0x30A0, LB_NS}, {0x30A1, 0x30FA, LB_ID}, {0x30FB, 0x30FE, LB_NS},
+  {0x30FF, 0x4DBF, LB_ID}, {0x4E00, 0xA4CF, LB_ID}, {0xA960, 0xA97F, LB_ID},
+  {0xAC00, 0xD7FF, LB_ID},
+  /* Planes 2 and 3 hold ideographs; low surrogates stay with their high
+     surrogate. */
+  {0xD840, 0xD8BF, LB_ID}, {0xDC00, 0xDFFF, LB_CM},
+  {0xF900, 0xFAFF, LB_ID}, {0xFE00, 0xFE0F, LB_CM}, {0xFE20, 0xFE2F, LB_CM},
+  {0xFE30, 0xFE34, LB_ID}, {0xFE35, 0xFE35, LB_OP}, {0xFE36, 0xFE36, LB_CL},
+  {0xFE37, 0xFE37, LB_OP}, {0xFE38, 0xFE38, LB_CL}, {0xFE39, 0xFE39, LB_OP},
+  {0xFE3A, 0xFE3A, LB_CL}, {0xFE3B, 0xFE3B, LB_OP}, {0xFE3C, 0xFE3C, LB_CL},
+  {0xFE3D, 0xFE3D, LB_OP}, {0xFE3E, 0xFE3E, LB_CL}, {0xFE3F, 0xFE3F, LB_OP},
+  {0xFE40, 0xFE40, LB_CL}, {0xFE41, 0xFE41, LB_OP}, {0xFE42, 0xFE42, LB_CL},
+  {0xFE43, 0xFE43, LB_OP}, {0xFE44, 0xFE44, LB_CL}, {0xFE45, 0xFE4F, LB_ID},
+  {0xFEFF, 0xFEFF, LB_GL}, {0xFF01, 0xFF01, LB_EX}, {0xFF02, 0xFF07, LB_ID},
+  {0xFF08, 0xFF08, LB_OP}, {0xFF09, 0xFF09, LB_CL}, {0xFF0A, 0xFF0B, LB_ID},
+  {0xFF0C, 0xFF0C, LB_CL}, {0xFF0D, 0xFF0D, LB_ID}, {0xFF0E, 0xFF0E, LB_CL},
+  {0xFF0F, 0xFF19, LB_ID}, {0xFF1A, 0xFF1B, LB_NS}, {0xFF1C, 0xFF1E, LB_ID},
+  {0xFF1F, 0xFF1F, LB_EX}, {0xFF20, 0xFF3A, LB_ID}, {0xFF3B, 0xFF3B, LB_OP},
+  {0xFF3C, 0xFF3C, LB_ID}, {0xFF3D, 0xFF3D, LB_CL}, {0xFF3E, 0xFF5A, LB_ID},
+  {0xFF5B, 0xFF5B, LB_OP}, {0xFF5C, 0xFF5C, LB_ID}, {0xFF5D, 0xFF5D, LB_CL},
+  {0xFF5E, 0xFF5E, LB_ID}, {0xFF5F, 0xFF5F, LB_OP}, {0xFF60, 0xFF61, LB_CL},
+  {0xFF62, 0xFF62, LB_OP}, {0xFF63, 0xFF64, LB_CL}, {0xFFE0, 0xFFE0, LB_PO},
+  {0xFFE1, 0xFFE1, LB_PR}, {0xFFE2, 0xFFE4, LB_ID}, {0xFFE5, 0xFFE6, LB_PR},
+};
+
+/* The class of every BMP character, built from the ranges above. */
+static unsigned char *lineBreakClasses = NULL;
+
+static void
+buildLineBreakClasses(void)
+{
+  unsigned int i, c;
+
+  lineBreakClasses = malloc(0x10000);
+  memset(lineBreakClasses, LB_AL, 0x10000);
+  for (i = 0; i < sizeof(lineBreakRanges) / sizeof(lineBreakRanges[0]); i++)
+    {
+      for (c = lineBreakRanges[i].first; c <= lineBreakRanges[i].last; c++)
+        {
+          lineBreakClasses[c] = lineBreakRanges[i].cls;
+        }
+    }
+}
+
+#define BIT_SET(bits, i) ((bits)[(i) >> 5] |= (1u << ((i) & 31)))
+#define BIT_TEST(bits, i) (((bits)[(i) >> 5] >> ((i) & 31)) & 1)
+
+/*
+Finds the line break opportunities in the n characters of a paragraph.
+Bit i of breaks is set if a line may be broken before chars[i] (bit n
+stands for the end, which always is a break), and bit i of spaces if
+chars[i] is a space. Both must hold n + 1 cleared bits. Not static, so
+that the tests can call it. GSHorizontalTypesetter must have been
+initialized, as that builds the class table.
+*/
+void
+GSLineBreakOpportunities(const unichar *chars, unsigned int n,
+                         uint32_t *breaks, uint32_t *spaces)
+{
+  unsigned int i;
+  int cls, cur, prev;
+
+  if (n == 0)
+    {
+      BIT_SET(breaks, 0);
+      return;
+    }
+  prev = cls = lineBreakClasses[chars[0]];
+  if (cls == LB_SP)
+    {
+      BIT_SET(spaces, 0);
+      cls = LB_GL;
+    }
+  else if (cls == LB_CM)
+    {
+      cls = LB_AL;
+    }
+  for (i = 1; i < n; i++)
+    {
+      cur = lineBreakClasses[chars[i]];
+
+      if (cls == LB_BK)
+        {
+          /* Always break after a hard line break. */
+          BIT_SET(breaks, i);
+        }
+      else if (cur == LB_SP)
+        {
+          /* Never break before spaces, the class before them decides. */
+          BIT_SET(spaces, i);
+          prev = cur;
+          continue;
+        }
+      else if (cur == LB_BK || cur == LB_ZW)
+        {
+          /* Never break before these. */
+        }
+      else if (cls == LB_ZW)
+        {
+          BIT_SET(breaks, i);
+        }
+      else
+        {
+          if (cur == LB_CM)
+            {
+              /* Combining marks stay with their base, unless they follow
+              a space, where they act as alphabetic characters. */
+              if (prev != LB_SP)
+                {
+                  prev = cur;
+                  continue;
+                }
+              cur = LB_AL;
+            }
+          switch (lineBreakPairs[cls][cur])
+            {
+              case '_':
+                BIT_SET(breaks, i);
+                break;
+              case '%':
+                if (prev == LB_SP)
+                  BIT_SET(breaks, i);
+                break;
+              default:
+                break;
+            }
+        }
+      prev = cur;
+      /* Only possible after a hard line break or a zero width space */
+      if (cur == LB_SP)
+        cur = LB_GL;
+      else if (cur == LB_CM)
+        cur = LB_AL;
+      cls = cur;
+    }
+  /* The end of the paragraph is always a break. */
+  BIT_SET(breaks, n);
+}
+
+/* Returns the highest set bit at or below i, or -1 if there is none. */
+static inline int
+previousSetBit(const uint32_t *bits, unsigned int i)
+{
+  int w = i >> 5;
+  uint32_t word = bits[w] & (0xffffffffu >> (31 - (i & 31)));
+
+  while (1)
+    {
+      if (word)
+        return (w << 5) + 31 - __builtin_clz(word);
+      if (--w < 0)
+        return -1;
+      word = bits[w];
+    }
+}
+
+
 @implementation GSHorizontalTypesetter
 
++ (void) initialize
+{
+  if (self == [GSHorizontalTypesetter class])
+    {
+      typesetQueueLock = [NSLock new];
+      buildLineBreakClasses();
+    }
+}
+
 - init
 {
   if (!(self = [super init])) return nil;
@@ -73,6 +436,11 @@ cache fairly aggressively without having to worry about memory consumption.
       free(line_frags);
       line_frags = NULL;
     }
+  if (breaks)
+    {
+      free(breaks);
+      breaks = spaces = NULL;
+    }
   DESTROY(lock);
   [super dealloc];
 }
@@ -122,8 +490,6 @@ struct GSHorizontalTypesetter_glyph_cache_s
 };
 typedef struct GSHorizontalTypesetter_glyph_cache_s glyph_cache_t;
 
-/* TODO: if we could know whether the layout manager had been modified since
-the last time or not, we wouldn't need to clear the cache every time */
 -(void) _cacheClear
 {
   cache_length = 0;
@@ -134,6 +500,7 @@ the last time or not, we wouldn't need to clear the cache every time */
   attributeRange = NSMakeRange(0, 0);
   curFont = nil;
   fontRange = NSMakeRange(0, 0);
+  break_range = NSMakeRange(0, 0);
 }
 
 -(void) _cacheAttributes: (unsigned int)char_index
@@ -271,58 +638,135 @@ the last time or not, we wouldn't need to clear the cache every time */
 }
 
 
+/*
+Makes sure the line break opportunities of the characters from start to
+last (and the position after last) are known. They are computed up to the
+end of the paragraph in one go, so the following lines of a paragraph
+reuse them.
+*/
+-(void) _cacheBreaksFrom: (unsigned int)start to: (unsigned int)last
+{
+  NSString *str;
+  NSUInteger end;
+  unsigned int n, words;
+  unichar *chars;
+
+  if (start >= break_range.location && last < NSMaxRange(break_range))
+    return;
+
+  str = [curTextStorage string];
+  [str getLineStart: NULL
+                end: NULL
+        contentsEnd: &end
+           forRange: NSMakeRange(last, 0)];
+  if (end <= last)
+    end = last + 1;
+  n = end - start;
+
+  /* One more bit for the position after the last character. */
+  words = (n + 1 + 31) / 32;
+  if (words > break_words)
+    {
+      break_words = words;
+      breaks = realloc(breaks, sizeof(uint32_t) * 2 * break_words);
+    }
+  spaces = breaks + break_words;
+  memset(breaks, 0, sizeof(uint32_t) * words);
+  memset(spaces, 0, sizeof(uint32_t) * words);
+
+  chars = malloc(sizeof(unichar) * n);
+  [str getCharacters: chars range: NSMakeRange(start, n)];
+
+  GSLineBreakOpportunities(chars, n, breaks, spaces);
+
+  free(chars);
+  break_range = NSMakeRange(start, n);
+}
+
+/*
+Hides the spaces at the end of a line that ends before glyph gi, so that
+they hang past its end (as they would be invisible there anyway).
+*/
+-(void) _hideSpacesBefore: (unsigned int)gi
+{
+  unsigned int s = gi;
+  glyph_cache_t *g;
+
+  while (s > 0
+         && BIT_TEST(spaces, cache[s - 1].char_index - break_range.location))
+    s--;
+
+  for (g = cache + s; s < gi; s++, g++)
+    {
+      g->dont_show = YES;
+      if (s > 0)
+        {
+          g->pos = g[-1].pos;
+          g->pos.x += g[-1].size.width;
+        }
+      else
+        g->pos = NSMakePoint(0, 0);
+      g->size.width = 0;
+    }
+}
+
 /*
 Should return the first glyph on the next line, which must be <=gi and
 >=cache_base (TODO: not enough. actually, it probably is now. the wrapping
 logic below will fall back to char wrapping if necessary). Glyphs up to and
 including gi will have been cached.
+
+A space that doesn't fit is allowed to hang past the end of the line, in
+which case gi+1 is returned.
 */
 -(unsigned int) breakLineByWordWrappingBefore: (unsigned int)gi
 {
   glyph_cache_t *g;
-  unichar ch;
-  NSString *str = [curTextStorage string];
+  unsigned int base, lo, hi;
+  int c;
 
   gi -= cache_base;
   g = cache + gi;
+  if (gi == 0)
+    return cache_base;
+
+  [self _cacheBreaksFrom: cache->char_index to: g->char_index];
+  base = break_range.location;
 
-  while (gi > 0)
+  c = g->char_index - base;
+  if (BIT_TEST(spaces, c) && BIT_TEST(breaks, c + 1))
     {
-      if (g->g == NSControlGlyph)
-        return gi + cache_base;
-      ch = [str characterAtIndex: g->char_index];
-      /* TODO: paragraph/line separator */
-      if (ch == 0x20 || ch == 0x0a || ch == 0x0d)
+      [self _hideSpacesBefore: gi + 1];
+      return gi + 1 + cache_base;
+    }
+
+  /* Scan backwards for a break opportunity at the start of a glyph after
+  the first one of the line. */
+  hi = gi;
+  while ((c = previousSetBit(breaks, c)) > 0
+         && c + base > cache->char_index)
+    {
+      /* Find the first glyph at or after the character. */
+      lo = 1;
+      while (lo < hi)
         {
-          g->dont_show = YES;
-          if (gi > 0)
-            {
-              g->pos = g[-1].pos;
-              g->pos.x += g[-1].size.width;
-            }
+          unsigned int mid = (lo + hi) / 2;
+
+          if (cache[mid].char_index < c + base)
+            lo = mid + 1;
           else
-            g->pos = NSMakePoint(0, 0);
-          g->size.width = 0;
-          return gi + 1 + cache_base;
+            hi = mid;
+        }
+      if (cache[lo].char_index == c + base)
+        {
+          [self _hideSpacesBefore: lo];
+          return lo + cache_base;
         }
-      /* Each CJK glyph should be treated as a word when wrapping word.
-         The range should work for most cases */
-      else if ((ch > 0x2ff0) && (ch < 0x9fff))
-         {
-           g->dont_show = NO;
-           if (gi > 0)
-             {
-               g->pos = g[-1].pos;
-               g->pos.x += g[-1].size.width;
-             }
-           else
-             g->pos = NSMakePoint(0,0);
-           return gi + cache_base;
-         }     
-      gi--;
-      g--;
+      hi = lo;
+      c--;
     }
-  return gi + cache_base;
+
+  return cache_base;
 }
 
 
@@ -1245,6 +1689,130 @@ restart: ;
     return 0;
 }
 
+/*
+Lays out as many whole paragraphs from curGlyph on as possible on worker
+threads (see the comment at the top of the file) and moves curGlyph and
+curPoint past them. Anything left is handled by the normal, serial code.
+*/
+-(void) _typesetParagraphsConcurrently
+{
+  NSString *str = [curTextStorage string];
+  unsigned int length = [str length];
+  unsigned int soft, ch;
+  CGFloat container_height;
+  BOOL done = NO;
+
+  if (![curTextContainer isSimpleRectangularTextContainer]
+      || [curTextContainer class] != [NSTextContainer class])
+    return;
+  container_height = [curTextContainer containerSize].height;
+  if (container_height < LARGE_SIZE)
+    return;
+  if ([[NSProcessInfo processInfo] activeProcessorCount] < 2)
+    return;
+
+  /* We must start at the beginning of a paragraph. */
+  if (curGlyph)
+    {
+      if (![curLayoutManager isValidGlyphIndex: curGlyph])
+        return;
+      ch = [curLayoutManager characterIndexForGlyphAtIndex: curGlyph];
+      if (ch == 0 || [str characterAtIndex: ch - 1] != '\n')
+        return;
+    }
+  else
+    {
+      ch = 0;
+    }
+
+  /* Soft invalidated layout is cheaper to reuse than to redo, so leave it
+  to the serial code. */
+  soft = [curLayoutManager _softInvalidateFirstGlyphInTextContainer:
+                             curTextContainer];
+  if (soft < curGlyph)
+    soft = (unsigned int)-1;
+
+  [typesetQueueLock lock];
+  if (typesetQueue == nil)
+    {
+      typesetQueue = [NSOperationQueue new];
+      [typesetQueue setMaxConcurrentOperationCount:
+        [[NSProcessInfo processInfo] activeProcessorCount]];
+    }
+  [typesetQueueLock unlock];
+
+  while (!done && length - ch >= CONCURRENT_MIN_CHARACTERS)
+    {
+      CREATE_AUTORELEASE_POOL(pool);
+      NSMutableArray *ops = [NSMutableArray array];
+      unsigned int end = ch;
+      NSUInteger i, count;
+
+      /* Snapshot paragraphs up to the batch size. The last paragraph of
+      the text is always left to the serial code, which also takes care of
+      the extra line fragment. */
+      while (end - ch < CONCURRENT_BATCH_CHARACTERS)
+        {
+          NSRange r, pr, gr, actual;
+          GSParagraphLayoutRecorder *recorder;
+          GSParagraphLayoutOperation *op;
+
+          r = [str rangeOfString: @"\n"
+                         options: NSLiteralSearch
+                           range: NSMakeRange(end, length - end)];
+          if (r.location == NSNotFound)
+            break;
+          pr = NSMakeRange(end, NSMaxRange(r) - end);
+          gr = [curLayoutManager glyphRangeForCharacterRange: pr
+                                        actualCharacterRange: &actual];
+          if (!NSEqualRanges(pr, actual) || NSMaxRange(gr) > soft)
+            break;
+
+          recorder = [[GSParagraphLayoutRecorder alloc]
+                       initWithLayoutManager: curLayoutManager
+                                  glyphRange: gr
+                              characterRange: pr];
+          if (recorder == nil)
+            break;
+          op = [[GSParagraphLayoutOperation alloc]
+                 initWithRecorder: recorder
+                    textContainer: curTextContainer];
+          [ops addObject: op];
+          RELEASE(op);
+          RELEASE(recorder);
+          end = NSMaxRange(pr);
+        }
+
+      count = [ops count];
+      if (count == 0)
+        {
+          [pool drain];
+          break;
+        }
+      [typesetQueue addOperations: ops waitUntilFinished: YES];
+
+      /* Stitch the paragraphs together. */
+      for (i = 0; i < count; i++)
+        {
+          GSParagraphLayoutRecorder *recorder = [[ops objectAtIndex: i] recorder];
+
+          if (recorder->failed
+              || curPoint.y + recorder->height > container_height)
+            {
+              done = YES;
+              break;
+            }
+          [recorder replayInLayoutManager: curLayoutManager
+                            textContainer: curTextContainer
+                                  yOffset: curPoint.y];
+          curGlyph = NSMaxRange(recorder->glyphRange);
+          curPoint.y += recorder->height;
+          ch = NSMaxRange(recorder->characterRange);
+        }
+      [pool drain];
+    }
+}
+
 
 -(int) layoutGlyphsInLayoutManager: (GSLayoutManager *)layoutManager
 		   inTextContainer: (NSTextContainer *)textContainer
@@ -1255,6 +1823,7 @@ restart: ;
 {
   int ret, real_ret;
   BOOL newParagraph;
+  unsigned int generation;
 
   if (![lock tryLock])
     {
@@ -1284,10 +1853,28 @@ NS_DURING
 
   curGlyph = glyphIndex;
 
-  [self _cacheClear];
+  /*
+  If nothing has changed since the last call and we continue where it
+  stopped, the cached glyphs and attributes are still valid. Glyphs before
+  that point may have been changed by laying them out (eg. hidden spaces),
+  so we don't reuse the cache when asked to lay them out again.
+  */
+  generation = [curLayoutManager _editGeneration];
+  if (curLayoutManager != cache_layout_manager
+      || !generation || generation != cache_generation
+      || curGlyph < cache_next_glyph)
+    {
+      [self _cacheClear];
+    }
+  cache_layout_manager = nil;
 
   real_ret = 4;
   curPoint = NSMakePoint(0, NSMaxY(previousLineFragRect));
+
+  if (!howMany && [curLayoutManager typesetsParagraphsConcurrently])
+    {
+      [self _typesetParagraphsConcurrently];
+    }
   while (1)
     {
       if (real_ret == 4)
@@ -1339,6 +1926,18 @@ NS_DURING
    }
 
   *nextGlyphIndex = curGlyph;
+
+  /*
+  If the container is full, the line that didn't fit has been laid out
+  (and its glyphs changed) without being used, so the next call will start
+  at its first glyph and must not see it.
+  */
+  if (ret != 1)
+    {
+      cache_layout_manager = curLayoutManager;
+      cache_generation = generation;
+      cache_next_glyph = curGlyph;
+    }
 NS_HANDLER
   NSLog(@"GSHorizontalTypesetter - %@", [localException reason]);
   [lock unlock];
@@ -1351,3 +1950,395 @@ NS_ENDHANDLER
 
 @end
 
+
+@implementation GSRecordedFont
+
+- (id) initWithFont: (NSFont *)font
+{
+  if (!(self = [super init])) return nil;
+  if (font != nil)
+    {
+      ascender = [font ascender];
+      descender = [font descender];
+      defaultLineHeight = [font defaultLineHeightForFont];
+      xHeight = [font xHeight];
+    }
+  return self;
+}
+
+- (CGFloat) ascender
+{
+  return ascender;
+}
+
+- (CGFloat) descender
+{
+  return descender;
+}
+
+- (CGFloat) defaultLineHeightForFont
+{
+  return defaultLineHeight;
+}
+
+- (CGFloat) xHeight
+{
+  return xHeight;
+}
+
+@end
+
+
+@implementation GSParagraphLayoutRecorder
+
+- (id) initWithLayoutManager: (GSLayoutManager *)layoutManager
+                  glyphRange: (NSRange)aGlyphRange
+              characterRange: (NSRange)charRange
+{
+  unsigned int i, j, font_end = 0;
+  NSFont **real_fonts = NULL;
+
+  if (!(self = [super init])) return nil;
+
+  glyphRange = aGlyphRange;
+  characterRange = charRange;
+  num_glyphs = aGlyphRange.length;
+  glyphs = malloc(sizeof(NSGlyph) * num_glyphs);
+  characters = malloc(sizeof(unsigned int) * num_glyphs);
+  advancements = malloc(sizeof(NSSize) * num_glyphs);
+
+  for (i = 0; i < num_glyphs; i++)
+    {
+      unsigned int gi = glyphRange.location + i;
+
+      glyphs[i] = [layoutManager glyphAtIndex: gi];
+      /* Attachment cells may only be asked for their size on the thread
+      that owns them. */
+      if (glyphs[i] == GSAttachmentGlyph)
+        {
+          free(real_fonts);
+          DESTROY(self);
+          return nil;
+        }
+      characters[i] = [layoutManager characterIndexForGlyphAtIndex: gi]
+        - charRange.location;
+      advancements[i] = [layoutManager advancementForGlyphAtIndex: gi];
+
+      if (i >= font_end)
+        {
+          NSRange r;
+          NSFont *f;
+
+          f = [layoutManager effectiveFontForGlyphAtIndex: gi
+                                                    range: &r];
+          font_end = MIN(NSMaxRange(r), NSMaxRange(glyphRange))
+            - glyphRange.location;
+          real_fonts = realloc(real_fonts,
+                               sizeof(NSFont *) * (num_font_runs + 1));
+          fonts = realloc(fonts,
+                          sizeof(GSRecordedFont *) * (num_font_runs + 1));
+          font_run_ends = realloc(font_run_ends,
+                                  sizeof(unsigned int) * (num_font_runs + 1));
+          /* The typesetter notices font changes by comparing pointers,
+          so runs in the same font share their recorded font. */
+          for (j = 0; j < num_font_runs; j++)
+            {
+              if (real_fonts[j] == f)
+                break;
+            }
+          if (j < num_font_runs)
+            fonts[num_font_runs] = RETAIN(fonts[j]);
+          else
+            fonts[num_font_runs] = [[GSRecordedFont alloc] initWithFont: f];
+          real_fonts[num_font_runs] = f;
+          font_run_ends[num_font_runs] = font_end;
+          num_font_runs++;
+        }
+    }
+  free(real_fonts);
+
+  text = [[[layoutManager textStorage] attributedSubstringFromRange: charRange]
+           copy];
+  return self;
+}
+
+- (void) dealloc
+{
+  unsigned int i;
+
+  for (i = 0; i < num_font_runs; i++)
+    {
+      RELEASE(fonts[i]);
+    }
+  free(fonts);
+  free(font_run_ends);
+  free(glyphs);
+  free(characters);
+  free(advancements);
+  free(records);
+  TEST_RELEASE(text);
+  [super dealloc];
+}
+
+- (layout_record_t *) _addRecord: (GSLayoutRecordType)type
+                           range: (NSRange)range
+{
+  layout_record_t *r;
+
+  if (num_records == size_records)
+    {
+      size_records += 32;
+      records = realloc(records, sizeof(layout_record_t) * size_records);
+    }
+  r = &records[num_records++];
+  memset(r, 0, sizeof(layout_record_t));
+  r->type = type;
+  r->range = range;
+  return r;
+}
+
+- (void) replayInLayoutManager: (GSLayoutManager *)layoutManager
+                 textContainer: (NSTextContainer *)textContainer
+                       yOffset: (CGFloat)dy
+{
+  unsigned int i;
+  layout_record_t *r;
+
+  for (i = 0, r = records; i < num_records; i++, r++)
+    {
+      NSRange range = NSMakeRange(r->range.location + glyphRange.location,
+                                  r->range.length);
+
+      switch (r->type)
+        {
+          case GSLayoutRecordTextContainer:
+            [layoutManager setTextContainer: textContainer
+                              forGlyphRange: range];
+            break;
+          case GSLayoutRecordLineFragment:
+            r->rect.origin.y += dy;
+            r->used.origin.y += dy;
+            [layoutManager setLineFragmentRect: r->rect
+                                 forGlyphRange: range
+                                      usedRect: r->used];
+            break;
+          case GSLayoutRecordDrawsOutside:
+            [layoutManager setDrawsOutsideLineFragment: YES
+                                       forGlyphAtIndex: range.location];
+            break;
+          case GSLayoutRecordNotShown:
+            [layoutManager setNotShownAttribute: YES
+                                forGlyphAtIndex: range.location];
+            break;
+          case GSLayoutRecordLocation:
+            [layoutManager setLocation: r->used.origin
+                  forStartOfGlyphRange: range];
+            break;
+          case GSLayoutRecordAttachmentSize:
+            [layoutManager setAttachmentSize: r->used.size
+                               forGlyphRange: range];
+            break;
+        }
+    }
+}
+
+/* The layout manager methods used by GSHorizontalTypesetter. */
+
+- (NSTextStorage *) textStorage
+{
+  return (NSTextStorage *)text;
+}
+
+- (NSDictionary *) typingAttributes
+{
+  return nil;
+}
+
+- (BOOL) typesetsParagraphsConcurrently
+{
+  return NO;
+}
+
+- (unsigned int) _editGeneration
+{
+  /* Every paragraph gets a new recorder, so never let a typesetter keep
+  its cache for the next one. */
+  return 0;
+}
+
+- (NSGlyph) glyphAtIndex: (unsigned int)glyphIndex
+            isValidIndex: (BOOL *)isValidIndex
+{
+  if (glyphIndex >= num_glyphs)
+    {
+      *isValidIndex = NO;
+      return NSNullGlyph;
+    }
+  *isValidIndex = YES;
+  return glyphs[glyphIndex];
+}
+
+- (unsigned int) characterIndexForGlyphAtIndex: (unsigned int)glyphIndex
+{
+  if (glyphIndex >= num_glyphs)
+    return [text length];
+  return characters[glyphIndex];
+}
+
+- (NSRange) characterRangeForGlyphRange: (NSRange)aGlyphRange
+                       actualGlyphRange: (NSRange *)actualGlyphRange
+{
+  unsigned int first, last;
+
+  if (actualGlyphRange)
+    *actualGlyphRange = aGlyphRange;
+  first = [self characterIndexForGlyphAtIndex: aGlyphRange.location];
+  last = [self characterIndexForGlyphAtIndex: NSMaxRange(aGlyphRange)];
+  return NSMakeRange(first, last - first);
+}
+
+- (NSSize) advancementForGlyphAtIndex: (unsigned int)glyphIndex
+{
+  return advancements[glyphIndex];
+}
+
+- (NSFont *) effectiveFontForGlyphAtIndex: (unsigned int)glyphIndex
+                                    range: (NSRange *)range
+{
+  unsigned int start;
+
+  /* The typesetter walks the glyphs in order, so start looking at the
+  last run. */
+  if (font_run > 0 && glyphIndex < font_run_ends[font_run - 1])
+    font_run = 0;
+  while (font_run < num_font_runs - 1 && glyphIndex >= font_run_ends[font_run])
+    font_run++;
+
+  start = font_run ? font_run_ends[font_run - 1] : 0;
+  if (range)
+    *range = NSMakeRange(start, font_run_ends[font_run] - start);
+  return (NSFont *)fonts[font_run];
+}
+
+-(unsigned int) _softInvalidateFirstGlyphInTextContainer: (NSTextContainer *)textContainer
+{
+  return (unsigned int)-1;
+}
+
+-(void) setExtraLineFragmentRect: (NSRect)linefrag
+                        usedRect: (NSRect)used
+                   textContainer: (NSTextContainer *)tc
+{
+  /* Only the serial code sets up the extra line fragment. */
+}
+
+- (void) setTextContainer: (NSTextContainer *)aTextContainer
+            forGlyphRange: (NSRange)aGlyphRange
+{
+  [self _addRecord: GSLayoutRecordTextContainer range: aGlyphRange];
+}
+
+- (void) setLineFragmentRect: (NSRect)fragmentRect
+               forGlyphRange: (NSRange)aGlyphRange
+                    usedRect: (NSRect)usedRect
+{
+  layout_record_t *r;
+
+  r = [self _addRecord: GSLayoutRecordLineFragment range: aGlyphRange];
+  r->rect = fragmentRect;
+  r->used = usedRect;
+  if (NSMaxY(fragmentRect) > height)
+    height = NSMaxY(fragmentRect);
+}
+
+- (void) setDrawsOutsideLineFragment: (BOOL)flag
+                     forGlyphAtIndex: (unsigned int)glyphIndex
+{
+  if (flag)
+    [self _addRecord: GSLayoutRecordDrawsOutside
+               range: NSMakeRange(glyphIndex, 1)];
+}
+
+- (void) setNotShownAttribute: (BOOL)flag
+              forGlyphAtIndex: (unsigned int)glyphIndex
+{
+  if (flag)
+    [self _addRecord: GSLayoutRecordNotShown
+               range: NSMakeRange(glyphIndex, 1)];
+}
+
+- (void) setLocation: (NSPoint)location
+forStartOfGlyphRange: (NSRange)aGlyphRange
+{
+  layout_record_t *r;
+
+  r = [self _addRecord: GSLayoutRecordLocation range: aGlyphRange];
+  r->used.origin = location;
+}
+
+- (void) setAttachmentSize: (NSSize)attachmentSize
+             forGlyphRange: (NSRange)aGlyphRange
+{
+  layout_record_t *r;
+
+  r = [self _addRecord: GSLayoutRecordAttachmentSize range: aGlyphRange];
+  r->used.size = attachmentSize;
+}
+
+@end
+
+
+@implementation GSParagraphLayoutOperation
+
+- (id) initWithRecorder: (GSParagraphLayoutRecorder *)aRecorder
+          textContainer: (NSTextContainer *)aTextContainer
+{
+  if (!(self = [super init])) return nil;
+  ASSIGN(recorder, aRecorder);
+  /* A plain copy of the container, so that the worker doesn't share it
+  with the main thread or the other workers. */
+  textContainer = [[NSTextContainer alloc]
+                    initWithContainerSize: [aTextContainer containerSize]];
+  [textContainer setLineFragmentPadding:
+                   [aTextContainer lineFragmentPadding]];
+  return self;
+}
+
+- (void) dealloc
+{
+  RELEASE(recorder);
+  RELEASE(textContainer);
+  [super dealloc];
+}
+
+- (GSParagraphLayoutRecorder *) recorder
+{
+  return recorder;
+}
+
+- (void) main
+{
+  CREATE_AUTORELEASE_POOL(pool);
+  unsigned int next = 0;
+
+  NS_DURING
+    {
+      [[GSHorizontalTypesetter sharedInstance]
+        layoutGlyphsInLayoutManager: (GSLayoutManager *)recorder
+                    inTextContainer: textContainer
+               startingAtGlyphIndex: 0
+           previousLineFragmentRect: NSZeroRect
+                     nextGlyphIndex: &next
+              numberOfLineFragments: 0];
+      if (next != recorder->num_glyphs || recorder->height <= 0.0)
+        recorder->failed = YES;
+    }
+  NS_HANDLER
+    {
+      recorder->failed = YES;
+    }
+  NS_ENDHANDLER
+  [pool drain];
+}
+
+@end
@@ -169,8 +169,22 @@ Private method used internally by GSLayoutManager for sanity checking.
 
 /***** Glyph handling *****/
 
+/*
+Source of edit generations. It is shared by all layout managers so that a
+generation identifies one state of one layout manager, even if a new layout
+manager is later allocated at the address of an old one. 0 is never used.
+*/
+static unsigned int last_edit_generation = 0;
+
 @implementation GSLayoutManager (GlyphsHelpers)
 
+-(void) _bumpEditGeneration
+{
+  if (++last_edit_generation == 0)
+    last_edit_generation = 1;
+  edit_generation = last_edit_generation;
+}
+
 -(void) _run_cache_attributes: (glyph_run_t *)r : (NSDictionary *)attributes
 {
   /* set up attributes for this run */
@@ -265,6 +279,8 @@ Private method used internally by GSLayoutManager for sanity checking.
 
   r = (glyph_run_t *)h;
   r->level = SKIP_LIST_DEPTH - 1;
+
+  [self _bumpEditGeneration];
 }
 
 - (void) _glyphDumpRuns
@@ -1211,6 +1227,7 @@ places where we switch.
   NSMinRange(range) < cpos + cached_run->head.char_lenght
   */
   cached_run = NULL;
+  [self _bumpEditGeneration];
 
   /* Set it now for early returns. */
   if (actualRange)
@@ -1676,6 +1693,7 @@ places where we switch.
     }
 
   r->glyphs[glyphIndex - pos].g = newGlyph;
+  [self _bumpEditGeneration];
 }
 
 - (void) deleteGlyphsInRange: (NSRange)aRange
@@ -1750,6 +1768,7 @@ places where we switch.
 
   r->glyphs[glyphIndex - pos].char_offset = charIndex - cpos;
   // What should happen to the following glyphs?
+  [self _bumpEditGeneration];
 }
 
 - (int) intAttribute: (int)attributeTag
@@ -2877,6 +2896,11 @@ forStartOfGlyphRange: (NSRange)glyphRange
   return tc->num_soft;
 }
 
+-(unsigned int) _editGeneration
+{
+  return edit_generation;
+}
+
 @end
 
 
@@ -3089,6 +3113,16 @@ See [NSTextView -setTextContainer:] for more information about these calls.
   return showsControlCharacters;
 }
 
+- (void) setTypesetsParagraphsConcurrently: (BOOL)flag
+{
+  typesetsParagraphsConcurrently = !!flag;
+}
+
+- (BOOL) typesetsParagraphsConcurrently
+{
+  return typesetsParagraphsConcurrently;
+}
+
 /*
 Note that NSLayoutManager completely overrides this (to perform more
 intelligent invalidation of layout using the constraints on layout it
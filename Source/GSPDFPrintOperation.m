@@ -65,14 +65,6 @@
                   insideRect: rect
                       toData: data
                    printInfo: aPrintInfo];
-                   
-  _path = [NSTemporaryDirectory() stringByAppendingPathComponent: @"GSPrint-"];
-  
-  _path = [_path stringByAppendingString: 
-		               [[NSProcessInfo processInfo] globallyUniqueString]];
-           
-  _path = [_path stringByAppendingPathExtension: @"pdf"];
-  RETAIN(_path);
                   
   return self;
 }
@@ -97,15 +89,30 @@
 - (NSGraphicsContext*)createContext
 {
   NSMutableDictionary *info;
+  NSString *output;
 
   if (_context)
     return _context;
 
+  output = _path;
+  if (output == nil)
+    {
+      /* Write straight into the data if we can */
+      output = [self _dataOutputPath];
+    }
+  if (output == nil)
+    {
+      _path = [NSTemporaryDirectory() stringByAppendingPathComponent: @"GSPrint-"];
+      _path = [_path stringByAppendingString: 
+                       [[NSProcessInfo processInfo] globallyUniqueString]];
+      _path = [_path stringByAppendingPathExtension: @"pdf"];
+      RETAIN(_path);
+      output = _path;
+    }
+
   info = [[self printInfo] dictionary];
 
-  // TODO: Instead we should support NSGraphicsContext writing to an 
-  // NSMutableData directly.
-  [info setObject: _path 
+  [info setObject: output
            forKey: @"NSOutputFile"];
   
   [info setObject: NSGraphicsContextPDFFormat
@@ -138,6 +145,10 @@
 
 - (BOOL)deliverResult
 {
+  if ([self _collectDataOutput])
+    {
+      return YES;
+    }
   if (_data != nil && _path != nil)
     {
       [_data setData: [NSData dataWithContentsOfFile: _path]];
@@ -0,0 +1,211 @@
+/*
+   GSSoundEngine.h
+
+   Shared mixing engine used by NSSound for playback.
+
+   Copyright (C) 2026 Free Software Foundation, Inc.
+
+   This file is part of the GNUstep GUI Library.
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with this library; see the file COPYING.LIB.
+   If not, see <http://www.gnu.org/licenses/> or write to the
+   Free Software Foundation, 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#ifndef _GNUstep_H_GSSoundEngine
+#define _GNUstep_H_GSSoundEngine
+
+#import <Foundation/NSObject.h>
+#import "GNUstepGUI/GSSoundSource.h"
+#import "GNUstepGUI/GSSoundSink.h"
+
+@class NSArray;
+@class NSConditionLock;
+@class NSData;
+@class NSFileHandle;
+@class NSLock;
+@class NSMutableArray;
+@class NSSound;
+@class NSString;
+
+/* Format the engine mixes in and hands to its sink: interleaved
+ * stereo signed 16 bit samples in host byte order. */
+#define GS_SOUND_ENGINE_RATE     44100
+#define GS_SOUND_ENGINE_CHANNELS 2
+
+/* Sounds up to this duration (in seconds) are decoded once and kept
+ * in memory by +[NSSound soundNamed:]. */
+#define GS_SOUND_PREDECODE_LIMIT 2.0
+
+/*
+ * One playing sound.  The voice converts the data of its source to the
+ * engine format before it is mixed.  Voices with pcm set play from
+ * decoded data (stereo floats at the engine rate) and never touch the
+ * source.  The public fields are protected by the engine lock, except
+ * volume and loops which the engine only reads.
+ *
+ * While a voice is in the engine only the engine thread touches its
+ * source.  It decodes without holding the engine lock, so pausing a
+ * sound or asking for its time never waits for the source.
+ */
+@interface GSSoundVoice : NSObject
+{
+@public
+  NSSound           *sound;
+  id<GSSoundSource> source;
+  NSData            *pcm;
+  NSUInteger        pcmFrame;
+  float             volume;
+  BOOL              loops;
+  BOOL              paused;
+  BOOL              finished;
+
+@private
+  int               encoding;
+  NSUInteger        channels;
+  NSUInteger        frameSize;
+  BOOL              littleEndian;
+  unsigned char     *bytes;
+  float             *frames;
+  NSUInteger        capacity;
+  NSUInteger        count;
+  double            position;
+  double            step;
+  NSUInteger        rate;
+  double            sourceFrame;
+  double            totalFrames;
+  NSTimeInterval    seekTime;
+  BOOL              seekRequested;
+  BOOL              needsSeek;
+  BOOL              ended;
+  BOOL              removed;
+  NSLock            *decodeLock;
+}
+
+- (id) initWithSource: (id<GSSoundSource>)aSource pcm: (NSData *)data;
+
+/** Decodes enough of the source for the next n frames to be mixed.
+ *  Called by the engine thread without the engine lock held.
+ */
+- (void) decodeForFrames: (NSUInteger)n;
+
+/** Adds up to n frames of the receiver, scaled by its volume, to mix.
+ *  Returns the number of frames added; sets finished once the end of
+ *  a sound that does not loop is reached.  Only what -decodeForFrames:
+ *  decoded is mixed.
+ */
+- (NSUInteger) mixInto: (float *)mix frames: (NSUInteger)n;
+
+- (NSTimeInterval) currentTime;
+- (void) setCurrentTime: (NSTimeInterval)time;
+
+@end
+
+/*
+ * The engine owns a single sink and a single thread which mixes all
+ * playing voices into it.  The sink is opened when the first sound
+ * plays and closed after the engine has been idle for a while, so
+ * sounds played in quick succession share the open device.
+ *
+ * The sink class can be chosen with the GSSoundOutputSink default;
+ * otherwise the first sink plug-in is used, falling back to
+ * GSNullSoundSink when none is installed.
+ */
+@interface GSSoundEngine : NSObject
+{
+  NSConditionLock   *lock;
+  NSMutableArray    *voices;
+  id<GSSoundSink>   sink;
+  Class             sinkClass;
+  NSString          *device;
+  NSArray           *mapping;
+  BOOL              sinkOutdated;
+  BOOL              running;
+}
+
++ (GSSoundEngine *) sharedEngine;
+
+/** Returns the PCM data of source decoded to the engine format, as
+ *  used by GSSoundVoice.  The source is rewound afterwards.
+ */
++ (NSData *) decodeSource: (id<GSSoundSource>)source;
+
+/** Locks the voices against the engine thread.  Needed by anything
+ *  touching a voice's fields or its source.
+ */
+- (void) lock;
+- (void) unlock;
+
+- (void) addVoice: (GSSoundVoice *)voice;
+/** Stops voice and lets its sound know that it did not finish.
+ */
+- (void) removeVoice: (GSSoundVoice *)voice;
+
+/** Sets the device and the channel mapping of the sink.  As all sounds
+ *  are mixed into the one sink, they apply to every sound playing.  The
+ *  sink is reopened with them before the next period is played.
+ */
+- (void) setPlaybackDeviceIdentifier: (NSString *)playbackDeviceIdentifier;
+- (NSString *) playbackDeviceIdentifier;
+/** Returns the class of the sink, choosing it first if needed.
+ */
+- (Class) sinkClass;
+- (void) setChannelMapping: (NSArray *)channelMapping;
+- (NSArray *) channelMapping;
+
+@end
+
+/*
+ * Sink which consumes data at the rate it would be played without
+ * producing any sound.  If the GSSoundOutputFile default is set the
+ * data is appended to that file, which makes it possible to check the
+ * engine output without an audio device.
+ */
+@interface GSNullSoundSink : NSObject <GSSoundSink>
+{
+  NSFileHandle  *file;
+  NSString      *device;
+  NSArray       *mapping;
+  NSUInteger    bytesPerSecond;
+  NSTimeInterval next;
+  float         volume;
+}
+@end
+
+/*
+ * Source reading uncompressed RIFF WAVE data, used when no source
+ * plug-in understands the data.
+ */
+@interface GSWaveSoundSource : NSObject <GSSoundSource>
+{
+  NSData        *data;
+  NSUInteger    start;
+  NSUInteger    length;
+  NSUInteger    offset;
+  NSUInteger    frameSize;
+  NSUInteger    channels;
+  NSUInteger    rate;
+  int           encoding;
+}
+@end
+
+@interface NSSound (GSSoundEngine)
++ (NSArray *) _soundSinkPlugIns;
+/* Called on the main thread once the engine dropped a voice, info
+ * holds the voice and whether it played to the end. */
+- (void) _voiceDidFinish: (NSArray *)info;
+@end
+
+#endif // _GNUstep_H_GSSoundEngine
@@ -0,0 +1,1108 @@
+/** <title>GSSoundEngine</title>
+
+   <abstract>Shared mixing engine used by NSSound for playback</abstract>
+
+   Copyright (C) 2026 Free Software Foundation, Inc.
+
+   This file is part of the GNUstep GUI Library.
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with this library; see the file COPYING.LIB.
+   If not, see <http://www.gnu.org/licenses/> or write to the
+   Free Software Foundation, 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include <math.h>
+#include <string.h>
+#include <stdint.h>
+
+#import <Foundation/NSArray.h>
+#import <Foundation/NSByteOrder.h>
+#import <Foundation/NSData.h>
+#import <Foundation/NSDate.h>
+#import <Foundation/NSEnumerator.h>
+#import <Foundation/NSFileHandle.h>
+#import <Foundation/NSFileManager.h>
+#import <Foundation/NSLock.h>
+#import <Foundation/NSString.h>
+#import <Foundation/NSThread.h>
+#import <Foundation/NSUserDefaults.h>
+#import <Foundation/NSValue.h>
+#import <Foundation/NSZone.h>
+#import "AppKit/NSSound.h"
+#import "GSSoundEngine.h"
+
+// Private NSConditionLock conditions of the engine
+enum
+{
+  ENGINE_IDLE = 0,
+  ENGINE_BUSY
+};
+
+/* Frames read from a source at a time, and frames mixed per period. */
+#define CHUNK_FRAMES  1024
+#define PERIOD_FRAMES 1024
+
+/* Seconds without anything to play after which the sink is closed. */
+#define IDLE_TIMEOUT  2.0
+
+static GSSoundEngine *sharedEngine = nil;
+
+@interface GSSoundVoice (Private)
+- (void) _stopDecoding;
+- (void) _takeSeek;
+@end
+
+static inline NSUInteger
+sampleSize(int encoding)
+{
+  switch (encoding)
+    {
+      case GSSoundFormatPCMS8:
+      case GSSoundFormatPCMU8:
+      case GSSoundFormatULaw:
+      case GSSoundFormatALaw:
+        return 1;
+      case GSSoundFormatPCM16:
+        return 2;
+      case GSSoundFormatPCM24:
+        return 3;
+      case GSSoundFormatPCM32:
+      case GSSoundFormatFloat32:
+        return 4;
+      case GSSoundFormatFloat64:
+        return 8;
+      default:
+        return 0;
+    }
+}
+
+static inline uint32_t
+get32(const unsigned char *p, BOOL little)
+{
+  if (little)
+    {
+      return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+    }
+  return ((uint32_t)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+static inline float
+ulaw(unsigned char u)
+{
+  int t;
+
+  u = ~u;
+  t = (((u & 0x0F) << 3) + 0x84) << ((u & 0x70) >> 4);
+  return ((u & 0x80) ? (0x84 - t) : (t - 0x84)) / 32768.0;
+}
+
+static inline float
+alaw(unsigned char a)
+{
+  int t;
+  int seg;
+
+  a ^= 0x55;
+  t = (a & 0x0F) << 4;
+  seg = (a & 0x70) >> 4;
+  if (seg == 0)
+    {
+      t += 8;
+    }
+  else
+    {
+      t = (t + 0x108) << (seg - 1);
+    }
+  return ((a & 0x80) ? t : -t) / 32768.0;
+}
+
+/* Returns the sample at p as a float between -1.0 and 1.0. */
+static inline float
+decodeSample(const unsigned char *p, int encoding, BOOL little)
+{
+  switch (encoding)
+    {
+      case GSSoundFormatPCMS8:
+        return (signed char)p[0] / 128.0;
+      case GSSoundFormatPCMU8:
+        return ((int)p[0] - 128) / 128.0;
+      case GSSoundFormatPCM16:
+        return (int16_t)(little ? (p[0] | (p[1] << 8))
+          : ((p[0] << 8) | p[1])) / 32768.0;
+      case GSSoundFormatPCM24:
+        {
+          int32_t v = little ? (p[0] | (p[1] << 8) | (p[2] << 16))
+            : ((p[0] << 16) | (p[1] << 8) | p[2]);
+
+          if (v & 0x800000)
+            {
+              v -= 0x1000000;
+            }
+          return v / 8388608.0;
+        }
+      case GSSoundFormatPCM32:
+        return (int32_t)get32(p, little) / 2147483648.0;
+      case GSSoundFormatFloat32:
+        {
+          uint32_t u = get32(p, little);
+          float f;
+
+          memcpy(&f, &u, sizeof(f));
+          return f;
+        }
+      case GSSoundFormatFloat64:
+        {
+          uint64_t u;
+          double d;
+
+          if (little)
+            {
+              u = ((uint64_t)get32(p + 4, YES) << 32) | get32(p, YES);
+            }
+          else
+            {
+              u = ((uint64_t)get32(p, NO) << 32) | get32(p + 4, NO);
+            }
+          memcpy(&d, &u, sizeof(d));
+          return d;
+        }
+      case GSSoundFormatULaw:
+        return ulaw(p[0]);
+      case GSSoundFormatALaw:
+        return alaw(p[0]);
+      default:
+        return 0.0;
+    }
+}
+
+
+@implementation GSSoundVoice
+
+- (id) initWithSource: (id<GSSoundSource>)aSource pcm: (NSData *)data
+{
+  if ((self = [super init]) != nil)
+    {
+      ASSIGN(source, aSource);
+      ASSIGN(pcm, data);
+      volume = 1.0;
+      if (pcm == nil)
+        {
+          NSByteOrder order = [source byteOrder];
+
+          encoding = [source encoding];
+          channels = [source channelCount];
+          rate = [source sampleRate];
+          frameSize = sampleSize(encoding) * channels;
+          if (frameSize == 0 || rate == 0)
+            {
+              NSLog (@"Unsupported sound format %d", encoding);
+              DESTROY(self);
+              return nil;
+            }
+          if (order == NS_UnknownByteOrder)
+            {
+              order = NSHostByteOrder();
+            }
+          littleEndian = (order == NS_LittleEndian);
+          step = (double)rate / GS_SOUND_ENGINE_RATE;
+          sourceFrame = [source currentTime] * rate;
+          totalFrames = [source duration] * rate;
+          bytes = NSZoneMalloc(NSDefaultMallocZone(),
+                               CHUNK_FRAMES * frameSize);
+          capacity = 2 * CHUNK_FRAMES;
+          frames = NSZoneMalloc(NSDefaultMallocZone(),
+                                capacity * 2 * sizeof(float));
+          decodeLock = [NSLock new];
+        }
+    }
+  return self;
+}
+
+- (void) dealloc
+{
+  if (bytes != NULL)
+    {
+      NSZoneFree(NSDefaultMallocZone(), bytes);
+      NSZoneFree(NSDefaultMallocZone(), frames);
+    }
+  RELEASE(decodeLock);
+  RELEASE(source);
+  RELEASE(pcm);
+  RELEASE(sound);
+  [super dealloc];
+}
+
+/* Reads the next chunk of the source into out as stereo floats,
+ * returns the number of frames read. */
+- (NSUInteger) _decodeInto: (float *)out
+{
+  NSUInteger width = frameSize / channels;
+  NSUInteger n;
+  NSUInteger i;
+  const unsigned char *p = bytes;
+
+  n = [source readBytes: bytes length: CHUNK_FRAMES * frameSize] / frameSize;
+  for (i = 0; i < n; i++, p += frameSize)
+    {
+      float l = decodeSample(p, encoding, littleEndian);
+
+      out[2 * i] = l;
+      out[2 * i + 1] = (channels > 1)
+        ? decodeSample(p + width, encoding, littleEndian) : l;
+    }
+  return n;
+}
+
+/* Called once the voice left the engine.  The engine thread may still be
+ * decoding it, so wait for that before rewinding the source. */
+- (void) _stopDecoding
+{
+  [decodeLock lock];
+  removed = YES;
+  [source setCurrentTime: 0.0];
+  [decodeLock unlock];
+}
+
+/* Called by the engine thread with the engine lock held.  Takes over a
+ * position set with -setCurrentTime:, the source is moved to it by the
+ * next -decodeForFrames:. */
+- (void) _takeSeek
+{
+  if (seekRequested)
+    {
+      seekRequested = NO;
+      needsSeek = YES;
+      ended = NO;
+      count = 0;
+      position = 0.0;
+      sourceFrame = MIN(MAX(seekTime, 0.0) * rate, totalFrames);
+    }
+}
+
+- (void) decodeForFrames: (NSUInteger)n
+{
+  NSUInteger need;
+  BOOL rewound = NO;
+
+  if (pcm != nil)
+    {
+      return;
+    }
+
+  /* The frames up to the one after the last interpolated. */
+  need = (NSUInteger)(position + n * step) + 2;
+  [decodeLock lock];
+  if (removed == NO)
+    {
+      if (needsSeek)
+        {
+          [source setCurrentTime: seekTime];
+          needsSeek = NO;
+        }
+      while (count < need && ended == NO)
+        {
+          NSUInteger got;
+
+          if (count + CHUNK_FRAMES > capacity)
+            {
+              capacity = count + CHUNK_FRAMES;
+              frames = NSZoneRealloc(NSDefaultMallocZone(), frames,
+                                     capacity * 2 * sizeof(float));
+            }
+          got = [self _decodeInto: frames + 2 * count];
+          if (got == 0)
+            {
+              if (loops && rewound == NO)
+                {
+                  [source setCurrentTime: 0.0];
+                  rewound = YES;
+                }
+              else
+                {
+                  ended = YES;
+                }
+            }
+          else
+            {
+              rewound = NO;
+            }
+          count += got;
+        }
+    }
+  [decodeLock unlock];
+}
+
+- (NSUInteger) mixInto: (float *)mix frames: (NSUInteger)n
+{
+  float v = volume;
+  NSUInteger i = 0;
+  NSUInteger done;
+
+  if (pcm != nil)
+    {
+      const float *p = [pcm bytes];
+      NSUInteger total = [pcm length] / (2 * sizeof(float));
+
+      while (i < n)
+        {
+          NSUInteger c;
+          NSUInteger j;
+
+          if (pcmFrame >= total)
+            {
+              if (loops && total > 0)
+                {
+                  pcmFrame = 0;
+                }
+              else
+                {
+                  finished = YES;
+                  break;
+                }
+            }
+          c = MIN(n - i, total - pcmFrame);
+          for (j = 0; j < 2 * c; j++)
+            {
+              mix[2 * i + j] += p[2 * pcmFrame + j] * v;
+            }
+          i += c;
+          pcmFrame += c;
+        }
+      return i;
+    }
+
+  /* The position changed after the frames were decoded. */
+  if (seekRequested || needsSeek)
+    {
+      return 0;
+    }
+
+  while (i < n)
+    {
+      NSUInteger k = (NSUInteger)position;
+      float f;
+
+      if (k + 1 >= count)
+        {
+          if (ended)
+            {
+              finished = YES;
+            }
+          break;
+        }
+      f = position - k;
+      mix[2 * i] += (frames[2 * k]
+                     + (frames[2 * k + 2] - frames[2 * k]) * f) * v;
+      mix[2 * i + 1] += (frames[2 * k + 1]
+                         + (frames[2 * k + 3] - frames[2 * k + 1]) * f) * v;
+      position += step;
+      i++;
+    }
+
+  /* Drop the frames played, keeping the one still interpolated from. */
+  done = MIN((NSUInteger)position, count);
+  if (done > 0)
+    {
+      memmove(frames, frames + 2 * done,
+              (count - done) * 2 * sizeof(float));
+      count -= done;
+      position -= done;
+      sourceFrame += done;
+    }
+  return i;
+}
+
+- (NSTimeInterval) currentTime
+{
+  double frame;
+
+  if (pcm != nil)
+    {
+      return (NSTimeInterval)pcmFrame / GS_SOUND_ENGINE_RATE;
+    }
+  if (seekRequested)
+    {
+      return seekTime;
+    }
+  frame = sourceFrame + position;
+  if (totalFrames > 0.0)
+    {
+      frame = loops ? fmod(frame, totalFrames) : MIN(frame, totalFrames);
+    }
+  return frame / rate;
+}
+
+- (void) setCurrentTime: (NSTimeInterval)time
+{
+  if (pcm != nil)
+    {
+      NSUInteger total = [pcm length] / (2 * sizeof(float));
+
+      [source setCurrentTime: time];
+      pcmFrame = MIN((NSUInteger)(time * GS_SOUND_ENGINE_RATE), total);
+    }
+  else
+    {
+      /* The engine thread moves the source. */
+      seekTime = time;
+      seekRequested = YES;
+    }
+}
+
+@end
+
+
+@implementation GSSoundEngine
+
++ (GSSoundEngine *) sharedEngine
+{
+  if (sharedEngine == nil)
+    {
+      [gnustep_global_lock lock];
+      if (sharedEngine == nil)
+        {
+          sharedEngine = [[self alloc] init];
+        }
+      [gnustep_global_lock unlock];
+    }
+  return sharedEngine;
+}
+
++ (NSData *) decodeSource: (id<GSSoundSource>)source
+{
+  GSSoundVoice *voice;
+  NSMutableData *data;
+  float buffer[PERIOD_FRAMES * GS_SOUND_ENGINE_CHANNELS];
+
+  voice = [[GSSoundVoice alloc] initWithSource: source pcm: nil];
+  if (voice == nil)
+    {
+      return nil;
+    }
+  data = [NSMutableData dataWithCapacity: (NSUInteger)([source duration]
+    * GS_SOUND_ENGINE_RATE) * sizeof(buffer) / PERIOD_FRAMES];
+  [source setCurrentTime: 0.0];
+  while (voice->finished == NO)
+    {
+      NSUInteger n;
+
+      memset(buffer, 0, sizeof(buffer));
+      [voice decodeForFrames: PERIOD_FRAMES];
+      n = [voice mixInto: buffer frames: PERIOD_FRAMES];
+      [data appendBytes: buffer length: n * sizeof(buffer) / PERIOD_FRAMES];
+    }
+  [source setCurrentTime: 0.0];
+  RELEASE(voice);
+  return data;
+}
+
+- (id) init
+{
+  if ((self = [super init]) != nil)
+    {
+      lock = [[NSConditionLock alloc] initWithCondition: ENGINE_IDLE];
+      voices = [[NSMutableArray alloc] init];
+    }
+  return self;
+}
+
+- (int) _condition
+{
+  NSUInteger i = [voices count];
+
+  while (i-- > 0)
+    {
+      if (((GSSoundVoice *)[voices objectAtIndex: i])->paused == NO)
+        {
+          return ENGINE_BUSY;
+        }
+    }
+  return ENGINE_IDLE;
+}
+
+- (void) lock
+{
+  [lock lock];
+}
+
+- (void) unlock
+{
+  [lock unlockWithCondition: [self _condition]];
+}
+
+- (void) addVoice: (GSSoundVoice *)voice
+{
+  [lock lock];
+  [voices addObject: voice];
+  if (running == NO)
+    {
+      running = YES;
+      [NSThread detachNewThreadSelector: @selector(_run)
+                               toTarget: self
+                             withObject: nil];
+    }
+  [lock unlockWithCondition: [self _condition]];
+}
+
+- (void) _finishVoice: (GSSoundVoice *)voice
+{
+  [voice->sound performSelectorOnMainThread: @selector(_voiceDidFinish:)
+                                 withObject:
+    [NSArray arrayWithObjects: voice,
+             [NSNumber numberWithBool: voice->finished], nil]
+                              waitUntilDone: NO];
+}
+
+- (void) removeVoice: (GSSoundVoice *)voice
+{
+  BOOL found = NO;
+
+  [lock lock];
+  if ([voices indexOfObjectIdenticalTo: voice] != NSNotFound)
+    {
+      [self _finishVoice: voice];
+      [voices removeObjectIdenticalTo: voice];
+      found = YES;
+    }
+  [lock unlockWithCondition: [self _condition]];
+
+  if (found)
+    {
+      [voice _stopDecoding];
+    }
+}
+
+- (Class) sinkClass
+{
+  Class c;
+
+  [lock lock];
+  if (sinkClass == Nil)
+    {
+      NSString *name = [[NSUserDefaults standardUserDefaults]
+                         stringForKey: @"GSSoundOutputSink"];
+
+      c = Nil;
+      if (name != nil)
+        {
+          c = NSClassFromString(name);
+        }
+      if ([c conformsToProtocol: @protocol(GSSoundSink)] == NO)
+        {
+          NSEnumerator *enumerator;
+
+          enumerator = [[NSSound _soundSinkPlugIns] objectEnumerator];
+          while ((c = [enumerator nextObject]) != nil)
+            {
+              if ([c canInitWithPlaybackDevice: nil])
+                {
+                  break;
+                }
+            }
+        }
+      sinkClass = (c == Nil) ? [GSNullSoundSink class] : c;
+    }
+  c = sinkClass;
+  [lock unlockWithCondition: [self _condition]];
+  return c;
+}
+
+- (void) setPlaybackDeviceIdentifier: (NSString *)playbackDeviceIdentifier
+{
+  [lock lock];
+  ASSIGN(device, playbackDeviceIdentifier);
+  sinkOutdated = YES;
+  [lock unlockWithCondition: [self _condition]];
+}
+
+- (NSString *) playbackDeviceIdentifier
+{
+  NSString *d;
+
+  [lock lock];
+  d = AUTORELEASE(RETAIN(device));
+  [lock unlockWithCondition: [self _condition]];
+  return d;
+}
+
+- (void) setChannelMapping: (NSArray *)channelMapping
+{
+  [lock lock];
+  ASSIGN(mapping, channelMapping);
+  sinkOutdated = YES;
+  [lock unlockWithCondition: [self _condition]];
+}
+
+- (NSArray *) channelMapping
+{
+  NSArray *m;
+
+  [lock lock];
+  m = AUTORELEASE(RETAIN(mapping));
+  [lock unlockWithCondition: [self _condition]];
+  return m;
+}
+
+- (BOOL) _openSink
+{
+  NSString *d;
+  NSArray *m;
+  Class c;
+
+  if (sink != nil)
+    {
+      return YES;
+    }
+
+  c = [self sinkClass];
+  [lock lock];
+  d = AUTORELEASE(RETAIN(device));
+  m = AUTORELEASE(RETAIN(mapping));
+  sinkOutdated = NO;
+  [lock unlockWithCondition: [self _condition]];
+
+  sink = [[c alloc] initWithEncoding: GSSoundFormatPCM16
+                                    channels: GS_SOUND_ENGINE_CHANNELS
+                                  sampleRate: GS_SOUND_ENGINE_RATE
+                                   byteOrder: NSHostByteOrder()];
+  if (sink != nil)
+    {
+      if (d != nil && [c canInitWithPlaybackDevice: d])
+        {
+          [sink setPlaybackDeviceIdentifier: d];
+        }
+      if (m != nil)
+        {
+          [sink setChannelMapping: m];
+        }
+      if ([sink open] == NO)
+        {
+          DESTROY(sink);
+        }
+    }
+  if (sink == nil && c != [GSNullSoundSink class])
+    {
+      NSLog (@"Could not open sound sink %@, sounds will not be heard",
+        NSStringFromClass(c));
+      [lock lock];
+      sinkClass = [GSNullSoundSink class];
+      [lock unlockWithCondition: [self _condition]];
+      return [self _openSink];
+    }
+  return (sink != nil);
+}
+
+- (void) _closeSink
+{
+  if (sink != nil)
+    {
+      [sink close];
+      DESTROY(sink);
+    }
+}
+
+- (void) _run
+{
+  float *mix;
+  int16_t *out;
+  NSMutableArray *decoding;
+  NSMutableArray *done;
+
+  mix = NSZoneMalloc(NSDefaultMallocZone(),
+    PERIOD_FRAMES * GS_SOUND_ENGINE_CHANNELS * sizeof(float));
+  out = NSZoneMalloc(NSDefaultMallocZone(),
+    PERIOD_FRAMES * GS_SOUND_ENGINE_CHANNELS * sizeof(int16_t));
+  decoding = [[NSMutableArray alloc] init];
+  done = [[NSMutableArray alloc] init];
+
+  while (YES)
+    {
+      CREATE_AUTORELEASE_POOL(pool);
+      NSUInteger frames = 0;
+      NSUInteger i;
+      BOOL reopen;
+
+      if ([lock lockWhenCondition: ENGINE_BUSY
+                       beforeDate: [NSDate dateWithTimeIntervalSinceNow:
+                                             IDLE_TIMEOUT]] == NO)
+        {
+          [self _closeSink];
+          [lock lockWhenCondition: ENGINE_BUSY];
+        }
+
+      /* Decode the voices outside the lock, so that the main thread can
+         pause or seek sounds meanwhile. */
+      i = [voices count];
+      while (i-- > 0)
+        {
+          GSSoundVoice *voice = [voices objectAtIndex: i];
+
+          if (voice->paused == NO && voice->pcm == nil)
+            {
+              [voice _takeSeek];
+              [decoding addObject: voice];
+            }
+        }
+      [lock unlockWithCondition: [self _condition]];
+      for (i = 0; i < [decoding count]; i++)
+        {
+          [[decoding objectAtIndex: i] decodeForFrames: PERIOD_FRAMES];
+        }
+      [decoding removeAllObjects];
+      [lock lock];
+
+      memset(mix, 0, PERIOD_FRAMES * GS_SOUND_ENGINE_CHANNELS * sizeof(float));
+      i = [voices count];
+      while (i-- > 0)
+        {
+          GSSoundVoice *voice = [voices objectAtIndex: i];
+
+          if (voice->paused)
+            {
+              continue;
+            }
+          frames = MAX(frames, [voice mixInto: mix frames: PERIOD_FRAMES]);
+          if (voice->finished)
+            {
+              [voice->source setCurrentTime: 0.0];
+              [done addObject: voice];
+              [voices removeObjectAtIndex: i];
+            }
+        }
+      reopen = sinkOutdated;
+      [lock unlockWithCondition: [self _condition]];
+
+      if (reopen)
+        {
+          [self _closeSink];
+        }
+
+      for (i = 0; i < [done count]; i++)
+        {
+          [self _finishVoice: [done objectAtIndex: i]];
+        }
+      [done removeAllObjects];
+
+      if (frames > 0 && [self _openSink])
+        {
+          for (i = 0; i < frames * GS_SOUND_ENGINE_CHANNELS; i++)
+            {
+              float s = mix[i];
+
+              if (s > 1.0)
+                {
+                  s = 1.0;
+                }
+              else if (s < -1.0)
+                {
+                  s = -1.0;
+                }
+              out[i] = (int16_t)(s * 32767.0);
+            }
+          [sink playBytes: out
+                   length: frames * GS_SOUND_ENGINE_CHANNELS * sizeof(int16_t)];
+        }
+      RELEASE(pool);
+    }
+}
+
+@end
+
+
+@implementation GSNullSoundSink
+
++ (BOOL) canInitWithPlaybackDevice: (NSString *)playbackDevice
+{
+  return YES;
+}
+
+- (id) initWithEncoding: (int)encoding
+               channels: (NSUInteger)channelCount
+             sampleRate: (NSUInteger)sampleRate
+              byteOrder: (NSByteOrder)byteOrder
+{
+  if ((self = [super init]) != nil)
+    {
+      bytesPerSecond = sampleRate * channelCount * sampleSize(encoding);
+      volume = 1.0;
+    }
+  return self;
+}
+
+- (void) dealloc
+{
+  [self close];
+  RELEASE(device);
+  RELEASE(mapping);
+  [super dealloc];
+}
+
+- (BOOL) open
+{
+  NSString *path = [[NSUserDefaults standardUserDefaults]
+                     stringForKey: @"GSSoundOutputFile"];
+
+  if (path != nil)
+    {
+      NSFileManager *mgr = [NSFileManager defaultManager];
+
+      if ([mgr fileExistsAtPath: path] == NO)
+        {
+          [mgr createFileAtPath: path contents: nil attributes: nil];
+        }
+      ASSIGN(file, [NSFileHandle fileHandleForWritingAtPath: path]);
+      [file seekToEndOfFile];
+    }
+  next = 0.0;
+  return YES;
+}
+
+- (void) close
+{
+  [file closeFile];
+  DESTROY(file);
+}
+
+- (BOOL) playBytes: (void *)bytes length: (NSUInteger)length
+{
+  NSTimeInterval now = [NSDate timeIntervalSinceReferenceDate];
+
+  if (file != nil)
+    {
+      [file writeData: [NSData dataWithBytes: bytes length: length]];
+    }
+
+  /* Take as long as a device would, keeping a short buffer ahead. */
+  if (bytesPerSecond > 0)
+    {
+      if (next < now)
+        {
+          next = now;
+        }
+      next += (NSTimeInterval)length / bytesPerSecond;
+      if (next - now > 0.05)
+        {
+          [NSThread sleepUntilDate:
+            [NSDate dateWithTimeIntervalSinceReferenceDate: next - 0.05]];
+        }
+    }
+  return YES;
+}
+
+- (void) setVolume: (float)aVolume
+{
+  volume = aVolume;
+}
+
+- (float) volume
+{
+  return volume;
+}
+
+- (void) setPlaybackDeviceIdentifier: (NSString *)playbackDeviceIdentifier
+{
+  ASSIGN(device, playbackDeviceIdentifier);
+}
+
+- (NSString *) playbackDeviceIdentifier
+{
+  return device;
+}
+
+- (void) setChannelMapping: (NSArray *)channelMapping
+{
+  ASSIGN(mapping, channelMapping);
+}
+
+- (NSArray *) channelMapping
+{
+  return mapping;
+}
+
+@end
+
+
+static inline NSUInteger
+get16le(const unsigned char *p)
+{
+  return p[0] | (p[1] << 8);
+}
+
+/* Finds the format and the sample data of a RIFF WAVE file. */
+static BOOL
+parseWave(NSData *data, NSUInteger *start, NSUInteger *length,
+          int *encoding, NSUInteger *channels, NSUInteger *rate)
+{
+  const unsigned char *b = [data bytes];
+  NSUInteger len = [data length];
+  NSUInteger pos = 12;
+  NSUInteger tag = 0;
+  NSUInteger bits = 0;
+  BOOL haveData = NO;
+
+  if (len < 12 || memcmp(b, "RIFF", 4) != 0 || memcmp(b + 8, "WAVE", 4) != 0)
+    {
+      return NO;
+    }
+
+  *encoding = GSSoundFormatUnknown;
+  while (pos + 8 <= len)
+    {
+      NSUInteger size = get32(b + pos + 4, YES);
+      const unsigned char *chunk = b + pos + 8;
+
+      if (memcmp(b + pos, "fmt ", 4) == 0 && size >= 16
+          && pos + 8 + size <= len)
+        {
+          tag = get16le(chunk);
+          *channels = get16le(chunk + 2);
+          *rate = get32(chunk + 4, YES);
+          bits = get16le(chunk + 14);
+          if (tag == 0xFFFE && size >= 26)
+            {
+              // WAVE_FORMAT_EXTENSIBLE, the sub format starts the GUID.
+              tag = get16le(chunk + 24);
+            }
+        }
+      else if (memcmp(b + pos, "data", 4) == 0)
+        {
+          *start = pos + 8;
+          *length = MIN(size, len - *start);
+          haveData = YES;
+        }
+      pos += 8 + size + (size & 1);
+    }
+
+  if (tag == 1)
+    {
+      if (bits == 8)
+        *encoding = GSSoundFormatPCMU8;
+      else if (bits == 16)
+        *encoding = GSSoundFormatPCM16;
+      else if (bits == 24)
+        *encoding = GSSoundFormatPCM24;
+      else if (bits == 32)
+        *encoding = GSSoundFormatPCM32;
+    }
+  else if (tag == 3)
+    {
+      if (bits == 32)
+        *encoding = GSSoundFormatFloat32;
+      else if (bits == 64)
+        *encoding = GSSoundFormatFloat64;
+    }
+  else if (tag == 6 && bits == 8)
+    {
+      *encoding = GSSoundFormatALaw;
+    }
+  else if (tag == 7 && bits == 8)
+    {
+      *encoding = GSSoundFormatULaw;
+    }
+
+  return (haveData && *encoding != GSSoundFormatUnknown
+          && *channels > 0 && *rate > 0);
+}
+
+@implementation GSWaveSoundSource
+
++ (NSArray *) soundUnfilteredFileTypes
+{
+  return [NSArray arrayWithObject: @"wav"];
+}
+
++ (NSArray *) soundUnfilteredTypes
+{
+  return [NSArray arrayWithObject: @"com.microsoft.waveform-audio"];
+}
+
++ (BOOL) canInitWithData: (NSData *)data
+{
+  NSUInteger start, length, channels, rate;
+  int encoding;
+
+  return parseWave(data, &start, &length, &encoding, &channels, &rate);
+}
+
+- (id) initWithData: (NSData *)someData
+{
+  if ((self = [super init]) != nil)
+    {
+      if (parseWave(someData, &start, &length, &encoding, &channels, &rate)
+          == NO)
+        {
+          DESTROY(self);
+          return nil;
+        }
+      ASSIGN(data, someData);
+      frameSize = sampleSize(encoding) * channels;
+      length -= length % frameSize;
+    }
+  return self;
+}
+
+- (void) dealloc
+{
+  RELEASE(data);
+  [super dealloc];
+}
+
+- (NSUInteger) readBytes: (void *)bytes length: (NSUInteger)len
+{
+  len = MIN(len, length - offset);
+  len -= len % frameSize;
+  memcpy(bytes, (const char *)[data bytes] + start + offset, len);
+  offset += len;
+  return len;
+}
+
+- (NSTimeInterval) duration
+{
+  return (NSTimeInterval)(length / frameSize) / rate;
+}
+
+- (void) setCurrentTime: (NSTimeInterval)currentTime
+{
+  NSUInteger frame = (currentTime > 0.0) ? currentTime * rate : 0;
+
+  offset = MIN(frame, length / frameSize) * frameSize;
+}
+
+- (NSTimeInterval) currentTime
+{
+  return (NSTimeInterval)(offset / frameSize) / rate;
+}
+
+- (int) encoding
+{
+  return encoding;
+}
+
+- (NSUInteger) channelCount
+{
+  return channels;
+}
+
+- (NSUInteger) sampleRate
+{
+  return rate;
+}
+
+- (NSByteOrder) byteOrder
+{
+  return NS_LittleEndian;
+}
+
+@end
@@ -32,6 +32,7 @@
 
 #import <Foundation/NSObject.h>
 
+@class NSArray;
 @class NSString;
 @class NSButton;
 @class NSMatrix;
@@ -77,6 +78,21 @@
 	      onlyInSelection: (BOOL)flag;
 - (NSTextView *) targetView: (NSTextView *)aTextView;
 
+// Returns the ranges (as NSValues) of all matches of the find string in
+// aTextView, or in its selection if flag is YES, e.g. to highlight them.
+- (NSArray *) findAllInTextView: (NSTextView *)aTextView
+		onlyInSelection: (BOOL)flag;
+// Like -findAllInTextView:onlyInSelection:, but sends selector to target
+// on the main thread with a dictionary holding the text searched
+// (String), its range in the text view (Range) and the matches (Ranges).
+// Large texts are searched in the background on a copy, so callers should
+// check that the text has not changed since.  A search which is still
+// pending when another one is started is cancelled and never reports.
+- (void) findAllInTextView: (NSTextView *)aTextView
+	   onlyInSelection: (BOOL)flag
+		    target: (id)target
+		  selector: (SEL)selector;
+
 @end
 
 #endif /* _GS_TEXT_FINDER_H */
@@ -25,8 +25,13 @@
 */
 
 #import "config.h"
-#import <Foundation/NSString.h>
+#import <Foundation/NSArray.h>
+#import <Foundation/NSDictionary.h>
 #import <Foundation/NSNotification.h>
+#import <Foundation/NSOperation.h>
+#import <Foundation/NSString.h>
+#import <Foundation/NSUndoManager.h>
+#import <Foundation/NSValue.h>
 #import "AppKit/NSApplication.h"
 #import "AppKit/NSButton.h"
 #import "AppKit/NSEvent.h"
@@ -37,6 +42,7 @@
 #import "AppKit/NSPanel.h"
 #import "AppKit/NSPasteboard.h"
 #import "AppKit/NSTextField.h"
+#import "AppKit/NSTextStorage.h"
 #import "AppKit/NSTextView.h"
 #import "AppKit/NSWindow.h"
 #import "GSGuiPrivate.h"
@@ -53,10 +59,71 @@
 - (void) _putFindStringToPasteboard;
 @end
 
+/* Searches for find strings off the main thread, see
+   -findAllInTextView:onlyInSelection:target:selector: */
+@interface GSFindAllOperation : NSOperation
+{
+  NSString *string;
+  NSString *findString;
+  unsigned int options;
+  NSRange range;
+  id target;
+  SEL selector;
+  NSDictionary *result;
+}
+- (id) initWithString: (NSString *)aString
+	   findString: (NSString *)aFindString
+	      options: (unsigned int)mask
+		range: (NSRange)aRange
+	       target: (id)aTarget
+	     selector: (SEL)aSelector;
+@end
+
+/* Texts shorter than this are searched for all matches at once */
+#define FIND_ALL_BACKGROUND_LENGTH 262144
+
+static NSOperationQueue *findQueue = nil;
+
+/* Returns the ranges of all matches of findString in range of string,
+   which do not overlap. */
+static NSArray *
+rangesOfString(NSString *string, NSString *findString,
+	       unsigned int options, NSRange range)
+{
+  NSMutableArray *ranges = [NSMutableArray array];
+  NSRange r;
+
+  if ([findString length] == 0)
+    {
+      return ranges;
+    }
+
+  while (range.length > 0)
+    {
+      r = [string rangeOfString: findString options: options range: range];
+      if (r.location == NSNotFound)
+	{
+	  break;
+	}
+      [ranges addObject: [NSValue valueWithRange: r]];
+      range = NSMakeRange(NSMaxRange(r), NSMaxRange(range) - NSMaxRange(r));
+    }
+  return ranges;
+}
+
 @implementation GSTextFinder
 
 static GSTextFinder *sharedTextFinder;
 
++ (void) initialize
+{
+  if (self == [GSTextFinder class])
+    {
+      findQueue = [NSOperationQueue new];
+      [findQueue setMaxConcurrentOperationCount: 1];
+    }
+}
+
 + (GSTextFinder *) sharedTextFinder
 {
   if (sharedTextFinder == nil)
@@ -357,8 +424,12 @@ static GSTextFinder *sharedTextFinder;
 - (void) replaceAllInTextView: (NSTextView *)aTextView
 	      onlyInSelection: (BOOL)flag
 {
-  int n;
+  NSUInteger i, n, count;
+  NSInteger delta;
   NSRange range, replaceRange;
+  NSArray *ranges;
+  NSTextStorage *textStorage;
+  NSUndoManager *undo;
   NSString *format;
   NSString *string;
   unsigned int options = NSLiteralSearch | NSCaseInsensitiveSearch;
@@ -372,48 +443,120 @@ static GSTextFinder *sharedTextFinder;
   replaceRange =
     flag ? [aTextView selectedRange] : NSMakeRange(0, [string length]);
 
-  // look for a first match in the range
-  range = [string rangeOfString: findString
-			options: options
-			  range: replaceRange];
-  if (range.location == NSNotFound)
+  // collect all matches in the range before changing anything
+  ranges = rangesOfString(string, findString, options, replaceRange);
+  count = [ranges count];
+  if (count == 0)
     {
       [messageText setStringValue: _(@"Not found")];
       NSBeep();
       return;
     }
 
+  // Replace the matches in one batch of edits, so that the text storage
+  // is processed and laid out once, and undo them in one step.  Each
+  // match is shifted by the change in length of the ones before it.
+  textStorage = [aTextView textStorage];
+  undo = [aTextView undoManager];
+  [undo beginUndoGrouping];
+  [textStorage beginEditing];
   n = 0;
-  do
+  delta = 0;
+  range = NSMakeRange(NSNotFound, 0);
+  for (i = 0; i < count; i++)
     {
+      range = [[ranges objectAtIndex: i] rangeValue];
+      range.location += delta;
       if ([aTextView shouldChangeTextInRange: range
 			   replacementString: replaceString])
 	{
 	  [aTextView replaceCharactersInRange: range
 				   withString: replaceString];
-	  [aTextView didChangeText];
+	  delta += (NSInteger)[replaceString length] - (NSInteger)range.length;
+	  range.length = [replaceString length];
 	  n++;
 	}
-
-      replaceRange =
-	NSMakeRange(range.location + [replaceString length],
-		    NSMaxRange(replaceRange) -
-		    (range.location + [findString length]));
-      range = [string rangeOfString: findString
-			    options: options
-			      range: replaceRange];
     }
-  while (range.location != NSNotFound);
+  [textStorage endEditing];
+  [undo endUndoGrouping];
+  if (n > 0)
+    {
+      [aTextView didChangeText];
+    }
 
   format = _(@"%d replaced");
-  [messageText setStringValue: [NSString stringWithFormat: format, n]];
+  [messageText setStringValue: [NSString stringWithFormat: format, (int)n]];
 
   // set insertion point to the end of the last match
-  range = NSMakeRange(replaceRange.location, 0);
+  range = NSMakeRange(NSMaxRange(range), 0);
   [aTextView setSelectedRange: range];
   [aTextView scrollRangeToVisible: range];
 }
 
+- (NSArray *) findAllInTextView: (NSTextView *)aTextView
+		onlyInSelection: (BOOL)flag
+{
+  NSString *string;
+  NSRange range;
+  unsigned int options = NSLiteralSearch | NSCaseInsensitiveSearch;
+
+  if (aTextView == nil)
+    {
+      return [NSArray array];
+    }
+
+  [self _updateFindStringFromPanel: &options putToPasteboard: NO];
+  string = [aTextView string];
+  range = flag ? [aTextView selectedRange] : NSMakeRange(0, [string length]);
+  return rangesOfString(string, findString, options, range);
+}
+
+- (void) findAllInTextView: (NSTextView *)aTextView
+	   onlyInSelection: (BOOL)flag
+		    target: (id)target
+		  selector: (SEL)selector
+{
+  GSFindAllOperation *op;
+  NSString *string;
+  NSRange range;
+  unsigned int options = NSLiteralSearch | NSCaseInsensitiveSearch;
+
+  if (aTextView == nil)
+    {
+      return;
+    }
+
+  // only the latest search is of interest
+  [findQueue cancelAllOperations];
+
+  [self _updateFindStringFromPanel: &options putToPasteboard: NO];
+  string = [aTextView string];
+  range = flag ? [aTextView selectedRange] : NSMakeRange(0, [string length]);
+  if (range.length < FIND_ALL_BACKGROUND_LENGTH)
+    {
+      NSDictionary *result;
+
+      result = [NSDictionary dictionaryWithObjectsAndKeys:
+	[string substringWithRange: range], @"String",
+	[NSValue valueWithRange: range], @"Range",
+	rangesOfString(string, findString, options, range), @"Ranges",
+	nil];
+      [target performSelector: selector withObject: result];
+      return;
+    }
+
+  // The text may change while the search runs, so search a copy of it.
+  op = [[GSFindAllOperation alloc]
+	 initWithString: [string substringWithRange: range]
+	     findString: findString
+		options: options
+		  range: range
+		 target: target
+	       selector: selector];
+  [findQueue addOperation: op];
+  RELEASE(op);
+}
+
 - (NSTextView *) targetView: (NSTextView *)aTextView
 {
   // If aTextView is equal to the find panel's field editor use the default
@@ -527,3 +670,79 @@ static GSTextFinder *sharedTextFinder;
 }
 
 @end
+
+@implementation GSFindAllOperation
+
+- (id) initWithString: (NSString *)aString
+	   findString: (NSString *)aFindString
+	      options: (unsigned int)mask
+		range: (NSRange)aRange
+	       target: (id)aTarget
+	     selector: (SEL)aSelector
+{
+  if ((self = [super init]) != nil)
+    {
+      ASSIGN(string, aString);
+      ASSIGNCOPY(findString, aFindString);
+      options = mask;
+      range = aRange;
+      ASSIGN(target, aTarget);
+      selector = aSelector;
+    }
+  return self;
+}
+
+- (void) dealloc
+{
+  RELEASE(string);
+  RELEASE(findString);
+  RELEASE(target);
+  RELEASE(result);
+  [super dealloc];
+}
+
+- (void) main
+{
+  CREATE_AUTORELEASE_POOL(pool);
+  NSMutableArray *ranges = [NSMutableArray array];
+  NSEnumerator *e;
+  NSValue *value;
+
+  if ([self isCancelled])
+    {
+      RELEASE(pool);
+      return;
+    }
+
+  // Report the ranges in the text the caller searched.
+  e = [rangesOfString(string, findString, options,
+		      NSMakeRange(0, [string length])) objectEnumerator];
+  while ((value = [e nextObject]) != nil)
+    {
+      NSRange r = [value rangeValue];
+
+      r.location += range.location;
+      [ranges addObject: [NSValue valueWithRange: r]];
+    }
+  result = [[NSDictionary alloc] initWithObjectsAndKeys:
+    string, @"String",
+    [NSValue valueWithRange: range], @"Range",
+    ranges, @"Ranges", nil];
+
+  [self performSelectorOnMainThread: @selector(_finish)
+			 withObject: nil
+		      waitUntilDone: NO];
+  RELEASE(pool);
+}
+
+- (void) _finish
+{
+  // A newer search may have been started while this one was running.
+  if (![self isCancelled])
+    {
+      [target performSelector: selector withObject: result];
+    }
+  DESTROY(target);
+}
+
+@end
@@ -87,6 +87,27 @@
                      inFrame: (NSRect)aRect;
 @end
 
+/* Returns the index of the first column from start on whose origin is
+   not to the left of x, or count if there is no such column.  The column
+   origins are in increasing order, so this is a binary search. */
+static inline NSInteger
+columnAtOrAfter(const CGFloat *origins, NSInteger start, NSInteger count,
+		CGFloat x)
+{
+  NSInteger end = count;
+
+  while (start < end)
+    {
+      NSInteger mid = start + (end - start) / 2;
+
+      if (x > origins[mid])
+	start = mid + 1;
+      else
+	end = mid;
+    }
+  return start;
+}
+
 @implementation	GSTheme (Drawing)
 - (void) setKeyEquivalent: (NSString *)key 
             forButtonCell: (NSButtonCell *)cell
@@ -3341,11 +3362,7 @@ static NSDictionary *titleTextAttributes[3] = {nil, nil, nil};
 
   /* Determine starting column as fast as possible */
   x_pos = NSMinX (clipRect);
-  i = 0;
-  while ((i < numberOfColumns) && (x_pos > columnOrigins[i]))
-    {
-      i++;
-    }
+  i = columnAtOrAfter (columnOrigins, 0, numberOfColumns, x_pos);
   startingColumn = (i - 1);
 
   if (startingColumn == -1)
@@ -3354,10 +3371,7 @@ static NSDictionary *titleTextAttributes[3] = {nil, nil, nil};
   /* Determine ending column as fast as possible */
   x_pos = NSMaxX (clipRect);
   // Nota Bene: we do *not* reset i
-  while ((i < numberOfColumns) && (x_pos > columnOrigins[i]))
-    {
-      i++;
-    }
+  i = columnAtOrAfter (columnOrigins, i, numberOfColumns, x_pos);
   endingColumn = (i - 1);
 
   if (endingColumn == -1)
@@ -33,13 +33,13 @@
 #import <Foundation/NSIndexSet.h>
 #import <Foundation/NSKeyValueObserving.h>
 #import <Foundation/NSPredicate.h>
+#import <Foundation/NSSet.h>
 #import <Foundation/NSSortDescriptor.h>
 #import <Foundation/NSString.h>
 
 #import "AppKit/NSArrayController.h"
 #import "AppKit/NSKeyValueBinding.h"
 #import "GSBindingHelpers.h"
-#import "GSFastEnumeration.h"
 
 @implementation GSObservableArray
 
@@ -115,6 +115,31 @@
                                 initWithArray: result]);
 }
 
+/* The array controller updates its arranged objects in place. */
+- (void) _insertObjects: (NSArray *)objects atIndexes: (NSIndexSet *)indexes
+{
+  if (![_array isKindOfClass: [NSMutableArray class]])
+    {
+      NSMutableArray *tmp = [_array mutableCopy];
+
+      RELEASE(_array);
+      _array = tmp;
+    }
+  [(NSMutableArray *)_array insertObjects: objects atIndexes: indexes];
+}
+
+- (void) _removeObjectsAtIndexes: (NSIndexSet *)indexes
+{
+  if (![_array isKindOfClass: [NSMutableArray class]])
+    {
+      NSMutableArray *tmp = [_array mutableCopy];
+
+      RELEASE(_array);
+      _array = tmp;
+    }
+  [(NSMutableArray *)_array removeObjectsAtIndexes: indexes];
+}
+
 - (void) addObserver: (NSObject*)anObserver
 	  forKeyPath: (NSString*)aPath
 	     options: (NSKeyValueObservingOptions)options
@@ -140,6 +165,61 @@
 
 @end
 
+/*
+ * Compare two objects using the sort descriptors in order.
+ */
+static NSComparisonResult
+compareWithDescriptors(id a, id b, NSArray *descriptors)
+{
+  NSUInteger count = [descriptors count];
+  NSUInteger i;
+
+  for (i = 0; i < count; i++)
+    {
+      NSComparisonResult result;
+
+      result = [[descriptors objectAtIndex: i] compareObject: a toObject: b];
+      if (result != NSOrderedSame)
+        {
+          return result;
+        }
+    }
+  return NSOrderedSame;
+}
+
+/*
+ * Return the index after the last object in the sorted array at or after
+ * start which does not sort after obj, so that equal objects keep the
+ * order in which they were added.
+ */
+static NSUInteger
+insertionIndex(NSArray *array, NSUInteger start, id obj, NSArray *descriptors)
+{
+  NSUInteger low = start;
+  NSUInteger high = [array count];
+
+  while (low < high)
+    {
+      NSUInteger mid = low + (high - low) / 2;
+
+      if (compareWithDescriptors([array objectAtIndex: mid], obj,
+                                 descriptors) == NSOrderedDescending)
+        {
+          high = mid;
+        }
+      else
+        {
+          low = mid + 1;
+        }
+    }
+  return low;
+}
+
+@interface NSArrayController (Private)
+- (void) _insertArrangedObjects: (NSArray *)objects;
+- (void) _removeArrangedObjects: (NSArray *)objects;
+@end
+
 @implementation NSArrayController
 
 + (void) initialize
@@ -147,8 +227,6 @@
   if (self == [NSArrayController class])
     {
       [self exposeBinding: NSContentArrayBinding];
-      [self setKeys: [NSArray arrayWithObjects: NSContentBinding, NSContentObjectBinding, nil] 
-            triggerChangeNotificationsForDependentKey: @"arrangedObjects"];
     }
 }
 
@@ -184,14 +262,7 @@
 {
   [self willChangeValueForKey: NSContentBinding];
   [_content addObject: obj];
-  if ([self automaticallyRearrangesObjects])
-    {
-      [self rearrangeObjects];
-    }
-  else 
-    {
-      DESTROY(_arranged_objects);
-    }
+  [self _insertArrangedObjects: [NSArray arrayWithObject: obj]];
   if ([self selectsInsertedObjects])
     {
       [self addSelectedObjects: [NSArray arrayWithObject: obj]];
@@ -203,14 +274,7 @@
 {
   [self willChangeValueForKey: NSContentBinding];
   [_content addObjectsFromArray: obj];
-  if ([self automaticallyRearrangesObjects])
-    {
-      [self rearrangeObjects];
-    }
-  else 
-    {
-      DESTROY(_arranged_objects);
-    }
+  [self _insertArrangedObjects: obj];
   if ([self selectsInsertedObjects])
     {
       [self addSelectedObjects: obj];
@@ -223,14 +287,7 @@
   [self willChangeValueForKey: NSContentBinding];
   [_content removeObject: obj];
   [self removeSelectedObjects: [NSArray arrayWithObject: obj]];
-  if ([self automaticallyRearrangesObjects])
-    {
-      [self rearrangeObjects];
-    }
-  else 
-    {
-      DESTROY(_arranged_objects);
-    }
+  [self _removeArrangedObjects: [NSArray arrayWithObject: obj]];
   [self didChangeValueForKey: NSContentBinding];
 }
 
@@ -239,14 +296,7 @@
   [self willChangeValueForKey: NSContentBinding];
   [_content removeObjectsInArray: obj];
   [self removeSelectedObjects: obj];
-  if ([self automaticallyRearrangesObjects])
-    {
-      [self rearrangeObjects];
-    }
-  else 
-    {
-      DESTROY(_arranged_objects);
-    }
+  [self _removeArrangedObjects: obj];
   [self didChangeValueForKey: NSContentBinding];
 }
 
@@ -272,17 +322,37 @@
 - (NSIndexSet*) _indexSetForObjects: (NSArray*)objects
 {
   NSMutableIndexSet *tmp = [NSMutableIndexSet new];
-  id<NSFastEnumeration> enumerator = objects;
-
-  FOR_IN (id, obj, enumerator)
-  {
-    NSUInteger index = [_arranged_objects indexOfObject: obj];
-    if (NSNotFound != index)
-      {
-        [tmp addIndex: index];
-      }
-  }
-  END_FOR_IN(enumerator)
+
+  if ([objects count] == 1)
+    {
+      NSUInteger index;
+
+      index = [_arranged_objects indexOfObject: [objects objectAtIndex: 0]];
+      if (NSNotFound != index)
+        {
+          [tmp addIndex: index];
+        }
+    }
+  else if ([objects count] > 1)
+    {
+      /* Look for all objects in a single pass over the arranged objects,
+         keeping the first index of each. */
+      NSMutableSet *wanted = [[NSMutableSet alloc] initWithArray: objects];
+      NSUInteger count = [_arranged_objects count];
+      NSUInteger index;
+
+      for (index = 0; index < count && [wanted count] > 0; index++)
+        {
+          id obj = [_arranged_objects objectAtIndex: index];
+
+          if ([wanted member: obj] != nil)
+            {
+              [tmp addIndex: index];
+              [wanted removeObject: obj];
+            }
+        }
+      RELEASE(wanted);
+    }
 
   return AUTORELEASE(tmp);
 }
@@ -469,6 +539,141 @@
   return [temp sortedArrayUsingDescriptors: _sort_descriptors];
 }
 
+/*
+ * Add objects just added to the content to the arranged objects.  When
+ * rearranging automatically only the new objects are filtered and they
+ * are inserted at their sorted positions, otherwise they are appended.
+ */
+- (void) _insertArrangedObjects: (NSArray *)objects
+{
+  NSUInteger count = [_arranged_objects count];
+  NSMutableIndexSet *indexes;
+  NSMutableIndexSet *selection;
+  NSUInteger index;
+
+  if (_arranged_objects == nil)
+    {
+      /* Arranged lazily on first use, but observers still need to know
+         that the arranged objects changed. */
+      [self willChangeValueForKey: @"arrangedObjects"];
+      [self didChangeValueForKey: @"arrangedObjects"];
+      return;
+    }
+
+  if ([self automaticallyRearrangesObjects])
+    {
+      if ([objects count] > count)
+        {
+          /* Cheaper to start over. */
+          [self rearrangeObjects];
+          return;
+        }
+      objects = [self arrangeObjects: objects];
+    }
+  if ([objects count] == 0)
+    {
+      return;
+    }
+
+  if ([self automaticallyRearrangesObjects] && [_sort_descriptors count] > 0)
+    {
+      NSUInteger start = 0;
+      NSUInteger i;
+
+      indexes = [NSMutableIndexSet indexSet];
+      for (i = 0; i < [objects count]; i++)
+        {
+          start = insertionIndex(_arranged_objects, start,
+                                 [objects objectAtIndex: i],
+                                 _sort_descriptors);
+          [indexes addIndex: start + i];
+        }
+    }
+  else
+    {
+      indexes = [NSMutableIndexSet indexSetWithIndexesInRange:
+                                     NSMakeRange(count, [objects count])];
+    }
+
+  [self willChange: NSKeyValueChangeInsertion
+   valuesAtIndexes: indexes
+            forKey: @"arrangedObjects"];
+  [(GSObservableArray *)_arranged_objects _insertObjects: objects atIndexes: indexes];
+  [self didChange: NSKeyValueChangeInsertion
+  valuesAtIndexes: indexes
+           forKey: @"arrangedObjects"];
+
+  /* Keep the selection on the same objects. */
+  if ([_selection_indexes count] > 0)
+    {
+      selection = AUTORELEASE([_selection_indexes mutableCopy]);
+      index = [indexes firstIndex];
+      while (index != NSNotFound)
+        {
+          [selection shiftIndexesStartingAtIndex: index by: 1];
+          index = [indexes indexGreaterThanIndex: index];
+        }
+      [self setSelectionIndexes: selection];
+    }
+}
+
+/*
+ * Remove objects just removed from the content from the arranged objects.
+ */
+- (void) _removeArrangedObjects: (NSArray *)objects
+{
+  NSMutableIndexSet *indexes;
+  NSMutableIndexSet *selection;
+  NSSet *removed;
+  NSUInteger count;
+  NSUInteger index;
+
+  if (_arranged_objects == nil)
+    {
+      [self willChangeValueForKey: @"arrangedObjects"];
+      [self didChangeValueForKey: @"arrangedObjects"];
+      return;
+    }
+
+  /* The content drops all equal objects, so do the same here. */
+  removed = [[NSSet alloc] initWithArray: objects];
+  indexes = [NSMutableIndexSet indexSet];
+  count = [_arranged_objects count];
+  for (index = 0; index < count; index++)
+    {
+      if ([removed member: [_arranged_objects objectAtIndex: index]] != nil)
+        {
+          [indexes addIndex: index];
+        }
+    }
+  RELEASE(removed);
+  if ([indexes count] == 0)
+    {
+      return;
+    }
+
+  [self willChange: NSKeyValueChangeRemoval
+   valuesAtIndexes: indexes
+            forKey: @"arrangedObjects"];
+  [(GSObservableArray *)_arranged_objects _removeObjectsAtIndexes: indexes];
+  [self didChange: NSKeyValueChangeRemoval
+  valuesAtIndexes: indexes
+           forKey: @"arrangedObjects"];
+
+  if ([_selection_indexes count] > 0)
+    {
+      selection = AUTORELEASE([_selection_indexes mutableCopy]);
+      [selection removeIndexes: indexes];
+      index = [indexes lastIndex];
+      while (index != NSNotFound)
+        {
+          [selection shiftIndexesStartingAtIndex: index + 1 by: -1];
+          index = [indexes indexLessThanIndex: index];
+        }
+      [self setSelectionIndexes: selection];
+    }
+}
+
 - (id) arrangedObjects
 {
   if (_arranged_objects == nil)
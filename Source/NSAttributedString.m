@@ -28,6 +28,8 @@
    Boston, MA 02110-1301, USA.
 */ 
 
+#include <pthread.h>
+
 #import <Foundation/NSArray.h>
 #import <Foundation/NSAutoreleasePool.h>
 #import <Foundation/NSBundle.h>
@@ -37,6 +39,8 @@
 #import <Foundation/NSError.h>
 #import <Foundation/NSException.h>
 #import <Foundation/NSFileManager.h>
+#import <Foundation/NSMapTable.h>
+#import <Foundation/NSNull.h>
 #import <Foundation/NSPathUtilities.h>
 #import <Foundation/NSRange.h>
 #import <Foundation/NSSet.h>
@@ -1460,6 +1464,38 @@ BOOL containsTable(NSArray *textBlocks, NSTextTable *table)
 static NSString *lastFont = nil;
 static NSCharacterSet *lastSet = nil;
 static NSMutableDictionary *cachedCSets = nil;
+/* Maps characters to the name of the font found to cover them, or to
+   NSNull when no font does. */
+static NSMapTable *cachedSubstitutes = nil;
+/* The font lists the caches above were filled from */
+static NSArray *cachedPreferredFonts = nil;
+static NSArray *cachedAvailableFonts = nil;
+/* Text storages may fix their attributes in any thread, so the caches
+   above are only used with this lock held.  It is initialised statically
+   because a category has no +initialize to create an NSLock in. */
+static pthread_mutex_t substituteLock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Empties the substitution caches when the preferred or the available
+   fonts have changed since they were filled. */
+static void
+checkSubstituteCaches(void)
+{
+  NSArray *preferred = [NSFont preferredFontNames];
+  NSArray *available = [[NSFontManager sharedFontManager] availableFonts];
+
+  if (preferred != cachedPreferredFonts || available != cachedAvailableFonts)
+    {
+      ASSIGN(cachedPreferredFonts, preferred);
+      ASSIGN(cachedAvailableFonts, available);
+      DESTROY(lastFont);
+      DESTROY(lastSet);
+      [cachedCSets removeAllObjects];
+      if (cachedSubstitutes != nil)
+        {
+          NSResetMapTable(cachedSubstitutes);
+        }
+    }
+}
 
 - (NSFont*)_substituteFontWithName: (NSString*)fontName 
                               font: (NSFont*)baseFont
@@ -1540,7 +1576,7 @@ static NSMutableDictionary *cachedCSets = nil;
     }
 }
 
-- (NSFont*)_substituteFontFor: (unichar)uchar font: (NSFont*)baseFont
+- (NSFont*)_findSubstituteFontFor: (unichar)uchar font: (NSFont*)baseFont
 {
   NSFont *subFont;
   NSFontDescriptor *descriptor;
@@ -1586,6 +1622,45 @@ static NSMutableDictionary *cachedCSets = nil;
   return nil;
 }
 
+- (NSFont*)_substituteFontFor: (unichar)uchar font: (NSFont*)baseFont
+{
+  NSFont *subFont = nil;
+  NSString *fName;
+
+  pthread_mutex_lock(&substituteLock);
+  NS_DURING
+    {
+      /* Walking the font lists is expensive, so remember the outcome for
+         each character, including that there was no font for it. */
+      checkSubstituteCaches();
+      if (cachedSubstitutes == nil)
+        {
+          cachedSubstitutes = NSCreateMapTable(NSIntegerMapKeyCallBacks,
+                                               NSObjectMapValueCallBacks, 64);
+        }
+      fName = NSMapGet(cachedSubstitutes, (void *)(uintptr_t)uchar);
+      if (fName == nil)
+        {
+          subFont = [self _findSubstituteFontFor: uchar font: baseFont];
+          NSMapInsert(cachedSubstitutes, (void *)(uintptr_t)uchar,
+                      (subFont != nil) ? (id)lastFont : (id)[NSNull null]);
+        }
+      else if (fName != (NSString *)[NSNull null])
+        {
+          subFont = [self _substituteFontWithName: fName font: baseFont];
+        }
+    }
+  NS_HANDLER
+    {
+      pthread_mutex_unlock(&substituteLock);
+      [localException raise];
+    }
+  NS_ENDHANDLER
+  pthread_mutex_unlock(&substituteLock);
+
+  return subFont;
+}
+
 - (void) fixFontAttributeInRange: (NSRange)range
 {
   NSString *string;
@@ -1596,6 +1671,8 @@ static NSMutableDictionary *cachedCSets = nil;
   NSUInteger lastMax;
   NSUInteger start;
   unichar chars[64];
+  NSFont *subFont = nil;
+  NSRange subRange = NSMakeRange(NSNotFound, 0);
   CREATE_AUTORELEASE_POOL(pool);
   NSCharacterSet *controlset = [NSCharacterSet controlCharacterSet];
   
@@ -1658,18 +1735,37 @@ static NSMutableDictionary *cachedCSets = nil;
           && ![controlset characterIsMember: uchar])
         {
           // Find a replacement font
-          NSFont *subFont;
+          NSFont *newFont;
           
-          subFont = [self _substituteFontFor: uchar font: font];
-          if (subFont != nil)
+          newFont = [self _substituteFontFor: uchar font: font];
+          if (newFont != nil)
             {
-              // Set substitution font permanently
-              [self addAttribute: NSFontAttributeName
-                    value: subFont
-                    range: NSMakeRange(i, 1)];
+              // Extend the pending run if it uses the same font
+              if (NSMaxRange(subRange) == i && [newFont isEqual: subFont])
+                {
+                  subRange.length++;
+                }
+              else
+                {
+                  if (subFont != nil)
+                    {
+                      // Set substitution font permanently
+                      [self addAttribute: NSFontAttributeName
+                            value: subFont
+                            range: subRange];
+                    }
+                  subFont = newFont;
+                  subRange = NSMakeRange(i, 1);
+                }
             }
         }
     }
+  if (subFont != nil)
+    {
+      [self addAttribute: NSFontAttributeName
+            value: subFont
+            range: subRange];
+    }
   
   [pool drain];
 }
@@ -32,10 +32,12 @@
 #import <Foundation/NSDebug.h>
 #import "AppKit/NSAffineTransform.h"
 #import "AppKit/NSFont.h"
+#import "AppKit/NSGraphicsContext.h"
 #import "AppKit/NSImage.h"
 #import "AppKit/PSOperators.h"
 #import "GNUstepGUI/GSFontInfo.h"
 #import "GSGuiPrivate.h"
+#import "NSShadowPrivate.h"
 
 #include <math.h>
 
@@ -82,6 +84,8 @@ static CGFloat default_miter_limit = 10.0;
 @interface NSBezierPath (PrivateMethods)
 - (void)_invalidateCache;
 - (void)_recalculateBounds;
+- (NSData *)_shadowKeyForStroke: (BOOL)stroke;
+- (void)_drawShadow: (NSShadow *)shadow forStroke: (BOOL)stroke;
 @end
 
 
@@ -151,11 +155,21 @@ static CGFloat default_miter_limit = 10.0;
 //
 + (void)fillRect: (NSRect)aRect
 {
+  if ([GSCurrentContext() GSCurrentShadow] != nil)
+    {
+      [[self bezierPathWithRect: aRect] fill];
+      return;
+    }
   PSrectfill(NSMinX(aRect), NSMinY(aRect), NSWidth(aRect),  NSHeight(aRect));
 }
 
 + (void)strokeRect: (NSRect)aRect
 {
+  if ([GSCurrentContext() GSCurrentShadow] != nil)
+    {
+      [[self bezierPathWithRect: aRect] stroke];
+      return;
+    }
   PSrectstroke(NSMinX(aRect), NSMinY(aRect), NSWidth(aRect),  NSHeight(aRect));
 }
 
@@ -514,7 +528,13 @@ static CGFloat default_miter_limit = 10.0;
 - (void)stroke
 {
   NSGraphicsContext *ctxt = GSCurrentContext();
+  NSShadow *shadow = [ctxt GSCurrentShadow];
   
+  if (shadow != nil)
+    {
+      [self _drawShadow: shadow forStroke: YES];
+    }
+
   if (_cachesBezierPath) 
     {
       NSRect bounds = [self bounds];
@@ -542,6 +562,12 @@ static CGFloat default_miter_limit = 10.0;
 - (void)fill
 {
   NSGraphicsContext *ctxt = GSCurrentContext();
+  NSShadow *shadow = [ctxt GSCurrentShadow];
+
+  if (shadow != nil)
+    {
+      [self _drawShadow: shadow forStroke: NO];
+    }
 
   if (_cachesBezierPath) 
     {
@@ -2091,6 +2117,68 @@ static int winding_curve(double_point from, double_point to, double_point c1,
 
 @implementation NSBezierPath (PrivateMethods)
 
+/* Describes the receiver as drawn by -fill or -stroke, for the cache of
+ * shadow masks. */
+- (NSData *)_shadowKeyForStroke: (BOOL)stroke
+{
+  NSInteger count = [self elementCount];
+  NSMutableData *key;
+  CGFloat style[8];
+  NSInteger i;
+  struct {
+    NSInteger type;
+    NSPoint points[3];
+  } element;
+
+  memset(style, 0, sizeof(style));
+  style[0] = stroke;
+  style[1] = _windingRule;
+  if (stroke)
+    {
+      style[2] = _lineWidth;
+      style[3] = _lineCapStyle;
+      style[4] = _lineJoinStyle;
+      style[5] = _miterLimit;
+      style[6] = _dash_count;
+      style[7] = _dash_phase;
+    }
+  key = [NSMutableData dataWithCapacity: sizeof(style)
+    + count * sizeof(element)];
+  [key appendBytes: style length: sizeof(style)];
+  if (stroke && _dash_count > 0)
+    {
+      [key appendBytes: _dash_pattern length: _dash_count * sizeof(CGFloat)];
+    }
+  for (i = 0; i < count; i++)
+    {
+      memset(&element, 0, sizeof(element));
+      element.type = [self elementAtIndex: i associatedPoints: element.points];
+      [key appendBytes: &element length: sizeof(element)];
+    }
+  return key;
+}
+
+- (void)_drawShadow: (NSShadow *)shadow forStroke: (BOOL)stroke
+{
+  NSRect bounds = [self bounds];
+
+  if (stroke)
+    {
+      CGFloat w = _lineWidth;
+
+      if (_lineJoinStyle == NSMiterLineJoinStyle)
+        {
+          w *= MAX(1.0, _miterLimit / 2);
+        }
+      bounds = NSInsetRect(bounds, -w, -w);
+    }
+  [shadow _drawShadowOf: self
+               selector: stroke ? @selector(stroke) : @selector(fill)
+               argument: nil
+                 bounds: bounds
+                    key: [self _shadowKeyForStroke: stroke]];
+}
+
 - (void) _invalidateCache
 {
   _shouldRecalculateBounds = YES;
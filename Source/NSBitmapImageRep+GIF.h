@@ -31,11 +31,16 @@
 
 #import "AppKit/NSBitmapImageRep.h"
 
+@class GSImageLoader;
+
 @interface NSBitmapImageRep (GIFReading)
 
 + (BOOL) _bitmapIsGIF: (NSData *)imageData;
 - (id) _initBitmapFromGIF: (NSData *)imageData
              errorMessage: (NSString **)errorMsg;
+/* Returns a new loader decoding GIF data incrementally into the
+   receiver, or nil if GIF is not supported. */
+- (GSImageLoader *) _newGIFLoader;
 - (NSData *) _GIFRepresentationWithProperties: (NSDictionary *) properties
                                  errorMessage: (NSString **)errorMsg;
 
@@ -32,11 +32,15 @@
 #import "config.h"
 #import <Foundation/NSData.h>
 #import <Foundation/NSDictionary.h>
+#import <Foundation/NSAutoreleasePool.h>
 #import <Foundation/NSException.h>
+#import <Foundation/NSLock.h>
 #import <Foundation/NSString.h>
+#import <Foundation/NSThread.h>
 #import <Foundation/NSValue.h>
 #import "AppKit/NSGraphics.h"
 #import "NSBitmapImageRep+GIF.h"
+#import "NSBitmapImageRepPrivate.h"
 #import "GSGuiPrivate.h"
 
 #if HAVE_LIBUNGIF || HAVE_LIBGIF
@@ -142,6 +146,375 @@ static int gs_gif_output(GifFileType *file, const GifByteType *buffer, int len)
 }
 #endif
 
+/* Converts count colour indices of src to rgb or rgba pixels at dest. */
+static void gs_gif_convert_pixels(unsigned char *dest, GifPixelType *src,
+                                  int count, ColorMapObject *colorMap,
+                                  BOOL hasAlpha, unsigned char transparentColor)
+{
+  GifColorType *color;
+  int i;
+
+  for (i = 0; i < count; i++)
+    {
+      unsigned char colorIndex = src[i];
+
+      color = &colorMap->Colors[colorIndex < colorMap->ColorCount
+                                ? colorIndex : 0];
+      *dest++ = color->Red;
+      *dest++ = color->Green;
+      *dest++ = color->Blue;
+      if (hasAlpha)
+        *dest++ = (transparentColor == colorIndex) ? 0 : 255;
+    }
+}
+
+/* -----------------------------------------------------------
+   Incremental loading
+   ----------------------------------------------------------- */
+
+/*
+ * giflib cannot stop in the middle of an image and carry on when more
+ * data arrives, so the loader runs it on a thread of its own, with an
+ * input function that waits for the data.  The decoder thread and the
+ * caller of -loadFromData:complete: take turns, only one of them runs
+ * at any time, and every byte is decoded exactly once.
+ */
+@interface GSGIFLoader : GSImageLoader
+{
+  NSCondition   *condition;
+  NSData        *data;          // the data received so far, during a turn
+  NSUInteger    offset;         // bytes given to giflib so far
+  NSInteger     result;         // status the decoder thread ended with
+  BOOL          complete;
+  BOOL          started;
+  BOOL          decoding;       // it is the turn of the decoder thread
+  BOOL          finished;       // the decoder thread has ended
+  BOOL          cancelled;
+  BOOL          eof;
+}
+- (int) _read: (GifByteType *)buffer length: (int)len;
+@end
+
+static int gs_gif_stream_input(GifFileType *file, GifByteType *buffer, int len)
+{
+  return [(GSGIFLoader *)file->UserData _read: buffer length: len];
+}
+
+@implementation GSGIFLoader
+
+- (id) initWithBitmap: (NSBitmapImageRep *)aRep
+{
+  if ((self = [super initWithBitmap: aRep]) != nil)
+    {
+      condition = [NSCondition new];
+      rows = -1;
+    }
+  return self;
+}
+
+- (void) dealloc
+{
+  RELEASE(condition);
+  [super dealloc];
+}
+
+- (NSInteger) loadFromData: (NSData *)someData complete: (BOOL)isComplete
+{
+  NSInteger status;
+
+  [condition lock];
+  if (finished)
+    {
+      [condition unlock];
+      return result;
+    }
+  data = someData;
+  complete = isComplete;
+  if (!started)
+    {
+      started = YES;
+      /* The thread retains the loader until it ends */
+      [NSThread detachNewThreadSelector: @selector(_decode:)
+                               toTarget: self
+                             withObject: nil];
+    }
+  decoding = YES;
+  [condition broadcast];
+  while (decoding)
+    {
+      [condition wait];
+    }
+  data = nil;
+
+  if (finished)
+    status = result;
+  else
+    status = (rows < 0) ? NSImageRepLoadStatusReadingHeader : rows;
+  [condition unlock];
+  return status;
+}
+
+- (void) stop
+{
+  [condition lock];
+  if (started && !finished)
+    {
+      /* Let the input function fail, giflib then gives up */
+      cancelled = YES;
+      [condition broadcast];
+      while (!finished)
+        {
+          [condition wait];
+        }
+    }
+  [condition unlock];
+}
+
+/* Acts like fread, but waits for more data when all of it has been read
+ * while the data is not complete, handing the turn back to the caller
+ * of -loadFromData:complete: */
+- (int) _read: (GifByteType *)buffer length: (int)len
+{
+  int count = 0;
+
+  [condition lock];
+  while (count < len && !cancelled)
+    {
+      NSUInteger available;
+
+      if (!decoding)
+        {
+          [condition wait];
+          continue;
+        }
+
+      available = [data length] - offset;
+      if (available > 0)
+        {
+          NSUInteger n = MIN(available, (NSUInteger)(len - count));
+
+          memcpy(buffer + count, [data bytes] + offset, n);
+          offset += n;
+          count += n;
+        }
+      else if (complete)
+        {
+          eof = YES;
+          break;
+        }
+      else
+        {
+          decoding = NO;
+          [condition broadcast];
+        }
+    }
+  [condition unlock];
+  return count;
+}
+
+/* Decodes the first image into rep, like -_initBitmapFromGIF:errorMessage:
+ * but a row at a time.  rep is not touched after a read failed, as it may
+ * be going away. */
+- (NSInteger) _decodeImage
+{
+  GifFileType            *file;
+  GifRecordType           recordType;
+  GifByteType            *extension;
+  GifPixelType           *line = NULL;
+  ColorMapObject         *colorMap;
+  unsigned char          *bitmap;
+  NSInteger               bytesPerRow;
+  int                     extCode;
+  int                     i, j;
+  int                     imgHeight, imgWidth, imgRow, imgCol;
+  BOOL                    hasAlpha = NO;
+  BOOL                    done = NO;
+  unsigned char           transparentColor = 0;
+  int                     sPP;
+  unsigned short          duration = 0;
+
+  file = DGifOpen(self, gs_gif_stream_input);
+  if (file == NULL)
+    {
+      return NSImageRepLoadStatusInvalidData;
+    }
+
+  while (!done)
+    {
+      if (DGifGetRecordType(file, &recordType) != GIF_OK)
+        {
+          goto failed;
+        }
+      switch (recordType)
+	{
+	  case IMAGE_DESC_RECORD_TYPE:
+	    {
+	      if (DGifGetImageDesc(file) != GIF_OK)
+                {
+                  goto failed;
+                }
+
+	      imgWidth  = file->Image.Width;
+	      imgHeight = file->Image.Height;
+	      imgRow    = file->Image.Top;
+	      imgCol    = file->Image.Left;
+	      colorMap = (file->Image.ColorMap ? file->Image.ColorMap
+                          : file->SColorMap);
+	      if ((imgCol + imgWidth > file->SWidth)
+		  || (imgRow + imgHeight > file->SHeight)
+                  || colorMap == NULL)
+		{
+                  goto failed;
+		}
+
+              /* set up the bitmap with the background colour */
+              sPP = hasAlpha ? 4 : 3;
+              bytesPerRow = file->SWidth * sPP;
+              if ([rep initWithBitmapDataPlanes: NULL
+                                     pixelsWide: file->SWidth
+                                     pixelsHigh: file->SHeight
+                                  bitsPerSample: 8
+                                samplesPerPixel: sPP
+                                       hasAlpha: hasAlpha
+                                       isPlanar: NO
+                                 colorSpaceName: NSCalibratedRGBColorSpace
+                                    bytesPerRow: bytesPerRow
+                                   bitsPerPixel: 8 * sPP] == nil)
+                {
+                  goto failed;
+                }
+              bitmap = [rep bitmapData];
+              line = malloc(file->SWidth * sizeof(GifPixelType));
+              if (line == NULL)
+                {
+                  goto failed;
+                }
+              memset(line, file->SBackGroundColor,
+                     file->SWidth * sizeof(GifPixelType));
+              for (i = 0; i < file->SHeight; i++)
+                {
+                  gs_gif_convert_pixels(bitmap + i * bytesPerRow, line,
+                                        file->SWidth, colorMap,
+                                        hasAlpha, transparentColor);
+                }
+
+              [rep setProperty: NSImageRGBColorTable
+                     withValue: [NSData dataWithBytes: colorMap->Colors
+                                               length: sizeof(GifColorType)
+                                               * colorMap->ColorCount]];
+              if (duration > 0)
+                {
+                  [rep setProperty: NSImageCurrentFrameDuration
+                         withValue: [NSNumber numberWithFloat: (100.0 * duration)]];
+                }
+              [rep setProperty: NSImageCurrentFrame
+                     withValue: [NSNumber numberWithInt: 0]];
+
+	      if (file->Image.Interlace)
+		{
+                  /* rows are only complete after the last pass */
+                  rows = 0;
+		  for (i = 0; i < 4; i++)
+		    {
+		      for (j = imgRow + InterlaceOffset[i]; j < imgRow + imgHeight;
+			   j = j + InterlaceJumps[i])
+			{
+			  if (DGifGetLine(file, line, imgWidth) != GIF_OK)
+                            {
+                              goto failed;
+                            }
+                          gs_gif_convert_pixels(bitmap + j * bytesPerRow
+                                                + imgCol * sPP, line,
+                                                imgWidth, colorMap,
+                                                hasAlpha, transparentColor);
+			}
+		    }
+		}
+	      else
+		{
+                  /* the rows above the image are complete already */
+                  rows = imgRow;
+		  for (i = 0; i < imgHeight; i++)
+		    {
+		      if (DGifGetLine(file, line, imgWidth) != GIF_OK)
+                        {
+                          goto failed;
+                        }
+                      gs_gif_convert_pixels(bitmap + (imgRow + i) * bytesPerRow
+                                            + imgCol * sPP, line,
+                                            imgWidth, colorMap,
+                                            hasAlpha, transparentColor);
+                      rows = imgRow + i + 1;
+		    }
+		}
+
+              rows = file->SHeight;
+              done = YES;
+	      break;
+	    }
+
+	  case EXTENSION_RECORD_TYPE:
+	    {
+	      /* transparency support */
+	      if (DGifGetExtension(file, &extCode, &extension) != GIF_OK)
+                {
+                  goto failed;
+                }
+              if (extCode == GRAPHICS_EXT_FUNC_CODE)
+                {
+                   hasAlpha = (extension[1] & 0x01);
+                   transparentColor = extension[4];
+                   duration = extension[3];
+                   duration = (duration << 8) + extension[2];
+                }
+	      while (extension != NULL)
+		{
+		  if (DGifGetExtensionNext(file, &extension) != GIF_OK)
+                    {
+                      goto failed;
+                    }
+                }
+	      break;
+	    }
+
+	  case TERMINATE_RECORD_TYPE:
+            /* there is no image */
+            goto failed;
+
+	  default:
+	    {
+	      break;
+	    }
+	}
+    }
+
+  free(line);
+  DGifCloseFile(file);
+  return NSImageRepLoadStatusCompleted;
+
+failed:
+  free(line);
+  DGifCloseFile(file);
+  return eof ? NSImageRepLoadStatusUnexpectedEOF
+    : NSImageRepLoadStatusInvalidData;
+}
+
+- (void) _decode: (id)unused
+{
+  CREATE_AUTORELEASE_POOL(pool);
+  NSInteger status = [self _decodeImage];
+
+  [condition lock];
+  result = status;
+  finished = YES;
+  decoding = NO;
+  [condition broadcast];
+  [condition unlock];
+  RELEASE(pool);
+}
+
+@end
+
 /* -----------------------------------------------------------
    The gif loading part of NSBitmapImageRep
    ----------------------------------------------------------- */
@@ -220,8 +593,6 @@ static int gs_gif_output(GifFileType *file, const GifByteType *buffer, int len)
   unsigned                rgbBufferPos;
   unsigned                rgbBufferSize;
   ColorMapObject         *colorMap;
-  GifColorType           *color;
-  unsigned char           colorIndex;
   unsigned                pixelSize, rowSize;
   int                     extCode;
   int                     gifrc; /* required by CALL_CHECKED */
@@ -354,17 +725,9 @@ static int gs_gif_output(GifFileType *file, const GifByteType *buffer, int len)
 
   for (i = 0; i < file->SHeight; i++)
     {
-      imgBufferPos = imgBuffer + (i * rowSize);
-      for (j = 0; j < file->SWidth; j++)
-	{
-          colorIndex = *(imgBufferPos + j*pixelSize);
-	  color = &colorMap->Colors[colorIndex];
-	  rgbBuffer[rgbBufferPos++] = color->Red;
-	  rgbBuffer[rgbBufferPos++] = color->Green;
-	  rgbBuffer[rgbBufferPos++] = color->Blue;
-          if (hasAlpha)
-            rgbBuffer[rgbBufferPos++] = (transparentColor == colorIndex)? 0 : 255;
-	}
+      gs_gif_convert_pixels(rgbBuffer + rgbBufferPos, imgBuffer + (i * rowSize),
+                            file->SWidth, colorMap, hasAlpha, transparentColor);
+      rgbBufferPos += file->SWidth * sPP;
     }
 
   NSZoneFree([self zone], imgBuffer);
@@ -401,6 +764,11 @@ static int gs_gif_output(GifFileType *file, const GifByteType *buffer, int len)
   return self;
 }
 
+- (GSImageLoader *) _newGIFLoader
+{
+  return [[GSGIFLoader alloc] initWithBitmap: self];
+}
+
 - (NSData *) _GIFRepresentationWithProperties: (NSDictionary *) properties
                                  errorMessage: (NSString **)errorMsg
 {
@@ -592,6 +960,11 @@ static int gs_gif_output(GifFileType *file, const GifByteType *buffer, int len)
   return nil;
 }
 
+- (GSImageLoader *) _newGIFLoader
+{
+  return nil;
+}
+
 - (NSData *) _GIFRepresentationWithProperties: (NSDictionary *) properties
                                  errorMessage: (NSString **)errorMsg
 {
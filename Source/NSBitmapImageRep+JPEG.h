@@ -31,12 +31,19 @@
 
 #import "AppKit/NSBitmapImageRep.h"
 
+@class GSImageLoader;
 
 @interface NSBitmapImageRep (JPEGReading)
 
 + (BOOL) _bitmapIsJPEG: (NSData *)imageData;
 - (id) _initBitmapFromJPEG: (NSData *)imageData
 	      errorMessage: (NSString **)errorMsg;
+- (id) _initBitmapFromJPEG: (NSData *)imageData
+          maximumPixelSize: (NSSize)maxSize
+	      errorMessage: (NSString **)errorMsg;
+/* Returns a new loader decoding JPEG data incrementally into the
+   receiver, or nil if JPEG is not supported. */
+- (GSImageLoader *) _newJPEGLoader;
 - (NSData *) _JPEGRepresentationWithProperties: (NSDictionary *) properties
                                   errorMessage: (NSString **)errorMsg;
 @end
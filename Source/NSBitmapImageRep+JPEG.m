@@ -226,6 +226,317 @@ static void gs_jpeg_memory_src_destroy(j_decompress_ptr cinfo)
 
 /* ------------------------------------------------------------------*/
 
+/* Sets the size in points and the properties of rep from the header
+ * read by cinfo.  A shrunk image keeps the size of the full one.  */
+static void gs_jpeg_set_properties(NSBitmapImageRep *rep,
+                                   j_decompress_ptr cinfo)
+{
+  BOOL isProgressive;
+  double x_density, y_density;
+
+  [rep setSize: NSMakeSize(cinfo->image_width, cinfo->image_height)];
+
+#ifdef GSTEP_PROGRESSIVE_CODEC
+  isProgressive = (cinfo->process == JPROC_PROGRESSIVE);
+#else
+  isProgressive = cinfo->progressive_mode;
+#endif
+  [rep setProperty: NSImageProgressive
+         withValue: [NSNumber numberWithBool: isProgressive]];
+
+  x_density = (double) cinfo->X_density;
+  y_density = (double) cinfo->Y_density;
+  if (x_density > 0 && y_density > 0)
+    {
+      unsigned short d_unit;
+      
+      d_unit = cinfo->density_unit;
+      /* we have dots/cm, convert to dots/inch*/
+      if (d_unit == 2)
+        {
+          x_density = x_density * 2.54;
+          y_density = y_density * 2.54;
+        }
+
+      /* consider density only if we have a valid unit */
+      if (d_unit && !(x_density == 72 && y_density == 72))
+        {
+          NSSize pointSize;
+
+          pointSize = NSMakeSize((double)cinfo->image_width * 72.0 / x_density,
+                                 (double)cinfo->image_height * 72.0 / y_density);
+          [rep setSize: pointSize];
+        }
+    }
+}
+
+/* ------------------------------------------------------------------*/
+
+/* A data source manager for incremental loading.  It suspends the
+ * decoder when it runs out of data, the loader points it at the data
+ * received since before resuming the decoder.  */
+typedef struct
+{
+  struct jpeg_source_mgr parent;
+
+  /* bytes still to be skipped which have not been received yet */
+  NSUInteger skip;
+  /* all the data has been received */
+  BOOL complete;
+  /* the decoder wanted more data than there is */
+  BOOL eof;
+} gs_jpeg_stream_mgr;
+
+typedef gs_jpeg_stream_mgr *gs_jpeg_stream_ptr;
+
+
+static boolean gs_stream_fill_input_buffer(j_decompress_ptr cinfo)
+{
+  static const JOCTET eoi[2] = { 0xFF, JPEG_EOI };
+  gs_jpeg_stream_ptr src = (gs_jpeg_stream_ptr)cinfo->src;
+
+  if (!src->complete)
+    {
+      /* suspend until more data arrives */
+      return FALSE;
+    }
+
+  /* the data ends early, let the decoder finish what it has got */
+  WARNMS(cinfo, JWRN_JPEG_EOF);
+  src->eof = YES;
+  src->parent.next_input_byte = eoi;
+  src->parent.bytes_in_buffer = 2;
+
+  return TRUE;
+}
+
+
+static void gs_stream_skip_input_data(j_decompress_ptr cinfo, long numBytes)
+{
+  gs_jpeg_stream_ptr src = (gs_jpeg_stream_ptr)cinfo->src;
+
+  if (numBytes <= 0)
+    {
+      return;
+    }
+  if ((size_t)numBytes > src->parent.bytes_in_buffer)
+    {
+      src->skip += numBytes - src->parent.bytes_in_buffer;
+      src->parent.next_input_byte += src->parent.bytes_in_buffer;
+      src->parent.bytes_in_buffer = 0;
+    }
+  else
+    {
+      src->parent.next_input_byte += numBytes;
+      src->parent.bytes_in_buffer -= numBytes;
+    }
+}
+
+/* Steps of an incremental load, each of them may suspend.  */
+enum {
+  GSJPEGLoadHeader,
+  GSJPEGLoadStart,
+  GSJPEGLoadRows,
+  GSJPEGLoadFinish
+};
+
+@interface GSJPEGLoader : GSImageLoader
+{
+  struct jpeg_decompress_struct cinfo;
+  struct gs_jpeg_error_mgr      jerrMgr;
+  gs_jpeg_stream_mgr            source;
+  NSUInteger                    offset;   // bytes consumed by the decoder
+  int                           step;
+  BOOL                          created;
+  unsigned char                 *bitmap;
+  NSInteger                     bytesPerRow;
+}
+@end
+
+@implementation GSJPEGLoader
+
+- (id) initWithBitmap: (NSBitmapImageRep *)aRep
+{
+  if ((self = [super initWithBitmap: aRep]) == nil)
+    return nil;
+
+  gs_jpeg_error_mgr_init(&jerrMgr);
+  cinfo.err = jpeg_std_error(&jerrMgr.parent);
+  jerrMgr.parent.error_exit = gs_jpeg_error_exit;
+  jerrMgr.parent.output_message = gs_jpeg_output_message;
+  if (setjmp(jerrMgr.setjmpBuffer))
+    {
+      RELEASE(self);
+      return nil;
+    }
+  jpeg_create_decompress(&cinfo);
+  created = YES;
+
+  source.parent.init_source = gs_init_source;
+  source.parent.fill_input_buffer = gs_stream_fill_input_buffer;
+  source.parent.skip_input_data = gs_stream_skip_input_data;
+  source.parent.resync_to_restart = jpeg_resync_to_restart;
+  source.parent.term_source = gs_term_source;
+  source.parent.bytes_in_buffer = 0;
+  source.parent.next_input_byte = NULL;
+  cinfo.src = &source.parent;
+
+  return self;
+}
+
+- (void) _destroy
+{
+  if (created)
+    {
+      cinfo.src = NULL;
+      jpeg_destroy_decompress(&cinfo);
+      created = NO;
+    }
+}
+
+- (void) dealloc
+{
+  [self _destroy];
+  [super dealloc];
+}
+
+/* Remembers how far the decoder got in bytes.  */
+- (NSInteger) _suspend: (const unsigned char *)bytes
+{
+  offset = source.parent.next_input_byte - bytes;
+  return (step == GSJPEGLoadHeader) ? NSImageRepLoadStatusReadingHeader : rows;
+}
+
+- (NSInteger) loadFromData: (NSData *)data complete: (BOOL)complete
+{
+  const unsigned char *bytes = [data bytes];
+  NSUInteger length = [data length];
+  NSUInteger pos = offset + source.skip;
+
+  if (pos > length)
+    {
+      source.skip = pos - length;
+      pos = length;
+    }
+  else
+    {
+      source.skip = 0;
+    }
+  source.parent.next_input_byte = bytes + pos;
+  source.parent.bytes_in_buffer = length - pos;
+  source.complete = complete;
+
+  if (setjmp(jerrMgr.setjmpBuffer))
+    {
+      [self _destroy];
+      return source.eof ? NSImageRepLoadStatusUnexpectedEOF
+        : NSImageRepLoadStatusInvalidData;
+    }
+
+  if (step == GSJPEGLoadHeader)
+    {
+      NSString *outColorSpace;
+
+      if (jpeg_read_header(&cinfo, TRUE) == JPEG_SUSPENDED)
+        {
+          return [self _suspend: bytes];
+        }
+
+      if (cinfo.jpeg_color_space == JCS_GRAYSCALE)
+        {
+          cinfo.out_color_space = JCS_GRAYSCALE;
+          outColorSpace = NSCalibratedWhiteColorSpace;
+        }
+      else
+        {
+          cinfo.out_color_space = JCS_RGB;
+          outColorSpace = NSCalibratedRGBColorSpace;
+        }
+      jpeg_calc_output_dimensions(&cinfo);
+
+      bytesPerRow = cinfo.output_width * cinfo.output_components;
+      if ([rep initWithBitmapDataPlanes: NULL
+                             pixelsWide: cinfo.output_width
+                             pixelsHigh: cinfo.output_height
+                          bitsPerSample: BITS_IN_JSAMPLE
+                        samplesPerPixel: cinfo.output_components
+                               hasAlpha: NO // JPEG has no Alpha support
+                               isPlanar: NO
+                         colorSpaceName: outColorSpace
+                            bytesPerRow: bytesPerRow
+                           bitsPerPixel: BITS_IN_JSAMPLE * cinfo.output_components] == nil)
+        {
+          [self _destroy];
+          return NSImageRepLoadStatusInvalidData;
+        }
+      bitmap = [rep bitmapData];
+      gs_jpeg_set_properties(rep, &cinfo);
+      step = GSJPEGLoadStart;
+    }
+
+  /* Progressive images are read completely before this returns.  */
+  if (step == GSJPEGLoadStart)
+    {
+      if (!jpeg_start_decompress(&cinfo))
+        {
+          return [self _suspend: bytes];
+        }
+      step = GSJPEGLoadRows;
+    }
+
+  if (step == GSJPEGLoadRows)
+    {
+      JSAMPROW rowPointers[cinfo.rec_outbuf_height];
+
+      while (cinfo.output_scanline < cinfo.output_height)
+        {
+          JDIMENSION count = cinfo.output_height - cinfo.output_scanline;
+          JDIMENSION i;
+
+          if (count > cinfo.rec_outbuf_height)
+            {
+              count = cinfo.rec_outbuf_height;
+            }
+          for (i = 0; i < count; i++)
+            {
+              rowPointers[i] = bitmap
+                + (cinfo.output_scanline + i) * bytesPerRow;
+            }
+          if (jpeg_read_scanlines(&cinfo, rowPointers, count) == 0)
+            {
+              break;
+            }
+          rows = cinfo.output_scanline;
+        }
+      if (cinfo.output_scanline < cinfo.output_height)
+        {
+          return [self _suspend: bytes];
+        }
+      step = GSJPEGLoadFinish;
+    }
+
+  if (!jpeg_finish_decompress(&cinfo))
+    {
+      return [self _suspend: bytes];
+    }
+  [self _destroy];
+
+  if (source.eof)
+    {
+      return NSImageRepLoadStatusUnexpectedEOF;
+    }
+  if (jerrMgr.parent.num_warnings)
+    {
+      NSLog(@"NSBitmapImageRep+JPEG: %ld warnings during jpeg decompression, "
+        @"image may be corrupted", jerrMgr.parent.num_warnings);
+    }
+  return NSImageRepLoadStatusCompleted;
+}
+
+@end
+
+/* ------------------------------------------------------------------*/
+
 /*
  * A custom destination manager.
  */
@@ -406,10 +717,19 @@ static void gs_jpeg_memory_dest_destroy (j_compress_ptr cinfo)
 }
 
 
+- (id) _initBitmapFromJPEG: (NSData *)imageData
+	      errorMessage: (NSString **)errorMsg
+{
+  return [self _initBitmapFromJPEG: imageData
+                  maximumPixelSize: NSZeroSize
+                      errorMessage: errorMsg];
+}
+
 /* Read the jpeg image. Assume it is from a jpeg file and imageData
- * is not nil.
+ * is not nil.  Images bigger than maxSize get shrunk while decoding.
  */
 - (id) _initBitmapFromJPEG: (NSData *)imageData
+          maximumPixelSize: (NSSize)maxSize
 	      errorMessage: (NSString **)errorMsg
 {
   struct jpeg_decompress_struct  cinfo;
@@ -417,14 +737,16 @@ static void gs_jpeg_memory_dest_destroy (j_compress_ptr cinfo)
   JDIMENSION sclcount, samplesPerRow, i, j, rowSize;
   JSAMPARRAY sclbuffer = NULL;
   unsigned char *imgbuffer = NULL;
-  BOOL isProgressive;
-  double x_density, y_density;
   NSString *outColorSpace;
+  NSSize target;
+  GSImageScaler scaler;
+  BOOL scaling;
 
   if (!(self = [super init]))
     return nil;
 
   memset((void*)&cinfo, 0, sizeof(struct jpeg_decompress_struct));
+  memset(&scaler, 0, sizeof(scaler));
 
   /* Establish the our custom error handler */
   gs_jpeg_error_mgr_init(&jerrMgr);
@@ -444,6 +766,7 @@ static void gs_jpeg_memory_dest_destroy (j_compress_ptr cinfo)
         {
           free(imgbuffer);
         }
+      GSImageScalerDestroy(&scaler);
       RELEASE(self);
       return nil;
     }
@@ -468,8 +791,27 @@ static void gs_jpeg_memory_dest_destroy (j_compress_ptr cinfo)
       cinfo.out_color_space = JCS_RGB;
       outColorSpace = NSCalibratedRGBColorSpace;
     }
+
+  target = GSImageScaledPixelSize(cinfo.image_width, cinfo.image_height,
+                                  maxSize);
+  if (target.width < cinfo.image_width || target.height < cinfo.image_height)
+    {
+      /* Let the decoder do most of the shrinking by scaling the DCT,
+         as far as the output stays at least as big as wanted. */
+      cinfo.scale_num = 1;
+      cinfo.scale_denom = 1;
+      while (cinfo.scale_denom < 8
+        && cinfo.image_width / (cinfo.scale_denom * 2) >= target.width
+        && cinfo.image_height / (cinfo.scale_denom * 2) >= target.height)
+        {
+          cinfo.scale_denom *= 2;
+        }
+    }
+
   /* decompress */
   jpeg_start_decompress(&cinfo);
+  scaling = (cinfo.output_width > target.width
+             || cinfo.output_height > target.height);
 
   /* process the decompressed  data */
   samplesPerRow = cinfo.output_width * cinfo.output_components;
@@ -483,12 +825,28 @@ static void gs_jpeg_memory_dest_destroy (j_compress_ptr cinfo)
                                       cinfo.rec_outbuf_height);
   /* sclbuffer is freed when cinfo is destroyed */
 
-  imgbuffer = NSZoneMalloc([self zone], cinfo.output_height * rowSize);
-  if (!imgbuffer)
+  if (scaling)
     {
-      NSLog(@"NSBitmapImageRep+JPEG: failed to allocated image buffer");
-      RELEASE(self);
-      return nil;
+      if (!GSImageScalerInit(&scaler, cinfo.output_width, cinfo.output_height,
+                             target.width, target.height,
+                             cinfo.output_components))
+        {
+          NSLog(@"NSBitmapImageRep+JPEG: failed to allocated image buffer");
+          gs_jpeg_memory_src_destroy(&cinfo);
+          jpeg_destroy_decompress(&cinfo);
+          RELEASE(self);
+          return nil;
+        }
+    }
+  else
+    {
+      imgbuffer = NSZoneMalloc([self zone], cinfo.output_height * rowSize);
+      if (!imgbuffer)
+        {
+          NSLog(@"NSBitmapImageRep+JPEG: failed to allocated image buffer");
+          RELEASE(self);
+          return nil;
+        }
     }
 
   i = 0;
@@ -499,20 +857,19 @@ static void gs_jpeg_memory_dest_destroy (j_compress_ptr cinfo)
 
       for (j = 0; j < sclcount; j++)
         {
-	  // copy a row to the image buffer
-	  memcpy((imgbuffer + (i * rowSize)),
-	    *(sclbuffer + (j * rowSize)),
-	    rowSize);
+          if (scaling)
+            {
+              GSImageScalerAddRow(&scaler, sclbuffer[j]);
+            }
+          else
+            {
+              // copy a row to the image buffer
+              memcpy((imgbuffer + (i * rowSize)), sclbuffer[j], rowSize);
+            }
 	  i++;
         }
     }
 
-#ifdef GSTEP_PROGRESSIVE_CODEC
-  isProgressive = (cinfo.process == JPROC_PROGRESSIVE);
-#else
-  isProgressive = cinfo.progressive_mode;
-#endif
-
   /* done */
   jpeg_finish_decompress(&cinfo);
 
@@ -526,53 +883,41 @@ static void gs_jpeg_memory_dest_destroy (j_compress_ptr cinfo)
     }
 
   // create the imagerep
-  //BITS_IN_JSAMPLE is defined by libjpeg
-  [self initWithBitmapDataPlanes: &imgbuffer
-		      pixelsWide: cinfo.output_width
-		      pixelsHigh: cinfo.output_height
-		   bitsPerSample: BITS_IN_JSAMPLE
-		 samplesPerPixel: cinfo.output_components
-			hasAlpha: NO // JPEG has no Alpha support
-			isPlanar: NO
-		  colorSpaceName: outColorSpace
-		     bytesPerRow: rowSize
-		    bitsPerPixel: BITS_IN_JSAMPLE * cinfo.output_components];
-
-  [self setProperty: NSImageProgressive
-          withValue: [NSNumber numberWithBool: isProgressive]];
-
-  x_density = (double) cinfo.X_density;
-  y_density = (double) cinfo.Y_density;
-  if (x_density > 0 && y_density > 0)
+  if (scaling)
     {
-      unsigned short d_unit;
-      
-      d_unit = cinfo.density_unit;
-      /* we have dots/cm, convert to dots/inch*/
-      if (d_unit == 2)
-        {
-          x_density = x_density * 2.54;
-          y_density = y_density * 2.54;
-        }
-
-      /* consider density only if we have a valid unit */
-      if (d_unit && !(x_density == 72 && y_density == 72))
-        {
-          NSSize pointSize;
-
-          pointSize = NSMakeSize((double)cinfo.output_width * 72.0 / x_density,
-                                 (double)cinfo.output_height * 72.0 / y_density);
-          [self setSize: pointSize];
-        }
+      self = [self _initWithScaler: &scaler
+                          hasAlpha: NO
+                    colorSpaceName: outColorSpace
+                      bitmapFormat: 0];
+      GSImageScalerDestroy(&scaler);
     }
-
-  _imageData = [[NSData alloc]
-    initWithBytesNoCopy: imgbuffer
-		 length: (rowSize * cinfo.output_height)];
+  else
+    {
+      //BITS_IN_JSAMPLE is defined by libjpeg
+      [self initWithBitmapDataPlanes: &imgbuffer
+                          pixelsWide: cinfo.output_width
+                          pixelsHigh: cinfo.output_height
+                       bitsPerSample: BITS_IN_JSAMPLE
+                     samplesPerPixel: cinfo.output_components
+                            hasAlpha: NO // JPEG has no Alpha support
+                            isPlanar: NO
+                      colorSpaceName: outColorSpace
+                         bytesPerRow: rowSize
+                        bitsPerPixel: BITS_IN_JSAMPLE * cinfo.output_components];
+      _imageData = [[NSData alloc]
+        initWithBytesNoCopy: imgbuffer
+                     length: (rowSize * cinfo.output_height)];
+    }
+  gs_jpeg_set_properties(self, &cinfo);
 
   return self;
 }
 
+- (GSImageLoader *) _newJPEGLoader
+{
+  return [[GSJPEGLoader alloc] initWithBitmap: self];
+}
+
 
 /* -----------------------------------------------------------
    The jpeg writing part of NSBitmapImageRep
@@ -743,6 +1088,18 @@ static void gs_jpeg_memory_dest_destroy (j_compress_ptr cinfo)
   RELEASE(self);
   return nil;
 }
+
+- (id) _initBitmapFromJPEG: (NSData *)imageData
+          maximumPixelSize: (NSSize)maxSize
+	      errorMessage: (NSString **)errorMsg
+{
+  RELEASE(self);
+  return nil;
+}
+- (GSImageLoader *) _newJPEGLoader
+{
+  return nil;
+}
 - (NSData *) _JPEGRepresentationWithProperties: (NSDictionary *) properties
                                   errorMessage: (NSString **)errorMsg
 {
@@ -32,9 +32,16 @@
 
 #import "AppKit/NSBitmapImageRep.h"
 
+@class GSImageLoader;
+
 @interface NSBitmapImageRep (PNG)
 + (BOOL) _bitmapIsPNG: (NSData *)imageData;
 - (id) _initBitmapFromPNG: (NSData *)imageData;
+- (id) _initBitmapFromPNG: (NSData *)imageData
+         maximumPixelSize: (NSSize)maxSize;
+/* Returns a new loader decoding PNG data incrementally into the
+   receiver, or nil if PNG is not supported. */
+- (GSImageLoader *) _newPNGLoader;
 - (NSData *) _PNGRepresentationWithProperties: (NSDictionary *) properties;
 @end
 
@@ -61,6 +61,271 @@
 
 #ifdef HAVE_LIBPNG
 
+/* Sets the gamma and the size in points of rep from the info read. */
+static void
+set_png_properties(NSBitmapImageRep *rep,
+                   png_structp png_struct, png_infop png_info)
+{
+  int width = png_get_image_width(png_struct, png_info);
+  int height = png_get_image_height(png_struct, png_info);
+
+  if (png_get_valid(png_struct, png_info, PNG_INFO_gAMA))
+  {
+    double file_gamma = 2.2;
+    if (PNG_FLOATING_POINT)
+    {
+      png_get_gAMA(png_struct, png_info, &file_gamma);
+      // remap file_gamma [1.0, 2.5] to property [0.0, 1.0]
+      file_gamma = (file_gamma - 1.0)/1.5;
+    }
+    else	// fixed point
+    {
+      png_fixed_point int_gamma = 220000;
+      png_get_gAMA_fixed(png_struct, png_info, &int_gamma);
+      // remap gamma [0.0, 1.0] to [100000, 250000]
+      file_gamma = ((double)int_gamma - 100000.0)/150000.0;
+    }
+    [rep setProperty: NSImageGamma
+           withValue: [NSNumber numberWithDouble: file_gamma]];
+    //NSLog(@"PNG file gamma: %f", file_gamma);
+   } 
+
+  if (png_get_valid(png_struct, png_info, PNG_INFO_pHYs))
+  {
+    png_uint_32 xppm = png_get_x_pixels_per_meter(png_struct, png_info);
+    png_uint_32 yppm = png_get_y_pixels_per_meter(png_struct, png_info);
+
+    if (xppm != 0 && yppm != 0)
+      {
+	const CGFloat pointsPerMeter = 39.3700787 * 72.0;
+	NSSize sizeInPoints = NSMakeSize((width / (CGFloat)xppm) * pointsPerMeter,
+					 (height / (CGFloat)yppm) * pointsPerMeter);
+
+	// HACK: PNG can not represent 72DPI exactly. If the ppm value is near 72DPI,
+	// assume it is exactly 72 DPI. Note that the same problem occurrs at 144DPI...
+	// so don't use PNG for resolution independent graphics.
+	if (xppm  == 2834 || xppm == 2835)
+	  {
+	    sizeInPoints.width = width;
+	  }
+	if (yppm == 2834 || yppm == 2835)
+	  {
+	    sizeInPoints.height = height;
+	  }
+
+	[rep setSize: sizeInPoints];
+      }
+  }
+}
+
+/*
+ * Incremental loading with the progressive reader of libpng, which
+ * keeps its state between the chunks of data it is given.
+ */
+@interface GSPNGLoader : GSImageLoader
+{
+  png_structp   png_struct;
+  png_infop     png_info;
+  NSUInteger    offset;         // bytes given to libpng so far
+  unsigned char *bitmap;
+  NSInteger     bytesPerRow;
+  NSInteger     height;
+  BOOL          interlaced;
+  BOOL          finished;
+}
+- (void) _readInfo;
+- (void) _readRow: (png_bytep)row number: (png_uint_32)n pass: (int)pass;
+- (void) _readEnd;
+@end
+
+static void
+loader_info_func(png_structp png_struct, png_infop png_info)
+{
+  [(GSPNGLoader *)png_get_progressive_ptr(png_struct) _readInfo];
+}
+
+static void
+loader_row_func(png_structp png_struct, png_bytep row,
+                png_uint_32 n, int pass)
+{
+  [(GSPNGLoader *)png_get_progressive_ptr(png_struct)
+    _readRow: row number: n pass: pass];
+}
+
+static void
+loader_end_func(png_structp png_struct, png_infop png_info)
+{
+  [(GSPNGLoader *)png_get_progressive_ptr(png_struct) _readEnd];
+}
+
+@implementation GSPNGLoader
+
+- (id) initWithBitmap: (NSBitmapImageRep *)aRep
+{
+  if ((self = [super initWithBitmap: aRep]) == nil)
+    return nil;
+
+  png_struct = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+  if (png_struct != NULL)
+    {
+      png_info = png_create_info_struct(png_struct);
+    }
+  if (png_info == NULL)
+    {
+      RELEASE(self);
+      return nil;
+    }
+  png_set_progressive_read_fn(png_struct, self, loader_info_func,
+                              loader_row_func, loader_end_func);
+  rows = -1;
+  return self;
+}
+
+- (void) _destroy
+{
+  if (png_struct != NULL)
+    {
+      png_destroy_read_struct(&png_struct, &png_info, NULL);
+    }
+}
+
+- (void) dealloc
+{
+  [self _destroy];
+  [super dealloc];
+}
+
+- (NSInteger) loadFromData: (NSData *)data complete: (BOOL)complete
+{
+  NSUInteger length = [data length];
+
+  if (setjmp(png_jmpbuf(png_struct)))
+    {
+      [self _destroy];
+      return NSImageRepLoadStatusInvalidData;
+    }
+
+  if (length > offset)
+    {
+      png_process_data(png_struct, png_info,
+                       (png_bytep)[data bytes] + offset, length - offset);
+      offset = length;
+    }
+
+  if (finished)
+    {
+      [self _destroy];
+      return NSImageRepLoadStatusCompleted;
+    }
+  if (complete)
+    {
+      [self _destroy];
+      return NSImageRepLoadStatusUnexpectedEOF;
+    }
+  return rows < 0 ? NSImageRepLoadStatusReadingHeader : rows;
+}
+
+- (void) _readInfo
+{
+  NSBitmapFormat bitmapFormat = NSAlphaNonpremultipliedBitmapFormat;
+  NSString *colorspace;
+  BOOL alpha = NO;
+  int width, type, channels, depth;
+
+  width = png_get_image_width(png_struct, png_info);
+  height = png_get_image_height(png_struct, png_info);
+  type = png_get_color_type(png_struct, png_info);
+
+  switch (type)
+    {
+      case PNG_COLOR_TYPE_GRAY_ALPHA:
+	alpha = YES;
+	/* fall through */
+      case PNG_COLOR_TYPE_GRAY:
+	colorspace = NSCalibratedWhiteColorSpace;
+	break;
+
+      case PNG_COLOR_TYPE_PALETTE:
+	png_set_palette_to_rgb(png_struct);
+	if (png_get_valid(png_struct, png_info, PNG_INFO_tRNS))
+	  {
+	    alpha = YES;
+	    png_set_tRNS_to_alpha(png_struct);
+	  }
+	colorspace = NSCalibratedRGBColorSpace;
+	break;
+
+      case PNG_COLOR_TYPE_RGB_ALPHA:
+	alpha = YES;
+	/* fall through */
+      case PNG_COLOR_TYPE_RGB:
+	colorspace = NSCalibratedRGBColorSpace;
+	break;
+
+      default:
+	NSLog(@"NSBitmapImageRep+PNG: unknown color type %i", type);
+	png_error(png_struct, "unknown color type");
+	return;
+    }
+
+  /* Let libpng put together the passes of interlaced images, so every
+     row callback gets a full row */
+  interlaced = (png_set_interlace_handling(png_struct) > 1);
+  png_read_update_info(png_struct, png_info);
+
+  channels = png_get_channels(png_struct, png_info);
+  depth = png_get_bit_depth(png_struct, png_info);
+  bytesPerRow = png_get_rowbytes(png_struct, png_info);
+  if (depth == 16)
+    {
+      bitmapFormat |= NSBitmapFormatSixteenBitBigEndian;
+    }
+
+  if ([rep initWithBitmapDataPlanes: NULL
+                         pixelsWide: width
+                         pixelsHigh: height
+                      bitsPerSample: depth
+                    samplesPerPixel: channels
+                           hasAlpha: alpha
+                           isPlanar: NO
+                     colorSpaceName: colorspace
+                       bitmapFormat: bitmapFormat
+                        bytesPerRow: bytesPerRow
+                       bitsPerPixel: channels * depth] == nil)
+    {
+      png_error(png_struct, "unable to create bitmap");
+    }
+  bitmap = [rep bitmapData];
+  set_png_properties(rep, png_struct, png_info);
+  rows = 0;
+}
+
+- (void) _readRow: (png_bytep)row number: (png_uint_32)n pass: (int)pass
+{
+  if (n >= height)
+    {
+      return;
+    }
+
+  /* Copies row for non interlaced images, merges the pixels of the
+     current pass into the row otherwise */
+  png_progressive_combine_row(png_struct, bitmap + n * bytesPerRow, row);
+
+  /* Rows of interlaced images are only complete in the last pass */
+  if (!interlaced || pass == 6)
+    {
+      rows = n + 1;
+    }
+}
+
+- (void) _readEnd
+{
+  rows = height;
+  finished = YES;
+}
+
+@end
+
 @implementation NSBitmapImageRep (PNG)
 
 + (BOOL) _bitmapIsPNG: (NSData *)imageData
@@ -94,6 +359,13 @@ static void reader_func(png_structp png_struct, png_bytep data,
 }
 
 - (id) _initBitmapFromPNG: (NSData *)imageData
+{
+  return [self _initBitmapFromPNG: imageData
+                 maximumPixelSize: NSZeroSize];
+}
+
+- (id) _initBitmapFromPNG: (NSData *)imageData
+         maximumPixelSize: (NSSize)maxSize
 {
   png_structp png_struct;
   png_infop png_info, png_end_info;
@@ -107,12 +379,17 @@ static void reader_func(png_structp png_struct, png_bytep data,
   int bpp;
   NSString *colorspace;
   NSBitmapFormat bitmapFormat = NSAlphaNonpremultipliedBitmapFormat;
+  NSSize target;
+  GSImageScaler scaler;
+  BOOL scaling = NO;
 
   reader_struct_t reader;
 
   if (!(self = [super init]))
     return nil;
 
+  memset(&scaler, 0, sizeof(scaler));
+
   png_struct = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
   if (!png_struct)
     {
@@ -144,6 +421,7 @@ static void reader_func(png_structp png_struct, png_bytep data,
         {
           NSZoneFree([self zone], buf);
         }
+      GSImageScalerDestroy(&scaler);
       RELEASE(self);
       return nil;
     }
@@ -215,98 +493,112 @@ static void reader_func(png_structp png_struct, png_bytep data,
 	return nil;
     }
 
-  buf = NSZoneMalloc([self zone], bytes_per_row * height);
-
-  {
-    png_bytep row_pointers[height];
-    int i;
-
-    for (i = 0; i < height; i++)
-      {
-        row_pointers[i] = buf + i * bytes_per_row;
-      }
-
-    png_read_image(png_struct, row_pointers);
-  }
-
-  if (depth == 16)
+  /* Interlaced images only have all of a row after the last pass,
+     they get scaled after reading. */
+  target = NSMakeSize(width, height);
+  if (png_get_interlace_type(png_struct, png_info) == PNG_INTERLACE_NONE)
     {
-      bitmapFormat |= NSBitmapFormatSixteenBitBigEndian;
+      target = GSImageScaledPixelSize(width, height, maxSize);
     }
-  else if (depth == 32)
+  if (target.width < width || target.height < height)
     {
-      bitmapFormat |= NSBitmapFormatThirtyTwoBitBigEndian;
-    }
+      int i;
 
-  self = [self initWithBitmapDataPlanes: &buf
-                             pixelsWide: width
-                             pixelsHigh: height
-                          bitsPerSample: depth
-                        samplesPerPixel: channels
-                               hasAlpha: alpha
-                               isPlanar: NO
-                         colorSpaceName: colorspace
-                           bitmapFormat: bitmapFormat
-                            bytesPerRow: bytes_per_row
-                           bitsPerPixel: bpp];
-  
-  _imageData = [[NSData alloc]
-    initWithBytesNoCopy: buf
-		 length: bytes_per_row * height];
+      /* Shrink each row as it is read, at 8 bits per sample */
+      if (depth == 16)
+        {
+          png_set_strip_16(png_struct);
+        }
+      else if (depth < 8)
+        {
+          png_set_expand_gray_1_2_4_to_8(png_struct);
+        }
+      png_read_update_info(png_struct, png_info);
+      channels = png_get_channels(png_struct, png_info);
+      bytes_per_row = png_get_rowbytes(png_struct, png_info);
 
-  if (png_get_valid(png_struct, png_info, PNG_INFO_gAMA))
-  {
-    double file_gamma = 2.2;
-    if (PNG_FLOATING_POINT)
-    {
-      png_get_gAMA(png_struct, png_info, &file_gamma);
-      // remap file_gamma [1.0, 2.5] to property [0.0, 1.0]
-      file_gamma = (file_gamma - 1.0)/1.5;
+      if (!GSImageScalerInit(&scaler, width, height,
+                             target.width, target.height, channels))
+        {
+          png_error(png_struct, "out of memory");
+        }
+      scaling = YES;
+
+      buf = NSZoneMalloc([self zone], bytes_per_row);
+      for (i = 0; i < height; i++)
+        {
+          png_read_row(png_struct, buf, NULL);
+          GSImageScalerAddRow(&scaler, buf);
+        }
+      NSZoneFree([self zone], buf);
+      buf = NULL;
     }
-    else	// fixed point
+  else
     {
-      png_fixed_point int_gamma = 220000;
-      png_get_gAMA_fixed(png_struct, png_info, &int_gamma);
-      // remap gamma [0.0, 1.0] to [100000, 250000]
-      file_gamma = ((double)int_gamma - 100000.0)/150000.0;
-    }
-    [self setProperty: NSImageGamma
-            withValue: [NSNumber numberWithDouble: file_gamma]];
-    //NSLog(@"PNG file gamma: %f", file_gamma);
-   } 
-
-  if (png_get_valid(png_struct, png_info, PNG_INFO_pHYs))
-  {
-    png_uint_32 xppm = png_get_x_pixels_per_meter(png_struct, png_info);
-    png_uint_32 yppm = png_get_y_pixels_per_meter(png_struct, png_info);
+      buf = NSZoneMalloc([self zone], bytes_per_row * height);
 
-    if (xppm != 0 && yppm != 0)
       {
-	const CGFloat pointsPerMeter = 39.3700787 * 72.0;
-	NSSize sizeInPoints = NSMakeSize((width / (CGFloat)xppm) * pointsPerMeter,
-					 (height / (CGFloat)yppm) * pointsPerMeter);
+        png_bytep row_pointers[height];
+        int i;
 
-	// HACK: PNG can not represent 72DPI exactly. If the ppm value is near 72DPI,
-	// assume it is exactly 72 DPI. Note that the same problem occurrs at 144DPI...
-	// so don't use PNG for resolution independent graphics.
-	if (xppm  == 2834 || xppm == 2835)
-	  {
-	    sizeInPoints.width = width;
-	  }
-	if (yppm == 2834 || yppm == 2835)
-	  {
-	    sizeInPoints.height = height;
-	  }
+        for (i = 0; i < height; i++)
+          {
+            row_pointers[i] = buf + i * bytes_per_row;
+          }
 
-	[self setSize: sizeInPoints];
+        png_read_image(png_struct, row_pointers);
       }
-  }
+    }
+
+  if (scaling)
+    {
+      self = [self _initWithScaler: &scaler
+                          hasAlpha: alpha
+                    colorSpaceName: colorspace
+                      bitmapFormat: bitmapFormat];
+      GSImageScalerDestroy(&scaler);
+      [self setSize: NSMakeSize(width, height)];
+    }
+  else
+    {
+      if (depth == 16)
+        {
+          bitmapFormat |= NSBitmapFormatSixteenBitBigEndian;
+        }
+      else if (depth == 32)
+        {
+          bitmapFormat |= NSBitmapFormatThirtyTwoBitBigEndian;
+        }
+
+      self = [self initWithBitmapDataPlanes: &buf
+                                 pixelsWide: width
+                                 pixelsHigh: height
+                              bitsPerSample: depth
+                            samplesPerPixel: channels
+                                   hasAlpha: alpha
+                                   isPlanar: NO
+                             colorSpaceName: colorspace
+                               bitmapFormat: bitmapFormat
+                                bytesPerRow: bytes_per_row
+                               bitsPerPixel: bpp];
+  
+      _imageData = [[NSData alloc]
+        initWithBytesNoCopy: buf
+                     length: bytes_per_row * height];
+    }
+
+  set_png_properties(self, png_struct, png_info);
 
   png_destroy_read_struct(&png_struct, &png_info, &png_end_info);
 
   return self;
 }
 
+- (GSImageLoader *) _newPNGLoader
+{
+  return [[GSPNGLoader alloc] initWithBitmap: self];
+}
+
 /***** PNG writing support ******/
 static void writer_func(png_structp png_struct, png_bytep data,
 			png_size_t length)
@@ -444,6 +736,16 @@ static void writer_func(png_structp png_struct, png_bytep data,
   RELEASE(self);
   return nil;
 }
+- (id) _initBitmapFromPNG: (NSData *)imageData
+         maximumPixelSize: (NSSize)maxSize
+{
+  RELEASE(self);
+  return nil;
+}
+- (GSImageLoader *) _newPNGLoader
+{
+  return nil;
+}
 - (NSData *) _PNGRepresentationWithProperties: (NSDictionary *) properties
 {
   return nil;
@@ -553,24 +553,92 @@
   return nil;
 }
 
+/** Initialises a receiver that gets its image with
+    -incrementalLoadFromData:complete: */
 - (id) initForIncrementalLoad
 {
-  // FIXME
-  return self;
+  return [super init];
+}
+
+/* Returns the loader for data, or nil while there is not enough of it
+   to tell the type of the image. */
+- (GSImageLoader *) _loaderForData: (NSData *)data complete: (BOOL)complete
+{
+  const unsigned char *bytes = [data bytes];
+  NSUInteger length = [data length];
+  GSImageLoader *loader = nil;
+
+  if (length < 8 && !complete)
+    {
+      return nil;
+    }
+
+  if (length >= 8 && memcmp(bytes, "\211PNG\r\n\032\n", 8) == 0)
+    {
+      loader = [self _newPNGLoader];
+    }
+  else if (length >= 3
+    && bytes[0] == 0xFF && bytes[1] == 0xD8 && bytes[2] == 0xFF)
+    {
+      loader = [self _newJPEGLoader];
+    }
+  else if (length >= 6
+    && (memcmp(bytes, "GIF87a", 6) == 0 || memcmp(bytes, "GIF89a", 6) == 0))
+    {
+      loader = [self _newGIFLoader];
+    }
+
+  if (loader == nil)
+    {
+      loader = [[GSImageLoader alloc] initWithBitmap: self];
+    }
+  return loader;
 }
 
+/** <p>Loads the image of a receiver initialised with
+    -initForIncrementalLoad from data, which must hold all the data of
+    the image received so far.  Set complete once data holds all of
+    it.</p>
+    <p>PNG, JPEG and GIF images are decoded as the data comes in, only
+    the bytes added since the last call are looked at.  The bitmap is
+    set up as soon as the header of the image has been read, and the
+    number of rows from the top which have been decoded is returned
+    from then on.  Otherwise one of the NSImageRepLoadStatus values is
+    returned: NSImageRepLoadStatusReadingHeader while the size of the
+    image is not known yet, NSImageRepLoadStatusWillNeedAllData for
+    formats which are only decoded once all of the data is there, and
+    NSImageRepLoadStatusCompleted, NSImageRepLoadStatusInvalidData or
+    NSImageRepLoadStatusUnexpectedEOF once the load has finished.</p>
+*/
 - (NSInteger) incrementalLoadFromData: (NSData *)data complete: (BOOL)complete
 {
-  if (!complete)
+  NSInteger status;
+
+  if (_loader == nil)
     {
-      // we don't implement it really
-      return NSImageRepLoadStatusWillNeedAllData;
+      _loader = [self _loaderForData: data complete: complete];
+      if (_loader == nil)
+        {
+          return NSImageRepLoadStatusReadingHeader;
+        }
+    }
+  if (((GSImageLoader *)_loader)->status != 0)
+    {
+      return ((GSImageLoader *)_loader)->status;
     }
-  return [self initWithData: data] ? NSImageRepLoadStatusCompleted : NSImageRepLoadStatusUnexpectedEOF;
+
+  status = [_loader loadFromData: data complete: complete];
+  if (status <= NSImageRepLoadStatusInvalidData)
+    {
+      ((GSImageLoader *)_loader)->status = status;
+    }
+  return status;
 }
 
 - (void) dealloc
 {
+  [_loader stop];
+  RELEASE(_loader);
   NSZoneFree([self zone],_imagePlanes);
   RELEASE(_imageData);
   RELEASE(_properties);
@@ -1821,6 +1889,8 @@ _set_bit_value(unsigned char *base, long msb_off, int bit_width,
   copy = (NSBitmapImageRep*)[super copyWithZone: zone];
 
   copy->_properties = [_properties mutableCopyWithZone: zone];
+  /* A copy is not loaded incrementally, it gets the image as it is */
+  copy->_loader = nil;
   copy->_imageData = [_imageData mutableCopyWithZone: zone];
   copy->_imagePlanes = NSZoneMalloc(zone, sizeof(unsigned char*) * MAX_PLANES);
   if (_imageData == nil)
@@ -1887,8 +1957,342 @@ _set_bit_value(unsigned char *base, long msb_off, int bit_width,
 
 @end
 
+@implementation GSImageLoader
+
+- (id) initWithBitmap: (NSBitmapImageRep *)aRep
+{
+  if ((self = [super init]) != nil)
+    {
+      rep = aRep;
+    }
+  return self;
+}
+
+- (NSInteger) loadFromData: (NSData *)data complete: (BOOL)complete
+{
+  NSBitmapImageRep *bitmap;
+
+  if (!complete)
+    {
+      return NSImageRepLoadStatusWillNeedAllData;
+    }
+
+  bitmap = [[NSBitmapImageRep alloc] initWithData: data];
+  if (bitmap == nil)
+    {
+      return NSImageRepLoadStatusInvalidData;
+    }
+  [rep _takeBitmapOf: bitmap];
+  RELEASE(bitmap);
+  rows = [rep pixelsHigh];
+  return NSImageRepLoadStatusCompleted;
+}
+
+- (void) stop
+{
+}
+
+@end
+
+@implementation NSBitmapImageRep (GNUstepExtension)
+
++ (NSArray*) imageRepsWithFile: (NSString *)filename
+{
+  return [self imageRepsWithData: [NSData dataWithContentsOfFile: filename]];
+}
+
++ (id) imageRepWithData: (NSData *)imageData
+       maximumPixelSize: (NSSize)size
+{
+  return AUTORELEASE([[self alloc] initWithData: imageData
+                               maximumPixelSize: size]);
+}
+
+- (id) initWithData: (NSData *)imageData
+   maximumPixelSize: (NSSize)size
+{
+  Class class;
+  NSBitmapImageRep *scaled;
+
+  if (imageData == nil)
+    {
+      RELEASE(self);
+      return nil;
+    }
+
+  class = [self class];
+  if ([class _bitmapIsPNG: imageData])
+    {
+      self = [self _initBitmapFromPNG: imageData
+                     maximumPixelSize: size];
+    }
+  else if ([class _bitmapIsJPEG: imageData])
+    {
+      self = [self _initBitmapFromJPEG: imageData
+                      maximumPixelSize: size
+                          errorMessage: NULL];
+    }
+  else
+    {
+      self = [self initWithData: imageData];
+    }
+
+  /* Formats which cannot be scaled while decoding get scaled now */
+  scaled = [self _bitmapFittingPixelSize: size];
+  if (scaled != self)
+    {
+      RETAIN(scaled);
+      RELEASE(self);
+      self = scaled;
+    }
+  return self;
+}
+
+@end
+
+NSSize
+GSImageScaledPixelSize(NSInteger width, NSInteger height, NSSize maxSize)
+{
+  CGFloat scale = 1.0;
+
+  if (maxSize.width > 0 && width > maxSize.width)
+    {
+      scale = maxSize.width / width;
+    }
+  if (maxSize.height > 0 && height * scale > maxSize.height)
+    {
+      scale = maxSize.height / height;
+    }
+  if (scale == 1.0)
+    {
+      return NSMakeSize(width, height);
+    }
+  return NSMakeSize(MAX(1, floor(width * scale + 0.5)),
+                    MAX(1, floor(height * scale + 0.5)));
+}
+
+BOOL
+GSImageScalerInit(GSImageScaler *scaler,
+                  NSInteger srcWidth, NSInteger srcHeight,
+                  NSInteger width, NSInteger height, NSInteger samples)
+{
+  NSInteger x;
+
+  memset(scaler, 0, sizeof(GSImageScaler));
+  scaler->srcWidth = srcWidth;
+  scaler->srcHeight = srcHeight;
+  scaler->width = width;
+  scaler->height = height;
+  scaler->samples = samples;
+  scaler->columns = malloc(srcWidth * sizeof(NSInteger));
+  scaler->counts = calloc(width, sizeof(NSInteger));
+  scaler->sums = calloc(width * samples, sizeof(unsigned int));
+  scaler->data = malloc(width * height * samples);
+  if (scaler->columns == NULL || scaler->counts == NULL
+    || scaler->sums == NULL || scaler->data == NULL)
+    {
+      GSImageScalerDestroy(scaler);
+      return NO;
+    }
+
+  for (x = 0; x < srcWidth; x++)
+    {
+      scaler->columns[x] = x * width / srcWidth;
+      scaler->counts[scaler->columns[x]]++;
+    }
+  return YES;
+}
+
+/* Stores the average of the rows summed up so far as the current
+ * destination row. */
+static void
+GSImageScalerFlush(GSImageScaler *scaler)
+{
+  const NSInteger samples = scaler->samples;
+  unsigned char *out = scaler->data + scaler->row * scaler->width * samples;
+  unsigned int *sums = scaler->sums;
+  NSInteger x, i;
+
+  if (scaler->rowCount == 0)
+    {
+      return;
+    }
+  for (x = 0; x < scaler->width; x++)
+    {
+      unsigned int n = scaler->counts[x] * scaler->rowCount;
+
+      for (i = 0; i < samples; i++)
+        {
+          *out++ = (*sums + n / 2) / n;
+          *sums++ = 0;
+        }
+    }
+  scaler->rowCount = 0;
+}
+
+void
+GSImageScalerAddRow(GSImageScaler *scaler, const unsigned char *row)
+{
+  const NSInteger samples = scaler->samples;
+  const NSInteger *columns = scaler->columns;
+  unsigned int *sums = scaler->sums;
+  NSInteger y;
+  NSInteger x, i;
+
+  if (scaler->srcRow >= scaler->srcHeight)
+    {
+      return;
+    }
+
+  y = scaler->srcRow * scaler->height / scaler->srcHeight;
+  if (y != scaler->row)
+    {
+      GSImageScalerFlush(scaler);
+      scaler->row = y;
+    }
+
+  for (x = 0; x < scaler->srcWidth; x++)
+    {
+      unsigned int *sum = sums + columns[x] * samples;
+
+      for (i = 0; i < samples; i++)
+        {
+          sum[i] += *row++;
+        }
+    }
+  scaler->rowCount++;
+  scaler->srcRow++;
+
+  if (scaler->srcRow == scaler->srcHeight)
+    {
+      GSImageScalerFlush(scaler);
+    }
+}
+
+void
+GSImageScalerDestroy(GSImageScaler *scaler)
+{
+  free(scaler->columns);
+  free(scaler->counts);
+  free(scaler->sums);
+  free(scaler->data);
+  scaler->columns = NULL;
+  scaler->counts = NULL;
+  scaler->sums = NULL;
+  scaler->data = NULL;
+}
+
 @implementation NSBitmapImageRep (GSPrivate)
 
+- (id) _initWithScaler: (GSImageScaler *)scaler
+              hasAlpha: (BOOL)alpha
+        colorSpaceName: (NSString *)colorSpaceName
+          bitmapFormat: (NSBitmapFormat)bitmapFormat
+{
+  unsigned char *buf = scaler->data;
+  NSInteger rowBytes = scaler->width * scaler->samples;
+
+  scaler->data = NULL;
+  self = [self initWithBitmapDataPlanes: &buf
+                             pixelsWide: scaler->width
+                             pixelsHigh: scaler->height
+                          bitsPerSample: 8
+                        samplesPerPixel: scaler->samples
+                               hasAlpha: alpha
+                               isPlanar: NO
+                         colorSpaceName: colorSpaceName
+                           bitmapFormat: bitmapFormat
+                            bytesPerRow: rowBytes
+                           bitsPerPixel: 8 * scaler->samples];
+  if (self == nil)
+    {
+      free(buf);
+      return nil;
+    }
+  _imageData = [[NSData alloc] initWithBytesNoCopy: buf
+                                            length: rowBytes * scaler->height];
+  return self;
+}
+
+/* Returns a shrunk copy of the receiver if it does not fit into
+ * maxSize pixels, otherwise the receiver itself. */
+- (NSBitmapImageRep *) _bitmapFittingPixelSize: (NSSize)maxSize
+{
+  NSBitmapFormat format;
+  NSBitmapImageRep *source;
+  NSBitmapImageRep *scaled;
+  GSImageScaler scaler;
+  NSSize target;
+  unsigned char *data;
+  NSInteger bytesPerRow;
+  NSInteger y;
+
+  target = GSImageScaledPixelSize(_pixelsWide, _pixelsHigh, maxSize);
+  if (target.width >= _pixelsWide && target.height >= _pixelsHigh)
+    {
+      return self;
+    }
+
+  format = _format & (NSAlphaFirstBitmapFormat
+                      | NSAlphaNonpremultipliedBitmapFormat);
+  source = [self _convertToFormatBitsPerSample: 8
+                               samplesPerPixel: _numColors
+                                      hasAlpha: _hasAlpha
+                                      isPlanar: NO
+                                colorSpaceName: _colorSpace
+                                  bitmapFormat: format
+                                   bytesPerRow: 0
+                                  bitsPerPixel: 0];
+  if (source == nil
+    || !GSImageScalerInit(&scaler, _pixelsWide, _pixelsHigh,
+                          target.width, target.height, _numColors))
+    {
+      return self;
+    }
+
+  data = [source bitmapData];
+  bytesPerRow = [source bytesPerRow];
+  for (y = 0; y < _pixelsHigh; y++)
+    {
+      GSImageScalerAddRow(&scaler, data + y * bytesPerRow);
+    }
+  scaled = [[[self class] alloc] _initWithScaler: &scaler
+                                        hasAlpha: _hasAlpha
+                                  colorSpaceName: _colorSpace
+                                    bitmapFormat: format];
+  GSImageScalerDestroy(&scaler);
+  [scaled setSize: [self size]];
+
+  return AUTORELEASE(scaled);
+}
+
+- (void) _takeBitmapOf: (NSBitmapImageRep *)bitmap
+{
+  unsigned char *planes[MAX_PLANES];
+  NSInteger planeSize = [bitmap bytesPerPlane];
+  NSInteger i;
+
+  [self initWithBitmapDataPlanes: NULL
+                      pixelsWide: [bitmap pixelsWide]
+                      pixelsHigh: [bitmap pixelsHigh]
+                   bitsPerSample: [bitmap bitsPerSample]
+                 samplesPerPixel: [bitmap samplesPerPixel]
+                        hasAlpha: [bitmap hasAlpha]
+                        isPlanar: [bitmap isPlanar]
+                  colorSpaceName: [bitmap colorSpaceName]
+                    bitmapFormat: [bitmap bitmapFormat]
+                     bytesPerRow: [bitmap bytesPerRow]
+                    bitsPerPixel: [bitmap bitsPerPixel]];
+  [bitmap getBitmapDataPlanes: planes];
+  for (i = 0; i < [bitmap numberOfPlanes]; i++)
+    {
+      memcpy(_imagePlanes[i], planes[i], planeSize);
+    }
+  [self setSize: [bitmap size]];
+  DESTROY(_properties);
+  _properties = [bitmap->_properties mutableCopy];
+}
+
 + (int) _localFromCompressionType: (NSTIFFCompression)type
 {
   switch (type)
@@ -28,6 +28,60 @@
 #import "AppKit/NSBitmapImageRep.h"
 #include "nsimage-tiff.h"
 
+/*
+ * Shrinks an image with a box filter, one row of 8 bit meshed samples
+ * at a time, so decoders can scale rows as they are produced without
+ * ever holding the full size image.
+ */
+typedef struct {
+  NSInteger     srcWidth;
+  NSInteger     srcHeight;
+  NSInteger     width;
+  NSInteger     height;
+  NSInteger     samples;
+  NSInteger     srcRow;         // source rows added so far
+  NSInteger     row;            // destination row being summed up
+  NSInteger     rowCount;       // source rows summed up in it
+  NSInteger     *columns;       // destination column of each source column
+  NSInteger     *counts;        // source columns in each destination column
+  unsigned int  *sums;
+  unsigned char *data;          // the destination image
+} GSImageScaler;
+
+/* Returns the size in pixels a width x height image gets shrunk to so
+ * it fits into maxSize, keeping its aspect ratio.  A zero dimension of
+ * maxSize is not limited. */
+NSSize GSImageScaledPixelSize(NSInteger width, NSInteger height,
+                              NSSize maxSize);
+BOOL GSImageScalerInit(GSImageScaler *scaler,
+                       NSInteger srcWidth, NSInteger srcHeight,
+                       NSInteger width, NSInteger height, NSInteger samples);
+void GSImageScalerAddRow(GSImageScaler *scaler, const unsigned char *row);
+void GSImageScalerDestroy(GSImageScaler *scaler);
+
+/*
+ * State of an incremental load of a bitmap.  Each call is handed all
+ * the data received so far and only decodes the bytes that were not
+ * seen before.  The bitmap of rep is set up as soon as the header has
+ * been read, and rows are decoded straight into it.
+ * This class itself handles the formats which cannot be decoded
+ * incrementally by waiting for all the data.
+ */
+@interface GSImageLoader : NSObject
+{
+@public
+  NSBitmapImageRep  *rep;       // not retained, the rep owns its loader
+  NSInteger         rows;       // rows of the bitmap decoded so far
+  NSInteger         status;     // final load status, 0 while loading
+}
+- (id) initWithBitmap: (NSBitmapImageRep *)aRep;
+/* Returns a NSImageRepLoadStatus, or the number of rows decoded so far
+ * once the size of the image is known. */
+- (NSInteger) loadFromData: (NSData *)data complete: (BOOL)complete;
+/* Called when the rep goes away before the load has finished. */
+- (void) stop;
+@end
+
 @interface NSBitmapImageRep (GSPrivate)
 // GNUstep extension
 + (BOOL) _bitmapIsTIFF: (NSData *)data;
@@ -51,4 +105,13 @@
                                         bitmapFormat: (NSBitmapFormat)bitmapFormat 
                                          bytesPerRow: (NSInteger)rowBytes
                                         bitsPerPixel: (NSInteger)pixelBits;
+/* Initialises the receiver with the image of a scaler, which has been
+ * given all its rows, taking over its data. */
+- (id) _initWithScaler: (GSImageScaler *)scaler
+              hasAlpha: (BOOL)alpha
+        colorSpaceName: (NSString *)colorSpaceName
+          bitmapFormat: (NSBitmapFormat)bitmapFormat;
+- (NSBitmapImageRep *) _bitmapFittingPixelSize: (NSSize)maxSize;
+/* Makes the receiver a copy of the image of bitmap. */
+- (void) _takeBitmapOf: (NSBitmapImageRep *)bitmap;
 @end
@@ -39,6 +39,7 @@
 #import <Foundation/NSArray.h>
 #import <Foundation/NSDebug.h>
 #import <Foundation/NSException.h>
+#import <Foundation/NSMapTable.h>
 #import <Foundation/NSIndexPath.h>
 #import <Foundation/NSNotification.h>
 #import <Foundation/NSUserDefaults.h>
@@ -81,6 +82,8 @@ static BOOL browserUseBezels;
   NSMatrix *_columnMatrix;
   NSString *_columnTitle;
   CGFloat _width;
+  NSRange _loadedRows;
+  NSMapTable *_cellRows;
 }
 
 - (void) setIsLoaded: (BOOL)flag;
@@ -102,6 +105,7 @@ static BOOL browserUseBezels;
     return nil;
 
   _isLoaded = NO;
+  _loadedRows = NSMakeRange(0, 0);
 
   return self;
 }
@@ -111,6 +115,8 @@ static BOOL browserUseBezels;
   TEST_RELEASE(_columnScrollView);
   TEST_RELEASE(_columnMatrix);
   TEST_RELEASE(_columnTitle);
+  if (_cellRows != NULL)
+    NSFreeMapTable(_cellRows);
   [super dealloc];
 }
 
@@ -245,6 +251,10 @@ static BOOL browserUseBezels;
 @interface NSBrowser (Private)
 - (NSString *) _getTitleOfColumn: (NSInteger)column;
 - (void) _performLoadOfColumn: (NSInteger)column;
+- (void) _loadVisibleRowsOfColumn: (NSInteger)column;
+- (void) _columnClipViewDidChange: (NSNotification *)notification;
+- (void) _loadSelectedCellsOfMatrix: (NSMatrix *)matrix
+                           inColumn: (NSInteger)column;
 - (void) _remapColumnSubviews: (BOOL)flag;
 - (void) _setColumnTitlesNeedDisplay;
 - (NSBorderType) _resolvedBorderType;
@@ -426,7 +436,7 @@ static BOOL browserUseBezels;
       return;
     }
 
-  if ((cell = [matrix cellAtRow: row column: 0]) == nil)
+  if ((cell = [self loadedCellAtRow: row column: column]) == nil)
     {
       return;
     }
@@ -790,7 +800,7 @@ static BOOL browserUseBezels;
           // find the cell in the browser matrix which is equal to aStr
           for (row = 0; row < numOfRows; row++)
             {
-              selectedCell = [matrix cellAtRow: row column: 0];
+              selectedCell = [self loadedCellAtRow: row column: column];
 
               if ([[selectedCell stringValue] isEqualToString: aStr])
                 {
@@ -919,6 +929,19 @@ static BOOL browserUseBezels;
   [sc setHasHorizontalScroller: NO];
   [sc setHasVerticalScroller: YES];
   [sc setBorderType: [self _resolvedBorderType]];
+
+  /* Track scrolling and resizing of the column so that lazily loaded
+     columns can fill in the rows which become visible. */
+  [[NSNotificationCenter defaultCenter]
+    addObserver: self
+       selector: @selector(_columnClipViewDidChange:)
+           name: NSViewBoundsDidChangeNotification
+         object: [sc contentView]];
+  [[NSNotificationCenter defaultCenter]
+    addObserver: self
+       selector: @selector(_columnClipViewDidChange:)
+           name: NSViewFrameDidChangeNotification
+         object: [sc contentView]];
   
   [bc setColumnScrollView: sc];
   [self addSubview: sc];
@@ -2337,6 +2360,13 @@ static BOOL browserUseBezels;
   if (column < 0 || column > _lastColumnLoaded)
     return;
     
+  if (_loadsColumnsLazily)
+    {
+      /* Cells selected by dragging or extending the selection may not
+         have been displayed yet. */
+      [self _loadSelectedCellsOfMatrix: sender inColumn: column];
+    }
+
   array = [sender selectedCells];
   aCount = [array count];
   if (aCount == 0)
@@ -3160,6 +3190,41 @@ static BOOL browserUseBezels;
   _sendsActionOnAlphaNumericalKeys = flag;
 }
 
+/** Returns YES if columns are loaded lazily.
+    <p>See Also: -setLoadsColumnsLazily:</p> */
+- (BOOL) loadsColumnsLazily
+{
+  return _loadsColumnsLazily;
+}
+
+/** <p>Sets whether columns are loaded lazily. This only has an effect
+    for passive delegates, i.e., delegates implementing
+    -browser:numberOfRowsInColumn:.</p>
+    <p>When enabled, -browser:willDisplayCell:atRow:column: is only sent
+    for the rows in and near the visible part of a column, as the column
+    is scrolled. Cells which move far out of sight are marked as unloaded
+    and release their contents, so that they are filled in again by the
+    delegate when they become visible.</p>
+    <p>Only filling in the cells is lazy: the column's matrix still
+    creates a cell for every row, so the memory used by a column grows
+    with its number of rows. Use -loadedCellAtRow:column: rather than
+    [NSMatrix-cellAtRow:column:] to access the cells of a lazily loaded
+    column.</p>
+    <p>Columns which are already loaded are reloaded.</p> */
+- (void) setLoadsColumnsLazily: (BOOL)flag
+{
+  NSInteger i;
+
+  if (_loadsColumnsLazily == flag)
+    return;
+
+  _loadsColumnsLazily = flag;
+  for (i = 0; i <= _lastColumnLoaded; i++)
+    {
+      [self reloadColumn: i];
+    }
+}
+
 @end
 
 
@@ -3274,6 +3339,13 @@ static BOOL browserUseBezels;
 
   matrix = [bc columnMatrix];
 
+  bc->_loadedRows = NSMakeRange(0, 0);
+  if (bc->_cellRows != NULL)
+    {
+      NSFreeMapTable(bc->_cellRows);
+      bc->_cellRows = NULL;
+    }
+
   if (_reusesColumns && matrix)
     {
       [matrix renewRows: rows columns: cols];
@@ -3319,7 +3391,26 @@ static BOOL browserUseBezels;
   [sc setDocumentView: matrix];
 
   // Loading is different based upon passive/active delegate
-  if (_passiveDelegate)
+  if (_passiveDelegate && _loadsColumnsLazily)
+    {
+      /* Only load the first row here, it determines the cell size and
+         thereby the rows visible. The remaining visible rows are loaded
+         by -_loadVisibleRowsOfColumn: below. */
+      if (rows > 0)
+        {
+          id aCell = [matrix cellAtRow: 0 column: 0];
+
+          if (![aCell isLoaded])
+            {
+              [_browserDelegate browser: self
+                        willDisplayCell: aCell
+                                  atRow: 0
+                                 column: column];
+              [aCell setLoaded: YES];
+            }
+        }
+    }
+  else if (_passiveDelegate)
     {
       // Now loop through the cells and load each one
       id aCell;
@@ -3373,12 +3464,164 @@ static BOOL browserUseBezels;
     [matrix setCellSize: ms];
   }
 
+  if (_passiveDelegate && _loadsColumnsLazily)
+    {
+      [self _loadVisibleRowsOfColumn: column];
+    }
+
   // Get the title even when untitled, as this may change later.
   [self setTitle: [self _getTitleOfColumn: column] ofColumn: column];
   // Mark for redisplay
   [self displayColumn: column];
 }
 
+/* Loads the rows of a lazily loaded column which are visible, or close
+   to the visible part of the column, and unloads the rows which moved
+   out of reach since the last call. Only the range of rows loaded by
+   this method is tracked, so that scrolling costs time proportional to
+   the number of rows visible rather than to the number of rows in the
+   column. */
+- (void) _loadVisibleRowsOfColumn: (NSInteger)column
+{
+  NSBrowserColumn *bc;
+  NSMatrix *matrix;
+  NSRect visibleRect;
+  NSRange oldRange;
+  NSRange newRange;
+  CGFloat rowHeight;
+  NSInteger rows, first, last, margin, i;
+  SEL sel = @selector(browser:willDisplayCell:atRow:column:);
+  IMP imp;
+
+  if (!_passiveDelegate || !_loadsColumnsLazily)
+    return;
+
+  if ((matrix = [self matrixInColumn: column]) == nil)
+    return;
+
+  bc = [_browserColumns objectAtIndex: column];
+  oldRange = bc->_loadedRows;
+  rows = [matrix numberOfRows];
+  rowHeight = [matrix cellSize].height + [matrix intercellSpacing].height;
+  if (rows == 0 || rowHeight <= 0.0)
+    {
+      bc->_loadedRows = NSMakeRange(0, 0);
+      return;
+    }
+
+  /* Keep one page of rows above and below the visible rect loaded. */
+  visibleRect = [matrix visibleRect];
+  margin = (NSInteger)ceil(NSHeight(visibleRect) / rowHeight);
+  first = (NSInteger)floor(NSMinY(visibleRect) / rowHeight) - margin;
+  last = (NSInteger)ceil(NSMaxY(visibleRect) / rowHeight) + margin;
+  if (first < 0)
+    first = 0;
+  if (last > rows)
+    last = rows;
+  if (last < first)
+    last = first;
+  newRange = NSMakeRange(first, last - first);
+
+  if (NSEqualRanges(oldRange, newRange))
+    return;
+
+  /* Unload cells which are no longer close to the visible rect. Selected
+     cells are kept, as the browser's path depends on them. */
+  for (i = oldRange.location; i < (NSInteger)NSMaxRange(oldRange); i++)
+    {
+      NSBrowserCell *aCell;
+
+      if (i >= rows)
+        break;
+      if (NSLocationInRange(i, newRange))
+        continue;
+
+      aCell = [matrix cellAtRow: i column: 0];
+      if ([aCell isLoaded] && ![aCell isHighlighted]
+          && [aCell state] == NSOffState && aCell != [matrix selectedCell])
+        {
+          [aCell setLoaded: NO];
+          [aCell setObjectValue: nil];
+        }
+    }
+
+  imp = [_browserDelegate methodForSelector: sel];
+  for (i = first; i < last; i++)
+    {
+      NSBrowserCell *aCell = [matrix cellAtRow: i column: 0];
+
+      if (![aCell isLoaded])
+        {
+          (*imp)(_browserDelegate, sel, self, aCell, i, column);
+          [aCell setLoaded: YES];
+        }
+    }
+  bc->_loadedRows = newRange;
+}
+
+/* Called when the clip view of a column scrolls or changes its size. */
+- (void) _columnClipViewDidChange: (NSNotification *)notification
+{
+  NSView *clipView;
+  NSInteger i;
+
+  if (!_loadsColumnsLazily)
+    return;
+
+  clipView = [notification object];
+  for (i = 0; i <= _lastColumnLoaded; i++)
+    {
+      NSBrowserColumn *bc = [_browserColumns objectAtIndex: i];
+
+      if ([[bc columnScrollView] contentView] == clipView)
+        {
+          [self _loadVisibleRowsOfColumn: i];
+          break;
+        }
+    }
+}
+
+/* Makes sure that all selected cells of a lazily loaded column have been
+   filled in by the delegate. Rows in the range loaded by
+   -_loadVisibleRowsOfColumn: are filled in already; the rows of other
+   selected cells are looked up in a map from cell to row, which is built
+   the first time it is needed after the column has been loaded. */
+- (void) _loadSelectedCellsOfMatrix: (NSMatrix *)matrix
+                           inColumn: (NSInteger)column
+{
+  NSBrowserColumn *bc = [_browserColumns objectAtIndex: column];
+  NSArray *selectedCells = [matrix selectedCells];
+  NSEnumerator *enumerator;
+  NSBrowserCell *cell;
+  NSInteger i, row, rows;
+
+  enumerator = [selectedCells objectEnumerator];
+  while ((cell = [enumerator nextObject]) != nil)
+    {
+      if (![cell respondsToSelector: @selector(isLoaded)] || [cell isLoaded])
+        continue;
+
+      rows = [matrix numberOfRows];
+      if (bc->_cellRows == NULL)
+        {
+          bc->_cellRows = NSCreateMapTable(NSNonOwnedPointerMapKeyCallBacks,
+                                           NSIntegerMapValueCallBacks, rows);
+          for (i = 0; i < rows; i++)
+            {
+              /* Store row + 1, as a NULL value means no row. */
+              NSMapInsert(bc->_cellRows, [matrix cellAtRow: i column: 0],
+                          (void *)(NSUInteger)(i + 1));
+            }
+        }
+
+      row = (NSInteger)(NSUInteger)NSMapGet(bc->_cellRows, cell) - 1;
+      if (row >= 0 && row < rows && [matrix cellAtRow: row column: 0] == cell)
+        {
+          [self loadedCellAtRow: row column: column];
+        }
+    }
+}
+
 /* Get the title of a column. */
 - (NSString *) _getTitleOfColumn: (NSInteger)column
 {
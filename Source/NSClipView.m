@@ -28,8 +28,10 @@
 
 #import "config.h"
 #import <Foundation/NSNotification.h>
+#import <Foundation/NSNotificationQueue.h>
 #import <Foundation/NSException.h>
 
+#import "AppKit/NSCachedImageRep.h"
 #import "AppKit/NSClipView.h"
 #import "AppKit/NSCursor.h"
 #import "AppKit/NSColor.h"
@@ -41,13 +43,78 @@
 
 #import <GNUstepGUI/GSNibLoading.h>
 #import "GSGuiPrivate.h"
+#import "NSViewPrivate.h"
 
 #include <math.h>
 
 @interface NSClipView (Private)
 - (void) _scrollToPoint: (NSPoint)aPoint;
+- (void) _exposeRect: (NSRect)aRect;
+- (BOOL) _canPrepareContent;
+- (void) _schedulePreparation;
+- (void) _prepareContent: (NSNotification *)aNotification;
+- (void) _renderPreparedContentInRect: (NSRect)aRect;
+- (BOOL) _drawPreparedContentInRect: (NSRect)aRect;
+- (void) _discardPreparedContent;
 @end
 
+/* Posted to a clip view when idle to fill in its prepared content */
+static NSString *GSClipViewPrepareContentNotification
+  = @"GSClipViewPrepareContentNotification";
+
+/* Content view of the offscreen window holding prepared content, which
+   has the same orientation as the document view */
+@interface GSPreparedContentView : NSView
+{
+@public
+  BOOL flipped;
+}
+@end
+
+@implementation GSPreparedContentView
+- (BOOL) isFlipped
+{
+  return flipped;
+}
+@end
+
+/*
+ * Store the parts of rect a which are not in rect b in parts and return
+ * their number.
+ */
+static int subtractRect (NSRect a, NSRect b, NSRect parts[4])
+{
+  NSRect i = NSIntersectionRect (a, b);
+  int n = 0;
+
+  if (NSIsEmptyRect (i))
+    {
+      parts[0] = a;
+      return NSIsEmptyRect (a) ? 0 : 1;
+    }
+  if (NSMinY (i) > NSMinY (a))
+    {
+      parts[n++] = NSMakeRect (NSMinX (a), NSMinY (a),
+                               NSWidth (a), NSMinY (i) - NSMinY (a));
+    }
+  if (NSMaxY (i) < NSMaxY (a))
+    {
+      parts[n++] = NSMakeRect (NSMinX (a), NSMaxY (i),
+                               NSWidth (a), NSMaxY (a) - NSMaxY (i));
+    }
+  if (NSMinX (i) > NSMinX (a))
+    {
+      parts[n++] = NSMakeRect (NSMinX (a), NSMinY (i),
+                               NSMinX (i) - NSMinX (a), NSHeight (i));
+    }
+  if (NSMaxX (i) < NSMaxX (a))
+    {
+      parts[n++] = NSMakeRect (NSMaxX (i), NSMinY (i),
+                               NSMaxX (a) - NSMaxX (i), NSHeight (i));
+    }
+  return n;
+}
+
 /*
  * Return the biggest integral (in device space) rect contained in rect. 
  * Conversion to/from device space is done using view.
@@ -110,6 +177,7 @@ static inline NSRect integralRect (NSRect rect, NSView *view)
 
 - (void) dealloc
 {
+  [self setPreparesContent: NO];
   [self setDocumentView: nil];
   RELEASE(_cursor);
   RELEASE(_backgroundColor);
@@ -132,6 +200,7 @@ static inline NSRect integralRect (NSRect rect, NSView *view)
       return;
     }
   
+  [self _discardPreparedContent];
   nc = [NSNotificationCenter defaultCenter];
   if (_documentView)
     {
@@ -209,6 +278,7 @@ static inline NSRect integralRect (NSRect rect, NSView *view)
       [self setNextKeyView: _documentView];
       if (![_documentView nextKeyView])
 	[_documentView setNextKeyView: nextKV];
+      [self _schedulePreparation];
     }
   else
     [self setNextKeyView: nextKV];
@@ -229,6 +299,7 @@ static inline NSRect integralRect (NSRect rect, NSView *view)
 
 - (void) setBounds: (NSRect)b
 {
+  [self _discardPreparedContent];
   [super setBounds: b];
   [self setNeedsDisplay: YES];
   [_super_view reflectScrolledClipView: self];
@@ -236,6 +307,7 @@ static inline NSRect integralRect (NSRect rect, NSView *view)
 
 - (void) setBoundsSize: (NSSize)aSize
 {
+  [self _discardPreparedContent];
   [super setBoundsSize: aSize];
   [self setNeedsDisplay: YES];
   [_super_view reflectScrolledClipView: self];
@@ -287,8 +359,7 @@ static inline NSRect integralRect (NSRect rect, NSView *view)
           // no recyclable part -- docview should redraw everything
           // from scratch
           [super setBoundsOrigin: newBounds.origin];
-          [_documentView setNeedsDisplayInRect: 
-                             [self documentVisibleRect]];
+          [self _exposeRect: _bounds];
         }
       else
         {
@@ -325,9 +396,7 @@ static inline NSRect integralRect (NSRect rect, NSView *view)
                                   _bounds.size.height);
           if (NSIsEmptyRect(redrawRect) == NO)
             {
-              [_documentView setNeedsDisplayInRect: 
-                                 [self convertRect: redrawRect 
-                                       toView: _documentView]];
+              [self _exposeRect: redrawRect];
             }
           
           /* Right */
@@ -336,9 +405,7 @@ static inline NSRect integralRect (NSRect rect, NSView *view)
                                   _bounds.size.height);
           if (NSIsEmptyRect(redrawRect) == NO)
             {
-              [_documentView setNeedsDisplayInRect: 
-                                 [self convertRect: redrawRect 
-                                       toView: _documentView]];
+              [self _exposeRect: redrawRect];
             }
           
           /* Up (or Down according to whether it's flipped or not) */
@@ -347,9 +414,7 @@ static inline NSRect integralRect (NSRect rect, NSView *view)
                                   NSMinY(intersection) - NSMinY(_bounds));
           if (NSIsEmptyRect(redrawRect) == NO)
             {
-              [_documentView setNeedsDisplayInRect: 
-                                 [self convertRect: redrawRect 
-                                       toView: _documentView]];
+              [self _exposeRect: redrawRect];
             }
           
           /* Down (or Up) */
@@ -358,9 +423,7 @@ static inline NSRect integralRect (NSRect rect, NSView *view)
                                   NSMaxY(_bounds) - NSMaxY(intersection));
           if (NSIsEmptyRect(redrawRect) == NO)
             {
-              [_documentView setNeedsDisplayInRect: 
-                                 [self convertRect: redrawRect 
-                                       toView: _documentView]];
+              [self _exposeRect: redrawRect];
             }
         }
     }
@@ -370,6 +433,7 @@ static inline NSRect integralRect (NSRect rect, NSView *view)
       [super setBoundsOrigin: newBounds.origin];
       [_documentView setNeedsDisplayInRect: [self documentVisibleRect]];
     }
+  [self _schedulePreparation];
 
   /* ?? TODO: Understand the following code - and add explanatory comment */
   /*if ([NSView focusView] == _documentView)
@@ -521,6 +585,7 @@ static inline NSRect integralRect (NSRect rect, NSView *view)
 
 - (void) viewBoundsChanged: (NSNotification*)aNotification
 {
+  [self _discardPreparedContent];
   [_super_view reflectScrolledClipView: self];
 }
 
@@ -529,6 +594,7 @@ static inline NSRect integralRect (NSRect rect, NSView *view)
  */
 - (void) viewFrameChanged: (NSNotification*)aNotification
 {
+  [self _discardPreparedContent];
   [self _scrollToPoint: _bounds.origin];
 
   /* If document frame does not completely cover _bounds */
@@ -545,6 +611,7 @@ static inline NSRect integralRect (NSRect rect, NSView *view)
 
 - (void) scaleUnitSquareToSize: (NSSize)newUnitSize
 {
+  [self _discardPreparedContent];
   [super scaleUnitSquareToSize: newUnitSize];
   [_super_view reflectScrolledClipView: self];
 }
@@ -599,6 +666,58 @@ static inline NSRect integralRect (NSRect rect, NSView *view)
   return _copiesOnScroll;
 }
 
+/**<p>Sets whether the NSClipView keeps a pre-rendered copy of the
+   document view around its visible rect.  The copy is filled in when
+   the application is idle, half a page to each side and a full page
+   above and below the visible rect, and areas scrolled into view are
+   copied from it instead of being drawn by the document view.</p>
+   <p>This only applies to document views without subviews, which are
+   neither scaled nor rotated.  Parts of the document view marked as
+   needing display are drawn again before they are used.</p>
+   <p>See Also: -preparesContent [NSView-prepareContentInRect:]</p>
+ */
+- (void) setPreparesContent: (BOOL)flag
+{
+  NSNotificationCenter *nc = [NSNotificationCenter defaultCenter];
+
+  if (_rFlags.prepares_content == flag)
+    {
+      return;
+    }
+  _rFlags.prepares_content = flag;
+  if (flag)
+    {
+      [nc addObserver: self
+             selector: @selector(_prepareContent:)
+                 name: GSClipViewPrepareContentNotification
+               object: self];
+      [self _schedulePreparation];
+    }
+  else
+    {
+      [[NSNotificationQueue defaultQueue]
+        dequeueNotificationsMatching:
+          [NSNotification notificationWithName:
+                            GSClipViewPrepareContentNotification
+                                        object: self]
+                        coalesceMask: NSNotificationCoalescingOnName
+                                      | NSNotificationCoalescingOnSender];
+      [nc removeObserver: self
+                    name: GSClipViewPrepareContentNotification
+                  object: self];
+      [self _discardPreparedContent];
+    }
+}
+
+/**<p>Returns whether the NSClipView keeps a pre-rendered copy of the
+   document view around its visible rect.</p>
+   <p>See Also: -setPreparesContent:</p>
+ */
+- (BOOL) preparesContent
+{
+  return _rFlags.prepares_content;
+}
+
 /**<p>Sets the cursor for the document view to <var>aCursor</var></p>
  <p>See Also: -documentCursor</p>
  */
@@ -636,6 +755,7 @@ static inline NSRect integralRect (NSRect rect, NSView *view)
     {
       ASSIGN (_backgroundColor, aColor);
   
+      [self _discardPreparedContent];
       [self setNeedsDisplay: YES];
     
       if (_drawsBackground == NO || _backgroundColor == nil
@@ -656,6 +776,7 @@ static inline NSRect integralRect (NSRect rect, NSView *view)
     {
       _drawsBackground = flag; 
 
+      [self _discardPreparedContent];
       [self setNeedsDisplay: YES];
 
       if (_drawsBackground == NO || _backgroundColor == nil
@@ -846,5 +967,219 @@ static inline NSRect integralRect (NSRect rect, NSView *view)
   [self scrollToPoint: newBounds.origin]; 
 }
 
+/*
+ * Mark aRect, in our own coordinates, as newly exposed by scrolling.
+ * It is copied from the prepared content when that covers it, otherwise
+ * the document view is asked to draw it.
+ */
+- (void) _exposeRect: (NSRect)aRect
+{
+  if ([self _drawPreparedContentInRect: aRect] == NO)
+    {
+      _exposing = YES;
+      [_documentView setNeedsDisplayInRect:
+                       [self convertRect: aRect toView: _documentView]];
+      _exposing = NO;
+    }
+}
+
+- (BOOL) _canPrepareContent
+{
+  return _rFlags.prepares_content
+    && _documentView != nil
+    && _window != nil && [_window gState] != 0
+    && [[_documentView subviews] count] == 0
+    && [self isRotatedOrScaledFromBase] == NO
+    && [_documentView isRotatedOrScaledFromBase] == NO;
+}
+
+- (void) _schedulePreparation
+{
+  if ([self _canPrepareContent] == NO)
+    {
+      return;
+    }
+  [[NSNotificationQueue defaultQueue]
+    enqueueNotification:
+      [NSNotification notificationWithName:
+                        GSClipViewPrepareContentNotification
+                                    object: self]
+           postingStyle: NSPostWhenIdle
+           coalesceMask: NSNotificationCoalescingOnName
+                         | NSNotificationCoalescingOnSender
+               forModes: nil];
+}
+
+/*
+ * Bring the prepared content up to date with the current visible rect.
+ * Whatever is still valid is moved within the cache and only the new
+ * and stale parts are drawn by the document view.
+ */
+- (void) _prepareContent: (NSNotification *)aNotification
+{
+  NSRect visible;
+  NSRect want;
+  NSRect ready;
+  NSRect keep;
+  NSRect parts[4];
+  GSPreparedContentView *cacheView;
+  BOOL flipped;
+  int count;
+  int i;
+
+  if ([self _canPrepareContent] == NO)
+    {
+      [self _discardPreparedContent];
+      return;
+    }
+
+  visible = [self documentVisibleRect];
+  want = NSIntegralRect (NSInsetRect (visible,
+                                      -NSWidth (visible) / 2,
+                                      -NSHeight (visible)));
+  flipped = [_documentView isFlipped];
+
+  cacheView = [[_preparedContent window] contentView];
+  if (_preparedContent == nil
+      || NSEqualSizes ([_preparedContent size], want.size) == NO
+      || cacheView->flipped != flipped)
+    {
+      NSRect cacheRect = NSMakeRect (0, 0, NSWidth (want), NSHeight (want));
+
+      [self _discardPreparedContent];
+      _preparedContent = [[NSCachedImageRep alloc] initWithWindow: nil
+                                                             rect: cacheRect];
+      cacheView = [[GSPreparedContentView alloc] initWithFrame: cacheRect];
+      cacheView->flipped = flipped;
+      [[_preparedContent window] setContentView: cacheView];
+      RELEASE (cacheView);
+    }
+
+  [_documentView prepareContentInRect: want];
+  ready = NSIntersectionRect (want, [_documentView preparedContentRect]);
+  ready = NSIntersectionRect (ready, [_documentView bounds]);
+
+  /* Move the part we already have to its new place in the cache */
+  keep = NSIntersectionRect (_preparedRect, ready);
+  if (NSIsEmptyRect (keep) == NO
+      && NSEqualPoints (_preparedOrigin, want.origin) == NO)
+    {
+      NSRect src = NSOffsetRect (keep, -_preparedOrigin.x,
+                                 -_preparedOrigin.y);
+      NSPoint dest = NSMakePoint (NSMinX (keep) - NSMinX (want),
+                                  NSMinY (keep) - NSMinY (want));
+
+      if (flipped)
+        {
+          dest.y += NSHeight (keep);
+        }
+      [cacheView lockFocus];
+      NSCopyBits ([[_preparedContent window] gState],
+                  [cacheView convertRect: src toView: nil], dest);
+      [cacheView unlockFocus];
+    }
+  _preparedOrigin = want.origin;
+
+  count = subtractRect (ready, keep, parts);
+  for (i = 0; i < count; i++)
+    {
+      [self _renderPreparedContentInRect: parts[i]];
+    }
+  keep = NSIntersectionRect (keep, _staleRect);
+  if (NSIsEmptyRect (keep) == NO)
+    {
+      [self _renderPreparedContentInRect: keep];
+    }
+
+  _preparedRect = ready;
+  _staleRect = NSZeroRect;
+}
+
+/*
+ * Draw aRect, in document view coordinates, into the prepared content.
+ */
+- (void) _renderPreparedContentInRect: (NSRect)aRect
+{
+  NSView *cacheView = [[_preparedContent window] contentView];
+
+  [cacheView lockFocus];
+  NSRectClip (NSOffsetRect (aRect, -_preparedOrigin.x, -_preparedOrigin.y));
+  PStranslate (-_preparedOrigin.x, -_preparedOrigin.y);
+  if (_drawsBackground)
+    {
+      [_backgroundColor set];
+      NSRectFill (aRect);
+    }
+  [_documentView drawRect: aRect];
+  [cacheView unlockFocus];
+}
+
+/*
+ * Copy aRect, in our own coordinates, from the prepared content.
+ * Returns NO if the prepared content does not cover it.
+ */
+- (BOOL) _drawPreparedContentInRect: (NSRect)aRect
+{
+  NSView *cacheView;
+  NSRect docRect;
+  NSRect src;
+  NSPoint dest;
+
+  if (_preparedContent == nil || [self _canPrepareContent] == NO)
+    {
+      return NO;
+    }
+  docRect = [self convertRect: aRect toView: _documentView];
+  if (NSContainsRect (_preparedRect, docRect) == NO
+      || NSIntersectsRect (_staleRect, docRect))
+    {
+      return NO;
+    }
+
+  cacheView = [[_preparedContent window] contentView];
+  src = NSOffsetRect (docRect, -_preparedOrigin.x, -_preparedOrigin.y);
+  dest = aRect.origin;
+  if ([self isFlipped])
+    {
+      dest.y += aRect.size.height;
+    }
+  [self lockFocus];
+  NSCopyBits ([[_preparedContent window] gState],
+              [cacheView convertRect: src toView: nil], dest);
+  [self unlockFocus];
+  return YES;
+}
+
+- (void) _discardPreparedContent
+{
+  DESTROY (_preparedContent);
+  _preparedRect = NSZeroRect;
+  _staleRect = NSZeroRect;
+}
+
+@end
+
+@implementation NSClipView (GSPreparedContent)
+
+/*
+ * Called when part of the document view is marked as needing display,
+ * so that the matching part of the prepared content is drawn again
+ * before it is used.
+ */
+- (void) _documentViewNeedsDisplayInRect: (NSRect)rect
+{
+  if (_exposing || _preparedContent == nil)
+    {
+      return;
+    }
+  rect = NSIntersectionRect (rect, _preparedRect);
+  if (NSIsEmptyRect (rect) == NO)
+    {
+      _staleRect = NSIsEmptyRect (_staleRect)
+        ? rect : NSUnionRect (_staleRect, rect);
+      [self _schedulePreparation];
+    }
+}
+
 @end
 
@@ -63,6 +63,8 @@ static NSString *placeholderItem = nil;
 - (void) _initDefaults;
 - (void) _resetItemSize;
 - (void) _removeItemsViews;
+- (NSRange) _itemRangeInRect: (NSRect)aRect;
+- (void) _recycleItemsOutsideRange: (NSRange)aRange;
 - (NSInteger) _indexAtPoint: (NSPoint)point;
 
 - (NSRect) _frameForRowOfItemAtIndex: (NSUInteger)theIndex;
@@ -120,6 +122,8 @@ static NSString *placeholderItem = nil;
   [self _resetItemSize];
   _content = [[NSArray alloc] init];
   _items = [[NSMutableArray alloc] init];
+  _loadedIndexes = [[NSMutableIndexSet alloc] init];
+  _reusableItems = [[NSMutableArray alloc] init];
   _selectionIndexes = [[NSIndexSet alloc] init];
   _draggingOnIndex = NSNotFound;
 }
@@ -152,18 +156,26 @@ static NSString *placeholderItem = nil;
       NSRectFill(dirtyRect);
     }
 
-  NSPoint origin = dirtyRect.origin;
-  NSSize size = dirtyRect.size;
-  NSPoint oppositeOrigin = NSMakePoint (origin.x + size.width, origin.y + size.height);
-  
-  NSInteger firstIndexInRect = MAX(0, [self _indexAtPoint: origin]);
-  // I had to extract these values from the macro to get it
-  // working correctly.
-  NSInteger index = [self _indexAtPoint: oppositeOrigin];
-  NSInteger last = [_items count] - 1;
-  NSInteger lastIndexInRect = MIN(last, index);
-
-  for (index = firstIndexInRect; index <= lastIndexInRect; index++)
+  NSRange range;
+  NSUInteger index;
+
+  if (_reusesItems)
+    {
+      /* Keep items for half a page above and below the visible rect,
+         so that they are ready when scrolled into view, and recycle
+         all others. */
+      NSRect visible = [self visibleRect];
+
+      range = [self _itemRangeInRect:
+                      NSInsetRect (visible, 0, -NSHeight (visible) / 2)];
+      [self _recycleItemsOutsideRange: range];
+    }
+  else
+    {
+      range = [self _itemRangeInRect: dirtyRect];
+    }
+
+  for (index = range.location; index < NSMaxRange(range); index++)
     {
       // Calling itemAtIndex: will eventually instantiate the collection view item,
       // if it hasn't been done already.
@@ -185,6 +197,8 @@ static NSString *placeholderItem = nil;
   DESTROY (_backgroundColors);
   DESTROY (_selectionIndexes);
   DESTROY (_items);
+  DESTROY (_loadedIndexes);
+  DESTROY (_reusableItems);
   //DESTROY (_mouseDownEvent);
   [super dealloc];
 }
@@ -267,6 +281,7 @@ static NSString *placeholderItem = nil;
 - (void) setItemPrototype: (NSCollectionViewItem *)prototype
 {
   ASSIGN(itemPrototype, prototype);
+  [_reusableItems removeAllObjects];
   [self _resetItemSize];
 }
 
@@ -342,8 +357,10 @@ static NSString *placeholderItem = nil;
   _isSelectable = flag;
   if (!_isSelectable)
     {
-      NSInteger index = -1;
-      while ((index = [_selectionIndexes indexGreaterThanIndex: index]) != NSNotFound)
+      NSUInteger index = [_selectionIndexes firstIndex];
+
+      for (; index != NSNotFound;
+           index = [_selectionIndexes indexGreaterThanIndex: index])
         {
           id item = [_items objectAtIndex: index];
           if ([item respondsToSelector: @selector(setSelected:)])
@@ -371,78 +388,56 @@ static NSString *placeholderItem = nil;
       ASSIGN(_selectionIndexes, indexes);
     }
   
-  NSUInteger index = 0;
-  while (index < [_items count])
+  /* Only instantiated items need updating, the others pick up their
+     state in -itemAtIndex:. */
+  NSUInteger index = [_loadedIndexes firstIndex];
+  while (index != NSNotFound)
     {
-      id item = [_items objectAtIndex: index];
-      if ([item respondsToSelector: @selector(setSelected:)])
-        {
-          [item setSelected:NO];
-        }
-      index++;
-    }
-  
-  index = -1;
-  while ((index = [_selectionIndexes indexGreaterThanIndex: index]) != 
-         NSNotFound)
-    {
-      id item = [_items objectAtIndex: index];
-      if ([item respondsToSelector: @selector(setSelected:)])
-        {
-          [item setSelected: YES];
-        }
+      [[_items objectAtIndex: index]
+        setSelected: [_selectionIndexes containsIndex: index]];
+      index = [_loadedIndexes indexGreaterThanIndex: index];
     }
 }
 
 - (NSRect) frameForItemAtIndex: (NSUInteger)theIndex
 {
-  NSRect itemFrame = NSMakeRect (0,0,0,0);
-  NSInteger index;
   NSUInteger count = [_items count];
-  CGFloat x = _horizontalMargin;
-  CGFloat y = -_itemSize.height;
+  NSUInteger columns = MAX(1, _numberOfColumns);
+  NSUInteger row;
+  NSUInteger column;
+  NSInteger draggingOffset = 0;
+  CGFloat x;
+  CGFloat y;
   
   if (_maxNumberOfColumns > 0 && _maxNumberOfRows > 0)
     {
       count = MIN(count, _maxNumberOfColumns * _maxNumberOfRows);
     }
+  if (theIndex >= count)
+    {
+      return NSMakeRect (0,0,0,0);
+    }
+
+  /* The items form a regular grid, so the frame follows from the row
+     and column. */
+  row = theIndex / columns;
+  column = theIndex % columns;
+  x = _horizontalMargin + column * (_itemSize.width + _horizontalMargin);
+  y = _verticalMargin + row * (_itemSize.height + _verticalMargin);
 
-  for (index = 0; index < count; ++index)
+  if (_draggingOnIndex != NSNotFound
+      && _draggingOnIndex / columns == row)
     {
-      if (index % _numberOfColumns == 0)
+      if (theIndex < _draggingOnIndex)
         {
-          x = _horizontalMargin;
-          y += _verticalMargin + _itemSize.height;
+          draggingOffset = -20;
         }
-      
-      if (index == theIndex)
+      else
         {
-          NSInteger draggingOffset = 0;
-
-          if (_draggingOnIndex != NSNotFound)
-            {
-              NSInteger draggingOnRow = (_draggingOnIndex / _numberOfColumns);
-              NSInteger currentIndexRow = (theIndex / _numberOfColumns);
-
-              if (draggingOnRow == currentIndexRow)
-                {
-                  if (index < _draggingOnIndex)
-                    {
-                      draggingOffset = -20;
-                    }
-                  else
-                    {
-                      draggingOffset = 20;
-                    }
-                }
-            }
-          itemFrame = NSMakeRect ((x + draggingOffset), y, _itemSize.width, _itemSize.height);
-          break;
+          draggingOffset = 20;
         }
-      
-      x += _itemSize.width + _horizontalMargin;
     }
-  return itemFrame;
+  return NSMakeRect ((x + draggingOffset), y, _itemSize.width, _itemSize.height);
 }
 
 - (NSRect) _frameForRowOfItemAtIndex: (NSUInteger)theIndex
@@ -468,12 +463,21 @@ static NSString *placeholderItem = nil;
 
   if (item == placeholderItem)
     {
-      item = [self newItemForRepresentedObject: [_content objectAtIndex: index]];
-      [_items replaceObjectAtIndex: index withObject: item];
-      if ([[self selectionIndexes] containsIndex: index])
+      id object = [_content objectAtIndex: index];
+
+      if ([_reusableItems count] > 0)
+        {
+          item = RETAIN([_reusableItems lastObject]);
+          [_reusableItems removeLastObject];
+          [item setRepresentedObject: object];
+        }
+      else
         {
-          [item setSelected: YES];
+          item = [self newItemForRepresentedObject: object];
         }
+      [_items replaceObjectAtIndex: index withObject: item];
+      [_loadedIndexes addIndex: index];
+      [item setSelected: [[self selectionIndexes] containsIndex: index]];
       [self addSubview: [item view]];
       RELEASE(item);
     }
@@ -496,18 +500,71 @@ static NSString *placeholderItem = nil;
   if (!_items)
     return;
   
-  NSUInteger count = [_items count];
+  NSUInteger index = [_loadedIndexes firstIndex];
   
-  while (count--)
+  while (index != NSNotFound)
     {
-      id item = [_items objectAtIndex: count];
+      id item = [_items objectAtIndex: index];
 
-      if ([item respondsToSelector: @selector(view)])
+      [[item view] removeFromSuperview];
+      [item setSelected: NO];
+      index = [_loadedIndexes indexGreaterThanIndex: index];
+    }
+  [_loadedIndexes removeAllIndexes];
+}
+
+/*
+ * Returns the range of indexes of the items in the rows crossing aRect.
+ */
+- (NSRange) _itemRangeInRect: (NSRect)aRect
+{
+  NSUInteger count = [_items count];
+  NSUInteger columns = MAX(1, _numberOfColumns);
+  CGFloat rowHeight = _itemSize.height + _verticalMargin;
+  NSUInteger first;
+  NSUInteger last;
+
+  if (_maxNumberOfColumns > 0 && _maxNumberOfRows > 0)
+    {
+      count = MIN(count, _maxNumberOfColumns * _maxNumberOfRows);
+    }
+  if (count == 0 || rowHeight <= 0 || NSIsEmptyRect(aRect))
+    {
+      return NSMakeRange(0, 0);
+    }
+
+  first = (NSUInteger)MAX(0, floor(NSMinY(aRect) / rowHeight)) * columns;
+  last = (NSUInteger)MAX(0, floor(NSMaxY(aRect) / rowHeight) + 1) * columns;
+  first = MIN(first, count);
+  last = MIN(last, count);
+  return NSMakeRange(first, last - first);
+}
+
+/*
+ * Take the views of items outside aRange out of the view hierarchy and
+ * keep enough of the items to fill aRange again when scrolling.
+ */
+- (void) _recycleItemsOutsideRange: (NSRange)aRange
+{
+  NSMutableIndexSet *outside = [_loadedIndexes mutableCopy];
+  NSUInteger index;
+
+  [outside removeIndexesInRange: aRange];
+  for (index = [outside firstIndex]; index != NSNotFound;
+       index = [outside indexGreaterThanIndex: index])
+    {
+      id item = [_items objectAtIndex: index];
+
+      [[item view] removeFromSuperview];
+      [item setSelected: NO];
+      if ([_reusableItems count] < aRange.length)
         {
-          [[item view] removeFromSuperview];
-          [item setSelected: NO];
+          [_reusableItems addObject: item];
         }
+      [_items replaceObjectAtIndex: index withObject: placeholderItem];
     }
+  [_loadedIndexes removeIndexes: outside];
+  RELEASE(outside);
 }
 
 - (void) tile
@@ -555,7 +612,6 @@ static NSString *placeholderItem = nil;
       _itemSize = itemSize;
     }
   
-  NSInteger index;
   NSUInteger count = [_items count];
   
   if (_maxNumberOfColumns > 0 && _maxNumberOfRows > 0)
@@ -565,18 +621,11 @@ static NSString *placeholderItem = nil;
 
   _horizontalMargin = floor((width - _numberOfColumns * itemSize.width) / 
                             (_numberOfColumns + 1));
-  CGFloat y = -itemSize.height;
-  
-  for (index = 0; index < count; ++index)
-    {
-      if (index % _numberOfColumns == 0)
-        {
-          y += _verticalMargin + itemSize.height;
-        }
-    }
-  
+
+  NSUInteger rows = (count + _numberOfColumns - 1) / _numberOfColumns;
   id superview = [self superview];
-  CGFloat proposedHeight = y + itemSize.height + _verticalMargin;
+  CGFloat proposedHeight = rows * (itemSize.height + _verticalMargin)
+    + _verticalMargin;
   if ([superview isKindOfClass: [NSClipView class]])
     {
       NSSize superviewSize = [superview bounds].size;
@@ -588,6 +637,31 @@ static NSString *placeholderItem = nil;
   [self setNeedsDisplay: YES];
 }
 
+/**
+ * Returns whether the receiver recycles items.  See -setReusesItems:.
+ */
+- (BOOL) reusesItems
+{
+  return _reusesItems;
+}
+
+/**
+ * Sets whether the receiver only keeps items for the visible part of its
+ * content.  When flag is YES, items scrolled well out of view are taken
+ * out of the view hierarchy and set up for other represented objects
+ * instead of copying the item prototype again.  Item views must then not
+ * keep state which does not come from their represented object.
+ */
+- (void) setReusesItems: (BOOL)flag
+{
+  _reusesItems = flag;
+  if (!flag)
+    {
+      [_reusableItems removeAllObjects];
+    }
+  [self setNeedsDisplay: YES];
+}
+
 - (void) resizeSubviewsWithOldSize: (NSSize)aSize
 {
   NSSize currentSize = [self frame].size;
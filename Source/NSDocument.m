@@ -33,6 +33,7 @@
 #import <Foundation/NSException.h>
 #import <Foundation/NSFileManager.h>
 #import <Foundation/NSNotification.h>
+#import <Foundation/NSOperation.h>
 #import <Foundation/NSProcessInfo.h>
 #import <Foundation/NSUndoManager.h>
 #import <Foundation/NSURL.h>
@@ -49,6 +50,36 @@
 
 #import "GSGuiPrivate.h"
 
+/* Writes the data of a snapshot taken for a concurrent autosave in the
+ * background and reports back to the document on the main thread.
+ */
+@interface GSDocumentAutosaveOperation : NSOperation
+{
+@public
+  NSDocument    *document;
+  id            snapshot;
+  NSURL         *url;
+  NSString      *type;
+  NSDictionary  *attributes;
+  id            delegate;
+  SEL           selector;
+  void          *contextInfo;
+  BOOL          saved;
+  NSError       *error;
+}
+@end
+
+@interface NSDocument (GSConcurrentAutosave)
+- (void) _autosaveConcurrentlyToURL: (NSURL *)url
+                             ofType: (NSString *)type
+                           delegate: (id)delegate
+                didAutosaveSelector: (SEL)didAutosaveSelector
+                        contextInfo: (void *)context;
+- (void) _autosaveOperationDidFinish: (GSDocumentAutosaveOperation *)op;
+@end
+
+static NSOperationQueue *autosaveQueue = nil;
+
 static inline NSError*
 create_error(int code, NSString* desc)
 {
@@ -59,6 +90,20 @@ create_error(int code, NSString* desc)
                                 NSLocalizedDescriptionKey, nil]];
 }
 
+static void
+notify_did_save(id delegate, SEL didSaveSelector, NSDocument *doc,
+                BOOL saved, void *contextInfo)
+{
+  if (delegate != nil && didSaveSelector != NULL)
+    {
+      void (*meth)(id, SEL, id, BOOL, void*);
+      meth = (void (*)(id, SEL, id, BOOL, void*))[delegate methodForSelector: 
+                                                               didSaveSelector];
+      if (meth)
+        meth(delegate, didSaveSelector, doc, saved, contextInfo);
+    }
+}
+
 @implementation NSDocument
 
 + (NSArray *) readableTypes
@@ -235,6 +280,7 @@ withContentsOfURL: (NSURL *)url
   RELEASE(_save_panel_accessory);
   RELEASE(_spa_button);
   RELEASE(_save_type);
+  RELEASE(_autosave_operation);
   [super dealloc];
 }
 
@@ -438,6 +484,13 @@ withContentsOfURL: (NSURL *)url
   int i, count = [_window_controllers count];
   BOOL isEdited;
   
+  /* Changes made while a concurrent autosave is writing a snapshot are
+   * not part of the autosaved file. */
+  if (_autosave_operation != nil && change != NSChangeAutosaved)
+    {
+      _doc_flags.autosave_changed = 1;
+    }
+
   switch (change)
     {
     case NSChangeDone:          _change_count++; 
@@ -1675,14 +1728,7 @@ originalContentsURL: (NSURL *)orig
 	noteNewRecentDocument: self];
     }
 
-  if (delegate != nil && didSaveSelector != NULL)
-    {
-      void (*meth)(id, SEL, id, BOOL, void*);
-      meth = (void (*)(id, SEL, id, BOOL, void*))[delegate methodForSelector: 
-                                                               didSaveSelector];
-      if (meth)
-        meth(delegate, didSaveSelector, self, saved, contextInfo);
-    }
+  notify_did_save(delegate, didSaveSelector, self, saved, contextInfo);
 }
 
 - (IBAction) revertDocumentToSaved: (id)sender
@@ -1873,6 +1919,19 @@ originalContentsURL: (NSURL *)orig
       url = [NSURL fileURLWithPath: path];
     }
 
+  if ([url isFileURL]
+      && [self canAsynchronouslyWriteToURL: url
+               ofType: type
+               forSaveOperation: NSAutosaveOperation])
+    {
+      [self _autosaveConcurrentlyToURL: url
+            ofType: type
+            delegate: delegate
+            didAutosaveSelector: didAutosaveSelector
+            contextInfo: context];
+      return;
+    }
+
   [self saveToURL: url
         ofType: type
         forSaveOperation: NSAutosaveOperation
@@ -1891,6 +1950,209 @@ originalContentsURL: (NSURL *)orig
   return _autosave_change_count != 0 || _doc_flags.autosave_permanently_modified;
 }
 
+/** Returns whether the document can be written to url in the
+ * background.  The default implementation returns NO.
+ * <p>GNUstep uses this for autosaving only.  When a subclass returns YES,
+ * an autosave takes a snapshot of the document with -snapshotOfType:error:
+ * on the main thread, and then encodes it with
+ * -dataOfSnapshot:ofType:error: and writes it to a temporary file, which
+ * replaces the autosaved file, on a background thread.  The document can
+ * be edited while this is done, and the delegate is told about the outcome
+ * on the main thread.  This is done in place of
+ * -writeSafelyToURL:ofType:forSaveOperation:error:, so subclasses
+ * overriding that method or the methods it calls should not return YES.
+ * </p>
+ */
+- (BOOL) canAsynchronouslyWriteToURL: (NSURL *)url
+                              ofType: (NSString *)type
+                    forSaveOperation: (NSSaveOperationType)op
+{
+  return NO;
+}
+
+@end
+
+@implementation NSDocument (GNUstepExtensions)
+
+- (id) snapshotOfType: (NSString *)type error: (NSError **)error
+{
+  return [self dataOfType: type error: error];
+}
+
+- (NSData *) dataOfSnapshot: (id)snapshot
+                     ofType: (NSString *)type
+                      error: (NSError **)error
+{
+  if ([snapshot isKindOfClass: [NSData class]])
+    {
+      return snapshot;
+    }
+  if (error)
+    {
+      *error = create_error(0, NSLocalizedString(@"Could not write file.",
+                                                 @"Error description"));
+    }
+  return nil;
+}
+
+@end
+
+@implementation NSDocument (GSConcurrentAutosave)
+
+- (void) _autosaveConcurrentlyToURL: (NSURL *)url
+                             ofType: (NSString *)type
+                           delegate: (id)delegate
+                didAutosaveSelector: (SEL)didAutosaveSelector
+                        contextInfo: (void *)context
+{
+  GSDocumentAutosaveOperation *op;
+  NSError *error = nil;
+  NSDictionary *attrs;
+  id snapshot;
+
+  /* The next autosave picks up any changes made while a snapshot is
+   * being written. */
+  if (_autosave_operation != nil)
+    {
+      notify_did_save(delegate, didAutosaveSelector, self, NO, context);
+      return;
+    }
+
+  snapshot = [self snapshotOfType: type error: &error];
+  if (snapshot == nil)
+    {
+      if (error != nil)
+        {
+          [self presentError: error];
+        }
+      notify_did_save(delegate, didAutosaveSelector, self, NO, context);
+      return;
+    }
+  attrs = [self fileAttributesToWriteToURL: url
+                ofType: type 
+                forSaveOperation: NSAutosaveOperation
+                originalContentsURL: [self fileURL]
+                error: &error];
+
+  if (autosaveQueue == nil)
+    {
+      // Write one document at a time, so autosaves do not compete for the disk.
+      autosaveQueue = [NSOperationQueue new];
+      [autosaveQueue setMaxConcurrentOperationCount: 1];
+    }
+
+  op = [GSDocumentAutosaveOperation new];
+  ASSIGN(op->document, self);
+  ASSIGN(op->snapshot, snapshot);
+  ASSIGN(op->url, url);
+  ASSIGN(op->type, type);
+  ASSIGN(op->attributes, attrs);
+  ASSIGN(op->delegate, delegate);
+  op->selector = didAutosaveSelector;
+  op->contextInfo = context;
+
+  _autosave_operation = op;
+  _doc_flags.autosave_changed = 0;
+  [autosaveQueue addOperation: op];
+}
+
+- (void) _autosaveOperationDidFinish: (GSDocumentAutosaveOperation *)op
+{
+  BOOL saved = op->saved;
+
+  if ([op isCancelled])
+    {
+      /* The document was saved or closed while the snapshot was written,
+       * so the file is out of date. */
+      if (saved && ![op->url isEqual: [self autosavedContentsFileURL]])
+        {
+          [[NSFileManager defaultManager] removeFileAtPath: [op->url path]
+                                                   handler: nil];
+        }
+      saved = NO;
+    }
+  else if (saved)
+    {
+      [self setAutosavedContentsFileURL: op->url];
+      if (_doc_flags.autosave_changed == 0)
+        {
+          [self updateChangeCount: NSChangeAutosaved];
+        }
+    }
+  else if (op->error != nil)
+    {
+      [self presentError: op->error];
+    }
+
+  _doc_flags.autosave_changed = 0;
+  if (op == _autosave_operation)
+    {
+      _autosave_operation = nil;
+      AUTORELEASE(op);
+    }
+  notify_did_save(op->delegate, op->selector, self, saved, op->contextInfo);
+}
+
+@end
+
+@implementation GSDocumentAutosaveOperation
+
+- (void) dealloc
+{
+  RELEASE(document);
+  RELEASE(snapshot);
+  RELEASE(url);
+  RELEASE(type);
+  RELEASE(attributes);
+  RELEASE(delegate);
+  RELEASE(error);
+  [super dealloc];
+}
+
+- (void) main
+{
+  CREATE_AUTORELEASE_POOL(pool);
+  NSError *err = nil;
+  NSData *data;
+
+  if (![self isCancelled])
+    {
+      data = [document dataOfSnapshot: snapshot ofType: type error: &err];
+      // The snapshot may be large, so do not keep it around.
+      DESTROY(snapshot);
+
+      // Written to a temporary file which is then renamed.
+      if (data != nil && [data writeToFile: [url path] atomically: YES])
+        {
+          if (attributes != nil)
+            {
+              [[NSFileManager defaultManager]
+                changeFileAttributes: attributes atPath: [url path]];
+            }
+          saved = YES;
+        }
+      else if (err == nil)
+        {
+          err = create_error(0, NSLocalizedString(@"Could not write file.",
+                                                  @"Error description"));
+        }
+      if (!saved)
+        {
+          ASSIGN(error, err);
+        }
+    }
+
+  [self performSelectorOnMainThread: @selector(_finish)
+                         withObject: nil
+                      waitUntilDone: NO];
+  RELEASE(pool);
+}
+
+- (void) _finish
+{
+  [document _autosaveOperationDidFinish: self];
+}
+
 @end
 
 @implementation NSDocument(Private)
@@ -1928,6 +2190,7 @@ originalContentsURL: (NSURL *)orig
 {
   NSURL *url = [self autosavedContentsFileURL];
 
+  [_autosave_operation cancel];
   if (url)
     {
       NSString *path = [[url path] retain];
@@ -148,33 +148,13 @@ static Class         fontPanelClass = Nil;
 
 - (NSArray*) availableFontNamesWithTraits: (NSFontTraitMask)fontTraitMask
 {
-  unsigned int i, j;
-  NSArray *fontFamilies = [self availableFontFamilies];
-  NSMutableArray *fontNames = [NSMutableArray array];
-  NSFontTraitMask traits;
-
   if (fontTraitMask == (NSUnitalicFontMask | NSUnboldFontMask))
     {
       fontTraitMask = 0;
     }
 
-  for (i = 0; i < [fontFamilies count]; i++)
-    {
-      NSArray *fontDefs = [self availableMembersOfFontFamily: 
-                                 [fontFamilies objectAtIndex: i]];
-      
-      for (j = 0; j < [fontDefs count]; j++)
-        {
-          NSArray *fontDef = [fontDefs objectAtIndex: j];
-
-          traits = [[fontDef objectAtIndex: 3] unsignedIntValue];
-          // Check if the font has exactly the given mask
-          if (traits == fontTraitMask)
-            [fontNames addObject: [fontDef objectAtIndex: 0]];
-        }
-    }
-
-  return fontNames;
+  // Fonts with exactly the given mask
+  return [_fontEnumerator availableFontNamesWithTraits: fontTraitMask];
 }
 
 - (NSArray*) availableMembersOfFontFamily: (NSString*)family
@@ -720,28 +700,24 @@ static Class         fontPanelClass = Nil;
                     weight: (int)weight
                       size: (float)size
 {
-  NSArray *fontDefs = [self availableMembersOfFontFamily: family];
+  NSArray *fontDefs;
+  NSString *fontName;
   unsigned int i;
 
   //NSLog(@"Searching font %@: %i: %i size %.0f", family, weight, traits, size);
 
   // First do an exact match search
-  for (i = 0; i < [fontDefs count]; i++)
+  fontName = [_fontEnumerator fontNameForFamily: family
+                                         weight: weight
+                                         traits: traits];
+  if (fontName != nil)
     {
-      NSArray *fontDef = [fontDefs objectAtIndex: i];
-
-      //NSLog(@"Testing font %@: %i: %i", [fontDef objectAtIndex: 0], 
-      //          [[fontDef objectAtIndex: 2] intValue], 
-      //          [[fontDef objectAtIndex: 3] unsignedIntValue]);  
-      if (([[fontDef objectAtIndex: 2] intValue] == weight) &&
-          ([[fontDef objectAtIndex: 3] unsignedIntValue] == traits))
-        {
-            //NSLog(@"Found font");
-          return [NSFont fontWithName: [fontDef objectAtIndex: 0] 
-                         size: size];
-        }
+      //NSLog(@"Found font");
+      return [NSFont fontWithName: fontName size: size];
     }
 
+  fontDefs = [self availableMembersOfFontFamily: family];
+
   // Try to find something close by ignoring some trait flags
   traits &= ~(NSNonStandardCharacterSetFontMask | NSFixedPitchFontMask
               | NSUnitalicFontMask | NSUnboldFontMask);
@@ -823,36 +799,18 @@ static Class         fontPanelClass = Nil;
 - (BOOL) fontNamed: (NSString*)typeface 
          hasTraits: (NSFontTraitMask)fontTraitMask
 {
-  // TODO: This method is implemented very slow, but I dont 
-  // see any use for it, so why change it?
-  unsigned int i, j;
-  NSArray *fontFamilies = [self availableFontFamilies];
+  NSFontDescriptor *fd;
   NSFontTraitMask traits;
-  
-  for (i = 0; i < [fontFamilies count]; i++)
+
+  fd = [_fontEnumerator fontDescriptorForFontName: typeface];
+  if (fd == nil)
     {
-      NSArray *fontDefs = [self availableMembersOfFontFamily: 
-                                  [fontFamilies objectAtIndex: i]];
-      
-      for (j = 0; j < [fontDefs count]; j++)
-        {
-          NSArray *fontDef = [fontDefs objectAtIndex: j];
-          
-          if ([[fontDef objectAtIndex: 0] isEqualToString: typeface])
-            {
-              traits = [[fontDef objectAtIndex: 3] unsignedIntValue];
-              // FIXME: This is not exactly the right condition
-              if ((traits & fontTraitMask) == fontTraitMask)
-                {
-                  return YES;
-                }
-              else
-                return NO;
-            }
-        }
+      return NO;
     }
-  
-  return NO;
+
+  traits = [fd symbolicTraits];
+  // FIXME: This is not exactly the right condition
+  return ((traits & fontTraitMask) == fontTraitMask);
 }
 
 /**<p>Returns whether the NSFontPanel is enabled ( if exists )</p> 
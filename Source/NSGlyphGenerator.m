@@ -111,7 +111,9 @@ fb04 'ffl'
   SEL cim_sel = @selector(characterIsMember:);
   BOOL (*characterIsMember)(id, SEL, unichar)
     = (BOOL(*)(id, SEL, unichar)) [cs methodForSelector: cim_sel];
-  SEL gfc_sel = @selector(glyphForCharacter:);
+  // Go through the font's cache, the ligature probes ask for the same
+  // characters over and over
+  SEL gfc_sel = @selector(cachedGlyphForCharacter:);
   NSGlyph (*glyphForCharacter)(id, SEL, unichar);
   NSGlyph fallback = NSNullGlyph;
 
@@ -269,13 +271,16 @@ fb04 'ffl'
             }
         }
 
-      // No glyph found add fallback
+      /* No glyph found add fallback. Characters which no font of the
+         run covers only end up here when the text storage could not
+         substitute a font for them, see -fixFontAttributeInRange:. */
       if (fallback == NSNullGlyph)
         {
-          // FIXME: Find a suitable fallback glyph
-            unichar uc = '?';
-            
-            fallback = glyphForCharacter(fi, gfc_sel, uc);
+          fallback = glyphForCharacter(fi, gfc_sel, 0xfffd);
+          if (fallback == NSNullGlyph)
+            {
+              fallback = glyphForCharacter(fi, gfc_sel, '?');
+            }
         }
       *g = fallback;
       g++;
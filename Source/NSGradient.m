@@ -29,25 +29,264 @@
    Boston, MA 02110-1301, USA.
 */ 
 
+#import <Foundation/NSAffineTransform.h>
 #import <Foundation/NSException.h>
 #import "AppKit/NSBezierPath.h"
+#import "AppKit/NSBitmapImageRep.h"
 #import "AppKit/NSColor.h"
 #import "AppKit/NSColorSpace.h"
 #import "AppKit/NSGradient.h"
+#import "AppKit/NSGraphics.h"
 #import "AppKit/NSGraphicsContext.h"
 
 #include <math.h>
+#include <stdint.h>
 
 #ifndef PI
 #define PI 3.1415926535897932384626434
 #endif
 
+/* Number of entries in the colour ramp of a gradient. */
+#define RAMP_SIZE 1024
+
+/* Fills of more pixels than this are left to the backend. */
+#define MAX_PIXELS (1024 * 1024)
+
+/*
+ * Lookup table of a gradient, built the first time it is needed.  The
+ * colour stops are converted once to the colour space of the gradient,
+ * where colours get interpolated.  The ramp holds the colour at evenly
+ * spaced locations from 0.0 to 1.0 as premultiplied RGBA pixels, which
+ * are copied straight into the bitmaps gradients get rasterised into.
+ * The last such bitmap is kept, as gradients are usually redrawn with
+ * the same size over and over.
+ */
+typedef struct {
+  NSColorSpace          *space;
+  NSColorSpaceModel     model;
+  NSUInteger            count;          // components per stop, with alpha
+  CGFloat               *components;
+  uint32_t              ramp[RAMP_SIZE];
+  NSBitmapImageRep      *rep;
+  NSSize                repSize;
+  NSPoint               repKey;
+  BOOL                  repRadial;
+} gradient_lut_t;
+
 @interface NSGradient (Private)
+- (gradient_lut_t *) _lut;
+- (BOOL) _fillRect: (NSRect)rect
+             start: (NSPoint)start
+               end: (NSPoint)end
+            radius: (CGFloat)radius
+            radial: (BOOL)radial
+               key: (NSPoint)key;
 - (void) _drawInRect: (NSRect)rect angle: (CGFloat)angle;
 - (void) _drawInRect: (NSRect)rect 
 relativeCenterPosition: (NSPoint)relativeCenterPoint;
 @end
 
+/* Returns the colour space colours of a gradient in space are
+ * interpolated in.  It must be one NSColor can create colours in. */
+static NSColorSpace *
+lutColorSpace(NSColorSpace *space)
+{
+  switch ([space colorSpaceModel])
+    {
+      case NSGrayColorSpaceModel:
+        if (space == [NSColorSpace deviceGrayColorSpace])
+          return space;
+        return [NSColorSpace genericGrayColorSpace];
+      case NSCMYKColorSpaceModel:
+        if (space == [NSColorSpace deviceCMYKColorSpace])
+          return space;
+        return [NSColorSpace genericCMYKColorSpace];
+      case NSRGBColorSpaceModel:
+        if (space == [NSColorSpace deviceRGBColorSpace])
+          return space;
+        return [NSColorSpace genericRGBColorSpace];
+      default:
+        return [NSColorSpace genericRGBColorSpace];
+    }
+}
+
+/* Sets out to the components of the colour at location, interpolated
+ * between the neighbouring stops. */
+static void
+lutInterpolate(gradient_lut_t *lut, const CGFloat *locations,
+               NSInteger stops, CGFloat location, CGFloat *out)
+{
+  const NSUInteger n = lut->count;
+  const CGFloat *a;
+  const CGFloat *b;
+  NSInteger low;
+  NSInteger high;
+  CGFloat f;
+  NSUInteger i;
+
+  if (location <= locations[0])
+    {
+      memcpy(out, lut->components, n * sizeof(CGFloat));
+      return;
+    }
+  if (location >= locations[stops - 1])
+    {
+      memcpy(out, lut->components + (stops - 1) * n, n * sizeof(CGFloat));
+      return;
+    }
+
+  /* Find the stops with locations[low] < location <= locations[high] */
+  low = 0;
+  high = stops - 1;
+  while (high - low > 1)
+    {
+      NSInteger mid = (low + high) / 2;
+
+      if (location <= locations[mid])
+        high = mid;
+      else
+        low = mid;
+    }
+
+  a = lut->components + low * n;
+  b = lut->components + high * n;
+  f = (location - locations[low]) / (locations[high] - locations[low]);
+  for (i = 0; i < n; i++)
+    {
+      out[i] = a[i] + f * (b[i] - a[i]);
+    }
+}
+
+static inline unsigned char
+lutByte(CGFloat v)
+{
+  if (v <= 0.0)
+    return 0;
+  if (v >= 1.0)
+    return 255;
+  return (unsigned char)(v * 255.0 + 0.5);
+}
+
+/* Converts colour components to a premultiplied RGBA pixel. */
+static uint32_t
+lutPixel(NSColorSpaceModel model, const CGFloat *c)
+{
+  CGFloat r, g, b, a;
+  uint32_t pixel;
+  unsigned char *p = (unsigned char *)&pixel;
+
+  switch (model)
+    {
+      case NSGrayColorSpaceModel:
+        r = g = b = c[0];
+        a = c[1];
+        break;
+      case NSCMYKColorSpaceModel:
+        {
+          /* Same conversion as NSColor */
+          CGFloat white = 1.0 - c[3];
+
+          r = c[0] > white ? 0.0 : white - c[0];
+          g = c[1] > white ? 0.0 : white - c[1];
+          b = c[2] > white ? 0.0 : white - c[2];
+          a = c[4];
+        }
+        break;
+      default:
+        r = c[0];
+        g = c[1];
+        b = c[2];
+        a = c[3];
+        break;
+    }
+  if (a < 0.0)
+    a = 0.0;
+  else if (a > 1.0)
+    a = 1.0;
+  p[0] = lutByte(r * a);
+  p[1] = lutByte(g * a);
+  p[2] = lutByte(b * a);
+  p[3] = lutByte(a);
+  return pixel;
+}
+
+/* Returns the ramp pixel at t, scaled to 0 .. RAMP_SIZE - 1. */
+static inline uint32_t
+rampAt(const uint32_t *ramp, CGFloat t)
+{
+  if (t <= 0.0)
+    return ramp[0];
+  if (t >= RAMP_SIZE - 1)
+    return ramp[RAMP_SIZE - 1];
+  return ramp[(int)(t + 0.5)];
+}
+
+/* The fill functions render a gradient into a w x h pixel bitmap
+ * covering a size sized rect at the origin, with the first row at the
+ * top.  Points outside the gradient get the colour of its nearest end. */
+static void
+fillLinear(unsigned char *data, NSInteger bytesPerRow,
+           NSInteger w, NSInteger h, NSSize size, const uint32_t *ramp,
+           NSPoint start, NSPoint end)
+{
+  CGFloat sx = size.width / w;
+  CGFloat sy = size.height / h;
+  CGFloat dx = end.x - start.x;
+  CGFloat dy = end.y - start.y;
+  CGFloat scale = dx * dx + dy * dy;
+  CGFloat step;
+  NSInteger x, y;
+
+  scale = (scale > 0.0) ? (RAMP_SIZE - 1) / scale : 0.0;
+  dx *= scale;
+  dy *= scale;
+  step = sx * dx;
+  for (y = 0; y < h; y++)
+    {
+      uint32_t *row = (uint32_t *)(data + y * bytesPerRow);
+      CGFloat t = (0.5 * sx - start.x) * dx
+        + (size.height - (y + 0.5) * sy - start.y) * dy;
+
+      for (x = 0; x < w; x++, t += step)
+        {
+          row[x] = rampAt(ramp, t);
+        }
+    }
+}
+
+/* For a gradient from a point at start to a circle at end, which has
+ * to enclose start.  Each pixel gets the colour of the largest circle
+ * in between going through it. */
+static void
+fillRadial(unsigned char *data, NSInteger bytesPerRow,
+           NSInteger w, NSInteger h, NSSize size, const uint32_t *ramp,
+           NSPoint start, NSPoint end, CGFloat radius)
+{
+  CGFloat sx = size.width / w;
+  CGFloat sy = size.height / h;
+  CGFloat dx = end.x - start.x;
+  CGFloat dy = end.y - start.y;
+  CGFloat a = dx * dx + dy * dy - radius * radius;
+  CGFloat scale = (RAMP_SIZE - 1) / a;
+  NSInteger x, y;
+
+  for (y = 0; y < h; y++)
+    {
+      uint32_t *row = (uint32_t *)(data + y * bytesPerRow);
+      CGFloat qy = size.height - (y + 0.5) * sy - start.y;
+
+      for (x = 0; x < w; x++)
+        {
+          CGFloat qx = (x + 0.5) * sx - start.x;
+          CGFloat b = qx * dx + qy * dy;
+          CGFloat c = qx * qx + qy * qy;
+
+          /* Solve |q - t * d| = t * radius for t >= 0, a is negative */
+          row[x] = rampAt(ramp, (b - sqrt(b * b - a * c)) * scale);
+        }
+    }
+}
+
 @implementation NSGradient
 
 - (NSColorSpace *) colorSpace; 
@@ -218,12 +457,21 @@ relativeCenterPosition: (NSPoint)relativeCenterPoint
   RELEASE(_colorSpace);
   RELEASE(_colors);
   free(_locations);
+  if (_lut != NULL)
+    {
+      gradient_lut_t *lut = (gradient_lut_t *)_lut;
+
+      free(lut->components);
+      RELEASE(lut->rep);
+      free(lut);
+    }
   [super dealloc];
 }
 
 - (NSColor *) interpolatedColorAtLocation: (CGFloat)location
 {
-  unsigned int i;
+  gradient_lut_t *lut;
+  CGFloat components[5];
 
   if (location <= _locations[0])
     {
@@ -235,21 +483,11 @@ relativeCenterPosition: (NSPoint)relativeCenterPoint
       return [_colors objectAtIndex: _numberOfColorStops - 1];
     }
 
-  for (i = 1; i < _numberOfColorStops; i++)
-    {
-      if (location <= _locations[i])
-        {
-          NSColor *c1 = [_colors objectAtIndex: i - 1];
-          NSColor *c2 = [_colors objectAtIndex: i];
-          float fraction = (_locations[i] - location) / (_locations[i] - _locations[i - 1]);
-          
-          // FIXME: Works only for RGB colours and does not respect the colour space
-          return [c1 blendedColorWithFraction: fraction
-                     ofColor: c2];
-        }
-    }
-
-  return nil;
+  lut = [self _lut];
+  lutInterpolate(lut, _locations, _numberOfColorStops, location, components);
+  return [NSColor colorWithColorSpace: lut->space
+                           components: components
+                                count: lut->count];
 }
 
 - (NSInteger) numberOfColorStops
@@ -268,6 +506,7 @@ relativeCenterPosition: (NSPoint)relativeCenterPoint
   RETAIN(g->_colors);
   g->_locations = malloc(sizeof(CGFloat) * _numberOfColorStops);
   memcpy(g->_locations, _locations, sizeof(CGFloat) * _numberOfColorStops);
+  g->_lut = NULL;
 
   return g;
 }
@@ -300,6 +539,149 @@ relativeCenterPosition: (NSPoint)relativeCenterPoint
 
 @implementation NSGradient (Private)
 
+- (gradient_lut_t *) _lut
+{
+  if (_lut == NULL)
+    {
+      gradient_lut_t *lut = calloc(1, sizeof(gradient_lut_t));
+      NSInteger i;
+
+      lut->space = lutColorSpace(_colorSpace);
+      lut->model = [lut->space colorSpaceModel];
+      lut->count = [lut->space numberOfColorComponents] + 1;
+      lut->components = calloc(_numberOfColorStops * lut->count,
+                               sizeof(CGFloat));
+      for (i = 0; i < _numberOfColorStops; i++)
+        {
+          NSColor *color = [_colors objectAtIndex: i];
+
+          color = [color colorUsingColorSpace: lut->space];
+          /* Colours which cannot be converted, like pattern colours,
+             are left transparent. */
+          if (color != nil)
+            {
+              [color getComponents: lut->components + i * lut->count];
+            }
+        }
+
+      for (i = 0; i < RAMP_SIZE; i++)
+        {
+          CGFloat components[5];
+
+          lutInterpolate(lut, _locations, _numberOfColorStops,
+                         (CGFloat)i / (RAMP_SIZE - 1), components);
+          lut->ramp[i] = lutPixel(lut->model, components);
+        }
+      _lut = lut;
+    }
+  return (gradient_lut_t *)_lut;
+}
+
+/* Fills rect, which has to be covered by the gradient, with a bitmap
+ * rendered from the ramp.  start and end are the points (or for a
+ * radial gradient, the centres) the gradient goes between, key
+ * identifies them relative to rect.  Returns NO when the fill is better
+ * left to the backend, because it would not be done in device pixels. */
+- (BOOL) _fillRect: (NSRect)rect
+             start: (NSPoint)start
+               end: (NSPoint)end
+            radius: (CGFloat)radius
+            radial: (BOOL)radial
+               key: (NSPoint)key
+{
+  NSGraphicsContext *ctxt = GSCurrentContext();
+  NSAffineTransformStruct m;
+  gradient_lut_t *lut;
+  NSInteger w;
+  NSInteger h;
+
+  if (![ctxt isDrawingToScreen])
+    {
+      return NO;
+    }
+  m = [[ctxt GSCurrentCTM] transformStruct];
+  if (m.m12 != 0.0 || m.m21 != 0.0)
+    {
+      return NO;
+    }
+  if (radial)
+    {
+      CGFloat dx = end.x - start.x;
+      CGFloat dy = end.y - start.y;
+
+      if (dx * dx + dy * dy >= radius * radius)
+        {
+          return NO;
+        }
+    }
+
+  w = (NSInteger)ceil(fabs(NSWidth(rect) * m.m11));
+  h = (NSInteger)ceil(fabs(NSHeight(rect) * m.m22));
+  /* A gradient along an axis is the same all across it, so it can
+     be drawn as a one pixel strip which gets stretched. */
+  if (!radial && start.y == end.y)
+    {
+      h = 1;
+    }
+  else if (!radial && start.x == end.x)
+    {
+      w = 1;
+    }
+  if (w < 1 || h < 1 || w * h > MAX_PIXELS)
+    {
+      return NO;
+    }
+
+  lut = [self _lut];
+  if (lut->rep == nil
+    || [lut->rep pixelsWide] != w || [lut->rep pixelsHigh] != h
+    || lut->repRadial != radial
+    || !NSEqualSizes(lut->repSize, rect.size)
+    || !NSEqualPoints(lut->repKey, key))
+    {
+      NSBitmapImageRep *rep;
+
+      rep = [[NSBitmapImageRep alloc] initWithBitmapDataPlanes: NULL
+                                                    pixelsWide: w
+                                                    pixelsHigh: h
+                                                 bitsPerSample: 8
+                                               samplesPerPixel: 4
+                                                      hasAlpha: YES
+                                                      isPlanar: NO
+                                                colorSpaceName: NSCalibratedRGBColorSpace
+                                                   bytesPerRow: w * 4
+                                                  bitsPerPixel: 32];
+      start.x -= NSMinX(rect);
+      start.y -= NSMinY(rect);
+      end.x -= NSMinX(rect);
+      end.y -= NSMinY(rect);
+      if (radial)
+        {
+          fillRadial([rep bitmapData], w * 4, w, h, rect.size, lut->ramp,
+                     start, end, radius);
+        }
+      else
+        {
+          fillLinear([rep bitmapData], w * 4, w, h, rect.size, lut->ramp,
+                     start, end);
+        }
+
+      RELEASE(lut->rep);
+      lut->rep = rep;
+      lut->repSize = rect.size;
+      lut->repKey = key;
+      lut->repRadial = radial;
+    }
+
+  [lut->rep drawInRect: rect
+              fromRect: NSZeroRect
+             operation: NSCompositeSourceOver
+              fraction: 1.0
+        respectFlipped: NO
+                 hints: nil];
+  return YES;
+}
+
 - (void) _drawInRect: (NSRect)rect angle: (CGFloat)angle
 {
   NSPoint startPoint;
@@ -334,13 +716,30 @@ relativeCenterPosition: (NSPoint)relativeCenterPoint
       startPoint = NSMakePoint(NSMinX(rect), NSMaxY(rect));
     }
   rad = PI * angle / 180;
-  length = fabs(NSWidth(rect) * cos(rad) + NSHeight(rect) * sin(rad));
+  length = fabs(NSWidth(rect) * cos(rad)) + fabs(NSHeight(rect) * sin(rad));
   endPoint = NSMakePoint(startPoint.x + length * cos(rad), 
                          startPoint.y + length * sin(rad));
+  /* Snap the axis aligned cases, so they get drawn as strips */
+  if (fabs(endPoint.x - startPoint.x) < 1e-6)
+    {
+      endPoint.x = startPoint.x;
+    }
+  if (fabs(endPoint.y - startPoint.y) < 1e-6)
+    {
+      endPoint.y = startPoint.y;
+    }
 
-  [self  drawFromPoint: startPoint
-         toPoint: endPoint
-         options: 0];
+  if (![self _fillRect: rect
+                 start: startPoint
+                   end: endPoint
+                radius: 0.0
+                radial: NO
+                   key: NSMakePoint(angle, 0.0)])
+    {
+      [self drawFromPoint: startPoint
+                  toPoint: endPoint
+                  options: 0];
+    }
 }
 
 static inline float sqr(float a)
@@ -380,10 +779,18 @@ relativeCenterPosition: (NSPoint)relativeCenterPoint
   if (endRadius < distance)
     endRadius = distance;
 
-  [self drawFromCenter: startCenter
-        radius: 0.0
-        toCenter: endCenter 
-        radius: endRadius
-        options: 0];
+  if (![self _fillRect: rect
+                 start: startCenter
+                   end: endCenter
+                radius: endRadius
+                radial: YES
+                   key: relativeCenterPoint])
+    {
+      [self drawFromCenter: startCenter
+                    radius: 0.0
+                  toCenter: endCenter 
+                    radius: endRadius
+                   options: 0];
+    }
 }
 @end
@@ -41,6 +41,7 @@
 #import <Foundation/NSException.h>
 #import <Foundation/NSData.h>
 #import <Foundation/NSLock.h>
+#import <Foundation/NSNull.h>
 #import <Foundation/NSRunLoop.h>
 #import <Foundation/NSSet.h>
 #import <Foundation/NSThread.h>
@@ -51,6 +52,7 @@
 #import "AppKit/NSBezierPath.h"
 #import "AppKit/NSPrintInfo.h"
 #import "AppKit/NSPrintOperation.h"
+#import "AppKit/NSShadow.h"
 #import "AppKit/NSWindow.h"
 #import "AppKit/NSView.h"
 #import "AppKit/DPSOperators.h"
@@ -316,6 +318,8 @@ NSGraphicsContext	*GSCurrentContext(void)
 
 - (void) dealloc
 {
+  DESTROY(_shadow);
+  DESTROY(_shadowStack);
   DESTROY(usedFonts);
   DESTROY(focus_stack);
   DESTROY(context_data);
@@ -398,11 +402,23 @@ NSGraphicsContext	*GSCurrentContext(void)
 - (void) restoreGraphicsState
 {
   [self DPSgrestore];
+  if ([_shadowStack count] > 0)
+    {
+      id shadow = [_shadowStack lastObject];
+
+      ASSIGN(_shadow, (shadow == [NSNull null]) ? nil : shadow);
+      [_shadowStack removeLastObject];
+    }
 }
 
 - (void) saveGraphicsState
 {
   [self DPSgsave];
+  if (_shadowStack == nil)
+    {
+      _shadowStack = [[NSMutableArray alloc] initWithCapacity: 4];
+    }
+  [_shadowStack addObject: (_shadow == nil) ? (id)[NSNull null] : _shadow];
 }
 
 - (void *) focusStack
@@ -410,6 +426,16 @@ NSGraphicsContext	*GSCurrentContext(void)
   return focus_stack;
 }
 
+- (NSShadow *) GSCurrentShadow
+{
+  return _shadow;
+}
+
+- (void) GSSetShadow: (NSShadow *)shadow
+{
+  ASSIGNCOPY(_shadow, shadow);
+}
+
 - (void) setFocusStack: (void *)stack
 {
   ASSIGN(focus_stack, (id)stack);
@@ -36,8 +36,13 @@
 #import <Foundation/NSFileManager.h>
 #import <Foundation/NSKeyedArchiver.h>
 #import <Foundation/NSLock.h>
+#import <Foundation/NSMapTable.h>
 #import <Foundation/NSNotification.h>
+#import <Foundation/NSOperation.h>
+#import <Foundation/NSProcessInfo.h>
 #import <Foundation/NSString.h>
+#import <Foundation/NSThread.h>
+#import <Foundation/NSUserDefaults.h>
 #import <Foundation/NSValue.h>
 
 #import "AppKit/NSImage.h"
@@ -380,6 +385,84 @@ fixupImageNameAndType(NSString **name, NSString **type)
 }
 @end
 
+/* Decodes an image on a thread of the load queue and hands it to its
+ * target on the main thread. */
+@interface GSImageLoadOperation : NSOperation
+{
+  Class         imageClass;
+  NSString      *path;
+  NSData        *data;
+  NSSize        size;
+  id            target;
+  SEL           selector;
+  NSImage       *image;
+}
+- (id) initWithImageClass: (Class)aClass
+                     path: (NSString *)aPath
+                     data: (NSData *)someData
+                     size: (NSSize)aSize
+                   target: (id)aTarget
+                 selector: (SEL)aSelector;
+@end
+
+@implementation GSImageLoadOperation
+
+- (id) initWithImageClass: (Class)aClass
+                     path: (NSString *)aPath
+                     data: (NSData *)someData
+                     size: (NSSize)aSize
+                   target: (id)aTarget
+                 selector: (SEL)aSelector
+{
+  if ((self = [super init]) != nil)
+    {
+      imageClass = aClass;
+      ASSIGN(path, aPath);
+      ASSIGN(data, someData);
+      size = aSize;
+      ASSIGN(target, aTarget);
+      selector = aSelector;
+    }
+  return self;
+}
+
+- (void) dealloc
+{
+  RELEASE(path);
+  RELEASE(data);
+  RELEASE(target);
+  RELEASE(image);
+  [super dealloc];
+}
+
+- (void) main
+{
+  CREATE_AUTORELEASE_POOL(pool);
+
+  if (data == nil && path != nil)
+    {
+      ASSIGN(data, [NSData dataWithContentsOfFile: path]);
+    }
+  if (data != nil)
+    {
+      image = [[imageClass alloc] initWithData: data
+                              maximumPixelSize: size];
+      DESTROY(data);
+    }
+  [self performSelectorOnMainThread: @selector(_finish)
+                         withObject: nil
+                      waitUntilDone: NO];
+  RELEASE(pool);
+}
+
+- (void) _finish
+{
+  [target performSelector: selector withObject: image];
+  DESTROY(target);
+}
+
+@end
+
 /* Class variables and functions for class methods */
 static NSRecursiveLock		*imageLock = nil;
 static NSMutableDictionary	*nameDict = nil;
@@ -394,6 +477,70 @@ static NSArray *imagePasteboardTypes = nil;
 
 static NSArray *iterate_reps_for_types(NSArray *imageReps, SEL method);
 
+/*
+ * The image cache.  Images holding representations which can be
+ * recreated have an entry in a list ordered by when they were last
+ * drawn, the most recently drawn first.  All of it is protected by
+ * imageLock.
+ */
+typedef struct _GSImageCacheEntry {
+  NSImage                       *image;         // not retained
+  NSUInteger                    bytes;
+  struct _GSImageCacheEntry     *prev;
+  struct _GSImageCacheEntry     *next;
+} GSImageCacheEntry;
+
+static NSMapTable               *cacheEntries = NULL;
+static GSImageCacheEntry        *cacheHead = NULL;
+static GSImageCacheEntry        *cacheTail = NULL;
+static NSUInteger               cacheSize = 0;
+static NSUInteger               cacheLimit = 0;
+
+static NSOperationQueue         *loadQueue = nil;
+
+static void
+cache_unlink(GSImageCacheEntry *entry)
+{
+  if (entry->prev != NULL)
+    entry->prev->next = entry->next;
+  else
+    cacheHead = entry->next;
+  if (entry->next != NULL)
+    entry->next->prev = entry->prev;
+  else
+    cacheTail = entry->prev;
+  entry->prev = entry->next = NULL;
+}
+
+static void
+cache_push(GSImageCacheEntry *entry)
+{
+  entry->prev = NULL;
+  entry->next = cacheHead;
+  if (cacheHead != NULL)
+    cacheHead->prev = entry;
+  else
+    cacheTail = entry;
+  cacheHead = entry;
+}
+
+/* Estimate the memory used by the pixels of a representation */
+static NSUInteger
+bytes_for_rep(NSImageRep *rep)
+{
+  if ([rep isKindOfClass: bitmapClass])
+    {
+      return [(NSBitmapImageRep*)rep bytesPerPlane]
+        * [(NSBitmapImageRep*)rep numberOfPlanes];
+    }
+  if ([rep isKindOfClass: cachedClass])
+    {
+      /* Cached representations live in a window, assume 32 bit pixels */
+      return [rep pixelsWide] * [rep pixelsHigh] * 4;
+    }
+  return 0;
+}
+
 /* Find the GSRepData object holding a representation */
 static GSRepData*
 repd_for_rep(NSArray *_reps, NSImageRep *rep)
@@ -420,10 +567,17 @@ repd_for_rep(NSArray *_reps, NSImageRep *rep)
 + (void) _reloadCachedImages;
 - (BOOL) _useFromFile: (NSString *)fileName;
 - (BOOL) _loadFromData: (NSData *)data;
+- (BOOL) _loadFromData: (NSData *)data maximumPixelSize: (NSSize)size;
 - (BOOL) _loadFromFile: (NSString *)fileName;
 - (BOOL) _resetAndUseFromFile: (NSString *)fileName;
 - (GSRepData*) _cacheForRep: (NSImageRep*)rep;
 - (NSCachedImageRep*) _doImageCache: (NSImageRep *)rep;
+- (BOOL) _reload;
+- (NSUInteger) _cacheBytes;
+- (void) _touchCache;
+- (void) _evictCache;
+- (void) _removeFromCache;
++ (void) _trimCacheKeeping: (GSImageCacheEntry *)keep;
 @end
 
 @implementation NSImage
@@ -433,6 +587,7 @@ repd_for_rep(NSArray *_reps, NSImageRep *rep)
   if (imageLock == nil)
     {
       NSString *path;
+      NSInteger limit;
 
       imageLock = [NSRecursiveLock new];
       [imageLock lock];
@@ -451,6 +606,15 @@ repd_for_rep(NSArray *_reps, NSImageRep *rep)
       clearColor = RETAIN([NSColor clearColor]);
       cachedClass = [NSCachedImageRep class];
       bitmapClass = [NSBitmapImageRep class];
+      cacheEntries = NSCreateMapTable(NSNonOwnedPointerMapKeyCallBacks,
+                                      NSNonOwnedPointerMapValueCallBacks, 0);
+      limit = [[NSUserDefaults standardUserDefaults]
+                integerForKey: @"GSImageCacheLimit"];
+      if (limit <= 0)
+        {
+          limit = 64;
+        }
+      cacheLimit = (NSUInteger)limit * 1024 * 1024;
       [[NSNotificationCenter defaultCenter]
 	addObserver: self
 	   selector: @selector(_clearFileTypeCaches:)
@@ -564,6 +728,8 @@ repd_for_rep(NSArray *_reps, NSImageRep *rep)
       RELEASE(self);
       return nil;
     }
+  ASSIGN(_fileName, fileName);
+  _flags.reloadable = YES;
 
   return self;
 }
@@ -579,6 +745,8 @@ repd_for_rep(NSArray *_reps, NSImageRep *rep)
       RELEASE(self);
       return nil;
     }
+  ASSIGN(_data, data);
+  _flags.reloadable = YES;
 
   return self;
 }
@@ -672,8 +840,10 @@ repd_for_rep(NSArray *_reps, NSImageRep *rep)
 {
   if (_name == nil)
     {
+      [self _removeFromCache];
       RELEASE(_reps);
       TEST_RELEASE(_fileName);
+      TEST_RELEASE(_data);
       RELEASE(_color);
       [super dealloc];
     }
@@ -695,6 +865,7 @@ repd_for_rep(NSArray *_reps, NSImageRep *rep)
 
   copy->_name = nil;
   RETAIN(_fileName);
+  RETAIN(_data);
   RETAIN(_color);
   copy->_lockedView = nil;
   // FIXME: maybe we should retain if _flags.dataRetained = NO
@@ -907,9 +1078,8 @@ repd_for_rep(NSArray *_reps, NSImageRep *rep)
     {
       /* Make sure any images that were added with _useFromFile: are loaded
          in and added to the representation list. */
-      if (![self _loadFromFile: _fileName])
+      if (![self _reload])
         return NO;
-      _flags.syncLoad = NO;
     }
 
   /* Go through all our representations and determine if at least one
@@ -934,6 +1104,7 @@ repd_for_rep(NSArray *_reps, NSImageRep *rep)
 {
   NSUInteger i;
 
+  [self _removeFromCache];
   i = [_reps count];
   while (i--) 
     {
@@ -1201,6 +1372,8 @@ repd_for_rep(NSArray *_reps, NSImageRep *rep)
 	 fraction: delta
        respectFlipped: respectFlipped
 	    hints: hints];
+
+  [self _touchCache];
 }
 
 - (void) addRepresentation: (NSImageRep *)imageRep
@@ -1213,6 +1386,7 @@ repd_for_rep(NSArray *_reps, NSImageRep *rep)
       repd->rep = RETAIN(imageRep);
       [_reps addObject: repd]; 
       RELEASE(repd);
+      _flags.reloadable = NO;
     }
 }
 
@@ -1229,6 +1403,10 @@ repd_for_rep(NSArray *_reps, NSImageRep *rep)
       [_reps addObject: repd]; 
       RELEASE(repd);
     }
+  if (count > 0)
+    {
+      _flags.reloadable = NO;
+    }
 }
 
 - (void) removeRepresentation: (NSImageRep *)imageRep
@@ -1236,6 +1414,7 @@ repd_for_rep(NSArray *_reps, NSImageRep *rep)
   NSUInteger i;
   GSRepData *repd;
 
+  _flags.reloadable = NO;
   i = [_reps count];
   while (i-- > 0)
     {
@@ -1277,6 +1456,9 @@ repd_for_rep(NSArray *_reps, NSImageRep *rep)
       if (repd == nil)
 	return;
 
+      /* Whatever gets drawn now exists only in the cache */
+      _flags.cacheModified = YES;
+
       imageRep = repd->rep;
 
       window = [(NSCachedImageRep *)imageRep window];
@@ -1634,7 +1816,7 @@ static NSSize GSResolutionOfImageRep(NSImageRep *rep)
     {
       /* Make sure any images that were added with _useFromFile: are loaded
          in and added to the representation list. */
-      [self _loadFromFile: _fileName];
+      [self _reload];
       _flags.syncLoad = NO;
     }
 
@@ -2308,6 +2490,21 @@ iterate_reps_for_types(NSArray* imageReps, SEL method)
   return ok;
 }
 
+- (BOOL) _loadFromData: (NSData *)data maximumPixelSize: (NSSize)size
+{
+  NSBitmapImageRep *rep;
+
+  rep = [[bitmapClass alloc] initWithData: data
+                         maximumPixelSize: size];
+  if (rep == nil)
+    {
+      return NO;
+    }
+  [self addRepresentation: rep];
+  RELEASE(rep);
+  return YES;
+}
+
 - (BOOL) _loadFromFile: (NSString *)fileName
 {
   NSArray *array;
@@ -2339,12 +2536,17 @@ iterate_reps_for_types(NSArray* imageReps, SEL method)
 
   ASSIGN(_fileName, fileName);
   _flags.syncLoad = YES;
+  _flags.reloadable = YES;
   return YES;
 }
 
 - (BOOL) _resetAndUseFromFile: (NSString *)fileName
 {
+  [self _removeFromCache];
   [_reps removeAllObjects];
+  DESTROY(_data);
+  _maximumPixelSize = NSZeroSize;
+  _flags.cacheModified = NO;
   
   if (!_flags.sizeWasExplicitlySet)
     {
@@ -2353,6 +2555,161 @@ iterate_reps_for_types(NSArray* imageReps, SEL method)
   return [self _useFromFile: fileName];
 }
 
+/* Loads the representations of an image which were released by the
+ * image cache, or not loaded yet by -_useFromFile:.
+ */
+- (BOOL) _reload
+{
+  BOOL ok;
+
+  if (_data != nil && !NSEqualSizes(_maximumPixelSize, NSZeroSize))
+    {
+      ok = [self _loadFromData: _data maximumPixelSize: _maximumPixelSize];
+    }
+  else if (_data != nil)
+    {
+      ok = [self _loadFromData: _data];
+    }
+  else
+    {
+      ok = [self _loadFromFile: _fileName];
+    }
+  if (ok)
+    {
+      _flags.syncLoad = NO;
+      _flags.reloadable = YES;
+    }
+  return ok;
+}
+
+/* Returns the size of the representations -_evictCache would release */
+- (NSUInteger) _cacheBytes
+{
+  NSUInteger bytes = 0;
+  NSUInteger i;
+
+  if (_flags.cacheModified)
+    {
+      return 0;
+    }
+  i = [_reps count];
+  while (i-- > 0)
+    {
+      GSRepData *repd = (GSRepData*)[_reps objectAtIndex: i];
+
+      if (_flags.reloadable || repd->original != nil)
+        {
+          bytes += bytes_for_rep(repd->rep);
+        }
+    }
+  return bytes;
+}
+
+/* Makes the receiver the most recently drawn image in the cache and
+ * releases the representations of others if it is over budget.
+ */
+- (void) _touchCache
+{
+  GSImageCacheEntry *entry;
+  NSUInteger bytes;
+
+  [imageLock lock];
+  bytes = [self _cacheBytes];
+  entry = (GSImageCacheEntry*)NSMapGet(cacheEntries, (void*)self);
+  if (bytes == 0)
+    {
+      if (entry != NULL)
+        {
+          [self _removeFromCache];
+        }
+      [imageLock unlock];
+      return;
+    }
+
+  if (entry == NULL)
+    {
+      entry = calloc(1, sizeof(GSImageCacheEntry));
+      entry->image = self;
+      NSMapInsert(cacheEntries, (void*)self, (void*)entry);
+    }
+  else
+    {
+      cache_unlink(entry);
+    }
+  cacheSize = cacheSize - entry->bytes + bytes;
+  entry->bytes = bytes;
+  cache_push(entry);
+
+  if (cacheSize > cacheLimit)
+    {
+      [NSImage _trimCacheKeeping: entry];
+    }
+  [imageLock unlock];
+}
+
+/* Releases the representations of the receiver which can be recreated */
+- (void) _evictCache
+{
+  NSUInteger i;
+
+  if (_lockedView != nil || _flags.cacheModified)
+    {
+      return;
+    }
+
+  NSDebugLLog(@"NSImage", @"Releasing cached representations of %@", self);
+  i = [_reps count];
+  while (i-- > 0)
+    {
+      GSRepData *repd = (GSRepData*)[_reps objectAtIndex: i];
+
+      if (_flags.reloadable || repd->original != nil)
+        {
+          [_reps removeObjectAtIndex: i];
+        }
+    }
+  if (_flags.reloadable)
+    {
+      _flags.syncLoad = YES;
+    }
+  [self _removeFromCache];
+}
+
+- (void) _removeFromCache
+{
+  GSImageCacheEntry *entry;
+
+  [imageLock lock];
+  entry = (GSImageCacheEntry*)NSMapGet(cacheEntries, (void*)self);
+  if (entry != NULL)
+    {
+      NSMapRemove(cacheEntries, (void*)self);
+      cache_unlink(entry);
+      cacheSize -= entry->bytes;
+      free(entry);
+    }
+  [imageLock unlock];
+}
+
+/* Releases representations, starting with the least recently drawn
+ * image, until the cache is within its budget.
+ */
++ (void) _trimCacheKeeping: (GSImageCacheEntry *)keep
+{
+  GSImageCacheEntry *entry = cacheTail;
+
+  while (cacheSize > cacheLimit && entry != NULL)
+    {
+      GSImageCacheEntry *prev = entry->prev;
+
+      if (entry != keep)
+        {
+          [entry->image _evictCache];
+        }
+      entry = prev;
+    }
+}
+
 // Cache the bestRepresentation.  If the bestRepresentation is not itself
 // a cache and no cache exists, create one and draw the representation in it
 // If a cache exists, but is not valid, redraw the cache from the original
@@ -2378,8 +2735,11 @@ iterate_reps_for_types(NSArray* imageReps, SEL method)
    */
   if (repd->bg == nil) 
     {
+      BOOL modified = _flags.cacheModified;
+
       [self lockFocusOnRepresentation: cache];
       [self unlockFocus];
+      _flags.cacheModified = modified;
       
       NSDebugLLog(@"NSImage", @"Rendered rep %p on background %@",
                   cache, repd->bg);
@@ -2543,3 +2903,108 @@ iterate_reps_for_types(NSArray* imageReps, SEL method)
 }
 
 @end
+
+@implementation NSImage (GNUstepExtensions)
+
++ (NSUInteger) imageCacheSize
+{
+  NSUInteger size;
+
+  [imageLock lock];
+  size = cacheSize;
+  [imageLock unlock];
+  return size;
+}
+
++ (NSUInteger) imageCacheLimit
+{
+  return cacheLimit;
+}
+
++ (void) setImageCacheLimit: (NSUInteger)limit
+{
+  [imageLock lock];
+  cacheLimit = limit;
+  [self _trimCacheKeeping: NULL];
+  [imageLock unlock];
+}
+
+- (id) initWithData: (NSData *)data
+   maximumPixelSize: (NSSize)size
+{
+  if (NSEqualSizes(size, NSZeroSize)
+    || ![bitmapClass canInitWithData: data])
+    {
+      return [self initWithData: data];
+    }
+
+  if (!(self = [self init]))
+    return nil;
+
+  _flags.dataRetained = YES;
+  if (![self _loadFromData: data maximumPixelSize: size])
+    {
+      RELEASE(self);
+      return nil;
+    }
+  /* Keep the data, so that the image cache can release the bitmap and
+     have it decoded again at the same size. */
+  ASSIGN(_data, data);
+  _maximumPixelSize = size;
+  _flags.reloadable = YES;
+
+  return self;
+}
+
++ (void) _loadImageWithContentsOfFile: (NSString *)path
+                                 data: (NSData *)data
+                     maximumPixelSize: (NSSize)size
+                               target: (id)target
+                             selector: (SEL)selector
+{
+  GSImageLoadOperation *op;
+
+  [imageLock lock];
+  if (loadQueue == nil)
+    {
+      loadQueue = [NSOperationQueue new];
+      [loadQueue setMaxConcurrentOperationCount:
+        [[NSProcessInfo processInfo] activeProcessorCount]];
+    }
+  [imageLock unlock];
+
+  op = [[GSImageLoadOperation alloc] initWithImageClass: self
+                                                   path: path
+                                                   data: data
+                                                   size: size
+                                                 target: target
+                                               selector: selector];
+  [loadQueue addOperation: op];
+  RELEASE(op);
+}
+
++ (void) loadImageWithContentsOfFile: (NSString *)path
+                    maximumPixelSize: (NSSize)size
+                              target: (id)target
+                            selector: (SEL)selector
+{
+  [self _loadImageWithContentsOfFile: path
+                                data: nil
+                    maximumPixelSize: size
+                              target: target
+                            selector: selector];
+}
+
++ (void) loadImageWithData: (NSData *)data
+          maximumPixelSize: (NSSize)size
+                    target: (id)target
+                  selector: (SEL)selector
+{
+  [self _loadImageWithContentsOfFile: nil
+                                data: data
+                    maximumPixelSize: size
+                              target: target
+                            selector: selector];
+}
+
+@end
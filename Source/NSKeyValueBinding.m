@@ -388,7 +388,17 @@ void GSBindingInvokeAction(NSString *targetKey, NSString *argumentKey,
   if (change != nil)
     {
       options = [info objectForKey: NSOptionsKey];
-      newValue = [change objectForKey: NSKeyValueChangeNewKey];
+      if ([[change objectForKey: NSKeyValueChangeKindKey] intValue]
+          == NSKeyValueChangeSetting)
+        {
+          newValue = [change objectForKey: NSKeyValueChangeNewKey];
+        }
+      else
+        {
+          /* An insertion, removal or replacement only carries the
+             changed objects, so fetch the whole collection. */
+          newValue = [object valueForKeyPath: keyPath];
+        }
       newValue = [self transformValue: newValue withOptions: options];
       NSDebugLLog(@"NSBinding", @"observeValueForKeyPath: binding %@, keyPath %@, source %@ value %@", binding, keyPath, src, newValue);
       [src setValue: newValue forKey: binding];
@@ -108,6 +108,7 @@ first. Remaining cases, highest priority first:
 #import <Foundation/NSEnumerator.h>
 #import <Foundation/NSException.h>
 #import <Foundation/NSValue.h>
+#import "AppKit/NSAffineTransform.h"
 #import "AppKit/NSAttributedString.h"
 #import "AppKit/NSBezierPath.h"
 #import "AppKit/NSColor.h"
@@ -116,6 +117,7 @@ first. Remaining cases, highest priority first:
 #import "AppKit/NSLayoutManager.h"
 #import "AppKit/NSParagraphStyle.h"
 #import "AppKit/NSRulerMarker.h"
+#import "AppKit/NSShadow.h"
 #import "AppKit/NSTextContainer.h"
 #import "AppKit/NSTextStorage.h"
 #import "AppKit/NSWindow.h"
@@ -123,6 +125,7 @@ first. Remaining cases, highest priority first:
 
 #import "GNUstepGUI/GSLayoutManager_internal.h"
 #import "GSBindingHelpers.h"
+#import "NSShadowPrivate.h"
 
 
 @interface NSLayoutManager (spelling)
@@ -1566,6 +1569,130 @@ attachmentSize(linefrag_t *lf, NSUInteger glyphIndex)
                               layoutManager: self];
 }
 
+/* A glyph casting a text shadow, positioned relative to the bounds of
+   the shadowed run. */
+typedef struct {
+  NSGlyph g;
+  NSFont *font;
+  NSPoint p;
+} shadow_glyph_t;
+
+/* Fills the outlines of the glyphs described by the first argument,
+   drawn at the origin given by the second.  Used to draw shadow masks. */
+-(void) _fillShadowGlyphs: (NSArray *)args
+{
+  NSData *glyphData = [args objectAtIndex: 0];
+  const shadow_glyph_t *sg = [glyphData bytes];
+  NSUInteger count = [glyphData length] / sizeof(shadow_glyph_t);
+  NSPoint origin = [[args objectAtIndex: 1] pointValue];
+  BOOL flipped = [[args objectAtIndex: 2] boolValue];
+  NSBezierPath *path = [NSBezierPath bezierPath];
+  NSUInteger i;
+
+  for (i = 0; i < count; i++)
+    {
+      NSBezierPath *outline = [NSBezierPath bezierPath];
+      NSAffineTransform *t = [NSAffineTransform transform];
+
+      /* Glyph outlines are y up, whatever the view. */
+      [outline moveToPoint: NSZeroPoint];
+      [outline appendBezierPathWithGlyphs: (NSGlyph *)&sg[i].g
+				    count: 1
+				   inFont: sg[i].font];
+      [t translateXBy: origin.x + sg[i].p.x yBy: origin.y + sg[i].p.y];
+      if (flipped)
+	[t scaleXBy: 1.0 yBy: -1.0];
+      [outline transformUsingAffineTransform: t];
+      [path appendBezierPath: outline];
+    }
+  [path fill];
+}
+
+/* Draws the shadows of the runs in range with an NSShadowAttributeName,
+   before the glyphs themselves are drawn. */
+-(void) _drawShadowsForGlyphRange: (NSRange)range
+			  atPoint: (NSPoint)containerOrigin
+{
+  NSRange charRange = [self characterRangeForGlyphRange: range
+				       actualGlyphRange: NULL];
+  NSUInteger i = charRange.location;
+  BOOL flipped = [GSCurrentContext() isFlipped];
+
+  while (i < NSMaxRange(charRange))
+    {
+      NSRange r;
+      NSShadow *shadow = [_textStorage attribute: NSShadowAttributeName
+					 atIndex: i
+			   longestEffectiveRange: &r
+					 inRange: charRange];
+
+      i = NSMaxRange(r);
+      if (shadow != nil)
+	{
+	  NSRange glyphRange;
+	  NSTextContainer *container;
+	  NSMutableData *glyphData;
+	  NSMutableArray *fonts;
+	  NSRect bounds;
+	  NSUInteger g;
+
+	  glyphRange = NSIntersectionRange(range,
+	    [self glyphRangeForCharacterRange: r actualCharacterRange: NULL]);
+	  if (glyphRange.length == 0)
+	    continue;
+	  container = [self textContainerForGlyphAtIndex: glyphRange.location
+					  effectiveRange: NULL];
+	  bounds = [self boundingRectForGlyphRange: glyphRange
+				   inTextContainer: container];
+	  bounds.origin.x += containerOrigin.x;
+	  bounds.origin.y += containerOrigin.y;
+
+	  /* The glyphs and their positions describe the shadow exactly, so
+	     they also serve as the key of the cached mask.  The key keeps the
+	     fonts, so that their addresses can't be reused by other fonts
+	     while it is in the cache. */
+	  glyphData = [NSMutableData dataWithCapacity:
+	    glyphRange.length * sizeof(shadow_glyph_t)];
+	  fonts = [NSMutableArray arrayWithCapacity: 1];
+	  for (g = glyphRange.location; g < NSMaxRange(glyphRange); g++)
+	    {
+	      unsigned int glyph_pos, char_pos;
+	      glyph_run_t *run;
+	      shadow_glyph_t sg;
+	      NSRect lf;
+
+	      memset(&sg, 0, sizeof(sg));
+	      sg.g = [self glyphAtIndex: g];
+	      if (sg.g == NSNullGlyph || sg.g == NSControlGlyph
+		|| sg.g == GSAttachmentGlyph
+		|| [self notShownAttributeForGlyphAtIndex: g])
+		continue;
+	      run = run_for_glyph_index(g, glyphs, &glyph_pos, &char_pos);
+	      lf = [self lineFragmentRectForGlyphAtIndex: g
+					  effectiveRange: NULL];
+	      sg.font = run->font;
+	      if ([fonts indexOfObjectIdenticalTo: sg.font] == NSNotFound)
+		[fonts addObject: sg.font];
+	      sg.p = [self locationForGlyphAtIndex: g];
+	      sg.p.x += lf.origin.x + containerOrigin.x - bounds.origin.x;
+	      sg.p.y += lf.origin.y + containerOrigin.y - bounds.origin.y;
+	      [glyphData appendBytes: &sg length: sizeof(sg)];
+	    }
+	  if ([glyphData length] == 0)
+	    continue;
+
+	  [shadow _drawShadowOf: self
+		       selector: @selector(_fillShadowGlyphs:)
+		       argument: [NSArray arrayWithObjects: glyphData,
+			 [NSValue valueWithPoint: bounds.origin],
+			 [NSNumber numberWithBool: flipped], nil]
+			 bounds: bounds
+			    key: [NSArray arrayWithObjects: glyphData,
+			      fonts, nil]];
+	}
+    }
+}
+
 -(void) drawGlyphsForGlyphRange: (NSRange)range
 			atPoint: (NSPoint)containerOrigin
 {
@@ -1610,6 +1737,8 @@ attachmentSize(linefrag_t *lf, NSUInteger glyphIndex)
     return;
   [self _doLayoutToGlyph: range.location + range.length - 1];
 
+  [self _drawShadowsForGlyphRange: range atPoint: containerOrigin];
+
   /* Find the selected range of glyphs as it overlaps with the range we
    * are about to display.
    */
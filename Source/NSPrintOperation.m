@@ -39,9 +39,13 @@
 #import <Foundation/NSString.h>
 #import <Foundation/NSDebug.h>
 #import <Foundation/NSData.h>
+#import <Foundation/NSDate.h>
+#import <Foundation/NSFileHandle.h>
 #import <Foundation/NSFileManager.h>
 #import <Foundation/NSException.h>
+#import <Foundation/NSLock.h>
 #import <Foundation/NSPathUtilities.h>
+#import <Foundation/NSRunLoop.h>
 #import <Foundation/NSTask.h>
 #import <Foundation/NSThread.h>
 #import <Foundation/NSUserDefaults.h>
@@ -49,7 +53,11 @@
 #import "AppKit/AppKitExceptions.h"
 #import "AppKit/NSAffineTransform.h"
 #import "AppKit/NSApplication.h"
+#import "AppKit/NSButton.h"
 #import "AppKit/NSGraphicsContext.h"
+#import "AppKit/NSPanel.h"
+#import "AppKit/NSProgressIndicator.h"
+#import "AppKit/NSTextField.h"
 #import "AppKit/NSView.h"
 #import "AppKit/NSPrinter.h"
 #import "AppKit/NSPrintPanel.h"
@@ -114,6 +122,41 @@ typedef struct _page_info_t {
                         last: (int)last
                         info: (page_info_t *)info;
 - (void) _print;
+- (void) _startPrintThread;
+- (void) _printThread: (NSThread *)callerThread;
+- (void) _printThreadDidFinish: (NSNumber *)result;
+- (void) _waitForPrintThread;
+- (void) _reportProgress;
+- (void) _updateProgressPanel: (NSNumber *)page;
+- (void) _cancel: (id)sender;
+- (void) _reportPrintError: (NSException *)exception;
+- (void) _notifyModalDelegate: (BOOL)success;
+@end
+
+/* Collects what a print context writes to a pipe into an NSMutableData.
+   The context opens the write end through /dev/fd, so no file is ever
+   written, and a thread drains the pipe while the pages are rendered. */
+@interface GSPrintDataSink : NSObject
+{
+  NSMutableData *_data;
+  NSFileHandle *_reader;
+  NSFileHandle *_writer;
+  NSConditionLock *_done;
+}
+- (id) initWithData: (NSMutableData *)data;
+- (NSString *) path;
+- (void) finish;
+@end
+
+/* Shows the progress of a print operation running in a separate
+   thread and lets the user cancel it. */
+@interface GSPrintProgressPanel : NSPanel
+{
+  NSTextField *_label;
+  NSProgressIndicator *_indicator;
+}
+- (id) initWithOperation: (NSPrintOperation *)operation;
+- (void) setPage: (int)page of: (int)total;
 @end
 
 
@@ -315,6 +358,9 @@ static NSString *NSPrintOperationThreadKey = @"NSPrintOperationThreadKey";
   TEST_RELEASE(_accessory_view);  
   TEST_RELEASE(_path);  
   TEST_RELEASE(_job_style_hint);  
+  TEST_RELEASE(_progress_panel);
+  [_output_sink finish];
+  TEST_RELEASE(_output_sink);
 
   [super dealloc];
 }
@@ -513,7 +559,14 @@ static NSString *NSPrintOperationThreadKey = @"NSPrintOperationThreadKey";
     }
 
   result = NO;
-  if ([self _runOperation])
+  if ([self canSpawnSeparateThread])
+    {
+      /* Keep the application responsive while the pages are rendered. */
+      [self _startPrintThread];
+      [self _waitForPrintThread];
+      result = _flags.thread_succeeded;
+    }
+  else if ([self _runOperation])
     result = [self deliverResult];
   [self cleanUpOperation];
 
@@ -540,6 +593,8 @@ static NSString *NSPrintOperationThreadKey = @"NSPrintOperationThreadKey";
                forKey: @"GSModalRunSelector"];
       [dict setObject: delegate
                forKey: @"GSModalRunDelegate"];
+      [dict setObject: [NSValue valueWithPointer: contextInfo]
+               forKey: @"GSModalRunContextInfo"];
     }
 
   /* Assume we want to show the panel regardless of the value
@@ -556,11 +611,21 @@ static NSString *NSPrintOperationThreadKey = @"NSPrintOperationThreadKey";
   [panel setAccessoryView: nil];
 }
 
+/** Returns YES if the receiver renders its pages in a separate thread.
+ */
 - (BOOL)canSpawnSeparateThread
 {
   return _flags.can_spawn_separate_thread;
 }
 
+/** Sets whether the receiver paginates and renders its pages in a
+    separate thread, with a graphics context of its own.  The progress
+    panel, if shown, stays responsive and can cancel the operation.
+    -runOperation still returns only when the operation is done, while
+    -runOperationModalForWindow:delegate:didRunSelector:contextInfo:
+    informs its delegate once the thread has finished.  The view must
+    be able to draw itself outside the main thread.
+*/
 - (void)setCanSpawnSeparateThread:(BOOL)flag
 {
   _flags.can_spawn_separate_thread = flag;
@@ -635,6 +700,104 @@ static NSString *NSPrintOperationThreadKey = @"NSPrintOperationThreadKey";
   [NSPrintOperation setCurrentOperation: self];
   return self;
 }
+
+- (NSString *) _dataOutputPath
+{
+  if (_data == nil)
+    {
+      return nil;
+    }
+  if (_output_sink == nil)
+    {
+      _output_sink = [[GSPrintDataSink alloc] initWithData: _data];
+    }
+  return [_output_sink path];
+}
+
+- (BOOL) _collectDataOutput
+{
+  if (_output_sink == nil)
+    {
+      return NO;
+    }
+  [_output_sink finish];
+  DESTROY(_output_sink);
+  return YES;
+}
+@end
+
+@implementation GSPrintDataSink
+
+- (id) initWithData: (NSMutableData *)data
+{
+  NSPipe *pipe;
+  NSString *path;
+
+  if ((self = [super init]) == nil)
+    {
+      return nil;
+    }
+  pipe = [NSPipe pipe];
+  path = [NSString stringWithFormat: @"/dev/fd/%d",
+                   [[pipe fileHandleForWriting] fileDescriptor]];
+  if (pipe == nil
+      || ![[NSFileManager defaultManager] fileExistsAtPath: path])
+    {
+      DESTROY(self);
+      return nil;
+    }
+  ASSIGN(_data, data);
+  ASSIGN(_reader, [pipe fileHandleForReading]);
+  ASSIGN(_writer, [pipe fileHandleForWriting]);
+  _done = [[NSConditionLock alloc] initWithCondition: 0];
+  [NSThread detachNewThreadSelector: @selector(_drain:)
+                           toTarget: self
+                         withObject: nil];
+  return self;
+}
+
+- (void) dealloc
+{
+  RELEASE(_data);
+  RELEASE(_reader);
+  RELEASE(_writer);
+  RELEASE(_done);
+  [super dealloc];
+}
+
+- (NSString *) path
+{
+  return [NSString stringWithFormat: @"/dev/fd/%d", [_writer fileDescriptor]];
+}
+
+- (void) _drain: (id)unused
+{
+  CREATE_AUTORELEASE_POOL(pool);
+  NSData *chunk;
+
+  [_done lock];
+  while ((chunk = [_reader availableData]) != nil && [chunk length] > 0)
+    {
+      [_data appendData: chunk];
+      [pool emptyPool];
+    }
+  [_done unlockWithCondition: 1];
+  RELEASE(pool);
+}
+
+/* Wait until everything written has been read.  This is only complete
+   once the print context has closed its end of the pipe. */
+- (void) finish
+{
+  if (_writer != nil)
+    {
+      [_writer closeFile];
+      DESTROY(_writer);
+    }
+  [_done lockWhenCondition: 1];
+  [_done unlock];
+}
+
 @end
 
 @implementation NSPrintOperation (TrulyPrivate)
@@ -667,15 +830,14 @@ static NSString *NSPrintOperationThreadKey = @"NSPrintOperationThreadKey";
   NS_DURING
     {
       [self _print];
-      result = YES;
+      result = !_flags.cancelled;
       [NSGraphicsContext setCurrentContext: oldContext];
     }
   NS_HANDLER
     {
       [_view _cleanupPrinting];
       [NSGraphicsContext setCurrentContext: oldContext];
-      NSRunAlertPanel(_(@"Error"), _(@"Printing error: %@"), 
-                      _(@"OK"), NULL, NULL, localException);
+      [self _reportPrintError: localException];
     }
   NS_ENDHANDLER
   [self destroyContext];
@@ -711,13 +873,32 @@ static NSString *NSPrintOperationThreadKey = @"NSPrintOperationThreadKey";
 
   if (returnCode == NSOKButton)
     {
+      if ([self canSpawnSeparateThread])
+        {
+          /* The delegate is told when the thread has finished. */
+          [self _startPrintThread];
+          _flags.modal_thread = YES;
+          return;
+        }
       if ([self _runOperation])
         success = [self deliverResult];
     }
   [self cleanUpOperation];
+  [self _notifyModalDelegate: success];
+}
+
+- (void) _notifyModalDelegate: (BOOL)success
+{
+  id delegate;
+  SEL didRunSelector = NULL;
+  void *contextInfo;
+  NSMutableDictionary *dict;
+  void (*didRun)(id, SEL, BOOL, id);
+
   dict = [_print_info dictionary];
   [[dict objectForKey: @"GSModalRunSelector"] getValue: &didRunSelector];
   delegate = [dict objectForKey: @"GSModalRunDelegate"];
+  contextInfo = [[dict objectForKey: @"GSModalRunContextInfo"] pointerValue];
   if (delegate != nil && didRunSelector != NULL)
     {
       didRun = (void (*)(id, SEL, BOOL, id))[delegate methodForSelector: 
@@ -726,6 +907,138 @@ static NSString *NSPrintOperationThreadKey = @"NSPrintOperationThreadKey";
     }
 }
 
+/* Render the pages in a separate thread.  The result is delivered back
+   on the calling thread by -_printThreadDidFinish:. */
+- (void) _startPrintThread
+{
+  _flags.thread_done = NO;
+  _flags.thread_succeeded = NO;
+  _flags.cancelled = NO;
+  _flags.modal_thread = NO;
+  if ([self showsProgressPanel] && NSApp != nil)
+    {
+      if (_progress_panel == nil)
+        {
+          _progress_panel = [[GSPrintProgressPanel alloc]
+                              initWithOperation: self];
+        }
+      [_progress_panel setPage: 0 of: 0];
+      [_progress_panel orderFront: self];
+    }
+  [NSThread detachNewThreadSelector: @selector(_printThread:)
+                           toTarget: self
+                         withObject: [NSThread currentThread]];
+}
+
+- (void) _printThread: (NSThread *)callerThread
+{
+  CREATE_AUTORELEASE_POOL(pool);
+  BOOL result;
+
+  /* The view asks for the current operation while drawing. */
+  [NSPrintOperation setCurrentOperation: self];
+  result = [self _runOperation];
+  [NSPrintOperation setCurrentOperation: nil];
+
+  [self performSelector: @selector(_printThreadDidFinish:)
+               onThread: callerThread
+             withObject: [NSNumber numberWithBool: result]
+          waitUntilDone: NO
+                  modes: [NSArray arrayWithObjects: NSDefaultRunLoopMode,
+                                  NSModalPanelRunLoopMode, nil]];
+  RELEASE(pool);
+}
+
+- (void) _printThreadDidFinish: (NSNumber *)result
+{
+  BOOL success = NO;
+
+  if ([result boolValue])
+    {
+      success = [self deliverResult];
+    }
+  [_progress_panel orderOut: self];
+  _flags.thread_succeeded = success;
+  _flags.thread_done = YES;
+  _flags.cancelled = NO;
+
+  if (_flags.modal_thread)
+    {
+      /* Started from the sheet, -runOperation is not waiting for us. */
+      _flags.modal_thread = NO;
+      RETAIN(self);
+      [self cleanUpOperation];
+      [self _notifyModalDelegate: success];
+      RELEASE(self);
+    }
+}
+
+- (void) _waitForPrintThread
+{
+  NSModalSession session = 0;
+  NSRunLoop *loop = [NSRunLoop currentRunLoop];
+
+  if (_progress_panel != nil && [_progress_panel isVisible])
+    {
+      session = [NSApp beginModalSessionForWindow: _progress_panel];
+    }
+  while (!_flags.thread_done)
+    {
+      if (session != 0)
+        {
+          [NSApp runModalSession: session];
+        }
+      [loop runMode: NSModalPanelRunLoopMode
+         beforeDate: [NSDate dateWithTimeIntervalSinceNow: 0.1]];
+    }
+  if (session != 0)
+    {
+      [NSApp endModalSession: session];
+    }
+}
+
+/* Called after each page.  Updates the progress panel on the main
+   thread and stops the page loop once the user has cancelled. */
+- (void) _reportProgress
+{
+  if (_progress_panel != nil)
+    {
+      [self performSelectorOnMainThread: @selector(_updateProgressPanel:)
+                             withObject: [NSNumber numberWithInt: _currentPage]
+                          waitUntilDone: NO
+                                  modes: [NSArray arrayWithObjects:
+                                                    NSDefaultRunLoopMode,
+                                                  NSModalPanelRunLoopMode,
+                                                  nil]];
+    }
+}
+
+- (void) _updateProgressPanel: (NSNumber *)page
+{
+  NSNumber *total;
+
+  total = [[_print_info dictionary] objectForKey: @"NSPrintTotalPages"];
+  [_progress_panel setPage: [page intValue] of: [total intValue]];
+}
+
+- (void) _cancel: (id)sender
+{
+  _flags.cancelled = YES;
+}
+
+- (void) _reportPrintError: (NSException *)exception
+{
+  if (![NSThread isMainThread])
+    {
+      [self performSelectorOnMainThread: _cmd
+                             withObject: exception
+                          waitUntilDone: NO];
+      return;
+    }
+  NSRunAlertPanel(_(@"Error"), _(@"Printing error: %@"), 
+                  _(@"OK"), NULL, NULL, exception);
+}
+
 
 
 
@@ -1058,7 +1371,7 @@ scaleRect(NSRect rect, double scale)
 
       NSDebugLLog(@"NSPrinting", @" current page %d, rect %@", 
                   _currentPage, NSStringFromRect(pageRect));
-      if (NSIsEmptyRect(pageRect))
+      if (NSIsEmptyRect(pageRect) || _flags.cancelled)
         break;
 
       /* Draw using our special view routine */
@@ -1084,6 +1397,7 @@ scaleRect(NSRect rect, double scale)
           viewPageRange = NSMakeRange(1, (info.xpages * info.ypages));
           info.last = NSMaxRange(viewPageRange) - 1;
         }
+      [self _reportProgress];
       i++;
       _currentPage += dir;
     } /* Print each page */
@@ -1109,6 +1423,66 @@ scaleRect(NSRect rect, double scale)
 
 @end
 
+@implementation GSPrintProgressPanel
+
+- (id) initWithOperation: (NSPrintOperation *)operation
+{
+  NSButton *cancel;
+
+  self = [super initWithContentRect: NSMakeRect(0, 0, 300, 100)
+                          styleMask: NSTitledWindowMask
+                            backing: NSBackingStoreBuffered
+                              defer: YES];
+  if (self == nil)
+    {
+      return nil;
+    }
+  [self setTitle: _(@"Printing")];
+  [self setReleasedWhenClosed: NO];
+
+  _label = [[NSTextField alloc] initWithFrame: NSMakeRect(20, 66, 260, 20)];
+  [_label setEditable: NO];
+  [_label setSelectable: NO];
+  [_label setBezeled: NO];
+  [_label setDrawsBackground: NO];
+  [[self contentView] addSubview: _label];
+  RELEASE(_label);
+
+  _indicator = [[NSProgressIndicator alloc]
+                 initWithFrame: NSMakeRect(20, 44, 260, 16)];
+  [_indicator setIndeterminate: NO];
+  [[self contentView] addSubview: _indicator];
+  RELEASE(_indicator);
+
+  cancel = [[NSButton alloc] initWithFrame: NSMakeRect(200, 8, 80, 24)];
+  [cancel setTitle: _(@"Cancel")];
+  [cancel setTarget: operation];
+  [cancel setAction: @selector(_cancel:)];
+  [[self contentView] addSubview: cancel];
+  RELEASE(cancel);
+
+  [self center];
+  return self;
+}
+
+- (void) setPage: (int)page of: (int)total
+{
+  if (total > 0)
+    {
+      [_label setStringValue:
+        [NSString stringWithFormat: _(@"Page %d of %d"), page, total]];
+      [_indicator setMaxValue: total];
+      [_indicator setDoubleValue: page];
+    }
+  else
+    {
+      [_label setStringValue: _(@"Preparing pages")];
+      [_indicator setDoubleValue: 0];
+    }
+}
+
+@end
+
 @implementation NSView (NSPrintOperation)
 
 - (void) _displayPageInRect: (NSRect)pageRect
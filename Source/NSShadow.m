@@ -27,12 +27,329 @@
    Boston, MA 02110-1301, USA.
 */
 
+#include <math.h>
+#include <pthread.h>
+#include <string.h>
+
+#import <Foundation/NSArray.h>
+#import <Foundation/NSDictionary.h>
+#import <Foundation/NSLock.h>
+#import <Foundation/NSProcessInfo.h>
 #import <Foundation/NSString.h>
-#import "AppKit/NSShadow.h"
+#import "AppKit/NSAffineTransform.h"
+#import "AppKit/NSBitmapImageRep.h"
 #import "AppKit/NSColor.h"
+#import "AppKit/NSGraphics.h"
+#import "AppKit/NSGraphicsContext.h"
+#import "AppKit/NSImage.h"
+#import "AppKit/DPSOperators.h"
+#import "NSShadowPrivate.h"
+
+/* Limits of the cache of blurred masks. */
+#define MASK_CACHE_ENTRIES 64
+#define MASK_CACHE_BYTES (4 * 1024 * 1024)
+
+/* Masks with more pixels than this are blurred by several threads. */
+#define THREADED_BLUR_PIXELS (256 * 256)
+#define MAX_BLUR_THREADS 4
+
+/*
+ * Key of a cached mask.  The object passed by the caller describes the
+ * drawing, the remaining fields what was done with it.
+ */
+@interface GSShadowKey : NSObject <NSCopying>
+{
+  id object;
+  NSSize size;
+  CGFloat radius;
+  CGFloat scale;
+  BOOL flipped;
+  NSUInteger hash;
+}
++ (GSShadowKey *) keyWithObject: (id)anObject
+                           size: (NSSize)aSize
+                         radius: (CGFloat)aRadius
+                          scale: (CGFloat)aScale
+                        flipped: (BOOL)isFlipped;
+@end
+
+@implementation GSShadowKey
+
++ (GSShadowKey *) keyWithObject: (id)anObject
+                           size: (NSSize)aSize
+                         radius: (CGFloat)aRadius
+                          scale: (CGFloat)aScale
+                        flipped: (BOOL)isFlipped
+{
+  GSShadowKey *k = [self new];
+
+  k->object = RETAIN(anObject);
+  k->size = aSize;
+  k->radius = aRadius;
+  k->scale = aScale;
+  k->flipped = isFlipped;
+  k->hash = [anObject hash] ^ ((NSUInteger)(aSize.width * 31 + aSize.height)
+    << 8) ^ (NSUInteger)(aRadius * 1024) ^ (NSUInteger)(aScale * 64);
+  return AUTORELEASE(k);
+}
+
+- (void) dealloc
+{
+  RELEASE(object);
+  [super dealloc];
+}
+
+- (id) copyWithZone: (NSZone*)zone
+{
+  return RETAIN(self);
+}
+
+- (NSUInteger) hash
+{
+  return hash;
+}
+
+- (BOOL) isEqual: (id)other
+{
+  GSShadowKey *k = other;
+
+  if (other == self)
+    {
+      return YES;
+    }
+  if ([other isKindOfClass: [GSShadowKey class]] == NO)
+    {
+      return NO;
+    }
+  return (k->hash == hash && NSEqualSizes(k->size, size)
+    && k->radius == radius && k->scale == scale && k->flipped == flipped
+    && [k->object isEqual: object]);
+}
+
+@end
+
+/*
+ * A blurred coverage mask, one byte per pixel with the top row first,
+ * covering the bounds of the drawing grown by pad on each side.
+ */
+@interface GSShadowMask : NSObject
+{
+@public
+  unsigned char *alpha;
+  NSInteger width;
+  NSInteger height;
+  CGFloat pad;
+}
+@end
+
+@implementation GSShadowMask
+
+- (void) dealloc
+{
+  if (alpha != NULL)
+    {
+      NSZoneFree(NSDefaultMallocZone(), alpha);
+    }
+  [super dealloc];
+}
+
+@end
+
+/* Shadows may be drawn by several threads at once (eg. when printing in
+   the background), so the cache is protected by maskLock. */
+static NSLock *maskLock = nil;
+static NSMutableDictionary *maskCache = nil;
+static NSMutableArray *maskOrder = nil;
+static NSUInteger maskBytes = 0;
+
+static GSShadowMask *
+cachedMask(GSShadowKey *key)
+{
+  GSShadowMask *mask;
+
+  [maskLock lock];
+  mask = RETAIN([maskCache objectForKey: key]);
+  if (mask != nil)
+    {
+      // Move to the end of the eviction order.
+      RETAIN(key);
+      [maskOrder removeObject: key];
+      [maskOrder addObject: key];
+      RELEASE(key);
+    }
+  [maskLock unlock];
+  return AUTORELEASE(mask);
+}
+
+static void
+cacheMask(GSShadowKey *key, GSShadowMask *mask)
+{
+  [maskLock lock];
+  while ([maskOrder count] > 0 && ([maskOrder count] >= MASK_CACHE_ENTRIES
+    || maskBytes + mask->width * mask->height > MASK_CACHE_BYTES))
+    {
+      GSShadowKey *oldest = [maskOrder objectAtIndex: 0];
+      GSShadowMask *old = [maskCache objectForKey: oldest];
+
+      maskBytes -= old->width * old->height;
+      [maskCache removeObjectForKey: oldest];
+      [maskOrder removeObjectAtIndex: 0];
+    }
+  if (mask->width * mask->height <= MASK_CACHE_BYTES)
+    {
+      [maskCache setObject: mask forKey: key];
+      [maskOrder addObject: key];
+      maskBytes += mask->width * mask->height;
+    }
+  [maskLock unlock];
+}
+
+typedef struct {
+  const unsigned char *src;
+  unsigned char *dst;
+  NSInteger width;
+  NSInteger height;
+  NSInteger radius;
+  NSInteger first;
+  NSInteger last;
+} blur_rows_t;
+
+/* Box blurs rows first to last of src, which has height rows of width
+ * pixels.  The result is written transposed to dst, so that running this
+ * twice blurs in both directions while only ever reading whole rows.
+ * The inner loop uses a running sum, so its cost does not depend on the
+ * radius.  Pixels beyond the edges count as transparent. */
+static void *
+boxBlurRows(void *arg)
+{
+  blur_rows_t *b = arg;
+  NSInteger w = b->width;
+  NSInteger h = b->height;
+  NSInteger r = b->radius;
+  unsigned int mul = 65536 / (2 * r + 1);
+  NSInteger x, y;
+
+  for (y = b->first; y < b->last; y++)
+    {
+      const unsigned char *in = b->src + y * w;
+      unsigned char *out = b->dst + y;
+      unsigned int sum = 0;
+
+      for (x = 0; x <= r && x < w; x++)
+        {
+          sum += in[x];
+        }
+      for (x = 0; x < w; x++)
+        {
+          out[x * h] = (sum * mul + 32768) >> 16;
+          if (x + r + 1 < w)
+            {
+              sum += in[x + r + 1];
+            }
+          if (x >= r)
+            {
+              sum -= in[x - r];
+            }
+        }
+    }
+  return NULL;
+}
+
+static void
+blurPass(const unsigned char *src, unsigned char *dst,
+         NSInteger w, NSInteger h, NSInteger r, int threads)
+{
+  blur_rows_t rows[MAX_BLUR_THREADS];
+  pthread_t ids[MAX_BLUR_THREADS];
+  BOOL started[MAX_BLUR_THREADS];
+  int i;
+
+  for (i = 0; i < threads; i++)
+    {
+      rows[i].src = src;
+      rows[i].dst = dst;
+      rows[i].width = w;
+      rows[i].height = h;
+      rows[i].radius = r;
+      rows[i].first = h * i / threads;
+      rows[i].last = h * (i + 1) / threads;
+      started[i] = NO;
+    }
+  for (i = 1; i < threads; i++)
+    {
+      started[i] = (pthread_create(&ids[i], NULL, boxBlurRows, &rows[i]) == 0);
+      if (started[i] == NO)
+        {
+          boxBlurRows(&rows[i]);
+        }
+    }
+  boxBlurRows(&rows[0]);
+  for (i = 1; i < threads; i++)
+    {
+      if (started[i])
+        {
+          pthread_join(ids[i], NULL);
+        }
+    }
+}
+
+/* Approximates a gaussian blur with standard deviation sigma by three
+ * box blurs in each direction. */
+void
+GSShadowBlurMask(unsigned char *mask, NSInteger w, NSInteger h, double sigma)
+{
+  unsigned char *tmp;
+  double ideal = sqrt(4.0 * sigma * sigma + 1.0);
+  int lower = (int)floor(ideal);
+  int threads = 1;
+  int m;
+  int i;
+
+  if (sigma <= 0.0)
+    {
+      return;
+    }
+  if (lower % 2 == 0)
+    {
+      lower--;
+    }
+  // Number of passes using the lower box width.
+  m = (int)floor((12.0 * sigma * sigma - 3 * lower * lower - 12 * lower - 9)
+    / (-4.0 * lower - 4.0) + 0.5);
+
+  if (w * h > THREADED_BLUR_PIXELS)
+    {
+      threads = MIN(MAX_BLUR_THREADS,
+        (int)[[NSProcessInfo processInfo] activeProcessorCount]);
+      threads = MAX(threads, 1);
+    }
+
+  tmp = NSZoneMalloc(NSDefaultMallocZone(), w * h);
+  for (i = 0; i < 3; i++)
+    {
+      NSInteger r = ((i < m ? lower : lower + 2) - 1) / 2;
+
+      if (r > 0)
+        {
+          blurPass(mask, tmp, w, h, r, threads);
+          blurPass(tmp, mask, h, w, r, threads);
+        }
+    }
+  NSZoneFree(NSDefaultMallocZone(), tmp);
+}
 
 @implementation NSShadow
 
++ (void) initialize
+{
+  if (self == [NSShadow class])
+    {
+      maskLock = [NSLock new];
+      maskCache = [[NSMutableDictionary alloc] init];
+      maskOrder = [[NSMutableArray alloc] init];
+    }
+}
+
 - (id) init
 {
   if ((self = [super init]))
@@ -96,7 +413,7 @@
 
 - (void) set
 {
-  // FIXME: Implement
+  [GSCurrentContext() GSSetShadow: self];
 }
 
 - (void) encodeWithCoder: (NSCoder*)aCoder
@@ -142,3 +459,212 @@
 }
 
 @end
+
+@implementation NSShadow (GNUstepPrivate)
+
+/* Renders the drawing into an offscreen image, white on black, and
+ * turns it into a blurred coverage mask. */
+- (GSShadowMask *) _maskOf: (id)target
+                  selector: (SEL)selector
+                  argument: (id)argument
+                    bounds: (NSRect)bounds
+                     scale: (CGFloat)scale
+                   flipped: (BOOL)flipped
+{
+  GSShadowMask *mask;
+  NSGraphicsContext *ctxt;
+  NSBitmapImageRep *rep;
+  NSImage *image;
+  NSRect rect;
+  CGFloat pad = ceil(1.5 * _radius) + 1;
+  NSInteger pw, ph;
+  NSInteger x, y;
+  unsigned char *data;
+  NSInteger spp, bpr, offset;
+
+  rect = NSInsetRect(bounds, -pad, -pad);
+  pw = (NSInteger)ceil(NSWidth(rect) * scale);
+  ph = (NSInteger)ceil(NSHeight(rect) * scale);
+  if (pw <= 0 || ph <= 0 || pw * ph > 4096 * 4096)
+    {
+      return nil;
+    }
+
+  image = [[NSImage alloc] initWithSize: NSMakeSize(pw, ph)];
+  [image lockFocus];
+  ctxt = GSCurrentContext();
+  [[NSColor whiteColor] set];
+  NSRectFill(NSMakeRect(0, 0, pw, ph));
+  if (flipped)
+    {
+      DPStranslate(ctxt, 0, ph);
+      DPSscale(ctxt, scale, -scale);
+    }
+  else
+    {
+      DPSscale(ctxt, scale, scale);
+    }
+  DPStranslate(ctxt, -NSMinX(rect), -NSMinY(rect));
+  [[NSColor blackColor] set];
+  [target performSelector: selector withObject: argument];
+  rep = [[NSBitmapImageRep alloc]
+          initWithFocusedViewRect: NSMakeRect(0, 0, pw, ph)];
+  [image unlockFocus];
+  RELEASE(image);
+  if (rep == nil)
+    {
+      return nil;
+    }
+
+  mask = AUTORELEASE([GSShadowMask new]);
+  mask->width = pw;
+  mask->height = ph;
+  mask->pad = pad;
+  mask->alpha = NSZoneMalloc(NSDefaultMallocZone(), pw * ph);
+
+  /* Whatever the format of the captured pixels, the coverage is the
+     darkness of the darkest channel. */
+  data = [rep bitmapData];
+  spp = [rep samplesPerPixel];
+  bpr = [rep bytesPerRow];
+  offset = ([rep hasAlpha]
+    && ([rep bitmapFormat] & NSAlphaFirstBitmapFormat)) ? 1 : 0;
+  if ([rep bitsPerSample] == 8 && ![rep isPlanar]
+    && [rep pixelsWide] >= pw && [rep pixelsHigh] >= ph)
+    {
+      NSInteger colors = spp - ([rep hasAlpha] ? 1 : 0);
+
+      for (y = 0; y < ph; y++)
+        {
+          const unsigned char *p = data + y * bpr + offset;
+          unsigned char *out = mask->alpha + y * pw;
+
+          for (x = 0; x < pw; x++, p += spp)
+            {
+              unsigned char v = p[0];
+
+              if (colors >= 3)
+                {
+                  v = MIN(v, MIN(p[1], p[2]));
+                }
+              out[x] = 255 - v;
+            }
+        }
+    }
+  else
+    {
+      for (y = 0; y < ph; y++)
+        {
+          for (x = 0; x < pw; x++)
+            {
+              NSColor *c = [[rep colorAtX: x y: y]
+                colorUsingColorSpaceName: NSCalibratedRGBColorSpace];
+              CGFloat v = MIN([c redComponent],
+                MIN([c greenComponent], [c blueComponent]));
+
+              mask->alpha[y * pw + x] = (unsigned char)((1.0 - v) * 255);
+            }
+        }
+    }
+  RELEASE(rep);
+
+  // Cocoa's blur radius covers about two standard deviations.
+  GSShadowBlurMask(mask->alpha, pw, ph, _radius * scale / 2.0);
+  return mask;
+}
+
+- (void) _drawShadowOf: (id)target
+              selector: (SEL)selector
+              argument: (id)argument
+                bounds: (NSRect)bounds
+                   key: (id)key
+{
+  NSGraphicsContext *ctxt = GSCurrentContext();
+  NSColor *color;
+  GSShadowKey *cacheKey = nil;
+  GSShadowMask *mask = nil;
+  NSBitmapImageRep *rep;
+  NSSize unit;
+  NSRect rect;
+  CGFloat scale, r, g, b, a;
+  BOOL flipped;
+  unsigned char *out;
+  NSInteger i;
+
+  color = [_color colorUsingColorSpaceName: NSCalibratedRGBColorSpace];
+  if (color == nil || [color alphaComponent] == 0.0 || NSIsEmptyRect(bounds))
+    {
+      return;
+    }
+
+  /* Render the mask at device resolution. */
+  unit = [[ctxt GSCurrentCTM] transformSize: NSMakeSize(1, 1)];
+  scale = MAX(fabs(unit.width), fabs(unit.height));
+  scale = MIN(MAX(scale, 1.0), 4.0);
+  flipped = [ctxt isFlipped];
+
+  if (key != nil)
+    {
+      cacheKey = [GSShadowKey keyWithObject: key
+                                       size: bounds.size
+                                     radius: _radius
+                                      scale: scale
+                                    flipped: flipped];
+      mask = cachedMask(cacheKey);
+    }
+  if (mask == nil)
+    {
+      mask = [self _maskOf: target
+                  selector: selector
+                  argument: argument
+                    bounds: bounds
+                     scale: scale
+                   flipped: flipped];
+      if (mask == nil)
+        {
+          return;
+        }
+      if (cacheKey != nil)
+        {
+          cacheMask(cacheKey, mask);
+        }
+    }
+
+  /* Colour the mask, premultiplied. */
+  [color getRed: &r green: &g blue: &b alpha: &a];
+  rep = [[NSBitmapImageRep alloc] initWithBitmapDataPlanes: NULL
+                                                pixelsWide: mask->width
+                                                pixelsHigh: mask->height
+                                             bitsPerSample: 8
+                                           samplesPerPixel: 4
+                                                  hasAlpha: YES
+                                                  isPlanar: NO
+                                            colorSpaceName: NSCalibratedRGBColorSpace
+                                               bytesPerRow: mask->width * 4
+                                              bitsPerPixel: 32];
+  out = [rep bitmapData];
+  for (i = 0; i < mask->width * mask->height; i++, out += 4)
+    {
+      CGFloat coverage = mask->alpha[i] * a;
+
+      out[0] = (unsigned char)(r * coverage);
+      out[1] = (unsigned char)(g * coverage);
+      out[2] = (unsigned char)(b * coverage);
+      out[3] = (unsigned char)coverage;
+    }
+
+  /* The offset is in base coordinates, up is always up. */
+  rect = NSInsetRect(bounds, -mask->pad, -mask->pad);
+  rect.size = NSMakeSize(mask->width / scale, mask->height / scale);
+  rect.origin.x += _offset.width;
+  rect.origin.y += flipped ? -_offset.height : _offset.height;
+  [rep drawInRect: rect
+         fromRect: NSZeroRect
+        operation: NSCompositeSourceOver
+         fraction: 1.0
+   respectFlipped: YES
+            hints: nil];
+  RELEASE(rep);
+}
+
+@end
@@ -0,0 +1,59 @@
+/*
+   NSShadowPrivate.h
+
+   Private interface used to draw shadows in software
+
+   Copyright (C) 2026 Free Software Foundation, Inc.
+
+   This file is part of the GNUstep GUI Library.
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with this library; see the file COPYING.LIB.
+   If not, see <http://www.gnu.org/licenses/> or write to the
+   Free Software Foundation, 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#ifndef _GNUstep_H_NSShadowPrivate
+#define _GNUstep_H_NSShadowPrivate
+
+#import "AppKit/NSShadow.h"
+
+/**
+ * Blurs the w by h coverage mask in place, approximating a gaussian blur
+ * with standard deviation sigma.  Pixels beyond the edges count as
+ * transparent.
+ */
+void GSShadowBlurMask(unsigned char *mask, NSInteger w, NSInteger h,
+                      double sigma);
+
+@interface NSShadow (GNUstepPrivate)
+/**
+ * Draws the shadow the receiver casts from some drawing into the current
+ * graphics context.  The drawing is done by sending selector to target
+ * with argument, and must stay within bounds (in user space).  It is
+ * rendered into an offscreen mask with the current colour set to black,
+ * so it only needs to draw the shape casting the shadow.
+ * <p>When key is not nil, it must identify the drawing exactly.  The
+ * blurred mask is then cached under key, the blur radius, the scale and
+ * the size of bounds, and the drawing is only done when the mask is not
+ * in the cache.</p>
+ */
+- (void) _drawShadowOf: (id)target
+              selector: (SEL)selector
+              argument: (id)argument
+                bounds: (NSRect)bounds
+                   key: (id)key;
+@end
+
+#endif // _GNUstep_H_NSShadowPrivate
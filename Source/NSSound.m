@@ -33,15 +33,7 @@
 
 #import "GNUstepGUI/GSSoundSource.h"
 #import "GNUstepGUI/GSSoundSink.h"
-
-// Private NSConditionLock conditions used for streaming
-enum
-{
-  SOUND_SHOULD_PLAY = 1,
-  SOUND_SHOULD_PAUSE
-};
-
-#define BUFFER_SIZE 4096
+#import "GSSoundEngine.h"
 
 /* Class variables and functions for class methods */
 static NSMutableDictionary *nameDict = nil;
@@ -95,6 +87,8 @@ static inline void _loadNSSoundPlugIns (void)
             path);
         }
     }
+  // Plain WAVE files can always be read.
+  [_sourcePlugIns addObject: [GSWaveSoundSource class]];
   
   sourcePlugIns = [[NSArray alloc] initWithArray: _sourcePlugIns];
   sinkPlugIns = [[NSArray alloc] initWithArray: _sinkPlugIns];
@@ -131,68 +125,25 @@ static inline void _loadNSSoundPlugIns (void)
 
 @end 
 
-@interface NSSound (PrivateMethods)
+@implementation NSSound (GSSoundEngine)
 
-- (void)_stream;
-- (void)_finished: (NSNumber *)finishedPlaying;
-
-@end
-
-@implementation NSSound (PrivateMethods)
-
-- (void)_stream
++ (NSArray *) _soundSinkPlugIns
 {
-  NSUInteger bytesRead;
-  BOOL success = NO;
-  void *buffer;
-  
-  // Exit with success = NO if device could not be open.
-  if ([_sink open])
-    {
-      // Allocate space for buffer and start writing.
-      buffer = NSZoneMalloc(NSDefaultMallocZone(), BUFFER_SIZE);
-      do
-        {
-          do
-            {
-              // If not SOUND_SHOULD_PLAY block thread
-              [_readLock lockWhenCondition: SOUND_SHOULD_PLAY];
-              if (_shouldStop)
-                {
-                  [_readLock unlock];
-                  break;
-                }
-              bytesRead = [_source readBytes: buffer
-                                     length: BUFFER_SIZE];
-              [_readLock unlock];
-              [_playbackLock lock];
-              success = [_sink playBytes: buffer length: bytesRead];
-              [_playbackLock unlock];
-            } while ((!_shouldStop) && (bytesRead > 0) && success);
-          
-          [_source setCurrentTime: 0.0];
-        } while (_shouldLoop == YES && _shouldStop == NO);
-      
-      [_sink close];
-      NSZoneFree (NSDefaultMallocZone(), buffer);
-    }
-  
-  RETAIN(self);
-  [self performSelectorOnMainThread: @selector(_finished:)
-                         withObject: [NSNumber numberWithBool: success]
-                      waitUntilDone: YES];
-  RELEASE(self);
+  return sinkPlugIns;
 }
 
-- (void)_finished: (NSNumber *)finishedPlaying
+- (void) _voiceDidFinish: (NSArray *)info
 {
-  DESTROY(_readLock);
-  DESTROY(_playbackLock);
+  if (_voice == [info objectAtIndex: 0])
+    {
+      DESTROY(_voice);
+    }
   
   /* FIXME: should I call -sound:didFinishPlaying: when -stop was sent? */
   if ([_delegate respondsToSelector: @selector(sound:didFinishPlaying:)])
     {
-      [_delegate sound: self didFinishPlaying: [finishedPlaying boolValue]];
+      [_delegate sound: self
+        didFinishPlaying: [[info objectAtIndex: 1] boolValue]];
     }
 }
 
@@ -236,7 +187,7 @@ static inline void _loadNSSoundPlugIns (void)
   RELEASE (_playbackDeviceIdentifier);
   RELEASE (_channelMapping);
   RELEASE (_source);
-  RELEASE (_sink);
+  RELEASE (_pcm);
   
   [super dealloc];
 }
@@ -275,8 +226,7 @@ static inline void _loadNSSoundPlugIns (void)
 - (id) initWithData: (NSData *)data
 {
   NSEnumerator *enumerator;
-  Class sourceClass,
-        sinkClass;
+  Class sourceClass;
     
   _data = data;
   RETAIN(_data);
@@ -298,34 +248,13 @@ static inline void _loadNSSoundPlugIns (void)
         }
     }
   
-  enumerator = [sinkPlugIns objectEnumerator];
-  /* FIXME: Grab the first available sink/device for now.  In the future
-       look for what is set in the GSSoundDeviceBundle default first. */
-  while ((sinkClass = [enumerator nextObject]) != nil)
-    {
-      if ([sinkClass canInitWithPlaybackDevice: nil])
-        {
-          _sink = [[sinkClass alloc] initWithEncoding: [_source encoding]
-                                             channels: [_source channelCount]
-                                           sampleRate: [_source sampleRate]
-                                            byteOrder: [_source byteOrder]];
-          if (_sink == nil)
-            {
-              NSLog (@"Could not open sound sink!");
-              DESTROY(self);
-              return nil;
-            }
-          break;
-        }
-    }
-  
-  /* FIXME: There has to be a better way to do this check??? */
-  if (sourceClass == nil || sinkClass == nil)
+  if (sourceClass == nil)
     {
       NSLog (@"Could not find suitable sound plug-in");
       DESTROY(self);
       return nil;
     }
+  _volume = 1.0;
   
   return self;
 }
@@ -347,113 +276,137 @@ static inline void _loadNSSoundPlugIns (void)
 //
 - (BOOL) pause 
 {
-  // Do nothing if sound is already paused.
-  if ([_readLock condition] == SOUND_SHOULD_PAUSE)
+  GSSoundEngine *engine = [GSSoundEngine sharedEngine];
+  BOOL paused = NO;
+  
+  // Do nothing if sound is not playing or is already paused.
+  [engine lock];
+  if (_voice != nil && _voice->paused == NO)
     {
-      return NO;
+      _voice->paused = YES;
+      paused = YES;
     }
-  
-  if ([_readLock tryLock] == NO)
+  [engine unlock];
+  return paused;
+}
+
+/* All sounds share the engine's sink, so the device and channel mapping
+   of the sound started or changed last apply to every sound playing. */
+- (void) _applyOutputSettings
+{
+  GSSoundEngine *engine = [GSSoundEngine sharedEngine];
+
+  if (_playbackDeviceIdentifier != nil)
     {
-      return NO;
+      [engine setPlaybackDeviceIdentifier: _playbackDeviceIdentifier];
+    }
+  if (_channelMapping != nil)
+    {
+      [engine setChannelMapping: _channelMapping];
     }
-  [_readLock unlockWithCondition: SOUND_SHOULD_PAUSE];
-  return YES;
 }
 
 - (BOOL) play
 {
-  // If the locks exists this instance is already playing
-  if (_readLock != nil && _playbackLock != nil)
+  // If there is a voice this instance is already playing
+  if (_voice != nil)
     {
       return NO;
     }
   
-  _readLock = [[NSConditionLock alloc] initWithCondition: SOUND_SHOULD_PAUSE];
-  _playbackLock = [[NSLock alloc] init];
-
-  if ([_readLock tryLock] != YES)
+  _voice = [[GSSoundVoice alloc] initWithSource: _source pcm: _pcm];
+  if (_voice == nil)
     {
       return NO;
     }
-  _shouldStop = NO;
-  [NSThread detachNewThreadSelector: @selector(_stream)
-                           toTarget: self
-                         withObject: nil];
-  [_readLock unlockWithCondition: SOUND_SHOULD_PLAY];
+  _voice->sound = RETAIN(self);
+  _voice->volume = _volume;
+  _voice->loops = _shouldLoop;
+  if (_pcm != nil)
+    {
+      [_voice setCurrentTime: [_source currentTime]];
+    }
+  [self _applyOutputSettings];
+  [[GSSoundEngine sharedEngine] addVoice: _voice];
   
   return YES;
 }
 
 - (BOOL) resume
 {
-  // Do nothing if sound is already playing.
-  if ([_readLock condition] == SOUND_SHOULD_PLAY)
-    {
-      return NO;
-    }
+  GSSoundEngine *engine = [GSSoundEngine sharedEngine];
+  BOOL resumed = NO;
   
-  if ([_readLock tryLock] == NO)
+  // Do nothing if sound is not paused.
+  [engine lock];
+  if (_voice != nil && _voice->paused == YES)
     {
-      return NO;
+      _voice->paused = NO;
+      resumed = YES;
     }
-  [_readLock unlockWithCondition: SOUND_SHOULD_PLAY];
-  return YES;
+  [engine unlock];
+  return resumed;
 }
 
 - (BOOL) stop
 {
-  if (_readLock == nil)
+  if (_voice == nil)
     {
       return NO;
     }
   
-  if ([_readLock tryLock] != YES)
-    {
-      return NO;
-    }
-  _shouldStop = YES;
-  // Set to SOUND_SHOULD_PLAY so that thread isn't blocked.
-  [_readLock unlockWithCondition: SOUND_SHOULD_PLAY];
+  /* The engine tells us with -_voiceDidFinish: once the voice is gone,
+     but we can play again straight away. */
+  [[GSSoundEngine sharedEngine] removeVoice: _voice];
+  DESTROY(_voice);
   
   return YES;
 }
 
 - (BOOL) isPlaying
 {
-  if (_readLock == nil)
-    {
-      return NO;
-    }
-  if ([_readLock condition] == SOUND_SHOULD_PLAY)
-    {
-      return YES;
-    }
-  return NO;
+  return (_voice != nil && _voice->paused == NO);
 }
 
 - (float) volume
 {
-  return [_sink volume];
+  return _volume;
 }
 
 - (void) setVolume: (float) volume
 {
-  [_playbackLock lock];
-  [_sink setVolume: volume];
-  [_playbackLock unlock];
+  _volume = MAX(0.0, MIN(volume, 1.0));
+  if (_voice != nil)
+    {
+      _voice->volume = _volume;
+    }
 }
 
 - (NSTimeInterval) currentTime
 {
-  return [_source currentTime];
+  GSSoundEngine *engine = [GSSoundEngine sharedEngine];
+  NSTimeInterval time;
+  
+  [engine lock];
+  time = (_voice != nil) ? [_voice currentTime] : [_source currentTime];
+  [engine unlock];
+  return time;
 }
 
 - (void) setCurrentTime: (NSTimeInterval) currentTime
 {
-  [_readLock lock];
-  [_source setCurrentTime: currentTime];
-  [_readLock unlock];
+  GSSoundEngine *engine = [GSSoundEngine sharedEngine];
+  
+  [engine lock];
+  if (_voice != nil)
+    {
+      [_voice setCurrentTime: currentTime];
+    }
+  else
+    {
+      [_source setCurrentTime: currentTime];
+    }
+  [engine unlock];
 }
 
 - (BOOL) loops
@@ -464,6 +417,10 @@ static inline void _loadNSSoundPlugIns (void)
 - (void) setLoops: (BOOL) loops
 {
   _shouldLoop = loops;
+  if (_voice != nil)
+    {
+      _voice->loops = loops;
+    }
 }
 
 - (NSTimeInterval) duration
@@ -619,6 +576,12 @@ static inline void _loadNSSoundPlugIns (void)
 	      [sound setName: name];
 	      RELEASE(sound);	
 	      sound->_onlyReference = YES;
+	      /* Named sounds are mostly short alerts played over and
+		 over, keep them decoded. */
+	      if ([sound duration] <= GS_SOUND_PREDECODE_LIMIT)
+		{
+		  ASSIGN(sound->_pcm, [GSSoundEngine decodeSource: sound->_source]);
+		}
 	    }
 
 	  return sound;
@@ -686,29 +649,34 @@ static inline void _loadNSSoundPlugIns (void)
 
 - (NSString *) playbackDeviceIdentifier
 {
-  return [_sink playbackDeviceIdentifier];
+  return _playbackDeviceIdentifier;
 }
 
 - (void) setPlaybackDeviceIdentifier: (NSString *)playbackDeviceIdentifier
 {
-  if ([[_sink class] canInitWithPlaybackDevice: playbackDeviceIdentifier])
+  if ([[[GSSoundEngine sharedEngine] sinkClass]
+        canInitWithPlaybackDevice: playbackDeviceIdentifier])
     {
-      [_playbackLock lock];
-      [_sink setPlaybackDeviceIdentifier: playbackDeviceIdentifier];
-      [_playbackLock unlock];
+      ASSIGN(_playbackDeviceIdentifier, playbackDeviceIdentifier);
+      if (_voice != nil)
+        {
+          [self _applyOutputSettings];
+        }
     }
 }
 
 - (NSArray *) channelMapping
 {
-  return [_sink channelMapping];
+  return _channelMapping;
 }
 
 - (void) setChannelMapping: (NSArray *)channelMapping
 {
-  [_playbackLock lock];
-  [_sink setChannelMapping: channelMapping];
-  [_playbackLock unlock];
+  ASSIGN(_channelMapping, channelMapping);
+  if (_voice != nil)
+    {
+      [self _applyOutputSettings];
+    }
 }
 
 //
@@ -780,6 +748,8 @@ static inline void _loadNSSoundPlugIns (void)
   newSound->_playbackDeviceIdentifier = [_playbackDeviceIdentifier
                                           copyWithZone: zone];
   newSound->_channelMapping = [_channelMapping copyWithZone: zone];
+  newSound->_pcm = RETAIN(_pcm);
+  newSound->_voice = nil;
 	
   /* FIXME: Need to prepare the object for playback before going further. */
   return newSound;
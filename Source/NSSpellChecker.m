@@ -33,15 +33,19 @@
 #import "config.h"
 #import <Foundation/NSArray.h>
 #import <Foundation/NSBundle.h>
+#import <Foundation/NSCharacterSet.h>
 #import <Foundation/NSConnection.h>
 #import <Foundation/NSDictionary.h>
 #import <Foundation/NSDistantObject.h>
 #import <Foundation/NSEnumerator.h>
 #import <Foundation/NSException.h>
+#import <Foundation/NSLock.h>
 #import <Foundation/NSNotification.h>
+#import <Foundation/NSOperation.h>
 #import <Foundation/NSProxy.h>
 #import <Foundation/NSSet.h>
 #import <Foundation/NSSpellServer.h>
+#import <Foundation/NSThread.h>
 #import <Foundation/NSUserDefaults.h>
 #import <Foundation/NSValue.h>
 #import "AppKit/NSBrowser.h"
@@ -75,6 +79,12 @@ extern NSString *GSSpellServerName(NSString *checkerDictionary, NSString *langua
 			      wordCount: (int *)wordCount
 			      countOnly: (BOOL)countOnly;
 
+// Returns the ranges of all misspelled words in stringToCheck in one
+// message.  Spell servers other than GSspell may not implement this.
+- (bycopy NSArray *) _findMisspelledWordsInString: (NSString *)stringToCheck
+					 language: (NSString *)language
+				     ignoredWords: (NSArray *)ignoredWords;
+
 - (BOOL) _learnWord: (NSString *)word
        inDictionary: (NSString *)language;
 
@@ -155,6 +165,112 @@ extern NSString *GSSpellServerName(NSString *checkerDictionary, NSString *langua
 static NSSpellChecker *__sharedSpellChecker = nil;
 static int __documentTag = 0;
 
+// Queue running the spell checks requested from the background.
+static NSOperationQueue *__checkQueue = nil;
+
+// The most words cached for a document before its cache is emptied.
+#define MAX_CACHED_WORDS 20000
+
+// The most words sent to a server without -_findMisspelledWordsInString:...
+// at once, which bounds what is sent again after each misspelling.
+#define MAX_WORDS_PER_MESSAGE 64
+
+// The last server found not to implement -_findMisspelledWordsInString:...
+// Only compared against, so not retained.  Protected by the cache lock.
+static id __legacyServer = nil;
+
+/* Returns the ranges of the words within range of string.  A word is a
+ * run of letters, which may contain single apostrophes.  Not static, so
+ * that the tests can call it.  */
+NSArray *
+GSSpellCheckerWordRanges(NSString *string, NSRange range)
+{
+  NSCharacterSet *letters = [NSCharacterSet letterCharacterSet];
+  NSMutableArray *words = [NSMutableArray array];
+  NSUInteger end = NSMaxRange(range);
+  NSUInteger i = range.location;
+
+  while (i < end)
+    {
+      NSUInteger start;
+
+      while (i < end
+        && ![letters characterIsMember: [string characterAtIndex: i]])
+        {
+          i++;
+        }
+      start = i;
+      while (i < end)
+        {
+          unichar c = [string characterAtIndex: i];
+
+          if (![letters characterIsMember: c]
+            && !(c == '\'' && i > start && i + 1 < end
+                 && [letters characterIsMember:
+                               [string characterAtIndex: i + 1]]))
+            {
+              break;
+            }
+          i++;
+        }
+      if (i > start)
+        {
+          [words addObject:
+            [NSValue valueWithRange: NSMakeRange(start, i - start)]];
+        }
+    }
+  return words;
+}
+
+// Checks a string on the spell checker queue.
+@interface GSSpellCheckOperation : NSOperation
+{
+  NSSpellChecker        *checker;
+  NSString              *string;
+  NSRange               range;
+  NSString              *language;
+  NSArray               *ignoredWords;
+  NSMutableDictionary   *cache;
+  id                    proxy;
+  id                    target;
+  SEL                   selector;
+  NSDictionary          *result;
+}
+- (id) initWithChecker: (NSSpellChecker *)aChecker
+                string: (NSString *)aString
+                 range: (NSRange)aRange
+              language: (NSString *)aLanguage
+          ignoredWords: (NSArray *)words
+                 cache: (NSMutableDictionary *)aCache
+                 proxy: (id)aProxy
+                target: (id)aTarget
+              selector: (SEL)aSelector;
+- (BOOL) isSupersededByRange: (NSRange)aRange
+                      target: (id)aTarget
+                    selector: (SEL)aSelector;
+@end
+
+@interface NSSpellChecker (GNUstepPrivate)
+- (NSMutableDictionary *) _wordCacheForTag: (NSInteger)tag;
+- (void) _flushWordCaches;
+- (NSArray *) _misspelledRangesInString: (NSString *)string
+                                  range: (NSRange)range
+                               language: (NSString *)language
+                           ignoredWords: (NSArray *)ignored
+                                  cache: (NSMutableDictionary *)cache
+                                  proxy: (id)proxy;
+- (void) _checkWords: (NSArray *)words
+            language: (NSString *)language
+        ignoredWords: (NSArray *)ignored
+               proxy: (id)proxy
+            verdicts: (NSMutableDictionary *)verdicts;
+- (void) _checkWordsOneByOne: (NSArray *)words
+                    language: (NSString *)language
+                ignoredWords: (NSArray *)ignored
+                       proxy: (id)proxy
+                    verdicts: (NSMutableDictionary *)verdicts;
+@end
+
 // Implementation of spell checker class
 @implementation NSSpellChecker
 //
@@ -166,6 +282,10 @@ static int __documentTag = 0;
     {
       // Initial version
       [self setVersion:1];
+
+      // Checks go through one connection, so run them one at a time.
+      __checkQueue = [NSOperationQueue new];
+      [__checkQueue setMaxConcurrentOperationCount: 1];
     }
 }
 
@@ -238,6 +358,9 @@ static int __documentTag = 0;
 	selector: @selector(_handleServerDeath:)
 	name: NSConnectionDidDieNotification
 	object: [(NSDistantObject *)proxy connectionForProxy]];
+
+      // Spelling is also checked from the checker queue.
+      [[(NSDistantObject *)proxy connectionForProxy] enableMultipleThreads];
     }
 
   return proxy;
@@ -300,6 +423,8 @@ static int __documentTag = 0;
   _serverProxy = nil;
   _currentTag = 0;
   _ignoredWords = [NSMutableDictionary new];
+  _wordCaches = [NSMutableDictionary new];
+  _cacheLock = [NSLock new];
 
   // Load the NIB file from the GUI bundle
   if (![GSGuiBundle() loadNibFile: @"GSSpellPanel"
@@ -318,6 +443,8 @@ static int __documentTag = 0;
 {
   RELEASE(_language);
   RELEASE(_ignoredWords);
+  RELEASE(_wordCaches);
+  RELEASE(_cacheLock);
   RELEASE(_serverProxy);
   [super dealloc];
 }
@@ -509,6 +636,9 @@ static int __documentTag = 0;
 {
   NSNumber *key = [NSNumber numberWithInt: tag];
   [_ignoredWords removeObjectForKey: key];
+  [_cacheLock lock];
+  [_wordCaches removeObjectForKey: key];
+  [_cacheLock unlock];
 }
 
 // Add a word to the ignored list.
@@ -598,6 +728,7 @@ inSpellDocumentWithTag:(int)tag
       NSLog(@"%@",[localException reason]);
     }
   NS_ENDHANDLER
+  [self _flushWordCaches];
 
   [self _findNext: sender];
 }
@@ -618,6 +749,7 @@ inSpellDocumentWithTag:(int)tag
       NSLog(@"%@",[localException reason]);
     }
   NS_ENDHANDLER
+  [self _flushWordCaches];
 
   [self _findNext: sender];
 }
@@ -670,6 +802,7 @@ inSpellDocumentWithTag:(int)tag
 	{
 	  ASSIGN(_language, language);
 	  ASSIGN(_serverProxy, (id)proxy);
+	  [self _flushWordCaches];
 	}
       else
 	{
@@ -717,6 +850,408 @@ inSpellDocumentWithTag:(int)tag
 }
 @end
 
+@implementation NSSpellChecker (GNUstepExtensions)
+
+- (NSArray *) misspelledRangesInString: (NSString *)stringToCheck
+                                 range: (NSRange)range
+                inSpellDocumentWithTag: (NSInteger)tag
+{
+  return [self _misspelledRangesInString: stringToCheck
+                                   range: range
+                                language: _language
+                            ignoredWords:
+                              [self ignoredWordsInSpellDocumentWithTag: tag]
+                                   cache: [self _wordCacheForTag: tag]
+                                   proxy: [self _serverProxy]];
+}
+
+- (void) requestMisspelledRangesInString: (NSString *)stringToCheck
+                                   range: (NSRange)range
+                  inSpellDocumentWithTag: (NSInteger)tag
+                                  target: (id)target
+                                selector: (SEL)selector
+{
+  GSSpellCheckOperation *op;
+  NSEnumerator *e;
+
+  // Checks of text this one covers again are out of date.
+  e = [[__checkQueue operations] objectEnumerator];
+  while ((op = [e nextObject]) != nil)
+    {
+      if ([op isSupersededByRange: range target: target selector: selector])
+        {
+          [op cancel];
+        }
+    }
+
+  // The server is started here, so it is never done from the queue.
+  op = [[GSSpellCheckOperation alloc]
+         initWithChecker: self
+                  string: [stringToCheck substringWithRange: range]
+                   range: range
+                language: _language
+            ignoredWords: [self ignoredWordsInSpellDocumentWithTag: tag]
+                   cache: [self _wordCacheForTag: tag]
+                   proxy: [self _serverProxy]
+                  target: target
+                selector: selector];
+  [__checkQueue addOperation: op];
+  RELEASE(op);
+}
+
+@end
+
+@implementation NSSpellChecker (GNUstepPrivate)
+
+- (NSMutableDictionary *) _wordCacheForTag: (NSInteger)tag
+{
+  NSNumber *key = [NSNumber numberWithInt: tag];
+  NSMutableDictionary *cache;
+
+  [_cacheLock lock];
+  cache = [_wordCaches objectForKey: key];
+  if (cache == nil)
+    {
+      cache = [NSMutableDictionary new];
+      [_wordCaches setObject: cache forKey: key];
+      RELEASE(cache);
+    }
+  else if ([cache count] > MAX_CACHED_WORDS)
+    {
+      [cache removeAllObjects];
+    }
+  RETAIN(cache);
+  [_cacheLock unlock];
+
+  return AUTORELEASE(cache);
+}
+
+- (void) _flushWordCaches
+{
+  [_cacheLock lock];
+  [_wordCaches removeAllObjects];
+  [_cacheLock unlock];
+}
+
+/* Asks the server for the verdicts on words, which are sent joined into
+ * one string, in a single message.  */
+- (void) _checkWords: (NSArray *)words
+            language: (NSString *)language
+        ignoredWords: (NSArray *)ignored
+               proxy: (id)proxy
+            verdicts: (NSMutableDictionary *)verdicts
+{
+  NSNumber *good = [NSNumber numberWithBool: YES];
+  NSNumber *bad = [NSNumber numberWithBool: NO];
+  NSArray *ranges;
+  NSUInteger count = [words count];
+  NSUInteger n = 0;
+  NSUInteger pos = 0;
+  NSUInteger i;
+
+  ranges = [proxy _findMisspelledWordsInString:
+                    [words componentsJoinedByString: @" "]
+                                      language: language
+                                  ignoredWords: ignored];
+  for (i = 0; i < count; i++)
+    {
+      NSString *word = [words objectAtIndex: i];
+      NSUInteger end = pos + [word length];
+      BOOL misspelled = NO;
+
+      // Both are in ascending order.
+      while (n < [ranges count])
+        {
+          NSRange r = [[ranges objectAtIndex: n] rangeValue];
+
+          if (NSMaxRange(r) <= pos || r.length == 0)
+            {
+              n++;
+              continue;
+            }
+          misspelled = (r.location < end);
+          break;
+        }
+      [verdicts setObject: (misspelled ? bad : good) forKey: word];
+      pos = end + 1;
+    }
+}
+
+/* Asks a server which can only return the first misspelled word of a
+ * string for the verdicts on words.  Every word before the misspelled
+ * word it returns is spelled correctly, so the words after it are sent
+ * again.  They are sent in groups of MAX_WORDS_PER_MESSAGE so that this
+ * stays linear in the number of words.  */
+- (void) _checkWordsOneByOne: (NSArray *)words
+                    language: (NSString *)language
+                ignoredWords: (NSArray *)ignored
+                       proxy: (id)proxy
+                    verdicts: (NSMutableDictionary *)verdicts
+{
+  NSNumber *good = [NSNumber numberWithBool: YES];
+  NSNumber *bad = [NSNumber numberWithBool: NO];
+  NSUInteger count = [words count];
+  NSUInteger first = 0;
+
+  while (first < count)
+    {
+      NSArray *batch;
+      NSRange r;
+      NSUInteger pos = 0;
+      NSUInteger last;
+      NSUInteger next;
+      int wordCount;
+
+      last = MIN(count, first + MAX_WORDS_PER_MESSAGE);
+      batch = [words subarrayWithRange: NSMakeRange(first, last - first)];
+      r = [proxy _findMisspelledWordInString:
+                   [batch componentsJoinedByString: @" "]
+                                    language: language
+                                ignoredWords: ignored
+                                   wordCount: &wordCount
+                                   countOnly: NO];
+      if (r.length == 0)
+        {
+          r.location = NSNotFound;
+        }
+
+      // Words before r are fine, the ones overlapping it are not.
+      for (next = first; next < last; next++)
+        {
+          NSString *word = [words objectAtIndex: next];
+          NSUInteger end = pos + [word length];
+
+          if (r.location != NSNotFound && end > r.location)
+            {
+              if (pos >= NSMaxRange(r))
+                break;
+              [verdicts setObject: bad forKey: word];
+            }
+          else
+            {
+              [verdicts setObject: good forKey: word];
+            }
+          pos = end + 1;
+        }
+      first = next;
+    }
+}
+
+/* Does the work of -misspelledRangesInString:range:inSpellDocumentWithTag:
+ * and can be called from any thread.  Words not in the cache are sent to
+ * the server joined into one string, which returns all the misspelled
+ * ones in a single round trip.  */
+- (NSArray *) _misspelledRangesInString: (NSString *)string
+                                  range: (NSRange)range
+                               language: (NSString *)language
+                           ignoredWords: (NSArray *)ignored
+                                  cache: (NSMutableDictionary *)cache
+                                  proxy: (id)proxy
+{
+  NSArray *words = GSSpellCheckerWordRanges(string, range);
+  NSSet *ignoredSet = [NSSet setWithArray: ignored];
+  NSMutableDictionary *verdicts = [NSMutableDictionary dictionary];
+  NSMutableArray *unknown = [NSMutableArray array];
+  NSMutableArray *misspelled = [NSMutableArray array];
+  NSNumber *good = [NSNumber numberWithBool: YES];
+  NSNumber *bad = [NSNumber numberWithBool: NO];
+  NSUInteger count = [words count];
+  NSUInteger i;
+
+  [_cacheLock lock];
+  for (i = 0; i < count; i++)
+    {
+      NSString *word = [string substringWithRange:
+                                 [[words objectAtIndex: i] rangeValue]];
+
+      if ([verdicts objectForKey: word] == nil)
+        {
+          NSNumber *verdict = [cache objectForKey: word];
+
+          if ([ignoredSet containsObject: word])
+            {
+              verdict = good;
+            }
+          if (verdict == nil)
+            {
+              [unknown addObject: word];
+              verdict = good;
+            }
+          [verdicts setObject: verdict forKey: word];
+        }
+    }
+  [_cacheLock unlock];
+
+  if ([unknown count] > 0 && proxy != nil)
+    {
+      NSMutableDictionary *found = [NSMutableDictionary dictionary];
+      BOOL legacy;
+
+      [_cacheLock lock];
+      legacy = (proxy == __legacyServer);
+      [_cacheLock unlock];
+
+      NS_DURING
+        {
+          if (!legacy)
+            {
+              NS_DURING
+                {
+                  [self _checkWords: unknown
+                           language: language
+                       ignoredWords: ignored
+                              proxy: proxy
+                           verdicts: found];
+                }
+              NS_HANDLER
+                {
+                  if (![[localException name]
+                         isEqualToString: NSInvalidArgumentException])
+                    {
+                      [localException raise];
+                    }
+                  legacy = YES;
+                  [_cacheLock lock];
+                  __legacyServer = proxy;
+                  [_cacheLock unlock];
+                }
+              NS_ENDHANDLER
+            }
+          if (legacy)
+            {
+              [self _checkWordsOneByOne: unknown
+                               language: language
+                           ignoredWords: ignored
+                                  proxy: proxy
+                               verdicts: found];
+            }
+
+          [verdicts addEntriesFromDictionary: found];
+          [_cacheLock lock];
+          [cache addEntriesFromDictionary: found];
+          [_cacheLock unlock];
+        }
+      NS_HANDLER
+        {
+          NSLog(@"%@",[localException reason]);
+        }
+      NS_ENDHANDLER
+    }
+
+  for (i = 0; i < count; i++)
+    {
+      NSValue *value = [words objectAtIndex: i];
+
+      if (![[verdicts objectForKey:
+                        [string substringWithRange: [value rangeValue]]]
+             boolValue])
+        {
+          [misspelled addObject: value];
+        }
+    }
+  return misspelled;
+}
+
+@end
+
+@implementation GSSpellCheckOperation
+
+- (id) initWithChecker: (NSSpellChecker *)aChecker
+                string: (NSString *)aString
+                 range: (NSRange)aRange
+              language: (NSString *)aLanguage
+          ignoredWords: (NSArray *)words
+                 cache: (NSMutableDictionary *)aCache
+                 proxy: (id)aProxy
+                target: (id)aTarget
+              selector: (SEL)aSelector
+{
+  if ((self = [super init]) != nil)
+    {
+      ASSIGN(checker, aChecker);
+      ASSIGN(string, aString);
+      range = aRange;
+      ASSIGN(language, aLanguage);
+      ASSIGN(ignoredWords, words);
+      ASSIGN(cache, aCache);
+      ASSIGN(proxy, aProxy);
+      ASSIGN(target, aTarget);
+      selector = aSelector;
+    }
+  return self;
+}
+
+- (void) dealloc
+{
+  RELEASE(checker);
+  RELEASE(string);
+  RELEASE(language);
+  RELEASE(ignoredWords);
+  RELEASE(cache);
+  RELEASE(proxy);
+  RELEASE(target);
+  RELEASE(result);
+  [super dealloc];
+}
+
+- (BOOL) isSupersededByRange: (NSRange)aRange
+                      target: (id)aTarget
+                    selector: (SEL)aSelector
+{
+  return target == aTarget && sel_isEqual(selector, aSelector)
+    && NSEqualRanges(NSUnionRange(range, aRange), aRange);
+}
+
+- (void) main
+{
+  CREATE_AUTORELEASE_POOL(pool);
+  NSMutableArray *ranges = [NSMutableArray array];
+  NSEnumerator *e;
+  NSValue *value;
+
+  if ([self isCancelled])
+    {
+      RELEASE(pool);
+      return;
+    }
+
+  // Report the ranges in the string the caller gave.
+  e = [[checker _misspelledRangesInString: string
+                                    range: NSMakeRange(0, [string length])
+                                 language: language
+                             ignoredWords: ignoredWords
+                                    cache: cache
+                                    proxy: proxy] objectEnumerator];
+  while ((value = [e nextObject]) != nil)
+    {
+      NSRange r = [value rangeValue];
+
+      r.location += range.location;
+      [ranges addObject: [NSValue valueWithRange: r]];
+    }
+  result = [[NSDictionary alloc] initWithObjectsAndKeys:
+    string, @"String",
+    [NSValue valueWithRange: range], @"Range",
+    ranges, @"Ranges", nil];
+
+  [self performSelectorOnMainThread: @selector(_finish)
+                         withObject: nil
+                      waitUntilDone: NO];
+  RELEASE(pool);
+}
+
+- (void) _finish
+{
+  // A newer check of the text may have been requested meanwhile.
+  if (![self isCancelled])
+    {
+      [target performSelector: selector withObject: result];
+    }
+  DESTROY(target);
+}
+
+@end
+
 @interface NSSpellChecker(SpellBrowserDelegate)
 - (BOOL) browser: (NSBrowser*)sender selectRow: (NSInteger)row inColumn: (NSInteger)column;
 
@@ -31,6 +31,7 @@
 */ 
 
 #import <Foundation/NSAutoreleasePool.h>
+#import <Foundation/NSDate.h>
 #import <Foundation/NSDebug.h>
 #import <Foundation/NSDictionary.h>
 #import <Foundation/NSEnumerator.h>
@@ -38,6 +39,7 @@
 #import <Foundation/NSFormatter.h>
 #import <Foundation/NSIndexSet.h>
 #import <Foundation/NSKeyValueCoding.h>
+#import <Foundation/NSMapTable.h>
 #import <Foundation/NSNotification.h>
 #import <Foundation/NSSet.h>
 #import <Foundation/NSSortDescriptor.h>
@@ -1986,8 +1988,21 @@ static void computeNewSelection
 - (void) _editNextCellAfterRow:(NSInteger)row inColumn:(NSInteger)column;
 - (void) _autosaveTableColumns;
 - (void) _autoloadTableColumns;
+- (void) _flushObjectValueCache;
+- (void) _flushObjectValuesForRows: (NSIndexSet *)rows;
+- (void) _flushObjectValuesForColumn: (NSTableColumn *)aColumn;
+- (void) _updatePrefetching;
 @end
 
+/* Stands for nil object values in the object value cache. */
+static id cachedNil = nil;
+
+/* Rows are prefetched for as far as the table scrolls in this many
+   seconds at its current speed, but at least one screen and at most
+   PREFETCH_MAX_ROWS rows ahead of the visible ones. */
+#define PREFETCH_INTERVAL 0.5
+#define PREFETCH_MAX_ROWS 1000
+
 
 @implementation NSTableView 
 
@@ -2001,6 +2016,7 @@ static void computeNewSelection
       [self exposeBinding: NSContentBinding];
       [self exposeBinding: NSSelectionIndexesBinding];
       [self exposeBinding: NSSortDescriptorsBinding];
+      cachedNil = [NSObject new];
     }
 }
 
@@ -2075,6 +2091,11 @@ static void computeNewSelection
 	  object: self];
     }
   TEST_RELEASE (_autosaveName);
+  if (_objectValueCache != NULL)
+    {
+      NSFreeMapTable (_objectValueCache);
+    }
+  TEST_RELEASE (_prefetchedRows);
   if (_numberOfColumns > 0)
     {
       NSZoneFree (NSDefaultMallocZone (), _columnOrigins);
@@ -2152,6 +2173,7 @@ static void computeNewSelection
   /* NB: Set table view to nil before removing the column from the
      array, because removing it from the array could deallocate it !  */
   [aColumn setTableView: nil];
+  [self _flushObjectValuesForColumn: aColumn];
   [_tableColumns removeObject: aColumn];
   _numberOfColumns--;
   if (_numberOfColumns > 0)
@@ -2173,6 +2195,7 @@ static void computeNewSelection
   NSInteger minRange, maxRange;
   /* Amount of shift for these columns */
   NSInteger shift;
+  NSInteger i;
   BOOL selected = NO;
 
   if ((columnIndex < 0) || (columnIndex > (_numberOfColumns - 1)))
@@ -2233,6 +2256,13 @@ static void computeNewSelection
       _editedColumn += shift;
     }
 
+  /* Data sources may look up values by column index, so forget the
+     values of all columns which change their index */
+  for (i = MIN (columnIndex, newIndex); i <= MAX (columnIndex, newIndex); i++)
+    {
+      [self _flushObjectValuesForColumn: [_tableColumns objectAtIndex: i]];
+    }
+
   /* Now really move the column */
   if (columnIndex < newIndex)
     {
@@ -2332,6 +2362,8 @@ static void computeNewSelection
     }
 
   _dataSource_editable = [anObject respondsToSelector: sel_c];
+  _dataSource_prefetches = [anObject respondsToSelector:
+    @selector(tableView:prefetchRowsWithIndexes:)];
 
   /* We do *not* retain the dataSource, it's like a delegate */
   _dataSource = anObject;
@@ -4868,6 +4900,8 @@ This method is deprecated, use -columnIndexesInRect:. */
 {
   NSRect newFrame;
 
+  /* Rows may have been inserted or removed anywhere */
+  [self _flushObjectValueCache];
   _numberOfRows = [self _numRows];
  
   /* If we are selecting rows, we have to check that we have no
@@ -5046,6 +5080,10 @@ This method is deprecated, use -columnIndexesInRect:. */
 
 - (void) drawRect: (NSRect)aRect
 {
+  if (_dataSource_prefetches)
+    {
+      [self _updatePrefetching];
+    }
   [[GSTheme theme] drawTableViewRect: aRect
 		   inView: self];
 }
@@ -6678,6 +6716,44 @@ For a more detailed explanation, -setSortDescriptors:. */
       return [(NSArray *)[theBinding destinationValue]
                  objectAtIndex: index];
     }
+  else if (_dataSource_prefetches)
+    {
+      NSMapTable *values;
+
+      if (_objectValueCache == NULL)
+        {
+          _objectValueCache = NSCreateMapTable (NSIntegerMapKeyCallBacks,
+                                                NSObjectMapValueCallBacks, 64);
+        }
+      values = NSMapGet (_objectValueCache, (void *)index);
+      if (values != nil)
+        {
+          result = NSMapGet (values, tb);
+          if (result != nil)
+            {
+              return (result == cachedNil) ? nil : result;
+            }
+        }
+      else
+        {
+          /* Retain the columns, so that a removed column's address
+             cannot be reused for another one while it is still cached */
+          values = NSCreateMapTable (NSObjectMapKeyCallBacks,
+                                     NSObjectMapValueCallBacks,
+                                     _numberOfColumns);
+          NSMapInsert (_objectValueCache, (void *)index, values);
+          RELEASE (values);
+        }
+
+      if ([_dataSource respondsToSelector:
+                         @selector(tableView:objectValueForTableColumn:row:)])
+        {
+          result = [_dataSource tableView: self
+                                objectValueForTableColumn: tb
+                                row: index];
+        }
+      NSMapInsert (values, tb, (result != nil) ? result : cachedNil);
+    }
   else if ([_dataSource respondsToSelector:
 		    @selector(tableView:objectValueForTableColumn:row:)])
     {
@@ -6701,6 +6777,148 @@ For a more detailed explanation, -setSortDescriptors:. */
 		   forTableColumn: tb
 		   row: index];
     }
+  if (_objectValueCache != NULL)
+    {
+      NSMapRemove (_objectValueCache, (void *)index);
+    }
+}
+
+- (void) _flushObjectValueCache
+{
+  if (_objectValueCache != NULL)
+    {
+      NSResetMapTable (_objectValueCache);
+    }
+  [_prefetchedRows removeAllIndexes];
+  _prefetchVisibleRows = NSMakeRange (0, 0);
+  _prefetchTime = 0.0;
+}
+
+- (void) _flushObjectValuesForRows: (NSIndexSet *)rows
+{
+  NSUInteger row;
+
+  if (_objectValueCache == NULL)
+    {
+      return;
+    }
+  for (row = [rows firstIndex]; row != NSNotFound;
+       row = [rows indexGreaterThanIndex: row])
+    {
+      NSMapRemove (_objectValueCache, (void *)row);
+    }
+}
+
+- (void) _flushObjectValuesForColumn: (NSTableColumn *)aColumn
+{
+  NSMapEnumerator e;
+  void *key;
+  void *values;
+
+  if (_objectValueCache == NULL)
+    {
+      return;
+    }
+  e = NSEnumerateMapTable (_objectValueCache);
+  while (NSNextMapEnumeratorPair (&e, &key, &values))
+    {
+      NSMapRemove ((NSMapTable *)values, aColumn);
+    }
+  NSEndMapTableEnumeration (&e);
+}
+
+/* Works out which rows are likely to be displayed next from the way the
+   visible rows changed since the last call, asks the data source to
+   prefetch them and to stop prefetching rows which are no longer needed.
+   Cached object values of the rows which are no longer needed are
+   dropped. */
+- (void) _updatePrefetching
+{
+  NSRange visible;
+  NSTimeInterval now = [NSDate timeIntervalSinceReferenceDate];
+  NSInteger moved, ahead, behind, first, last;
+  NSMutableIndexSet *fetch, *cancel, *stale;
+  NSMapEnumerator e;
+  void *key;
+  void *value;
+
+  if (_numberOfRows == 0)
+    {
+      return;
+    }
+  visible = [self rowsInRect: [self visibleRect]];
+  if ((NSInteger)visible.location < 0 || visible.length == 0
+    || NSEqualRanges (visible, _prefetchVisibleRows))
+    {
+      return;
+    }
+
+  /* Look one screen ahead in the direction of scrolling, or further
+     when scrolling fast, and half a screen behind. */
+  moved = (NSInteger)visible.location - (NSInteger)_prefetchVisibleRows.location;
+  ahead = visible.length;
+  if (moved != 0 && now > _prefetchTime)
+    {
+      double speed = ((moved < 0) ? -moved : moved) / (now - _prefetchTime);
+
+      ahead = MAX (ahead,
+                   (NSInteger)MIN (speed * PREFETCH_INTERVAL, PREFETCH_MAX_ROWS));
+    }
+  behind = (visible.length + 1) / 2;
+  if (moved < 0)
+    {
+      first = (NSInteger)visible.location - ahead;
+      last = NSMaxRange (visible) + behind;
+    }
+  else
+    {
+      first = (NSInteger)visible.location - behind;
+      last = NSMaxRange (visible) + ahead;
+    }
+  first = MAX (first, 0);
+  last = MIN (last, _numberOfRows);
+
+  fetch = [NSMutableIndexSet indexSetWithIndexesInRange:
+                               NSMakeRange (first, last - first)];
+  [fetch removeIndexesInRange: visible];
+  cancel = AUTORELEASE([_prefetchedRows mutableCopy]);
+  [cancel removeIndexesInRange: NSMakeRange (first, last - first)];
+  if (_prefetchedRows == nil)
+    {
+      _prefetchedRows = [NSMutableIndexSet new];
+    }
+  [fetch removeIndexes: _prefetchedRows];
+  [_prefetchedRows removeIndexes: cancel];
+  [_prefetchedRows removeIndexesInRange: visible];
+  [_prefetchedRows addIndexes: fetch];
+  _prefetchVisibleRows = visible;
+  _prefetchTime = now;
+
+  if (_objectValueCache != NULL)
+    {
+      stale = [NSMutableIndexSet indexSet];
+      e = NSEnumerateMapTable (_objectValueCache);
+      while (NSNextMapEnumeratorPair (&e, &key, &value))
+        {
+          if ((NSInteger)key < first || (NSInteger)key >= last)
+            {
+              [stale addIndex: (NSUInteger)key];
+            }
+        }
+      NSEndMapTableEnumeration (&e);
+      [self _flushObjectValuesForRows: stale];
+    }
+
+  if ([cancel count] > 0 && [_dataSource respondsToSelector:
+          @selector(tableView:cancelPrefetchingForRowsWithIndexes:)])
+    {
+      [_dataSource tableView: self
+              cancelPrefetchingForRowsWithIndexes: cancel];
+    }
+  if ([fetch count] > 0)
+    {
+      [_dataSource tableView: self prefetchRowsWithIndexes: fetch];
+    }
 }
 
 /* Quasi private method called on self from -noteNumberOfRowsChanged
@@ -6775,7 +6993,35 @@ For a more detailed explanation, -setSortDescriptors:. */
 - (void) reloadDataForRowIndexes: (NSIndexSet*)rowIndexes
                    columnIndexes: (NSIndexSet*)columnIndexes
 {
-  [self reloadData];
+  NSMutableIndexSet *rows;
+  NSUInteger row;
+
+  /* If the number of rows changed after all, every cached row may be
+     wrong. */
+  if ([self _numRows] != _numberOfRows)
+    {
+      [self reloadData];
+      return;
+    }
+
+  /* Otherwise only the given rows which exist need to be fetched and
+     drawn again. */
+  rows = AUTORELEASE([rowIndexes mutableCopy]);
+  if (_numberOfRows > 0)
+    {
+      [rows removeIndexesInRange:
+              NSMakeRange(_numberOfRows, NSNotFound - _numberOfRows)];
+    }
+  else
+    {
+      [rows removeAllIndexes];
+    }
+  [self _flushObjectValuesForRows: rows];
+  for (row = [rows firstIndex]; row != NSNotFound;
+       row = [rows indexGreaterThanIndex: row])
+    {
+      [self setNeedsDisplayInRect: [self rectOfRow: row]];
+    }
 }
 
 - (void) beginUpdates
@@ -6396,59 +6396,72 @@ or add guards
   
   // Check all of aRange
 
-  [_layoutManager removeTemporaryAttribute: NSSpellingStateAttributeName
-			 forCharacterRange: aRange];
-  
   {
     NSSpellChecker *sp = [NSSpellChecker sharedSpellChecker];
-    NSInteger start = 0;
-    int count;
-    // FIXME: doing the spellcheck on this substring could create false-positives
-    // if a word is split in half.. so the range should be expanded to the 
-    // nearest word boundary
-    NSString *substring = [[self string] substringWithRange: aRange];
-    
+    NSString *text = [self string];
+    NSCharacterSet *boundary = [[NSCharacterSet letterCharacterSet] invertedSet];
+    NSUInteger start;
+    NSUInteger end;
+    NSRange r;
+
     if (sp == nil)
       {
         return;
       }
 
-    do {
-      NSRange errorRange = [sp checkSpellingOfString: substring
-					  startingAt: start
-					    language: [sp language]
-						wrap: YES
-			      inSpellDocumentWithTag: [self spellCheckerDocumentTag]
-					   wordCount: &count];
-      
-      if (errorRange.location < start)
-	{
-	  break;
-	}
-      
-      if (errorRange.length > 0)
-	{
-	  start = NSMaxRange(errorRange);
-	}
-      else
-	{
-	  break;
-	}
-      
-      errorRange = NSMakeRange(aRange.location + errorRange.location, errorRange.length);
-      
-      //NSLog(@"highlighting mistake: %@", [[self string] substringWithRange: errorRange]);
-      
+    /* Extend the range to the nearest word boundaries, so a word cut in
+       half at the edge is not reported as a mistake */
+    r = [text rangeOfCharacterFromSet: boundary
+                              options: NSBackwardsSearch
+                                range: NSMakeRange(0, aRange.location)];
+    start = (r.location == NSNotFound) ? 0 : NSMaxRange(r);
+    end = NSMaxRange(aRange);
+    r = [text rangeOfCharacterFromSet: boundary
+                              options: 0
+                                range: NSMakeRange(end, [text length] - end)];
+    end = (r.location == NSNotFound) ? [text length] : r.location;
+
+    /* The whole range is checked in one go on a background thread,
+       -_spellCheckingDidFinish: marks the mistakes once done */
+    [sp requestMisspelledRangesInString: text
+                                  range: NSMakeRange(start, end - start)
+                 inSpellDocumentWithTag: [self spellCheckerDocumentTag]
+                                 target: self
+                               selector: @selector(_spellCheckingDidFinish:)];
+  }
+}
+
+- (void) _spellCheckingDidFinish: (NSDictionary *)result
+{
+  NSString *text = [self string];
+  NSRange range = [[result objectForKey: @"Range"] rangeValue];
+  NSEnumerator *e;
+  NSValue *value;
+
+  if (nil == _layoutManager || !_tf.continuous_spell_checking)
+    {
+      return;
+    }
+  /* If the text changed meanwhile it gets checked again */
+  if (NSMaxRange(range) > [text length]
+    || ![[text substringWithRange: range]
+          isEqualToString: [result objectForKey: @"String"]])
+    {
+      return;
+    }
+
+  [_layoutManager removeTemporaryAttribute: NSSpellingStateAttributeName
+			 forCharacterRange: range];
+  e = [[result objectForKey: @"Ranges"] objectEnumerator];
+  while ((value = [e nextObject]) != nil)
+    {
       [_layoutManager addTemporaryAttribute: NSSpellingStateAttributeName
 				      value: [NSNumber numberWithInteger: NSSpellingStateSpellingFlag]
-			  forCharacterRange: errorRange];
-      
-    } while (1);
-    
-    [_layoutManager addTemporaryAttribute: @"NSTextChecked"
-				    value: [NSNumber numberWithBool: YES]
-			forCharacterRange: aRange];
-  }
+			  forCharacterRange: [value rangeValue]];
+    }
+  [_layoutManager addTemporaryAttribute: @"NSTextChecked"
+				  value: [NSNumber numberWithBool: YES]
+		      forCharacterRange: range];
 }
 
 - (void) _textCheckingTimerFired: (NSTimer *)t
@@ -57,11 +57,369 @@
 
 #import <Foundation/NSArray.h>
 #import <Foundation/NSIndexPath.h>
+#import <Foundation/NSIndexSet.h>
+#import <Foundation/NSKeyValueCoding.h>
+#import <Foundation/NSKeyValueObserving.h>
+#import <Foundation/NSMapTable.h>
 #import <Foundation/NSString.h>
 #import <Foundation/NSSortDescriptor.h>
+#import <Foundation/NSValue.h>
 
 #import <AppKit/NSTreeController.h>
 #import <AppKit/NSTreeNode.h>
+#import <AppKit/NSKeyValueBinding.h>
+#import "GSBindingHelpers.h"
+
+@interface NSTreeController (Private)
+- (NSMutableArray *) _mutableRootObjects;
+- (NSTreeNode *) _nodeAtIndexPath: (NSIndexPath *)indexPath;
+- (void) _insertNode: (NSTreeNode *)node
+              object: (id)object
+         atIndexPath: (NSIndexPath *)indexPath;
+- (void) _detachNode: (NSTreeNode *)node;
+- (void) _pruneSelection;
+- (void) _willChangeSelection;
+- (void) _didChangeSelection;
+@end
+
+/*
+ * The nodes handed out by the tree controller.  Children are only
+ * fetched from the represented object when they are first asked for.
+ * Until then the leaf and count key paths, if set, answer whether a
+ * node has children.
+ */
+@interface GSControllerTreeNode : NSTreeNode
+{
+  NSTreeController *_controller;
+  BOOL _isRoot;
+  BOOL _loaded;
+}
+- (id) initWithRepresentedObject: (id)object
+                      controller: (NSTreeController *)controller;
+- (id) initRootWithController: (NSTreeController *)controller;
+- (BOOL) _isLoaded;
+- (NSArray *) _modelChildren;
+- (NSMutableArray *) _mutableModelChildren;
+- (void) _loadChildren;
+- (void) _rearrange;
+- (void) _insertNode: (GSControllerTreeNode *)node
+              object: (id)object
+             atIndex: (NSUInteger)index;
+- (void) _removeNodeAtIndex: (NSUInteger)index;
+- (NSUInteger) _indexOfChildNode: (NSTreeNode *)node;
+@end
+
+@implementation GSControllerTreeNode
+
+- (id) initWithRepresentedObject: (id)object
+                      controller: (NSTreeController *)controller
+{
+  if ((self = [super initWithRepresentedObject: object]) != nil)
+    {
+      _controller = controller;
+    }
+  return self;
+}
+
+- (id) initRootWithController: (NSTreeController *)controller
+{
+  if ((self = [self initWithRepresentedObject: nil
+                                   controller: controller]) != nil)
+    {
+      _isRoot = YES;
+    }
+  return self;
+}
+
+- (BOOL) _isLoaded
+{
+  return _loaded;
+}
+
+- (NSArray *) _modelChildren
+{
+  NSString *path;
+
+  if (_isRoot)
+    {
+      id content = [_controller content];
+
+      if (content == nil || [content isKindOfClass: [NSArray class]])
+        {
+          return content;
+        }
+      return [NSArray arrayWithObject: content];
+    }
+
+  path = [_controller leafKeyPathForNode: self];
+  if (path != nil && [[_representedObject valueForKeyPath: path] boolValue])
+    {
+      return nil;
+    }
+  path = [_controller childrenKeyPathForNode: self];
+  if (path == nil)
+    {
+      return nil;
+    }
+  return [_representedObject valueForKeyPath: path];
+}
+
+- (NSMutableArray *) _mutableModelChildren
+{
+  if (_isRoot)
+    {
+      return [_controller _mutableRootObjects];
+    }
+  return [_representedObject mutableArrayValueForKeyPath:
+                               [_controller childrenKeyPathForNode: self]];
+}
+
+/*
+ * Wrap the children of the represented object in nodes, sorted by the
+ * controller's sort descriptors.  Nodes which already exist for the same
+ * objects are kept, so that their own children are not fetched again.
+ */
+- (void) _loadChildren
+{
+  NSArray *children = [self _modelChildren];
+  NSArray *sortDescriptors = [_controller sortDescriptors];
+  NSMutableArray *nodes;
+  NSMapTable *existing = nil;
+  NSUInteger count;
+  NSUInteger i;
+
+  if ([sortDescriptors count] > 0)
+    {
+      children = [children sortedArrayUsingDescriptors: sortDescriptors];
+    }
+
+  if (_loaded && [_childNodes count] > 0)
+    {
+      existing = [NSMapTable mapTableWithKeyOptions:
+                               NSMapTableObjectPointerPersonality
+                                       valueOptions:
+                               NSMapTableStrongMemory];
+      count = [_childNodes count];
+      for (i = 0; i < count; i++)
+        {
+          NSTreeNode *node = [_childNodes objectAtIndex: i];
+
+          [existing setObject: node forKey: [node representedObject]];
+        }
+    }
+
+  count = [children count];
+  nodes = [[NSMutableArray alloc] initWithCapacity: count];
+  for (i = 0; i < count; i++)
+    {
+      id object = [children objectAtIndex: i];
+      GSControllerTreeNode *node = [existing objectForKey: object];
+
+      if (node != nil)
+        {
+          [nodes addObject: node];
+          [existing removeObjectForKey: object];
+        }
+      else
+        {
+          node = [[GSControllerTreeNode alloc]
+                   initWithRepresentedObject: object
+                                  controller: _controller];
+          node->_parentNode = self;
+          [nodes addObject: node];
+          RELEASE(node);
+        }
+    }
+
+  if (existing != nil)
+    {
+      NSEnumerator *e = [existing objectEnumerator];
+      GSControllerTreeNode *node;
+
+      while ((node = [e nextObject]) != nil)
+        {
+          node->_parentNode = nil;
+        }
+    }
+
+  ASSIGN(_childNodes, nodes);
+  RELEASE(nodes);
+  _loaded = YES;
+}
+
+/*
+ * Refetch and sort the children of every level that has been loaded.
+ */
+- (void) _rearrange
+{
+  NSUInteger count;
+  NSUInteger i;
+
+  if (!_loaded)
+    {
+      return;
+    }
+  [self _loadChildren];
+  count = [_childNodes count];
+  for (i = 0; i < count; i++)
+    {
+      [[_childNodes objectAtIndex: i] _rearrange];
+    }
+}
+
+- (void) _insertNode: (GSControllerTreeNode *)node
+              object: (id)object
+             atIndex: (NSUInteger)index
+{
+  NSMutableArray *model = [self _mutableModelChildren];
+  NSIndexSet *indexes;
+
+  /* The model is only in the same order as the nodes when unsorted. */
+  if ([[_controller sortDescriptors] count] > 0 || index > [model count])
+    {
+      [model addObject: object];
+    }
+  else
+    {
+      [model insertObject: object atIndex: index];
+    }
+
+  if (!_loaded)
+    {
+      return;
+    }
+  if (node == nil)
+    {
+      node = AUTORELEASE([[GSControllerTreeNode alloc]
+                           initWithRepresentedObject: object
+                                          controller: _controller]);
+    }
+  if (index > [_childNodes count])
+    {
+      index = [_childNodes count];
+    }
+  indexes = [NSIndexSet indexSetWithIndex: index];
+  [self willChange: NSKeyValueChangeInsertion
+   valuesAtIndexes: indexes
+            forKey: @"childNodes"];
+  [_childNodes insertObject: node atIndex: index];
+  node->_parentNode = self;
+  [self didChange: NSKeyValueChangeInsertion
+  valuesAtIndexes: indexes
+           forKey: @"childNodes"];
+}
+
+- (void) _removeNodeAtIndex: (NSUInteger)index
+{
+  GSControllerTreeNode *node = [_childNodes objectAtIndex: index];
+  NSMutableArray *model = [self _mutableModelChildren];
+  NSUInteger modelIndex;
+  NSIndexSet *indexes;
+
+  modelIndex = [model indexOfObjectIdenticalTo: [node representedObject]];
+  if (modelIndex != NSNotFound)
+    {
+      [model removeObjectAtIndex: modelIndex];
+    }
+
+  indexes = [NSIndexSet indexSetWithIndex: index];
+  [self willChange: NSKeyValueChangeRemoval
+   valuesAtIndexes: indexes
+            forKey: @"childNodes"];
+  node->_parentNode = nil;
+  [_childNodes removeObjectAtIndex: index];
+  [self didChange: NSKeyValueChangeRemoval
+  valuesAtIndexes: indexes
+           forKey: @"childNodes"];
+}
+
+- (NSUInteger) _indexOfChildNode: (NSTreeNode *)node
+{
+  return [_childNodes indexOfObjectIdenticalTo: node];
+}
+
+- (NSArray*) childNodes
+{
+  if (!_loaded)
+    {
+      [self _loadChildren];
+    }
+  return [super childNodes];
+}
+
+- (NSMutableArray*) mutableChildNodes
+{
+  if (!_loaded)
+    {
+      [self _loadChildren];
+    }
+  return [super mutableChildNodes];
+}
+
+- (NSTreeNode*) descendantNodeAtIndexPath: (NSIndexPath*)path
+{
+  NSUInteger len = [path length];
+  NSUInteger i;
+  GSControllerTreeNode *node = self;
+
+  for (i = 0; i < len; i++)
+    {
+      NSUInteger index = [path indexAtPosition: i];
+
+      if (!node->_loaded)
+        {
+          [node _loadChildren];
+        }
+      if (index >= [node->_childNodes count])
+        {
+          return nil;
+        }
+      node = [node->_childNodes objectAtIndex: index];
+    }
+
+  return node;
+}
+
+- (BOOL) isLeaf
+{
+  NSString *path;
+
+  if (_isRoot)
+    {
+      return NO;
+    }
+  path = [_controller leafKeyPathForNode: self];
+  if (path != nil)
+    {
+      return [[_representedObject valueForKeyPath: path] boolValue];
+    }
+  if (!_loaded)
+    {
+      path = [_controller countKeyPathForNode: self];
+      if (path != nil)
+        {
+          return [[_representedObject valueForKeyPath: path]
+                   unsignedIntegerValue] == 0;
+        }
+      [self _loadChildren];
+    }
+  return [_childNodes count] == 0;
+}
+
+@end
+
+/*
+ * Returns YES if node is still part of the tree below root.
+ */
+static BOOL
+isAttached(NSTreeNode *node, NSTreeNode *root)
+{
+  while (node != nil && node != root)
+    {
+      node = [node parentNode];
+    }
+  return node != nil;
+}
 
 @implementation NSTreeController
 
@@ -69,6 +427,7 @@
 {
   if ((self = [super initWithContent: content]) != nil)
     {
+      _selectedNodes = [[NSMutableArray alloc] init];
     }
   
   return self;
@@ -80,13 +439,28 @@
   RELEASE(_countKeyPath);
   RELEASE(_leafKeyPath);
   RELEASE(_sortDescriptors);
+  RELEASE(_arrangedObjects);
+  RELEASE(_selectedNodes);
   [super dealloc];
 }
 
 - (BOOL) addSelectionIndexPaths: (NSArray*)indexPaths
 {
-  // FIXME
-  return NO;
+  NSMutableArray *paths;
+  NSUInteger count = [indexPaths count];
+  NSUInteger i;
+
+  paths = [NSMutableArray arrayWithArray: [self selectionIndexPaths]];
+  for (i = 0; i < count; i++)
+    {
+      id path = [indexPaths objectAtIndex: i];
+
+      if (![paths containsObject: path])
+        {
+          [paths addObject: path];
+        }
+    }
+  return [self setSelectionIndexPaths: paths];
 }
 
 - (BOOL) alwaysUsesMultipleValuesMarker
@@ -101,20 +475,18 @@
 
 - (BOOL) canAddChid
 {
-  // FIXME
-  return NO;
+  return [self canInsertChild];
 }
 
 - (BOOL) canInsert
 {
-  // FIXME
-  return NO;
+  return [self isEditable];
 }
 
 - (BOOL) canInsertChild
 {
-  // FIXME
-  return NO;
+  return [self isEditable] && _childrenKeyPath != nil
+    && [_selectedNodes count] == 1;
 }
 
 - (BOOL) preservesSelection
@@ -129,44 +501,82 @@
 
 - (BOOL) setSelectionIndexPath: (NSIndexPath*)indexPath
 {
-  // FIXME
-  return NO;
+  return [self setSelectionIndexPaths:
+                 (indexPath == nil) ? [NSArray array]
+                 : [NSArray arrayWithObject: indexPath]];
 }
 
 - (BOOL) setSelectionIndexPaths: (NSArray*)indexPaths
 {
-  // FIXME
-  return NO;
+  NSMutableArray *nodes;
+  NSArray *paths;
+  NSUInteger count;
+  NSUInteger i;
+
+  paths = [indexPaths sortedArrayUsingSelector: @selector(compare:)];
+  if ([paths isEqual: [self selectionIndexPaths]])
+    {
+      return NO;
+    }
+
+  count = [paths count];
+  nodes = [[NSMutableArray alloc] initWithCapacity: count];
+  for (i = 0; i < count; i++)
+    {
+      NSTreeNode *node = [self _nodeAtIndexPath: [paths objectAtIndex: i]];
+
+      if (node != nil)
+        {
+          [nodes addObject: node];
+        }
+    }
+  [self _willChangeSelection];
+  ASSIGN(_selectedNodes, nodes);
+  [self _didChangeSelection];
+  RELEASE(nodes);
+  return YES;
 }
 
 - (id) arrangedObjects
 {
-  // FIXME
-  return nil;
+  if (_arrangedObjects == nil)
+    {
+      _arrangedObjects = [[GSControllerTreeNode alloc]
+                           initRootWithController: self];
+    }
+  return _arrangedObjects;
 }
 
 - (id) content
 {
-  // FIXME
   return [super content];
 }
 
 - (NSArray*) selectedObjects
 {
-  // FIXME
-  return [super selectedObjects];
+  return [[self selectedNodes] valueForKey: @"representedObject"];
 }
 
 - (NSIndexPath*) selectionIndexPath
 {
-  // FIXME
-  return nil;
+  NSArray *paths = [self selectionIndexPaths];
+
+  return ([paths count] > 0) ? [paths objectAtIndex: 0] : nil;
 }
 
 - (NSArray*) selectionIndexPaths
 {
-  // FIXME
-  return nil;
+  NSMutableArray *paths;
+  NSUInteger count = [_selectedNodes count];
+  NSUInteger i;
+
+  paths = [NSMutableArray arrayWithCapacity: count];
+  for (i = 0; i < count; i++)
+    {
+      [paths addObject: [[_selectedNodes objectAtIndex: i] indexPath]];
+    }
+  [paths sortUsingSelector: @selector(compare:)];
+  return paths;
 }
 
 - (NSArray*) sortDescriptors
@@ -191,59 +601,154 @@
 
 - (void) addChild: (id)sender
 {
-  // FIXME
+  if ([self canAddChid])
+    {
+      NSTreeNode *parent = [_selectedNodes objectAtIndex: 0];
+      NSIndexPath *path = [parent indexPath];
+      id new = [self newObject];
+
+      [self insertObject: new
+        atArrangedObjectIndexPath:
+          [path indexPathByAddingIndex: [[parent childNodes] count]]];
+      RELEASE(new);
+    }
 }
 
 - (void) add: (id)sender
 {
-  // FIXME
-  [super add: sender];
+  if ([self canAdd])
+    {
+      NSTreeNode *parent = [self arrangedObjects];
+      NSIndexPath *path;
+      id new = [self newObject];
+
+      if ([_selectedNodes count] > 0)
+        {
+          parent = [[_selectedNodes objectAtIndex: 0] parentNode];
+        }
+      path = [parent indexPath];
+      if (path == nil)
+        {
+          path = [NSIndexPath indexPathWithIndex: [[parent childNodes] count]];
+        }
+      else
+        {
+          path = [path indexPathByAddingIndex: [[parent childNodes] count]];
+        }
+      [self insertObject: new atArrangedObjectIndexPath: path];
+      RELEASE(new);
+    }
 }
 
 - (void) insertChild: (id)sender
 {
-  // FIXME
+  [self addChild: sender];
 }
 
 - (void) insertObject: (id)object atArrangedObjectIndexPath: (NSIndexPath*)indexPath
 {
-  // FIXME
+  /* The index paths of selected nodes after indexPath change. */
+  [self _willChangeSelection];
+  [self _insertNode: nil object: object atIndexPath: indexPath];
+  [self _didChangeSelection];
+  if ([self selectsInsertedObjects])
+    {
+      [self setSelectionIndexPath: indexPath];
+    }
 }
 
 - (void) insertObjects: (NSArray*)objects atArrangedObjectIndexPaths: (NSArray*)indexPaths
 {
-  // FIXME
+  NSUInteger count = [objects count];
+  NSUInteger i;
+
+  [self _willChangeSelection];
+  for (i = 0; i < count; i++)
+    {
+      [self _insertNode: nil
+                 object: [objects objectAtIndex: i]
+            atIndexPath: [indexPaths objectAtIndex: i]];
+    }
+  [self _didChangeSelection];
+  if ([self selectsInsertedObjects])
+    {
+      [self setSelectionIndexPaths: indexPaths];
+    }
 }
 
 - (void) insert: (id)sender
 {
-  // FIXME
+  if ([self canInsert])
+    {
+      NSIndexPath *path = [self selectionIndexPath];
+      id new = [self newObject];
+
+      if (path == nil)
+        {
+          path = [NSIndexPath indexPathWithIndex:
+                   [[[self arrangedObjects] childNodes] count]];
+        }
+      [self insertObject: new atArrangedObjectIndexPath: path];
+      RELEASE(new);
+    }
 }
 
 - (void) rearrangeObjects
 {
-  // FIXME
+  if (_arrangedObjects == nil)
+    {
+      return;
+    }
+  [self _willChangeSelection];
+  [self willChangeValueForKey: @"arrangedObjects"];
+  [(GSControllerTreeNode *)_arrangedObjects _rearrange];
+  [self didChangeValueForKey: @"arrangedObjects"];
+  [self _pruneSelection];
+  [self _didChangeSelection];
 }
 
 - (void) removeObjectAtArrangedObjectIndexPath: (NSIndexPath*)indexPath
 {
-  // FIXME
+  [self removeObjectsAtArrangedObjectIndexPaths:
+          [NSArray arrayWithObject: indexPath]];
 }
 
 - (void) removeObjectsAtArrangedObjectIndexPaths: (NSArray*)indexPaths
 {
-  // FIXME
+  NSArray *paths = [indexPaths sortedArrayUsingSelector: @selector(compare:)];
+  NSUInteger i = [paths count];
+
+  [self _willChangeSelection];
+  /* Remove from the back so that the remaining paths stay valid. */
+  while (i-- > 0)
+    {
+      NSTreeNode *node = [self _nodeAtIndexPath: [paths objectAtIndex: i]];
+
+      if (node != nil)
+        {
+          [self _detachNode: node];
+        }
+    }
+  [self _pruneSelection];
+  [self _didChangeSelection];
 }
 
 - (void) removeSelectionIndexPaths: (NSArray*)indexPaths
 {
-  // FIXME
+  NSMutableArray *paths;
+
+  paths = [NSMutableArray arrayWithArray: [self selectionIndexPaths]];
+  [paths removeObjectsInArray: indexPaths];
+  [self setSelectionIndexPaths: paths];
 }
 
 - (void) remove: (id)sender
 {
-  // FIXME
-  [super remove: sender];
+  if ([self canRemove])
+    {
+      [self removeObjectsAtArrangedObjectIndexPaths:
+              [self selectionIndexPaths]];
+    }
 }
 
 - (void) setAlwaysUsesMultipleValuesMarker: (BOOL)flag
@@ -263,8 +768,13 @@
 
 - (void) setContent: (id)content
 {
-  // FIXME
+  [self _willChangeSelection];
+  [self willChangeValueForKey: @"arrangedObjects"];
   [super setContent: content];
+  DESTROY(_arrangedObjects);
+  [_selectedNodes removeAllObjects];
+  [self didChangeValueForKey: @"arrangedObjects"];
+  [self _didChangeSelection];
 }
 
 - (void) setCountKeyPath: (NSString*)path
@@ -290,40 +800,69 @@
 - (void) setSortDescriptors: (NSArray*)descriptors
 {
   ASSIGN(_sortDescriptors, descriptors);
+  [self rearrangeObjects];
 }
 
 - (NSString*) childrenKeyPathForNode: (NSTreeNode*)node
 {
-  // FIXME
-  return nil;
+  return _childrenKeyPath;
 }
 
 - (NSString*) countKeyPathForNode: (NSTreeNode*)node
 {
-  // FIXME
-  return nil;
+  return _countKeyPath;
 }
 
 - (NSString*) leafKeyPathForNode: (NSTreeNode*)node
 {
-  // FIXME
-  return nil;
+  return _leafKeyPath;
 }
 
 - (void) moveNode: (NSTreeNode*)node toIndexPath: (NSIndexPath*)indexPath
 {
-  // FIXME
+  RETAIN(node);
+  [self _willChangeSelection];
+  [self _detachNode: node];
+  [self _insertNode: node
+             object: [node representedObject]
+        atIndexPath: indexPath];
+  [self _didChangeSelection];
+  RELEASE(node);
 }
 
 - (void) moveNodes: (NSArray*)nodes toIndexPath: (NSIndexPath*)startingIndexPath
 {
-  // FIXME
+  NSUInteger count = [nodes count];
+  NSUInteger length = [startingIndexPath length];
+  NSIndexPath *parentPath;
+  NSUInteger index;
+  NSUInteger i;
+
+  if (length == 0)
+    {
+      return;
+    }
+  index = [startingIndexPath indexAtPosition: length - 1];
+  parentPath = [startingIndexPath indexPathByRemovingLastIndex];
+  for (i = 0; i < count; i++)
+    {
+      NSIndexPath *path;
+
+      if (length > 1)
+        {
+          path = [parentPath indexPathByAddingIndex: index + i];
+        }
+      else
+        {
+          path = [NSIndexPath indexPathWithIndex: index + i];
+        }
+      [self moveNode: [nodes objectAtIndex: i] toIndexPath: path];
+    }
 }
 
 - (NSArray*) selectedNodes
 {
-  // FIXME
-  return nil;
+  return AUTORELEASE([_selectedNodes copy]);
 }
 
 - (id) initWithCoder: (NSCoder*)coder
@@ -342,3 +881,148 @@
 }
 
 @end
+
+@implementation NSTreeController (Private)
+
+/*
+ * Returns the content as a mutable array, so that root objects can be
+ * inserted and removed.  Content which is not a mutable array is
+ * replaced by a mutable copy; observers of the content are told, and
+ * the copy is set on the object the content is bound to, if any.
+ */
+- (NSMutableArray *) _mutableRootObjects
+{
+  if (![_content isKindOfClass: [NSMutableArray class]])
+    {
+      GSKeyValueBinding *theBinding;
+      NSMutableArray *roots;
+
+      if ([_content isKindOfClass: [NSArray class]])
+        {
+          roots = [_content mutableCopy];
+        }
+      else if (_content != nil)
+        {
+          roots = [[NSMutableArray alloc] initWithObjects: &_content
+                                                    count: 1];
+        }
+      else
+        {
+          roots = [[NSMutableArray alloc] init];
+        }
+      [self willChangeValueForKey: NSContentBinding];
+      ASSIGN(_content, roots);
+      [self didChangeValueForKey: NSContentBinding];
+      RELEASE(roots);
+
+      theBinding = [GSKeyValueBinding getBinding: NSContentArrayBinding
+                                       forObject: self];
+      if (theBinding == nil)
+        {
+          theBinding = [GSKeyValueBinding getBinding: NSContentObjectBinding
+                                           forObject: self];
+        }
+      if (theBinding != nil)
+        {
+          [theBinding reverseSetValueFor: @"content"];
+        }
+    }
+  return _content;
+}
+
+- (NSTreeNode *) _nodeAtIndexPath: (NSIndexPath *)indexPath
+{
+  if ([indexPath length] == 0)
+    {
+      return nil;
+    }
+  return [[self arrangedObjects] descendantNodeAtIndexPath: indexPath];
+}
+
+/*
+ * Insert object, and node if it already exists, at indexPath in both
+ * the model and the loaded nodes.
+ */
+- (void) _insertNode: (NSTreeNode *)node
+              object: (id)object
+         atIndexPath: (NSIndexPath *)indexPath
+{
+  NSUInteger length = [indexPath length];
+  GSControllerTreeNode *parent;
+
+  if (length == 0)
+    {
+      return;
+    }
+  if (length > 1)
+    {
+      parent = (GSControllerTreeNode *)[self _nodeAtIndexPath:
+        [indexPath indexPathByRemovingLastIndex]];
+    }
+  else
+    {
+      parent = [self arrangedObjects];
+    }
+  if (parent == nil)
+    {
+      return;
+    }
+  if (![parent _isLoaded])
+    {
+      [parent _loadChildren];
+    }
+  [parent _insertNode: (GSControllerTreeNode *)node
+               object: object
+              atIndex: [indexPath indexAtPosition: length - 1]];
+}
+
+- (void) _detachNode: (NSTreeNode *)node
+{
+  GSControllerTreeNode *parent = (GSControllerTreeNode *)[node parentNode];
+  NSUInteger index;
+
+  index = [parent _indexOfChildNode: node];
+  if (index != NSNotFound)
+    {
+      [parent _removeNodeAtIndex: index];
+    }
+}
+
+/*
+ * Drop selected nodes which are no longer in the tree.  Called between
+ * -_willChangeSelection and -_didChangeSelection.
+ */
+- (void) _pruneSelection
+{
+  NSUInteger i = [_selectedNodes count];
+
+  while (i-- > 0)
+    {
+      if (!isAttached([_selectedNodes objectAtIndex: i], _arrangedObjects))
+        {
+          [_selectedNodes removeObjectAtIndex: i];
+        }
+    }
+}
+
+/*
+ * The selection keys all change together, whether nodes are selected or
+ * the index paths of the selected nodes move.
+ */
+- (void) _willChangeSelection
+{
+  [self willChangeValueForKey: @"selectionIndexPaths"];
+  [self willChangeValueForKey: @"selectionIndexPath"];
+  [self willChangeValueForKey: @"selectedNodes"];
+  [self willChangeValueForKey: @"selectedObjects"];
+}
+
+- (void) _didChangeSelection
+{
+  [self didChangeValueForKey: @"selectedObjects"];
+  [self didChangeValueForKey: @"selectedNodes"];
+  [self didChangeValueForKey: @"selectionIndexPath"];
+  [self didChangeValueForKey: @"selectionIndexPaths"];
+}
+
+@end
@@ -147,6 +147,12 @@ static void	(*invalidateImp)(NSView*, SEL);
 static NSMapTable	*typesMap = 0;
 static NSLock		*typesLock = nil;
 
+/*
+ *	Prepared content rectangles are kept in a map table too, as only
+ *	views which are scrolled with prepared content ever have one.
+ */
+static NSMapTable	*preparedRects = 0;
+
 /*
  * This is the only external interface to the drag types info.
  */
@@ -754,6 +760,10 @@ GSSetDragTypes(NSView* obj, NSArray *types)
     {
       [GSToolTips removeTipsForView: self];
     }
+  if (_rFlags.has_prepared_rect != 0)
+    {
+      NSMapRemove(preparedRects, self);
+    }
   if (_rFlags.has_currects != 0)
     {
       [self discardCursorRects];	// Handle release of cursors
@@ -2696,6 +2706,45 @@ static void autoresize(CGFloat oldContainerSize,
   return _visibleRect;
 }
 
+/**
+ * Returns the part of the receiver which has been prepared for drawing
+ * by -prepareContentInRect:.  This is the visible rectangle unless
+ * -setPreparedContentRect: has been called.
+ */
+- (NSRect) preparedContentRect
+{
+  if (_rFlags.has_prepared_rect != 0)
+    {
+      return [(NSValue *)NSMapGet(preparedRects, self) rectValue];
+    }
+  return [self visibleRect];
+}
+
+- (void) setPreparedContentRect: (NSRect)rect
+{
+  if (preparedRects == 0)
+    {
+      preparedRects = NSCreateMapTable(NSNonOwnedPointerMapKeyCallBacks,
+                                       NSObjectMapValueCallBacks, 0);
+    }
+  NSMapInsert(preparedRects, self, [NSValue valueWithRect: rect]);
+  _rFlags.has_prepared_rect = 1;
+}
+
+/**
+ * Called by an enclosing clip view which prepares content (see
+ * [NSClipView-setPreparesContent:]) before it draws rect, a larger area
+ * than the visible one, offscreen in idle time.  Subclasses can override
+ * this to load the data needed to draw the area, and may prepare a
+ * different area.  They must call -setPreparedContentRect: (or the
+ * superclass implementation, which does this) with the area actually
+ * prepared, and only that area is drawn.
+ */
+- (void) prepareContentInRect: (NSRect)rect
+{
+  [self setPreparedContentRect: rect];
+}
+
 - (BOOL) wantsDefaultClipping
 {
   return YES;
@@ -2824,6 +2873,10 @@ in the main thread.
    *	set the new _invalidRect.
    */
   invalidRect = NSIntersectionRect(invalidRect, _bounds);
+  if (_super_view != nil && _super_view->_rFlags.prepares_content)
+    {
+      [(NSClipView *)_super_view _documentViewNeedsDisplayInRect: invalidRect];
+    }
   invalidRect = NSUnionRect(_invalidRect, invalidRect);
   if (NSEqualRects(invalidRect, _invalidRect) == NO)
     {
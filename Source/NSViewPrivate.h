@@ -27,6 +27,7 @@
 #ifndef _GNUstep_H_NSViewPrivate
 #define _GNUstep_H_NSViewPrivate
 
+#import "AppKit/NSClipView.h"
 #import "AppKit/NSView.h"
 
 @interface NSView (KeyViewLoop)
@@ -38,4 +39,10 @@
 - (void) _insertSubview: (NSView *)sv atIndex: (NSUInteger)idx;
 @end
 
+@interface NSClipView (GSPreparedContent)
+/* Called when the receiver's document view is marked as needing display
+ * in rect while the receiver prepares content. */
+- (void) _documentViewNeedsDisplayInRect: (NSRect)rect;
+@end
+
 #endif // _GNUstep_H_NSViewPrivate
@@ -0,0 +1,99 @@
+/*
+  Check that the indexed font lookups of GSFontEnumerator give the same
+  answers as a scan of the enumerated fonts would.
+*/
+
+#import "Testing.h"
+#import <Foundation/NSArray.h>
+#import <Foundation/NSAutoreleasePool.h>
+#import <Foundation/NSDictionary.h>
+#import <Foundation/NSString.h>
+#import <Foundation/NSValue.h>
+#import <AppKit/NSFontDescriptor.h>
+#import <AppKit/NSFontManager.h>
+#import <GNUstepGUI/GSFontInfo.h>
+
+@interface TestFontEnumerator : GSFontEnumerator
+@end
+
+static NSArray *
+fontDef(NSString *name, NSString *face, int weight, NSFontTraitMask traits)
+{
+  return [NSArray arrayWithObjects: name, face,
+                  [NSNumber numberWithInt: weight],
+                  [NSNumber numberWithUnsignedInt: traits], nil];
+}
+
+@implementation TestFontEnumerator
+- (void) enumerateFontsAndFamilies
+{
+  allFontFamilies = [[NSMutableDictionary alloc] init];
+  [allFontFamilies setObject:
+    [NSArray arrayWithObjects:
+      fontDef(@"Sans", @"Book", 5, 0),
+      fontDef(@"Sans-Bold", @"Bold", 9, NSBoldFontMask),
+      fontDef(@"Sans-Oblique", @"Oblique", 5, NSItalicFontMask), nil]
+                      forKey: @"Sans"];
+  [allFontFamilies setObject:
+    [NSArray arrayWithObjects:
+      fontDef(@"Mono", @"Book", 5, NSFixedPitchFontMask),
+      fontDef(@"Mono-Bold", @"Bold", 9,
+              NSFixedPitchFontMask | NSBoldFontMask), nil]
+                      forKey: @"Mono"];
+  allFontNames = [[NSArray alloc] initWithObjects: @"Sans", @"Sans-Bold",
+                    @"Sans-Oblique", @"Mono", @"Mono-Bold", nil];
+}
+@end
+
+int main()
+{
+  NSAutoreleasePool *arp = [NSAutoreleasePool new];
+  GSFontEnumerator *fe = [TestFontEnumerator new];
+  NSDictionary *attributes;
+  NSArray *found;
+
+  START_SET("GSFontEnumerator indexes")
+
+  PASS([[fe availableFontDescriptors] count] == 5,
+       "all fonts get a descriptor");
+  PASS_EQUAL([[fe fontDescriptorForFontName: @"Mono-Bold"]
+               objectForKey: NSFontFamilyAttribute], @"Mono",
+             "font name lookup finds the right descriptor");
+  PASS([fe fontDescriptorForFontName: @"Serif"] == nil,
+       "font name lookup of a missing font gives nil");
+
+  PASS_EQUAL([fe fontNameForFamily: @"Sans" weight: 9 traits: NSBoldFontMask],
+             @"Sans-Bold", "family style lookup finds the exact font");
+  PASS([fe fontNameForFamily: @"Sans" weight: 9 traits: 0] == nil,
+       "family style lookup only finds exact matches");
+
+  PASS_EQUAL([fe availableFontNamesWithTraits: NSBoldFontMask],
+             [NSArray arrayWithObject: @"Sans-Bold"],
+             "traits lookup only finds fonts with exactly those traits");
+
+  attributes = [NSDictionary dictionaryWithObject: @"Bold"
+                                           forKey: NSFontFaceAttribute];
+  found = [fe matchingFontDescriptorsFor: attributes];
+  PASS([found count] == 2, "face lookup finds the face in all families");
+
+  attributes = [NSDictionary dictionaryWithObjectsAndKeys:
+    @"Mono", NSFontFamilyAttribute,
+    @"Bold", NSFontFaceAttribute, nil];
+  found = [fe matchingFontDescriptorsFor: attributes];
+  PASS([found count] == 1
+       && [[[found objectAtIndex: 0] objectForKey: NSFontNameAttribute]
+            isEqual: @"Mono-Bold"],
+       "family and face narrow down to one font");
+
+  attributes = [NSDictionary dictionaryWithObjectsAndKeys:
+    @"Sans-Oblique", NSFontNameAttribute,
+    @"Mono", NSFontFamilyAttribute, nil];
+  found = [fe matchingFontDescriptorsFor: attributes];
+  PASS([found count] == 0, "all attributes still have to match");
+
+  END_SET("GSFontEnumerator indexes")
+
+  DESTROY(fe);
+  [arp release];
+  return 0;
+}
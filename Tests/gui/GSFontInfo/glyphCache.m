@@ -0,0 +1,128 @@
+/*
+  Check that -cachedGlyphForCharacter: gives the answers of
+  -glyphForCharacter:, asks for each character only once and can be
+  used from several threads at once.
+*/
+
+#import "Testing.h"
+#import <Foundation/NSAutoreleasePool.h>
+#import <Foundation/NSDate.h>
+#import <Foundation/NSLock.h>
+#import <Foundation/NSThread.h>
+#import <Foundation/NSValue.h>
+#import <GNUstepGUI/GSFontInfo.h>
+
+#define THREADS 4
+
+/* Covers the characters below U+3000, each with glyph character + 1. */
+@interface CountingFontInfo : GSFontInfo
+{
+@public
+  NSLock *lock;
+  int lookups;
+  int running;
+  BOOL wrong;
+}
+@end
+
+@implementation CountingFontInfo
+- (id) init
+{
+  if ((self = [super init]) != nil)
+    {
+      lock = [NSLock new];
+    }
+  return self;
+}
+
+- (void) dealloc
+{
+  RELEASE(lock);
+  [super dealloc];
+}
+
+- (NSGlyph) glyphForCharacter: (unichar)theChar
+{
+  [lock lock];
+  lookups++;
+  [lock unlock];
+  return (theChar < 0x3000) ? theChar + 1 : NSNullGlyph;
+}
+
+/* Looks up every character in a different order in each thread. */
+- (void) lookUp: (id)start
+{
+  CREATE_AUTORELEASE_POOL(pool);
+  unsigned int c;
+  unsigned int i;
+
+  for (i = 0; i < 0x10000; i++)
+    {
+      c = (i * 7 + [start unsignedIntValue]) & 0xffff;
+      if ([self cachedGlyphForCharacter: c]
+        != ((c < 0x3000) ? c + 1 : NSNullGlyph))
+        {
+          wrong = YES;
+        }
+    }
+  [lock lock];
+  running--;
+  [lock unlock];
+  RELEASE(pool);
+}
+@end
+
+int
+main(int argc, char **argv)
+{
+  CountingFontInfo *info;
+  int i;
+  BOOL done;
+
+  START_SET("GSFontInfo glyph cache")
+  CREATE_AUTORELEASE_POOL(arp);
+
+  info = AUTORELEASE([CountingFontInfo new]);
+  PASS([info cachedGlyphForCharacter: 'a'] == 'a' + 1,
+       "a cached glyph is the font's glyph");
+  PASS([info cachedGlyphForCharacter: 'a'] == 'a' + 1 && info->lookups == 1,
+       "the font is only asked once for a character");
+  PASS([info cachedGlyphForCharacter: 0x4e00] == NSNullGlyph
+       && [info cachedGlyphForCharacter: 0x4e00] == NSNullGlyph
+       && info->lookups == 2,
+       "missing glyphs are cached too");
+  PASS([info cachedGlyphForCharacter: 0xffff] == NSNullGlyph
+       && [info cachedGlyphForCharacter: 0] == 1,
+       "the first and last characters have their own entries");
+
+  info = AUTORELEASE([CountingFontInfo new]);
+  info->running = THREADS;
+  for (i = 0; i < THREADS; i++)
+    {
+      [NSThread detachNewThreadSelector: @selector(lookUp:)
+                               toTarget: info
+                             withObject: [NSNumber numberWithInt: i * 4099]];
+    }
+  do
+    {
+      [NSThread sleepForTimeInterval: 0.01];
+      [info->lock lock];
+      done = (info->running == 0);
+      [info->lock unlock];
+    }
+  while (!done);
+  PASS(!info->wrong, "threads looking up glyphs at once get right answers");
+  PASS(info->lookups >= 0x10000 && info->lookups <= THREADS * 0x10000,
+       "every character is looked up");
+  info->lookups = 0;
+  for (i = 0; i < 0x10000; i += 97)
+    {
+      [info cachedGlyphForCharacter: i];
+    }
+  PASS(info->lookups == 0, "all answers of the threads are cached");
+
+  DESTROY(arp);
+  END_SET("GSFontInfo glyph cache")
+
+  return 0;
+}
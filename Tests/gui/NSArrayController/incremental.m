@@ -0,0 +1,125 @@
+/*
+  Add and remove objects in an array controller which rearranges its
+  objects automatically.
+*/
+
+#import "Testing.h"
+#import <Foundation/NSArray.h>
+#import <Foundation/NSAutoreleasePool.h>
+#import <Foundation/NSDictionary.h>
+#import <Foundation/NSIndexSet.h>
+#import <Foundation/NSKeyValueObserving.h>
+#import <Foundation/NSPredicate.h>
+#import <Foundation/NSSortDescriptor.h>
+#import <Foundation/NSValue.h>
+#import <AppKit/NSArrayController.h>
+
+@interface Observer : NSObject
+{
+@public
+  NSKeyValueChange kind;
+  NSIndexSet *indexes;
+}
+@end
+
+@implementation Observer
+- (void) dealloc
+{
+  RELEASE(indexes);
+  [super dealloc];
+}
+
+- (void) observeValueForKeyPath: (NSString *)keyPath
+                       ofObject: (id)object
+                         change: (NSDictionary *)change
+                        context: (void *)context
+{
+  kind = [[change objectForKey: NSKeyValueChangeKindKey] intValue];
+  ASSIGN(indexes, [change objectForKey: NSKeyValueChangeIndexesKey]);
+}
+@end
+
+static NSArray *
+numbers(int first, ...)
+{
+  NSMutableArray *a = [NSMutableArray array];
+  va_list ap;
+  int n;
+
+  va_start(ap, first);
+  for (n = first; n >= 0; n = va_arg(ap, int))
+    {
+      [a addObject: [NSNumber numberWithInt: n]];
+    }
+  va_end(ap);
+  return a;
+}
+
+int main(int argc, char **argv)
+{
+  CREATE_AUTORELEASE_POOL(arp);
+  NSArrayController *ac;
+  Observer *o;
+
+  START_SET("NSArrayController incremental arrangement")
+
+  ac = AUTORELEASE([[NSArrayController alloc] initWithContent:
+    [NSMutableArray arrayWithArray: numbers(5, 1, 3, -1)]]);
+  o = AUTORELEASE([Observer new]);
+  [ac setAutomaticallyRearrangesObjects: YES];
+  [ac setSelectsInsertedObjects: NO];
+  [ac setSortDescriptors: [NSArray arrayWithObject:
+    AUTORELEASE([[NSSortDescriptor alloc] initWithKey: @"self"
+                                            ascending: YES])]];
+  [ac setFilterPredicate:
+    [NSPredicate predicateWithFormat: @"self < 10"]];
+  [ac rearrangeObjects];
+  PASS_EQUAL([ac arrangedObjects], numbers(1, 3, 5, -1),
+    "arranged objects are filtered and sorted")
+
+  [ac setSelectionIndex: 1];
+  [ac addObserver: o forKeyPath: @"arrangedObjects" options: 0 context: 0];
+
+  [ac addObject: [NSNumber numberWithInt: 4]];
+  PASS_EQUAL([ac arrangedObjects], numbers(1, 3, 4, 5, -1),
+    "added object is inserted at its sorted position")
+  PASS(o->kind == NSKeyValueChangeInsertion
+    && [o->indexes isEqual: [NSIndexSet indexSetWithIndex: 2]],
+    "insertion is reported with its index")
+  PASS([ac selectionIndex] == 1, "selection is kept")
+
+  [ac addObjects: numbers(12, 0, 6, -1)];
+  PASS_EQUAL([ac arrangedObjects], numbers(0, 1, 3, 4, 5, 6, -1),
+    "only new objects matching the filter are inserted")
+  PASS([o->indexes count] == 2 && [o->indexes containsIndex: 0]
+    && [o->indexes containsIndex: 5],
+    "insertions are reported at their final indexes")
+  PASS([ac selectionIndex] == 2, "selection moves with its object")
+
+  [ac removeObject: [NSNumber numberWithInt: 1]];
+  PASS_EQUAL([ac arrangedObjects], numbers(0, 3, 4, 5, 6, -1),
+    "removed object leaves the arranged objects")
+  PASS(o->kind == NSKeyValueChangeRemoval
+    && [o->indexes isEqual: [NSIndexSet indexSetWithIndex: 1]],
+    "removal is reported with its index")
+  PASS([ac selectionIndex] == 1, "selection moves with its object")
+
+  [ac removeObserver: o forKeyPath: @"arrangedObjects"];
+
+  /* Nothing asked for the arranged objects of this one yet. */
+  ac = AUTORELEASE([[NSArrayController alloc] initWithContent:
+    [NSMutableArray arrayWithArray: numbers(2, 1, -1)]]);
+  [ac addObserver: o forKeyPath: @"arrangedObjects" options: 0 context: 0];
+  o->kind = 0;
+  [ac addObject: [NSNumber numberWithInt: 7]];
+  PASS(o->kind == NSKeyValueChangeSetting,
+    "adding is reported before the objects were arranged")
+  PASS_EQUAL([ac arrangedObjects], numbers(2, 1, 7, -1),
+    "added object is arranged on first use")
+  [ac removeObserver: o forKeyPath: @"arrangedObjects"];
+
+  END_SET("NSArrayController incremental arrangement")
+
+  DESTROY(arp);
+  return 0;
+}
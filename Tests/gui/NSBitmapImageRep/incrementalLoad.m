@@ -0,0 +1,143 @@
+/*
+  Load images incrementally, handing the data over in small pieces.
+*/
+
+#include <string.h>
+
+#import "Testing.h"
+#import <Foundation/NSAutoreleasePool.h>
+#import <Foundation/NSData.h>
+#import <AppKit/NSBitmapImageRep.h>
+
+/* A 64 x 64 image with a different colour in every pixel */
+static NSBitmapImageRep *
+makeBitmap(void)
+{
+  NSBitmapImageRep *rep;
+  unsigned char *p;
+  NSInteger x, y;
+
+  rep = AUTORELEASE([[NSBitmapImageRep alloc]
+    initWithBitmapDataPlanes: NULL
+                  pixelsWide: 64
+                  pixelsHigh: 64
+               bitsPerSample: 8
+             samplesPerPixel: 3
+                    hasAlpha: NO
+                    isPlanar: NO
+              colorSpaceName: NSCalibratedRGBColorSpace
+                 bytesPerRow: 192
+                bitsPerPixel: 24]);
+  p = [rep bitmapData];
+  for (y = 0; y < 64; y++)
+    {
+      for (x = 0; x < 64; x++)
+        {
+          *p++ = x * 4;
+          *p++ = y * 4;
+          *p++ = (x * y) & 0xFF;
+        }
+    }
+  return rep;
+}
+
+/* Loads data in pieces of step bytes, returning the final status.
+   Sets *progress if rows were reported, always increasing, before all
+   of the data had been handed over. */
+static NSInteger
+load(NSBitmapImageRep *rep, NSData *data, NSUInteger length,
+     NSUInteger step, BOOL *progress)
+{
+  NSInteger status = NSImageRepLoadStatusReadingHeader;
+  NSInteger last = -1;
+  NSUInteger n;
+
+  *progress = NO;
+  for (n = step; n < length; n += step)
+    {
+      status = [rep incrementalLoadFromData:
+        [data subdataWithRange: NSMakeRange(0, n)] complete: NO];
+      if (status >= 0)
+        {
+          if (status < last)
+            return NSImageRepLoadStatusInvalidData;
+          if (last >= 0 && status > last)
+            *progress = YES;
+          last = status;
+        }
+      else if (status <= NSImageRepLoadStatusInvalidData)
+        {
+          return status;
+        }
+    }
+  return [rep incrementalLoadFromData:
+    [data subdataWithRange: NSMakeRange(0, length)] complete: YES];
+}
+
+int
+main(int argc, char **argv)
+{
+  NSBitmapImageRep *bitmap;
+  NSBitmapImageRep *rep;
+  NSData *data;
+  NSInteger status;
+  BOOL progress;
+
+  START_SET("NSBitmapImageRep GNUstep incremental loading")
+  CREATE_AUTORELEASE_POOL(arp);
+
+  bitmap = makeBitmap();
+
+  data = [bitmap representationUsingType: NSPNGFileType properties: nil];
+  rep = AUTORELEASE([[NSBitmapImageRep alloc] initForIncrementalLoad]);
+  PASS([rep incrementalLoadFromData:
+    [data subdataWithRange: NSMakeRange(0, 4)] complete: NO]
+       == NSImageRepLoadStatusReadingHeader,
+       "PNG header is being read");
+  status = load(rep, data, [data length], 64, &progress);
+  PASS(status == NSImageRepLoadStatusCompleted, "PNG loads");
+  PASS(progress, "PNG rows are reported as they are decoded");
+  PASS([rep pixelsWide] == 64 && [rep pixelsHigh] == 64
+    && memcmp([rep bitmapData], [bitmap bitmapData], 64 * 192) == 0,
+       "PNG is decoded correctly");
+  PASS([rep incrementalLoadFromData: data complete: YES]
+       == NSImageRepLoadStatusCompleted,
+       "status is kept once the load finished");
+
+  rep = AUTORELEASE([[NSBitmapImageRep alloc] initForIncrementalLoad]);
+  status = load(rep, data, [data length] / 2, 64, &progress);
+  PASS(status == NSImageRepLoadStatusUnexpectedEOF,
+       "truncated PNG is reported");
+
+  data = [bitmap representationUsingType: NSJPEGFileType
+                              properties: nil];
+  rep = AUTORELEASE([[NSBitmapImageRep alloc] initForIncrementalLoad]);
+  status = load(rep, data, [data length], 64, &progress);
+  PASS(status == NSImageRepLoadStatusCompleted, "JPEG loads");
+  PASS(progress, "JPEG rows are reported as they are decoded");
+  PASS([rep pixelsWide] == 64 && [rep pixelsHigh] == 64,
+       "JPEG has the right size");
+
+  rep = AUTORELEASE([[NSBitmapImageRep alloc] initForIncrementalLoad]);
+  PASS([rep incrementalLoadFromData: [NSData dataWithBytes: "\xFF\xD8\xFF\xE0xxxxxx"
+                                                    length: 10]
+                           complete: YES]
+       <= NSImageRepLoadStatusInvalidData,
+       "broken JPEG fails");
+
+  data = [bitmap TIFFRepresentation];
+  rep = AUTORELEASE([[NSBitmapImageRep alloc] initForIncrementalLoad]);
+  PASS([rep incrementalLoadFromData:
+    [data subdataWithRange: NSMakeRange(0, 64)] complete: NO]
+       == NSImageRepLoadStatusWillNeedAllData,
+       "TIFF needs all the data");
+  PASS([rep incrementalLoadFromData: data complete: YES]
+       == NSImageRepLoadStatusCompleted
+    && memcmp([rep bitmapData], [bitmap bitmapData], 64 * 192) == 0,
+       "TIFF loads once complete");
+
+  DESTROY(arp);
+  END_SET("NSBitmapImageRep GNUstep incremental loading")
+
+  return 0;
+}
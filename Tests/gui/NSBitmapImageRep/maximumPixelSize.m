@@ -0,0 +1,139 @@
+/*
+  Decode images shrunk to a maximum size, directly and on the image
+  load threads.
+*/
+
+#import "Testing.h"
+#import <Foundation/NSAutoreleasePool.h>
+#import <Foundation/NSData.h>
+#import <Foundation/NSDate.h>
+#import <Foundation/NSRunLoop.h>
+#import <AppKit/NSBitmapImageRep.h>
+#import <AppKit/NSImage.h>
+
+@interface Receiver : NSObject
+{
+@public
+  BOOL done;
+  NSImage *image;
+}
+@end
+
+@implementation Receiver
+- (void) imageLoaded: (NSImage *)anImage
+{
+  ASSIGN(image, anImage);
+  done = YES;
+}
+- (void) dealloc
+{
+  RELEASE(image);
+  [super dealloc];
+}
+@end
+
+/* A 200 x 100 image, red in the left half and blue in the right one */
+static NSBitmapImageRep *
+makeBitmap(void)
+{
+  NSBitmapImageRep *rep;
+  unsigned char *p;
+  NSInteger x, y;
+
+  rep = AUTORELEASE([[NSBitmapImageRep alloc]
+    initWithBitmapDataPlanes: NULL
+                  pixelsWide: 200
+                  pixelsHigh: 100
+               bitsPerSample: 8
+             samplesPerPixel: 3
+                    hasAlpha: NO
+                    isPlanar: NO
+              colorSpaceName: NSCalibratedRGBColorSpace
+                 bytesPerRow: 600
+                bitsPerPixel: 24]);
+  p = [rep bitmapData];
+  for (y = 0; y < 100; y++)
+    {
+      for (x = 0; x < 200; x++)
+        {
+          *p++ = x < 100 ? 255 : 0;
+          *p++ = 0;
+          *p++ = x < 100 ? 0 : 255;
+        }
+    }
+  return rep;
+}
+
+static BOOL
+isShrunk(NSBitmapImageRep *rep)
+{
+  NSUInteger pixel[3];
+
+  if ([rep pixelsWide] != 50 || [rep pixelsHigh] != 25
+    || !NSEqualSizes([rep size], NSMakeSize(200, 100)))
+    return NO;
+  [rep getPixel: pixel atX: 2 y: 12];
+  if (pixel[0] < 200 || pixel[2] > 50)
+    return NO;
+  [rep getPixel: pixel atX: 47 y: 12];
+  if (pixel[0] > 50 || pixel[2] < 200)
+    return NO;
+  return YES;
+}
+
+int
+main(int argc, char **argv)
+{
+  NSBitmapImageRep *bitmap;
+  NSBitmapImageRep *rep;
+  NSData *data;
+  Receiver *receiver;
+  NSDate *limit;
+
+  START_SET("NSBitmapImageRep GNUstep maximumPixelSize")
+  CREATE_AUTORELEASE_POOL(arp);
+
+  bitmap = makeBitmap();
+
+  data = [bitmap representationUsingType: NSPNGFileType properties: nil];
+  rep = [NSBitmapImageRep imageRepWithData: data
+                          maximumPixelSize: NSMakeSize(50, 50)];
+  PASS(isShrunk(rep), "PNG is shrunk while decoding");
+
+  data = [bitmap representationUsingType: NSJPEGFileType properties: nil];
+  rep = [NSBitmapImageRep imageRepWithData: data
+                          maximumPixelSize: NSMakeSize(50, 50)];
+  PASS(isShrunk(rep), "JPEG is shrunk while decoding");
+
+  data = [bitmap TIFFRepresentation];
+  rep = [NSBitmapImageRep imageRepWithData: data
+                          maximumPixelSize: NSMakeSize(50, 50)];
+  PASS(isShrunk(rep), "TIFF is shrunk after decoding");
+
+  rep = [NSBitmapImageRep imageRepWithData: data
+                          maximumPixelSize: NSMakeSize(400, 400)];
+  PASS([rep pixelsWide] == 200 && [rep pixelsHigh] == 100,
+       "smaller images keep their size");
+
+  receiver = AUTORELEASE([Receiver new]);
+  [NSImage loadImageWithData: data
+            maximumPixelSize: NSMakeSize(50, 0)
+                      target: receiver
+                    selector: @selector(imageLoaded:)];
+  limit = [NSDate dateWithTimeIntervalSinceNow: 10.0];
+  while (!receiver->done && [limit timeIntervalSinceNow] > 0.0)
+    {
+      [[NSRunLoop currentRunLoop]
+        runMode: NSDefaultRunLoopMode
+        beforeDate: [NSDate dateWithTimeIntervalSinceNow: 0.01]];
+    }
+  PASS(receiver->done, "image is loaded in the background");
+  PASS(isShrunk((NSBitmapImageRep*)[[receiver->image representations]
+                                      lastObject]),
+       "loaded image is shrunk");
+
+  DESTROY(arp);
+  END_SET("NSBitmapImageRep GNUstep maximumPixelSize")
+
+  return 0;
+}
@@ -0,0 +1,110 @@
+/*
+  Check that a browser which loads its columns lazily only asks a passive
+  delegate for the rows near the visible part of a column.
+*/
+
+#import "Testing.h"
+#import <Foundation/NSAutoreleasePool.h>
+#import <Foundation/NSIndexSet.h>
+#import <AppKit/NSApplication.h>
+#import <AppKit/NSBrowser.h>
+#import <AppKit/NSBrowserCell.h>
+
+#define ROWS 10000
+
+@interface CountingDelegate : NSObject
+{
+@public
+  NSMutableIndexSet *rowsAsked;
+}
+@end
+
+@implementation CountingDelegate
+- (id) init
+{
+  if ((self = [super init]) != nil)
+    {
+      rowsAsked = [NSMutableIndexSet new];
+    }
+  return self;
+}
+
+- (void) dealloc
+{
+  RELEASE(rowsAsked);
+  [super dealloc];
+}
+
+- (NSInteger) browser: (NSBrowser *)sender numberOfRowsInColumn: (NSInteger)column
+{
+  return ROWS;
+}
+
+- (void) browser: (NSBrowser *)sender
+ willDisplayCell: (id)cell
+           atRow: (NSInteger)row
+          column: (NSInteger)column
+{
+  [rowsAsked addIndex: row];
+  [cell setStringValue: [NSString stringWithFormat: @"Row %ld", (long)row]];
+  [cell setLeaf: YES];
+}
+@end
+
+int
+main(int argc, char **argv)
+{
+  NSBrowser *browser;
+  CountingDelegate *delegate;
+  id cell;
+
+  START_SET("NSBrowser GNUstep lazy columns")
+  CREATE_AUTORELEASE_POOL(arp);
+
+  NS_DURING
+  {
+    [NSApplication sharedApplication];
+  }
+  NS_HANDLER
+  {
+    if ([[localException name] isEqualToString: NSInternalInconsistencyException ])
+       SKIP("It looks like GNUstep backend is not yet installed")
+  }
+  NS_ENDHANDLER
+
+  delegate = AUTORELEASE([CountingDelegate new]);
+  browser = AUTORELEASE([[NSBrowser alloc]
+    initWithFrame: NSMakeRect(0, 0, 200, 200)]);
+  [browser setDelegate: delegate];
+  [browser setLoadsColumnsLazily: YES];
+  [browser loadColumnZero];
+
+  PASS([[browser matrixInColumn: 0] numberOfRows] == ROWS,
+       "column has all rows");
+  PASS([delegate->rowsAsked containsIndex: 0],
+       "first row is filled in");
+  PASS([delegate->rowsAsked count] > 1
+       && [delegate->rowsAsked count] < 200,
+       "only the rows near the visible rect are filled in");
+  PASS([delegate->rowsAsked lastIndex] < 200,
+       "rows far below the visible rect are not filled in");
+
+  cell = [browser loadedCellAtRow: ROWS / 2 column: 0];
+  PASS([delegate->rowsAsked containsIndex: ROWS / 2]
+       && [[cell stringValue] isEqual: @"Row 5000"],
+       "-loadedCellAtRow:column: fills in a row on demand");
+
+  [[browser matrixInColumn: 0] selectCellAtRow: ROWS - 1 column: 0];
+  [browser doClick: [browser matrixInColumn: 0]];
+  PASS([delegate->rowsAsked containsIndex: ROWS - 1],
+       "a selected row out of sight is filled in on a click");
+
+  [browser setLoadsColumnsLazily: NO];
+  PASS([delegate->rowsAsked count] == ROWS,
+       "eager loading fills in every row");
+
+  DESTROY(arp);
+  END_SET("NSBrowser GNUstep lazy columns")
+
+  return 0;
+}
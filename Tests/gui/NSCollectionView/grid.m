@@ -0,0 +1,119 @@
+/*
+  Check the grid arithmetic of NSCollectionView and the recycling of
+  items which went out of view.  No window is needed.
+*/
+
+#import "Testing.h"
+#import <Foundation/NSArray.h>
+#import <Foundation/NSAutoreleasePool.h>
+#import <Foundation/NSValue.h>
+#import <AppKit/NSApplication.h>
+#import <AppKit/NSCollectionView.h>
+#import <AppKit/NSCollectionViewItem.h>
+#import <AppKit/NSView.h>
+
+#define ITEMS 100
+
+@interface NSCollectionView (Private)
+- (NSRange) _itemRangeInRect: (NSRect)aRect;
+- (void) _recycleItemsOutsideRange: (NSRange)aRange;
+@end
+
+int
+main(int argc, char **argv)
+{
+  NSCollectionView *cv;
+  NSCollectionViewItem *prototype;
+  NSCollectionViewItem *item;
+  NSMutableArray *content;
+  NSMutableArray *items;
+  NSRange range;
+  NSUInteger i;
+
+  START_SET("NSCollectionView GNUstep grid")
+  CREATE_AUTORELEASE_POOL(arp);
+
+  NS_DURING
+  {
+    [NSApplication sharedApplication];
+  }
+  NS_HANDLER
+  {
+    if ([[localException name] isEqualToString: NSInternalInconsistencyException ])
+       SKIP("It looks like GNUstep backend is not yet installed")
+  }
+  NS_ENDHANDLER
+
+  content = [NSMutableArray array];
+  for (i = 0; i < ITEMS; i++)
+    {
+      [content addObject: [NSNumber numberWithUnsignedInteger: i]];
+    }
+
+  /* 100x50 items in a 420 wide view give four columns with 4 points
+     between them, and rows 60 apart with a vertical margin of 10. */
+  prototype = AUTORELEASE([NSCollectionViewItem new]);
+  [prototype setView: AUTORELEASE([[NSView alloc]
+    initWithFrame: NSMakeRect(0, 0, 100, 50)])];
+  cv = AUTORELEASE([[NSCollectionView alloc]
+    initWithFrame: NSMakeRect(0, 0, 420, 300)]);
+  [cv setItemPrototype: prototype];
+  [cv setVerticalMargin: 10];
+  [cv setContent: content];
+
+  PASS(NSEqualRects([cv frameForItemAtIndex: 0],
+                    NSMakeRect(4, 10, 100, 50)),
+       "the first item is at the margins");
+  PASS(NSEqualRects([cv frameForItemAtIndex: 5],
+                    NSMakeRect(108, 70, 100, 50)),
+       "items wrap after the last column");
+  PASS(NSEqualRects([cv frameForItemAtIndex: ITEMS - 1],
+                    NSMakeRect(316, 1450, 100, 50)),
+       "the last item is in the last row");
+  PASS(NSIsEmptyRect([cv frameForItemAtIndex: ITEMS]),
+       "there is no frame past the last item");
+
+  range = [cv _itemRangeInRect: NSMakeRect(0, 0, 420, 100)];
+  PASS(NSEqualRanges(range, NSMakeRange(0, 8)),
+       "a rect in the first two rows holds their items");
+  range = [cv _itemRangeInRect: NSMakeRect(0, 130, 420, 60)];
+  PASS(NSEqualRanges(range, NSMakeRange(8, 8)),
+       "a rect crossing two rows holds all their items");
+  range = [cv _itemRangeInRect: NSMakeRect(0, 10000, 420, 100)];
+  PASS(range.length == 0, "a rect below the last row holds no items");
+  range = [cv _itemRangeInRect: NSZeroRect];
+  PASS(range.length == 0, "an empty rect holds no items");
+
+  [cv setReusesItems: YES];
+  items = [NSMutableArray array];
+  for (i = 0; i < 8; i++)
+    {
+      [items addObject: [cv itemAtIndex: i]];
+    }
+  [cv _recycleItemsOutsideRange: NSMakeRange(8, 8)];
+  PASS([[items objectAtIndex: 0] view] != nil
+       && [[[items objectAtIndex: 0] view] superview] == nil,
+       "items out of range leave the view hierarchy");
+  item = [cv itemAtIndex: 8];
+  PASS([items indexOfObjectIdenticalTo: item] != NSNotFound,
+       "a recycled item is used for a new index");
+  PASS([[item representedObject] isEqual: [content objectAtIndex: 8]]
+       && [[item view] superview] == cv,
+       "the recycled item shows its new object");
+  PASS([[[cv itemAtIndex: 0] representedObject]
+         isEqual: [content objectAtIndex: 0]],
+       "going back to a recycled index gives it its object again");
+
+  [cv setMaxNumberOfColumns: 4];
+  [cv setMaxNumberOfRows: 2];
+  PASS(NSIsEmptyRect([cv frameForItemAtIndex: 8]),
+       "items past the maximum number of rows have no frame");
+  range = [cv _itemRangeInRect: NSMakeRect(0, 0, 420, 10000)];
+  PASS(NSEqualRanges(range, NSMakeRange(0, 8)),
+       "only items within the maximum number of rows are in a rect");
+
+  DESTROY(arp);
+  END_SET("NSCollectionView GNUstep grid")
+
+  return 0;
+}
@@ -0,0 +1,136 @@
+/*
+  Autosave a document which writes its autosaved file in the background.
+*/
+
+#include <string.h>
+
+#import "Testing.h"
+#import <Foundation/NSAutoreleasePool.h>
+#import <Foundation/NSData.h>
+#import <Foundation/NSDate.h>
+#import <Foundation/NSFileManager.h>
+#import <Foundation/NSPathUtilities.h>
+#import <Foundation/NSRunLoop.h>
+#import <Foundation/NSURL.h>
+#import <AppKit/NSDocument.h>
+
+@interface Doc : NSDocument
+{
+@public
+  NSData *contents;
+}
+@end
+
+@implementation Doc
+- (void) dealloc
+{
+  RELEASE(contents);
+  [super dealloc];
+}
+
+- (NSData *) dataOfType: (NSString *)type error: (NSError **)error
+{
+  return contents;
+}
+
+- (BOOL) canAsynchronouslyWriteToURL: (NSURL *)url
+                              ofType: (NSString *)type
+                    forSaveOperation: (NSSaveOperationType)op
+{
+  return YES;
+}
+@end
+
+@interface Listener : NSObject
+{
+@public
+  int calls;
+  BOOL saved;
+}
+@end
+
+@implementation Listener
+- (void) document: (NSDocument *)doc
+      didAutosave: (BOOL)flag
+      contextInfo: (void *)context
+{
+  calls++;
+  saved = flag;
+}
+@end
+
+static void
+waitFor(Listener *l, int count)
+{
+  NSDate *limit = [NSDate dateWithTimeIntervalSinceNow: 10.0];
+
+  while (l->calls < count && [limit timeIntervalSinceNow] > 0.0)
+    {
+      [[NSRunLoop currentRunLoop]
+        runMode: NSDefaultRunLoopMode
+        beforeDate: [NSDate dateWithTimeIntervalSinceNow: 0.01]];
+    }
+}
+
+static NSData *
+dataOf(const char *s)
+{
+  return [NSData dataWithBytes: s length: strlen(s)];
+}
+
+int
+main(int argc, char **argv)
+{
+  NSString *path;
+  Listener *listener;
+  Doc *doc;
+
+  START_SET("NSDocument GNUstep concurrent autosave")
+  CREATE_AUTORELEASE_POOL(arp);
+
+  path = [NSTemporaryDirectory()
+           stringByAppendingPathComponent: @"NSDocument-autosave.test"];
+  listener = AUTORELEASE([Listener new]);
+  doc = AUTORELEASE([Doc new]);
+  [doc setFileType: @"test"];
+  [doc setAutosavedContentsFileURL: [NSURL fileURLWithPath: path]];
+
+  ASSIGN(doc->contents, dataOf("one"));
+  [doc updateChangeCount: NSChangeDone];
+  [doc autosaveDocumentWithDelegate: listener
+                didAutosaveSelector: @selector(document:didAutosave:contextInfo:)
+                        contextInfo: NULL];
+  ASSIGN(doc->contents, dataOf("two"));
+  PASS(listener->calls == 0, "autosave finishes later");
+  waitFor(listener, 1);
+  PASS(listener->calls == 1 && listener->saved, "document is autosaved");
+  PASS([[NSData dataWithContentsOfFile: path] isEqual: dataOf("one")],
+       "the snapshot taken when the autosave started is written");
+  PASS([doc hasUnautosavedChanges] == NO, "document has no unsaved changes");
+
+  [doc updateChangeCount: NSChangeDone];
+  [doc autosaveDocumentWithDelegate: listener
+                didAutosaveSelector: @selector(document:didAutosave:contextInfo:)
+                        contextInfo: NULL];
+  [doc updateChangeCount: NSChangeDone];
+  [doc autosaveDocumentWithDelegate: listener
+                didAutosaveSelector: @selector(document:didAutosave:contextInfo:)
+                        contextInfo: NULL];
+  PASS(listener->calls == 2 && listener->saved == NO,
+       "only one autosave runs at a time");
+  waitFor(listener, 3);
+  PASS(listener->calls == 3 && listener->saved, "document is autosaved again");
+  PASS([[NSData dataWithContentsOfFile: path] isEqual: dataOf("two")],
+       "the new snapshot is written");
+  PASS([doc hasUnautosavedChanges],
+       "changes made while writing are still unsaved");
+
+  [doc close];
+  PASS([[NSFileManager defaultManager] fileExistsAtPath: path] == NO,
+       "autosaved file is removed when the document closes");
+
+  DESTROY(arp);
+  END_SET("NSDocument GNUstep concurrent autosave")
+
+  return 0;
+}
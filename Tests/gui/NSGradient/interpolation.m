@@ -0,0 +1,67 @@
+/*
+  Check the colours NSGradient interpolates between its stops.
+*/
+
+#import "Testing.h"
+#import <Foundation/NSArray.h>
+#import <Foundation/NSAutoreleasePool.h>
+#import <AppKit/NSColor.h>
+#import <AppKit/NSColorSpace.h>
+#import <AppKit/NSGradient.h>
+
+static BOOL
+near(CGFloat a, CGFloat b)
+{
+  return a - b < 0.001 && b - a < 0.001;
+}
+
+int
+main(int argc, char **argv)
+{
+  NSGradient *gradient;
+  NSColor *color;
+  CGFloat r, g, b, a;
+  CGFloat locations[3] = {0.0, 0.25, 1.0};
+
+  START_SET("NSGradient interpolation")
+  CREATE_AUTORELEASE_POOL(arp);
+
+  gradient = AUTORELEASE([[NSGradient alloc]
+    initWithColors: [NSArray arrayWithObjects:
+      [NSColor colorWithCalibratedRed: 1.0 green: 0.0 blue: 0.0 alpha: 1.0],
+      [NSColor colorWithCalibratedRed: 0.0 green: 1.0 blue: 0.0 alpha: 1.0],
+      [NSColor colorWithCalibratedRed: 0.0 green: 0.0 blue: 1.0 alpha: 0.0],
+      nil]
+       atLocations: locations
+        colorSpace: [NSColorSpace genericRGBColorSpace]]);
+
+  color = [gradient interpolatedColorAtLocation: -1.0];
+  [color getRed: &r green: &g blue: &b alpha: &a];
+  PASS(r == 1.0 && g == 0.0 && b == 0.0, "first stop is used before the start");
+
+  color = [gradient interpolatedColorAtLocation: 0.05];
+  [color getRed: &r green: &g blue: &b alpha: &a];
+  PASS(near(r, 0.8) && near(g, 0.2) && near(b, 0.0),
+       "colour near a stop is close to that stop");
+
+  color = [gradient interpolatedColorAtLocation: 0.625];
+  [color getRed: &r green: &g blue: &b alpha: &a];
+  PASS(near(r, 0.0) && near(g, 0.5) && near(b, 0.5) && near(a, 0.5),
+       "colours are interpolated between the surrounding stops");
+
+  color = [gradient interpolatedColorAtLocation: 2.0];
+  [color getRed: &r green: &g blue: &b alpha: &a];
+  PASS(b == 1.0 && a == 0.0, "last stop is used after the end");
+
+  gradient = AUTORELEASE([[NSGradient alloc]
+    initWithStartingColor: [NSColor colorWithCalibratedWhite: 0.0 alpha: 1.0]
+              endingColor: [NSColor colorWithCalibratedWhite: 1.0 alpha: 1.0]]);
+  color = [gradient interpolatedColorAtLocation: 0.5];
+  PASS(near([color whiteComponent], 0.5),
+       "grey gradients are interpolated in their colour space");
+
+  DESTROY(arp);
+  END_SET("NSGradient interpolation")
+
+  return 0;
+}
@@ -0,0 +1,111 @@
+/*
+  Check that images drawn while the image cache is over its budget
+  release the representations of the least recently drawn images.
+*/
+
+#import "Testing.h"
+#import <Foundation/NSArray.h>
+#import <Foundation/NSAutoreleasePool.h>
+#import <AppKit/NSApplication.h>
+#import <AppKit/NSBitmapImageRep.h>
+#import <AppKit/NSImage.h>
+
+static NSImage *
+makeImage(void)
+{
+  NSBitmapImageRep *rep;
+
+  rep = AUTORELEASE([[NSBitmapImageRep alloc]
+    initWithBitmapDataPlanes: NULL
+                  pixelsWide: 100
+                  pixelsHigh: 100
+               bitsPerSample: 8
+             samplesPerPixel: 4
+                    hasAlpha: YES
+                    isPlanar: NO
+              colorSpaceName: NSCalibratedRGBColorSpace
+                 bytesPerRow: 0
+                bitsPerPixel: 0]);
+  return AUTORELEASE([[NSImage alloc]
+    initWithData: [rep TIFFRepresentation]]);
+}
+
+int
+main(int argc, char **argv)
+{
+  NSImage *target;
+  NSImage *first;
+  NSImage *second;
+  NSImage *scaled;
+  NSUInteger size;
+
+  START_SET("NSImage GNUstep cache limit")
+  CREATE_AUTORELEASE_POOL(arp);
+
+  NS_DURING
+  {
+    [NSApplication sharedApplication];
+  }
+  NS_HANDLER
+  {
+    if ([[localException name] isEqualToString: NSInternalInconsistencyException ])
+       SKIP("It looks like GNUstep backend is not yet installed")
+  }
+  NS_ENDHANDLER
+
+  PASS([NSImage imageCacheLimit] > 0, "image cache has a budget");
+
+  target = AUTORELEASE([[NSImage alloc] initWithSize: NSMakeSize(100, 100)]);
+  first = makeImage();
+  second = makeImage();
+  [NSImage setImageCacheLimit: 100 * 100 * 4];
+
+  [target lockFocus];
+  [first drawInRect: NSMakeRect(0, 0, 100, 100)];
+  size = [NSImage imageCacheSize];
+  PASS(size >= 100 * 100 * 4, "decoded image is counted");
+
+  [second drawInRect: NSMakeRect(0, 0, 100, 100)];
+  PASS([NSImage imageCacheSize] <= size,
+       "least recently drawn image is released over budget");
+
+  [first drawInRect: NSMakeRect(0, 0, 100, 100)];
+  [target unlockFocus];
+  PASS([first isValid] && [[first representations] count] > 0,
+       "released image is decoded again when drawn");
+
+  [NSImage setImageCacheLimit: 0];
+  PASS([NSImage imageCacheSize] == 0, "lowering the budget to 0 empties the cache");
+
+  [NSImage setImageCacheLimit: 4 * 100 * 100 * 4];
+  [target lockFocus];
+  [second drawInRect: NSMakeRect(0, 0, 100, 100)];
+  [target unlockFocus];
+  PASS([second isValid] && [[second representations] count] > 0
+       && [[[second representations] objectAtIndex: 0] pixelsWide] == 100,
+       "trimmed image is decoded again when drawn");
+  PASS([NSImage imageCacheSize] >= 100 * 100 * 4,
+       "reloaded image is counted again");
+
+  /* Images decoded to a maximum size are decoded again at that size. */
+  scaled = AUTORELEASE([[NSImage alloc]
+    initWithData: [[[second representations] objectAtIndex: 0]
+                    TIFFRepresentation]
+    maximumPixelSize: NSMakeSize(50, 50)]);
+  [NSImage setImageCacheLimit: 0];
+  [NSImage setImageCacheLimit: 4 * 100 * 100 * 4];
+  [target lockFocus];
+  [scaled drawInRect: NSMakeRect(0, 0, 100, 100)];
+  [target unlockFocus];
+  PASS([NSImage imageCacheSize] >= 50 * 50 * 4,
+       "image decoded to a maximum size can be released");
+  [NSImage setImageCacheLimit: 0];
+  PASS([NSImage imageCacheSize] == 0, "it is released");
+  PASS([[[scaled representations] objectAtIndex: 0] pixelsWide] == 50,
+       "it is decoded again at the maximum size");
+
+  DESTROY(arp);
+  END_SET("NSImage GNUstep cache limit")
+
+  return 0;
+}
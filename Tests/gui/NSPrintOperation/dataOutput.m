@@ -0,0 +1,116 @@
+/*
+  Check that PDF and EPS operations with an NSData destination write
+  their output straight into the data.  The pipe collecting the output
+  is checked first, which needs no backend.
+*/
+
+#include <string.h>
+
+#import "Testing.h"
+#import <Foundation/NSAutoreleasePool.h>
+#import <Foundation/NSData.h>
+#import <Foundation/NSFileHandle.h>
+#import <Foundation/NSString.h>
+#import <AppKit/NSApplication.h>
+#import <AppKit/NSPrintOperation.h>
+#import <AppKit/NSView.h>
+
+/* Private class of NSPrintOperation.m */
+@interface GSPrintDataSink : NSObject
+- (id) initWithData: (NSMutableData *)data;
+- (NSString *) path;
+- (void) finish;
+@end
+
+@interface TrivialView : NSView
+@end
+
+@implementation TrivialView
+- (void) drawRect: (NSRect)rect
+{
+}
+@end
+
+static BOOL
+hasPrefix(NSData *data, const char *prefix)
+{
+  NSUInteger length = strlen(prefix);
+
+  return [data length] >= length
+    && memcmp([data bytes], prefix, length) == 0;
+}
+
+int
+main(int argc, char **argv)
+{
+  GSPrintDataSink *sink;
+  NSFileHandle *handle;
+  NSMutableData *data;
+  NSMutableData *big;
+  NSPrintOperation *op;
+  TrivialView *view;
+  BOOL result;
+
+  START_SET("NSPrintOperation GNUstep data sink")
+  CREATE_AUTORELEASE_POOL(arp);
+
+  /* Larger than a pipe buffer, so it must be drained while written. */
+  big = [NSMutableData dataWithLength: 256 * 1024];
+  memset([big mutableBytes], 'x', [big length]);
+
+  data = [NSMutableData data];
+  sink = AUTORELEASE([[GSPrintDataSink alloc] initWithData: data]);
+  if (sink == nil)
+    SKIP("There is no /dev/fd here, so output goes to a temporary file")
+
+  PASS([[sink path] hasPrefix: @"/dev/fd/"], "the sink has a path");
+  handle = [NSFileHandle fileHandleForWritingAtPath: [sink path]];
+  PASS(handle != nil, "the path can be opened for writing");
+  [handle writeData: big];
+  [handle closeFile];
+  [sink finish];
+  PASS([data isEqualToData: big], "everything written ends up in the data");
+
+  DESTROY(arp);
+  END_SET("NSPrintOperation GNUstep data sink")
+
+  START_SET("NSPrintOperation GNUstep data output")
+  CREATE_AUTORELEASE_POOL(arp);
+
+  NS_DURING
+  {
+    [NSApplication sharedApplication];
+  }
+  NS_HANDLER
+  {
+    if ([[localException name] isEqualToString: NSInternalInconsistencyException ])
+       SKIP("It looks like GNUstep backend is not yet installed")
+  }
+  NS_ENDHANDLER
+
+  view = AUTORELEASE([[TrivialView alloc]
+    initWithFrame: NSMakeRect(0, 0, 100, 100)]);
+
+  data = [NSMutableData data];
+  op = [NSPrintOperation PDFOperationWithView: view
+                                   insideRect: [view bounds]
+                                       toData: data];
+  [op setShowsPrintPanel: NO];
+  [op setShowsProgressPanel: NO];
+  result = [op runOperation];
+  PASS(result && hasPrefix(data, "%PDF"), "PDF output goes into the data");
+
+  data = [NSMutableData data];
+  op = [NSPrintOperation EPSOperationWithView: view
+                                   insideRect: [view bounds]
+                                       toData: data];
+  [op setShowsPrintPanel: NO];
+  [op setShowsProgressPanel: NO];
+  result = [op runOperation];
+  PASS(result && hasPrefix(data, "%!PS"), "EPS output goes into the data");
+
+  DESTROY(arp);
+  END_SET("NSPrintOperation GNUstep data output")
+
+  return 0;
+}
@@ -0,0 +1,100 @@
+/*
+  Check that a print operation allowed to spawn a separate thread draws
+  its view there, reports success once the thread is done and reports
+  failure when it is cancelled while printing.
+*/
+
+#import "Testing.h"
+#import <Foundation/NSAutoreleasePool.h>
+#import <Foundation/NSData.h>
+#import <Foundation/NSThread.h>
+#import <AppKit/NSApplication.h>
+#import <AppKit/NSPrintOperation.h>
+#import <AppKit/NSView.h>
+
+@interface NSPrintOperation (Private)
+- (void) _cancel: (id)sender;
+@end
+
+/* Counts how often it is drawn and where, and may cancel printing. */
+@interface TrivialView : NSView
+{
+@public
+  int draws;
+  BOOL drewOnMainThread;
+  BOOL cancels;
+}
+@end
+
+@implementation TrivialView
+- (void) drawRect: (NSRect)rect
+{
+  draws++;
+  if ([NSThread isMainThread])
+    {
+      drewOnMainThread = YES;
+    }
+  if (cancels)
+    {
+      [[NSPrintOperation currentOperation] _cancel: self];
+    }
+}
+@end
+
+int
+main(int argc, char **argv)
+{
+  TrivialView *view;
+  NSMutableData *data;
+  NSPrintOperation *op;
+  BOOL result;
+
+  START_SET("NSPrintOperation GNUstep separate thread")
+  CREATE_AUTORELEASE_POOL(arp);
+
+  NS_DURING
+  {
+    [NSApplication sharedApplication];
+  }
+  NS_HANDLER
+  {
+    if ([[localException name] isEqualToString: NSInternalInconsistencyException ])
+       SKIP("It looks like GNUstep backend is not yet installed")
+  }
+  NS_ENDHANDLER
+
+  view = AUTORELEASE([[TrivialView alloc]
+    initWithFrame: NSMakeRect(0, 0, 100, 100)]);
+  data = [NSMutableData data];
+  op = [NSPrintOperation EPSOperationWithView: view
+                                   insideRect: [view bounds]
+                                       toData: data];
+  [op setShowsPrintPanel: NO];
+  [op setShowsProgressPanel: NO];
+  [op setCanSpawnSeparateThread: YES];
+  PASS([op canSpawnSeparateThread], "the operation may spawn a thread");
+
+  result = [op runOperation];
+  PASS(result, "-runOperation succeeds once the thread is done");
+  PASS(view->draws > 0 && !view->drewOnMainThread,
+       "the view is drawn outside the main thread");
+  PASS([data length] > 0, "the output is delivered");
+
+  view->draws = 0;
+  view->cancels = YES;
+  data = [NSMutableData data];
+  op = [NSPrintOperation EPSOperationWithView: view
+                                   insideRect: [view bounds]
+                                       toData: data];
+  [op setShowsPrintPanel: NO];
+  [op setShowsProgressPanel: NO];
+  [op setCanSpawnSeparateThread: YES];
+  result = [op runOperation];
+  PASS(!result && view->draws == 1,
+       "cancelling stops the operation and makes it fail");
+
+  DESTROY(arp);
+  END_SET("NSPrintOperation GNUstep separate thread")
+
+  return 0;
+}
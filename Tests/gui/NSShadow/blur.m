@@ -0,0 +1,96 @@
+/*
+  Check the software blur used for shadow masks.  It is plain C, so no
+  backend is needed.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#import "Testing.h"
+#import <Foundation/NSAutoreleasePool.h>
+
+/* Private function of NSShadow.m */
+extern void GSShadowBlurMask(unsigned char *mask, NSInteger w, NSInteger h,
+                             double sigma);
+
+/* Returns a w by h mask with a size by size square of full coverage
+   with its top left corner at x, y. */
+static unsigned char *
+squareMask(NSInteger w, NSInteger h, NSInteger x, NSInteger y, NSInteger size)
+{
+  unsigned char *m = calloc(w * h, 1);
+  NSInteger i, j;
+
+  for (j = y; j < y + size; j++)
+    for (i = x; i < x + size; i++)
+      m[j * w + i] = 255;
+  return m;
+}
+
+int
+main(int argc, char **argv)
+{
+  unsigned char *m;
+  unsigned char *big;
+  NSInteger i, j;
+  long sum;
+  BOOL symmetric, decreasing, same;
+
+  START_SET("NSShadow GNUstep blur")
+  CREATE_AUTORELEASE_POOL(arp);
+
+  m = squareMask(31, 31, 13, 13, 5);
+  GSShadowBlurMask(m, 31, 31, 0.0);
+  PASS(m[15 * 31 + 15] == 255 && m[12 * 31 + 15] == 0,
+       "no blur leaves the mask alone");
+
+  GSShadowBlurMask(m, 31, 31, 2.0);
+  sum = 0;
+  symmetric = YES;
+  for (j = 0; j < 31; j++)
+    for (i = 0; i < 31; i++)
+      {
+        sum += m[j * 31 + i];
+        if (abs(m[j * 31 + i] - m[i * 31 + j]) > 1
+          || abs(m[j * 31 + i] - m[(30 - j) * 31 + (30 - i)]) > 1)
+          symmetric = NO;
+      }
+  PASS(symmetric, "blur is symmetric up to rounding");
+  PASS(labs(sum - 25 * 255) < 25 * 255 / 20, "blur keeps the coverage");
+  PASS(m[15 * 31 + 15] < 255 && m[15 * 31 + 15] > 0,
+       "centre of a small square is blurred");
+  PASS(m[0] == 0 && m[15 * 31 + 0] == 0, "far pixels stay transparent");
+
+  decreasing = YES;
+  for (i = 16; i < 31; i++)
+    if (m[15 * 31 + i] > m[15 * 31 + i - 1])
+      decreasing = NO;
+  PASS(decreasing, "coverage falls off away from the square");
+  free(m);
+
+  m = squareMask(41, 41, 0, 0, 41);
+  GSShadowBlurMask(m, 41, 41, 2.0);
+  PASS(m[20 * 41 + 20] == 255, "inside of a large area keeps full coverage");
+  PASS(m[0] < m[20 * 41 + 0] && m[20 * 41 + 0] < 255,
+       "edges fade out as if surrounded by transparency");
+  free(m);
+
+  /* Big masks are blurred by several threads; the result must be the
+     same as for a small mask. */
+  m = squareMask(61, 61, 20, 20, 21);
+  big = squareMask(400, 400, 20, 20, 21);
+  GSShadowBlurMask(m, 61, 61, 3.0);
+  GSShadowBlurMask(big, 400, 400, 3.0);
+  same = YES;
+  for (j = 0; j < 61; j++)
+    if (memcmp(m + j * 61, big + j * 400, 61) != 0)
+      same = NO;
+  PASS(same, "threaded blur gives the same result");
+  free(m);
+  free(big);
+
+  DESTROY(arp);
+  END_SET("NSShadow GNUstep blur")
+
+  return 0;
+}
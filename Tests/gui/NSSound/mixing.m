@@ -0,0 +1,159 @@
+/*
+  Play two sounds at once through the shared sound engine, writing the
+  mixed output to a file instead of an audio device.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#import "Testing.h"
+#import <Foundation/NSAutoreleasePool.h>
+#import <Foundation/NSData.h>
+#import <Foundation/NSDate.h>
+#import <Foundation/NSDictionary.h>
+#import <Foundation/NSFileManager.h>
+#import <Foundation/NSRunLoop.h>
+#import <Foundation/NSUserDefaults.h>
+#import <AppKit/NSSound.h>
+
+#define RATE 22050
+
+@interface Listener : NSObject
+{
+@public
+  int finished;
+  BOOL success[2];
+}
+@end
+
+@implementation Listener
+- (void) sound: (NSSound *)sound didFinishPlaying: (BOOL)flag
+{
+  success[[[sound name] isEqualToString: @"short"] ? 0 : 1] = flag;
+  finished++;
+}
+@end
+
+static void
+put32(unsigned char *p, unsigned int v)
+{
+  p[0] = v & 0xFF;
+  p[1] = (v >> 8) & 0xFF;
+  p[2] = (v >> 16) & 0xFF;
+  p[3] = (v >> 24) & 0xFF;
+}
+
+/* Mono 16 bit WAVE data holding a constant level. */
+static NSData *
+waveData(NSUInteger frames, short level)
+{
+  NSMutableData *d = [NSMutableData dataWithLength: 44 + 2 * frames];
+  unsigned char *b = [d mutableBytes];
+  NSUInteger i;
+
+  memcpy(b, "RIFF", 4);
+  put32(b + 4, 36 + 2 * frames);
+  memcpy(b + 8, "WAVEfmt ", 8);
+  put32(b + 16, 16);
+  b[20] = 1;                    // PCM
+  b[22] = 1;                    // mono
+  put32(b + 24, RATE);
+  put32(b + 28, 2 * RATE);
+  b[32] = 2;
+  b[34] = 16;
+  memcpy(b + 36, "data", 4);
+  put32(b + 40, 2 * frames);
+  for (i = 0; i < frames; i++)
+    {
+      b[44 + 2 * i] = level & 0xFF;
+      b[45 + 2 * i] = (level >> 8) & 0xFF;
+    }
+  return d;
+}
+
+static void
+waitFor(Listener *l, int count)
+{
+  NSDate *limit = [NSDate dateWithTimeIntervalSinceNow: 10.0];
+
+  while (l->finished < count && [limit timeIntervalSinceNow] > 0.0)
+    {
+      [[NSRunLoop currentRunLoop]
+        runMode: NSDefaultRunLoopMode
+        beforeDate: [NSDate dateWithTimeIntervalSinceNow: 0.01]];
+    }
+}
+
+int
+main(int argc, char **argv)
+{
+  NSString *path;
+  NSSound *looping;
+  NSSound *once;
+  Listener *listener;
+  NSData *output;
+  const short *samples;
+  NSUInteger count, i;
+  BOOL mixed = NO;
+  BOOL single = NO;
+
+  START_SET("NSSound GNUstep mixing engine")
+  CREATE_AUTORELEASE_POOL(arp);
+
+  path = [NSTemporaryDirectory()
+           stringByAppendingPathComponent: @"NSSound-mixing.raw"];
+  [[NSFileManager defaultManager] removeFileAtPath: path handler: nil];
+  [[NSUserDefaults standardUserDefaults] registerDefaults:
+    [NSDictionary dictionaryWithObjectsAndKeys:
+      @"GSNullSoundSink", @"GSSoundOutputSink",
+      path, @"GSSoundOutputFile", nil]];
+
+  listener = AUTORELEASE([Listener new]);
+  looping = AUTORELEASE([[NSSound alloc]
+    initWithData: waveData(RATE / 20, 8192)]);
+  once = AUTORELEASE([[NSSound alloc]
+    initWithData: waveData(RATE / 5, 8192)]);
+  PASS(looping != nil && once != nil, "WAVE data can be played");
+
+  [looping setName: @"short"];
+  [looping setLoops: YES];
+  [looping setDelegate: listener];
+  [once setName: @"long"];
+  [once setVolume: 0.5];
+  [once setDelegate: listener];
+
+  PASS([looping play], "first sound starts");
+  PASS([once play], "second sound starts while the first plays");
+  PASS([looping isPlaying] && [once isPlaying], "both sounds are playing");
+  PASS([once play] == NO, "a playing sound cannot be started again");
+
+  waitFor(listener, 1);
+  PASS(listener->finished == 1 && listener->success[1],
+       "second sound played to the end");
+  PASS([looping isPlaying], "looping sound keeps playing");
+
+  PASS([looping stop], "looping sound stops");
+  waitFor(listener, 2);
+  PASS(listener->finished == 2 && listener->success[0] == NO,
+       "stopped sound reports that it did not finish");
+
+  output = [NSData dataWithContentsOfFile: path];
+  samples = [output bytes];
+  count = [output length] / sizeof(short);
+  PASS(count >= 2 * 44100 / 5, "output covers the longer sound");
+  for (i = 0; i < count; i++)
+    {
+      if (abs(samples[i] - 8191) <= 2)
+        single = YES;
+      else if (abs(samples[i] - 12287) <= 2)
+        mixed = YES;
+    }
+  PASS(single, "first sound is heard alone");
+  PASS(mixed, "sounds are mixed at their own volume");
+
+  [[NSFileManager defaultManager] removeFileAtPath: path handler: nil];
+  DESTROY(arp);
+  END_SET("NSSound GNUstep mixing engine")
+
+  return 0;
+}
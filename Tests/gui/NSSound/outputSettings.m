@@ -0,0 +1,210 @@
+/*
+  Check that the playback device and channel mapping of a sound reach
+  the sink of the shared sound engine, and that a playing sound can be
+  moved.
+*/
+
+#include <math.h>
+#include <string.h>
+
+#import "Testing.h"
+#import <Foundation/NSArray.h>
+#import <Foundation/NSAutoreleasePool.h>
+#import <Foundation/NSData.h>
+#import <Foundation/NSDate.h>
+#import <Foundation/NSDictionary.h>
+#import <Foundation/NSRunLoop.h>
+#import <Foundation/NSThread.h>
+#import <Foundation/NSUserDefaults.h>
+#import <AppKit/NSSound.h>
+#import <GNUstepGUI/GSSoundSink.h>
+
+#define RATE 22050
+
+static NSString *openedDevice = nil;
+static NSArray *openedMapping = nil;
+static int finished = 0;
+
+/* Sink which remembers the settings it was opened with. */
+@interface RecordingSink : NSObject <GSSoundSink>
+{
+  NSString *device;
+  NSArray *mapping;
+  float volume;
+}
+@end
+
+@implementation RecordingSink
++ (BOOL) canInitWithPlaybackDevice: (NSString *)playbackDevice
+{
+  return ![playbackDevice isEqual: @"unknown-device"];
+}
+
+- (id) initWithEncoding: (int)encoding
+               channels: (NSUInteger)channelCount
+             sampleRate: (NSUInteger)sampleRate
+              byteOrder: (NSByteOrder)byteOrder
+{
+  return [super init];
+}
+
+- (void) dealloc
+{
+  RELEASE(device);
+  RELEASE(mapping);
+  [super dealloc];
+}
+
+- (BOOL) open
+{
+  @synchronized ([RecordingSink class])
+    {
+      ASSIGN(openedDevice, device);
+      ASSIGN(openedMapping, mapping);
+    }
+  return YES;
+}
+
+- (void) close
+{
+}
+
+- (BOOL) playBytes: (void *)bytes length: (NSUInteger)length
+{
+  [NSThread sleepUntilDate: [NSDate dateWithTimeIntervalSinceNow: 0.005]];
+  return YES;
+}
+
+- (void) setVolume: (float)aVolume
+{
+  volume = aVolume;
+}
+
+- (float) volume
+{
+  return volume;
+}
+
+- (void) setPlaybackDeviceIdentifier: (NSString *)playbackDeviceIdentifier
+{
+  ASSIGN(device, playbackDeviceIdentifier);
+}
+
+- (NSString *) playbackDeviceIdentifier
+{
+  return device;
+}
+
+- (void) setChannelMapping: (NSArray *)channelMapping
+{
+  ASSIGN(mapping, channelMapping);
+}
+
+- (NSArray *) channelMapping
+{
+  return mapping;
+}
+@end
+
+@interface Listener : NSObject
+@end
+
+@implementation Listener
+- (void) sound: (NSSound *)sound didFinishPlaying: (BOOL)flag
+{
+  finished++;
+}
+@end
+
+/* Mono 16 bit WAVE data holding silence. */
+static NSData *
+waveData(NSUInteger frames)
+{
+  NSMutableData *d = [NSMutableData dataWithLength: 44 + 2 * frames];
+  unsigned char *b = [d mutableBytes];
+
+  memcpy(b, "RIFF", 4);
+  b[4] = (36 + 2 * frames) & 0xFF;
+  b[5] = ((36 + 2 * frames) >> 8) & 0xFF;
+  memcpy(b + 8, "WAVEfmt ", 8);
+  b[16] = 16;
+  b[20] = 1;                    // PCM
+  b[22] = 1;                    // mono
+  b[24] = RATE & 0xFF;
+  b[25] = (RATE >> 8) & 0xFF;
+  b[28] = (2 * RATE) & 0xFF;
+  b[29] = ((2 * RATE) >> 8) & 0xFF;
+  b[30] = ((2 * RATE) >> 16) & 0xFF;
+  b[32] = 2;
+  b[34] = 16;
+  memcpy(b + 36, "data", 4);
+  b[40] = (2 * frames) & 0xFF;
+  b[41] = ((2 * frames) >> 8) & 0xFF;
+  return d;
+}
+
+static void
+waitFor(int count)
+{
+  NSDate *limit = [NSDate dateWithTimeIntervalSinceNow: 10.0];
+
+  while (finished < count && [limit timeIntervalSinceNow] > 0.0)
+    {
+      [[NSRunLoop currentRunLoop]
+        runMode: NSDefaultRunLoopMode
+        beforeDate: [NSDate dateWithTimeIntervalSinceNow: 0.01]];
+    }
+}
+
+int
+main(int argc, char **argv)
+{
+  NSSound *sound;
+  NSArray *mapping;
+  Listener *listener;
+  BOOL ok;
+
+  START_SET("NSSound GNUstep output settings")
+  CREATE_AUTORELEASE_POOL(arp);
+
+  [[NSUserDefaults standardUserDefaults] registerDefaults:
+    [NSDictionary dictionaryWithObject: @"RecordingSink"
+                                forKey: @"GSSoundOutputSink"]];
+
+  listener = AUTORELEASE([Listener new]);
+  mapping = [NSArray arrayWithObjects: @"1", @"0", nil];
+  sound = AUTORELEASE([[NSSound alloc] initWithData: waveData(RATE / 10)]);
+  [sound setDelegate: listener];
+  [sound setPlaybackDeviceIdentifier: @"test-device"];
+  [sound setChannelMapping: mapping];
+  PASS([[sound playbackDeviceIdentifier] isEqual: @"test-device"]
+       && [[sound channelMapping] isEqual: mapping],
+       "settings are kept by the sound");
+  [sound setPlaybackDeviceIdentifier: @"unknown-device"];
+  PASS([[sound playbackDeviceIdentifier] isEqual: @"test-device"],
+       "a device the sink cannot use is ignored");
+
+  PASS([sound play], "sound starts");
+  waitFor(1);
+  PASS(finished == 1, "sound played to the end");
+  @synchronized ([RecordingSink class])
+    {
+      ok = [openedDevice isEqual: @"test-device"]
+        && [openedMapping isEqual: mapping];
+    }
+  PASS(ok, "sink is opened with the device and mapping of the sound");
+
+  sound = AUTORELEASE([[NSSound alloc] initWithData: waveData(RATE)]);
+  [sound setDelegate: listener];
+  PASS([sound play], "a longer sound starts");
+  [sound setCurrentTime: 0.5];
+  PASS(fabs([sound currentTime] - 0.5) < 0.1,
+       "a playing sound can be moved");
+  [sound stop];
+  waitFor(2);
+
+  DESTROY(arp);
+  END_SET("NSSound GNUstep output settings")
+
+  return 0;
+}
@@ -0,0 +1,258 @@
+/*
+  Check how NSSpellChecker splits text into words and batches the
+  unknown ones for the spell server.  A fake proxy stands in for the
+  server, so none needs to be running.
+*/
+
+#import "Testing.h"
+#import <Foundation/NSArray.h>
+#import <Foundation/NSAutoreleasePool.h>
+#import <Foundation/NSDictionary.h>
+#import <Foundation/NSSet.h>
+#import <Foundation/NSString.h>
+#import <Foundation/NSValue.h>
+#import <AppKit/NSSpellChecker.h>
+
+/* Private function of NSSpellChecker.m */
+extern NSArray *GSSpellCheckerWordRanges(NSString *string, NSRange range);
+
+@interface NSSpellChecker (GNUstepPrivate)
+- (NSArray *) _misspelledRangesInString: (NSString *)string
+                                  range: (NSRange)range
+                               language: (NSString *)language
+                           ignoredWords: (NSArray *)ignored
+                                  cache: (NSMutableDictionary *)cache
+                                  proxy: (id)proxy;
+@end
+
+/* Spell server which knows a fixed set of misspelled words, can only
+   return the first one of a string, and counts how often it is asked. */
+@interface FakeSpellServer : NSObject
+{
+  NSSet *misspelled;
+@public
+  int calls;
+}
+@end
+
+@implementation FakeSpellServer
+- (id) initWithMisspelledWords: (NSArray *)words
+{
+  if ((self = [super init]) != nil)
+    {
+      misspelled = [[NSSet alloc] initWithArray: words];
+    }
+  return self;
+}
+
+- (void) dealloc
+{
+  RELEASE(misspelled);
+  [super dealloc];
+}
+
+- (NSRange) _findMisspelledWordInString: (NSString *)stringToCheck
+                               language: (NSString *)language
+                           ignoredWords: (NSArray *)ignoredWords
+                              wordCount: (int *)wordCount
+                              countOnly: (BOOL)countOnly
+{
+  NSArray *words = [stringToCheck componentsSeparatedByString: @" "];
+  NSUInteger pos = 0;
+  NSUInteger i;
+
+  calls++;
+  *wordCount = [words count];
+  for (i = 0; i < [words count]; i++)
+    {
+      NSString *word = [words objectAtIndex: i];
+
+      if ([misspelled containsObject: word])
+        {
+          return NSMakeRange(pos, [word length]);
+        }
+      pos += [word length] + 1;
+    }
+  return NSMakeRange(NSNotFound, 0);
+}
+@end
+
+/* Spell server which can return all misspelled words of a string. */
+@interface BatchSpellServer : FakeSpellServer
+{
+@public
+  int batchCalls;
+}
+@end
+
+@implementation BatchSpellServer
+- (NSArray *) _findMisspelledWordsInString: (NSString *)stringToCheck
+                                  language: (NSString *)language
+                              ignoredWords: (NSArray *)ignoredWords
+{
+  NSMutableArray *ranges = [NSMutableArray array];
+  NSArray *words = [stringToCheck componentsSeparatedByString: @" "];
+  NSUInteger pos = 0;
+  NSUInteger i;
+
+  batchCalls++;
+  for (i = 0; i < [words count]; i++)
+    {
+      NSString *word = [words objectAtIndex: i];
+
+      if ([misspelled containsObject: word])
+        {
+          [ranges addObject:
+            [NSValue valueWithRange: NSMakeRange(pos, [word length])]];
+        }
+      pos += [word length] + 1;
+    }
+  return ranges;
+}
+@end
+
+static BOOL
+rangesAre(NSArray *ranges, NSUInteger count, NSRange *expected)
+{
+  NSUInteger i;
+
+  if ([ranges count] != count)
+    return NO;
+  for (i = 0; i < count; i++)
+    {
+      NSRange r = [[ranges objectAtIndex: i] rangeValue];
+
+      if (!NSEqualRanges(r, expected[i]))
+        return NO;
+    }
+  return YES;
+}
+
+int
+main(int argc, char **argv)
+{
+  NSSpellChecker *checker;
+  FakeSpellServer *server;
+  NSMutableDictionary *cache;
+  NSArray *ranges;
+  NSString *text = @"teh cat sat on teh mat wiht";
+  NSRange words[] = {{0, 4}, {6, 1}, {8, 5}, {14, 4}, {20, 6}};
+  NSRange dog[] = {{8, 5}};
+  NSRange rock[] = {{0, 4}, {6, 1}};
+  NSRange bad[] = {{0, 3}, {15, 3}, {23, 4}};
+  NSRange ignored[] = {{23, 4}};
+  NSMutableString *longText;
+  int i;
+
+  START_SET("NSSpellChecker GNUstep misspelled ranges")
+  CREATE_AUTORELEASE_POOL(arp);
+
+  ranges = GSSpellCheckerWordRanges(@"it's  a dog's-life 'quoted'",
+                                    NSMakeRange(0, 27));
+  PASS(rangesAre(ranges, 5, words),
+       "words are runs of letters with apostrophes inside them");
+  ranges = GSSpellCheckerWordRanges(@"it's  a dog's-life 'quoted'",
+                                    NSMakeRange(8, 5));
+  PASS(rangesAre(ranges, 1, dog), "only words in the range are found");
+  ranges = GSSpellCheckerWordRanges(@"rock''n", NSMakeRange(0, 7));
+  PASS(rangesAre(ranges, 2, rock), "two apostrophes end a word");
+  ranges = GSSpellCheckerWordRanges(@" 12, -- ", NSMakeRange(0, 8));
+  PASS([ranges count] == 0, "text without letters has no words");
+
+  /* -init loads the spelling panel, which the checks below do not use. */
+  checker = [NSSpellChecker alloc];
+  server = [[FakeSpellServer alloc] initWithMisspelledWords:
+    [NSArray arrayWithObjects: @"teh", @"wiht", nil]];
+  cache = [NSMutableDictionary dictionary];
+
+  ranges = [checker _misspelledRangesInString: text
+                                        range: NSMakeRange(0, [text length])
+                                     language: @"English"
+                                 ignoredWords: nil
+                                        cache: cache
+                                        proxy: server];
+  PASS(rangesAre(ranges, 3, bad), "every misspelling is found");
+  PASS(server->calls == 2,
+       "an old server is asked once for each distinct misspelled word");
+  PASS([cache count] == 6, "a verdict is cached for each distinct word");
+  PASS([[cache objectForKey: @"teh"] boolValue] == NO
+       && [[cache objectForKey: @"mat"] boolValue] == YES,
+       "cached verdicts are right");
+
+  server->calls = 0;
+  ranges = [checker _misspelledRangesInString: text
+                                        range: NSMakeRange(0, [text length])
+                                     language: @"English"
+                                 ignoredWords: nil
+                                        cache: cache
+                                        proxy: server];
+  PASS(rangesAre(ranges, 3, bad) && server->calls == 0,
+       "cached words are not sent to the server again");
+
+  cache = [NSMutableDictionary dictionary];
+  ranges = [checker _misspelledRangesInString: text
+                                        range: NSMakeRange(0, [text length])
+                                     language: @"English"
+                                 ignoredWords:
+                                   [NSArray arrayWithObject: @"teh"]
+                                        cache: cache
+                                        proxy: server];
+  PASS(rangesAre(ranges, 1, ignored) && server->calls == 1,
+       "ignored words are neither reported nor sent to the server");
+  PASS([cache objectForKey: @"teh"] == nil, "ignored words are not cached");
+
+  cache = [NSMutableDictionary dictionary];
+  ranges = [checker _misspelledRangesInString: text
+                                        range: NSMakeRange(0, [text length])
+                                     language: @"English"
+                                 ignoredWords: nil
+                                        cache: cache
+                                        proxy: nil];
+  PASS([ranges count] == 0 && [cache count] == 0,
+       "without a server nothing is reported or cached");
+
+  /* Keeps the old server alive, so the new one is at another address */
+  AUTORELEASE(server);
+  server = [[BatchSpellServer alloc] initWithMisspelledWords:
+    [NSArray arrayWithObjects: @"teh", @"wiht", nil]];
+  cache = [NSMutableDictionary dictionary];
+  ranges = [checker _misspelledRangesInString: text
+                                        range: NSMakeRange(0, [text length])
+                                     language: @"English"
+                                 ignoredWords: nil
+                                        cache: cache
+                                        proxy: server];
+  PASS(rangesAre(ranges, 3, bad), "a batch server finds every misspelling");
+  PASS(((BatchSpellServer *)server)->batchCalls == 1 && server->calls == 0,
+       "a batch server is asked once for all words");
+  PASS([[cache objectForKey: @"wiht"] boolValue] == NO
+       && [[cache objectForKey: @"sat"] boolValue] == YES,
+       "the verdicts of a batch server are cached");
+
+  /* Many misspellings from a server which only finds the first one */
+  RELEASE(server);
+  server = [[FakeSpellServer alloc] initWithMisspelledWords:
+    [NSArray arrayWithObjects: @"teh", @"wiht", nil]];
+  longText = [NSMutableString string];
+  for (i = 0; i < 1000; i++)
+    {
+      [longText appendFormat: @"w%c%c%c teh ",
+        'a' + (i % 26), 'a' + (i / 26 % 26), 'a' + (i / 676)];
+    }
+  cache = [NSMutableDictionary dictionary];
+  ranges = [checker _misspelledRangesInString: longText
+                                        range: NSMakeRange(0, [longText length])
+                                     language: @"English"
+                                 ignoredWords: nil
+                                        cache: cache
+                                        proxy: server];
+  PASS([ranges count] == 1000 && server->calls <= 1001 / 64 + 2,
+       "words are sent to an old server a bounded number at a time");
+
+  RELEASE(server);
+  RELEASE(checker);
+  DESTROY(arp);
+  END_SET("NSSpellChecker GNUstep misspelled ranges")
+
+  return 0;
+}
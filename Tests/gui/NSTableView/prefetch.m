@@ -0,0 +1,178 @@
+/*
+  Check which rows a table view asks a prefetching data source for, and
+  that the object values it caches are dropped when they may be stale.
+  The table is put in a clip view outside any window and the prefetch
+  window is updated by hand, as drawing would do.
+*/
+
+#import "Testing.h"
+#import <Foundation/NSAutoreleasePool.h>
+#import <Foundation/NSIndexSet.h>
+#import <AppKit/NSApplication.h>
+#import <AppKit/NSClipView.h>
+#import <AppKit/NSTableColumn.h>
+#import <AppKit/NSTableView.h>
+
+#define ROWS 1000
+
+@interface NSTableView (Private)
+- (id) _objectValueForTableColumn: (NSTableColumn *)tb
+                              row: (NSInteger)index;
+- (void) _updatePrefetching;
+@end
+
+@interface PrefetchingSource : NSObject
+{
+@public
+  NSMutableIndexSet *fetched;
+  NSMutableIndexSet *cancelled;
+  NSInteger rows;
+  int calls;
+}
+@end
+
+@implementation PrefetchingSource
+- (id) init
+{
+  if ((self = [super init]) != nil)
+    {
+      fetched = [NSMutableIndexSet new];
+      cancelled = [NSMutableIndexSet new];
+      rows = ROWS;
+    }
+  return self;
+}
+
+- (void) dealloc
+{
+  RELEASE(fetched);
+  RELEASE(cancelled);
+  [super dealloc];
+}
+
+- (NSInteger) numberOfRowsInTableView: (NSTableView *)aTableView
+{
+  return rows;
+}
+
+- (id) tableView: (NSTableView *)aTableView
+objectValueForTableColumn: (NSTableColumn *)aTableColumn
+             row: (NSInteger)rowIndex
+{
+  calls++;
+  return [NSString stringWithFormat: @"%@ %ld",
+    [aTableColumn identifier], (long)rowIndex];
+}
+
+- (void) tableView: (NSTableView *)aTableView
+prefetchRowsWithIndexes: (NSIndexSet *)rows
+{
+  [fetched addIndexes: rows];
+}
+
+- (void) tableView: (NSTableView *)aTableView
+cancelPrefetchingForRowsWithIndexes: (NSIndexSet *)rows
+{
+  [cancelled addIndexes: rows];
+}
+@end
+
+int
+main(int argc, char **argv)
+{
+  NSTableView *table;
+  NSTableColumn *first, *second;
+  NSClipView *clip;
+  PrefetchingSource *source;
+  NSRange visible, scrolled;
+  id value;
+
+  START_SET("NSTableView GNUstep prefetching")
+  CREATE_AUTORELEASE_POOL(arp);
+
+  NS_DURING
+  {
+    [NSApplication sharedApplication];
+  }
+  NS_HANDLER
+  {
+    if ([[localException name] isEqualToString: NSInternalInconsistencyException ])
+       SKIP("It looks like GNUstep backend is not yet installed")
+  }
+  NS_ENDHANDLER
+
+  source = AUTORELEASE([PrefetchingSource new]);
+  table = AUTORELEASE([[NSTableView alloc]
+    initWithFrame: NSMakeRect(0, 0, 200, 200)]);
+  first = AUTORELEASE([[NSTableColumn alloc] initWithIdentifier: @"first"]);
+  second = AUTORELEASE([[NSTableColumn alloc] initWithIdentifier: @"second"]);
+  [table addTableColumn: first];
+  [table addTableColumn: second];
+  clip = AUTORELEASE([[NSClipView alloc]
+    initWithFrame: NSMakeRect(0, 0, 200, 100)]);
+  [clip setDocumentView: table];
+  [table setDataSource: source];
+  [table reloadData];
+
+  [table _updatePrefetching];
+  visible = [table rowsInRect: [table visibleRect]];
+  PASS(visible.location == 0 && visible.length > 0 && visible.length < ROWS,
+       "only the top rows are visible");
+  PASS([source->fetched containsIndexesInRange:
+    NSMakeRange(NSMaxRange(visible), visible.length)],
+       "the screen below the visible rows is prefetched");
+  PASS(![source->fetched intersectsIndexesInRange: visible],
+       "visible rows are not prefetched");
+
+  value = [table _objectValueForTableColumn: first row: 0];
+  source->calls = 0;
+  value = [table _objectValueForTableColumn: first row: 0];
+  PASS(source->calls == 0 && [value isEqual: @"first 0"],
+       "object values of visible rows are cached");
+
+  [table scrollRowToVisible: ROWS / 2];
+  [table _updatePrefetching];
+  scrolled = [table rowsInRect: [table visibleRect]];
+  PASS(NSLocationInRange(ROWS / 2, scrolled),
+       "scrolling shows the row");
+  PASS([source->fetched containsIndex: NSMaxRange(scrolled)],
+       "rows below the new visible rows are prefetched");
+  PASS([source->cancelled containsIndex: NSMaxRange(visible)],
+       "rows far above the new visible rows are cancelled");
+  PASS(![source->cancelled intersectsIndexesInRange: scrolled],
+       "the new visible rows are not cancelled");
+
+  source->calls = 0;
+  value = [table _objectValueForTableColumn: first row: 0];
+  PASS(source->calls == 1,
+       "values of rows outside the prefetch window are dropped");
+
+  value = [table _objectValueForTableColumn: second row: ROWS / 2];
+  source->calls = 0;
+  [table moveColumn: 1 toColumn: 0];
+  value = [table _objectValueForTableColumn: second row: ROWS / 2];
+  PASS(source->calls == 1 && [value isEqual: @"second 500"],
+       "values of moved columns are fetched again");
+
+  value = [table _objectValueForTableColumn: first row: ROWS / 2];
+  source->calls = 0;
+  [table reloadDataForRowIndexes: [NSIndexSet indexSetWithIndex: ROWS / 2]
+                   columnIndexes: [NSIndexSet indexSetWithIndex: 0]];
+  value = [table _objectValueForTableColumn: first row: ROWS / 2];
+  PASS(source->calls == 1, "reloaded rows are fetched again");
+
+  [table reloadDataForRowIndexes: [NSIndexSet indexSetWithIndex: 2 * ROWS]
+                   columnIndexes: [NSIndexSet indexSetWithIndex: 0]];
+  PASS([table numberOfRows] == ROWS, "rows past the end are ignored");
+
+  source->rows = ROWS - 10;
+  [table reloadDataForRowIndexes: [NSIndexSet indexSetWithIndex: ROWS - 1]
+                   columnIndexes: [NSIndexSet indexSetWithIndex: 0]];
+  PASS([table numberOfRows] == ROWS - 10,
+       "a changed number of rows is picked up");
+
+  DESTROY(arp);
+  END_SET("NSTableView GNUstep prefetching")
+
+  return 0;
+}
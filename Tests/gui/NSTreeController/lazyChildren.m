@@ -0,0 +1,115 @@
+/*
+  Check that a tree controller only fetches the children of nodes which
+  are accessed, and keeps its nodes and the model in step.
+*/
+
+#import "Testing.h"
+#import <Foundation/NSArray.h>
+#import <Foundation/NSAutoreleasePool.h>
+#import <Foundation/NSIndexPath.h>
+#import <Foundation/NSSortDescriptor.h>
+#import <Foundation/NSString.h>
+#import <Foundation/NSValue.h>
+#import <AppKit/NSTreeController.h>
+#import <AppKit/NSTreeNode.h>
+
+static int fetches = 0;
+
+@interface Item : NSObject
+{
+  NSString *name;
+  NSMutableArray *children;
+}
+@end
+
+@implementation Item
++ (Item *) itemNamed: (NSString *)aName
+{
+  Item *item = AUTORELEASE([Item new]);
+
+  ASSIGN(item->name, aName);
+  item->children = [NSMutableArray new];
+  return item;
+}
+
+- (void) dealloc
+{
+  RELEASE(name);
+  RELEASE(children);
+  [super dealloc];
+}
+
+- (NSString *) name
+{
+  return name;
+}
+
+- (NSMutableArray *) children
+{
+  fetches++;
+  return children;
+}
+
+- (NSUInteger) count
+{
+  return [children count];
+}
+@end
+
+int main(int argc, char **argv)
+{
+  CREATE_AUTORELEASE_POOL(arp);
+  NSTreeController *tc;
+  Item *a = [Item itemNamed: @"a"];
+  Item *b = [Item itemNamed: @"b"];
+  NSTreeNode *root;
+  NSTreeNode *node;
+
+  START_SET("NSTreeController lazy children")
+
+  [[b children] addObject: [Item itemNamed: @"y"]];
+  [[b children] addObject: [Item itemNamed: @"x"]];
+  fetches = 0;
+
+  tc = AUTORELEASE([[NSTreeController alloc] initWithContent:
+    [NSMutableArray arrayWithObjects: b, a, nil]]);
+  [tc setChildrenKeyPath: @"children"];
+  [tc setCountKeyPath: @"count"];
+  [tc setSelectsInsertedObjects: YES];
+  [tc setSortDescriptors: [NSArray arrayWithObject:
+    AUTORELEASE([[NSSortDescriptor alloc] initWithKey: @"name"
+                                            ascending: YES])]];
+
+  root = [tc arrangedObjects];
+  PASS([[root childNodes] count] == 2, "root has the content as children")
+  node = [[root childNodes] objectAtIndex: 0];
+  PASS([node representedObject] == a, "top level is sorted")
+  PASS([node isLeaf] && ![[[root childNodes] objectAtIndex: 1] isLeaf],
+    "count key path tells leaves apart")
+  PASS(fetches == 0, "children are not fetched to tell leaves apart")
+
+  node = [root descendantNodeAtIndexPath:
+    [[NSIndexPath indexPathWithIndex: 1] indexPathByAddingIndex: 0]];
+  PASS_EQUAL([[node representedObject] name], @"x",
+    "children are sorted when they are loaded")
+  PASS(fetches == 1, "only the accessed node fetched its children")
+
+  [tc insertObject: [Item itemNamed: @"z"]
+    atArrangedObjectIndexPath: [NSIndexPath indexPathWithIndex: 0]];
+  PASS([[root childNodes] count] == 3 && [[tc content] count] == 3,
+    "insertion updates nodes and content")
+  PASS([[tc selectionIndexPath] isEqual: [NSIndexPath indexPathWithIndex: 0]],
+    "inserted object is selected")
+  PASS_EQUAL([[[tc selectedObjects] lastObject] name], @"z",
+    "selected objects are the represented objects")
+
+  [tc remove: nil];
+  PASS([[root childNodes] count] == 2 && [[tc content] count] == 2,
+    "removal updates nodes and content")
+  PASS([[tc selectionIndexPaths] count] == 0, "removed node is deselected")
+
+  END_SET("NSTreeController lazy children")
+
+  DESTROY(arp);
+  return 0;
+}
@@ -0,0 +1,106 @@
+/*
+  Check that a tree controller tells observers when its selection or its
+  content change.
+*/
+
+#import "Testing.h"
+#import <Foundation/NSArray.h>
+#import <Foundation/NSAutoreleasePool.h>
+#import <Foundation/NSDictionary.h>
+#import <Foundation/NSIndexPath.h>
+#import <Foundation/NSKeyValueObserving.h>
+#import <Foundation/NSSet.h>
+#import <Foundation/NSString.h>
+#import <AppKit/NSTreeController.h>
+
+@interface Observer : NSObject
+{
+@public
+  NSMutableSet *keys;
+}
+@end
+
+@implementation Observer
+- (id) init
+{
+  if ((self = [super init]) != nil)
+    {
+      keys = [NSMutableSet new];
+    }
+  return self;
+}
+
+- (void) dealloc
+{
+  RELEASE(keys);
+  [super dealloc];
+}
+
+- (void) observeValueForKeyPath: (NSString *)keyPath
+                       ofObject: (id)object
+                         change: (NSDictionary *)change
+                        context: (void *)context
+{
+  [keys addObject: keyPath];
+}
+@end
+
+int main(int argc, char **argv)
+{
+  CREATE_AUTORELEASE_POOL(arp);
+  NSTreeController *tc;
+  Observer *o;
+  NSArray *observed;
+  NSUInteger i;
+
+  START_SET("NSTreeController selection observing")
+
+  observed = [NSArray arrayWithObjects: @"selectionIndexPaths",
+    @"selectedNodes", @"selectedObjects", @"content", nil];
+  tc = AUTORELEASE([[NSTreeController alloc] initWithContent:
+    [NSArray arrayWithObjects: @"a", @"b", nil]]);
+  [tc setSelectsInsertedObjects: NO];
+  o = AUTORELEASE([Observer new]);
+  for (i = 0; i < [observed count]; i++)
+    {
+      [tc addObserver: o
+           forKeyPath: [observed objectAtIndex: i]
+              options: 0
+              context: 0];
+    }
+
+  [tc setSelectionIndexPath: [NSIndexPath indexPathWithIndex: 1]];
+  PASS([o->keys containsObject: @"selectionIndexPaths"]
+    && [o->keys containsObject: @"selectedNodes"]
+    && [o->keys containsObject: @"selectedObjects"],
+    "selecting is reported for all selection keys")
+
+  [o->keys removeAllObjects];
+  [tc insertObject: @"c"
+    atArrangedObjectIndexPath: [NSIndexPath indexPathWithIndex: 0]];
+  PASS([[tc selectionIndexPath] isEqual: [NSIndexPath indexPathWithIndex: 2]],
+    "selection moves with its node")
+  PASS([o->keys containsObject: @"selectionIndexPaths"],
+    "moving the selected node is reported")
+  PASS([o->keys containsObject: @"content"]
+    && [[tc content] isKindOfClass: [NSMutableArray class]]
+    && [[tc content] count] == 3,
+    "replacing immutable content with a mutable copy is reported")
+
+  [o->keys removeAllObjects];
+  [tc removeObjectAtArrangedObjectIndexPath: [tc selectionIndexPath]];
+  PASS([[tc selectionIndexPaths] count] == 0, "removed node is deselected")
+  PASS([o->keys containsObject: @"selectionIndexPaths"]
+    && [o->keys containsObject: @"selectedObjects"],
+    "dropping a removed node from the selection is reported")
+
+  for (i = 0; i < [observed count]; i++)
+    {
+      [tc removeObserver: o forKeyPath: [observed objectAtIndex: i]];
+    }
+
+  END_SET("NSTreeController selection observing")
+
+  DESTROY(arp);
+  return 0;
+}
@@ -0,0 +1,60 @@
+/*
+  Check that NSView keeps the prepared content rect of each view apart
+  and falls back to the visible rect.
+*/
+#include "Testing.h"
+
+#include <Foundation/NSAutoreleasePool.h>
+#include <Foundation/NSGeometry.h>
+#include <AppKit/NSView.h>
+
+/* Prepares no more than the top half of what it is asked for. */
+@interface HalfView : NSView
+@end
+
+@implementation HalfView
+- (void) prepareContentInRect: (NSRect)rect
+{
+  rect.size.height /= 2;
+  [self setPreparedContentRect: rect];
+}
+@end
+
+int main(int argc, char **argv)
+{
+  CREATE_AUTORELEASE_POOL(arp);
+  NSRect f = NSMakeRect(0, 0, 100, 100);
+  NSRect r = NSMakeRect(-50, -100, 200, 300);
+  NSView *v = AUTORELEASE([[NSView alloc] initWithFrame: f]);
+  NSView *w = AUTORELEASE([[NSView alloc] initWithFrame: f]);
+  HalfView *h = AUTORELEASE([[HalfView alloc] initWithFrame: f]);
+
+  START_SET("NSView GNUstep prepared content rect")
+
+  PASS(NSEqualRects([v preparedContentRect], [v visibleRect]),
+       "the prepared content rect is the visible rect by default");
+
+  [v setPreparedContentRect: r];
+  PASS(NSEqualRects([v preparedContentRect], r),
+       "-setPreparedContentRect: stores the rect");
+  PASS(NSEqualRects([w preparedContentRect], [w visibleRect]),
+       "other views keep their own prepared content rect");
+
+  [w prepareContentInRect: r];
+  PASS(NSEqualRects([w preparedContentRect], r),
+       "-prepareContentInRect: prepares the whole rect");
+
+  [h prepareContentInRect: r];
+  PASS(NSEqualRects([h preparedContentRect], NSMakeRect(-50, -100, 200, 150)),
+       "subclasses may prepare a different rect");
+
+  [v setPreparedContentRect: f];
+  PASS(NSEqualRects([v preparedContentRect], f)
+       && NSEqualRects([w preparedContentRect], r),
+       "setting the rect again replaces it");
+
+  END_SET("NSView GNUstep prepared content rect")
+
+  DESTROY(arp);
+  return 0;
+}
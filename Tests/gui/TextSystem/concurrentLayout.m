@@ -0,0 +1,156 @@
+/*
+  Check that laying out paragraphs concurrently gives the same line
+  fragments and glyph locations as laying them out one after another.
+*/
+
+#import "Testing.h"
+#import <Foundation/NSAutoreleasePool.h>
+#import <Foundation/NSDictionary.h>
+#import <Foundation/NSString.h>
+#import <Foundation/NSValue.h>
+#import <AppKit/NSApplication.h>
+#import <AppKit/NSAttributedString.h>
+#import <AppKit/NSFont.h>
+#import <AppKit/NSLayoutManager.h>
+#import <AppKit/NSTextContainer.h>
+#import <AppKit/NSTextStorage.h>
+
+/* Well above the amount of text the typesetter splits into batches */
+#define PARAGRAPHS 1500
+
+static NSTextStorage *
+makeText(void)
+{
+  NSTextStorage *text = AUTORELEASE([NSTextStorage new]);
+  NSDictionary *plain;
+  NSDictionary *bold;
+  NSDictionary *big;
+  int i;
+  int j;
+
+  plain = [NSDictionary dictionaryWithObject: [NSFont userFontOfSize: 12]
+                                      forKey: NSFontAttributeName];
+  bold = [NSDictionary dictionaryWithObject: [NSFont boldSystemFontOfSize: 12]
+                                     forKey: NSFontAttributeName];
+  big = [NSDictionary dictionaryWithObjectsAndKeys:
+    [NSFont userFontOfSize: 20], NSFontAttributeName,
+    [NSNumber numberWithInt: 1], NSSuperscriptAttributeName,
+    nil];
+
+  [text beginEditing];
+  for (i = 0; i < PARAGRAPHS; i++)
+    {
+      /* Paragraphs of one to many lines, with a few font changes */
+      for (j = 0; j <= i % 13; j++)
+        {
+          [text appendAttributedString: AUTORELEASE([[NSAttributedString alloc]
+            initWithString: @"Lorem ipsum dolor sit amet, "
+                attributes: plain])];
+          if ((i + j) % 5 == 0)
+            {
+              [text appendAttributedString:
+                AUTORELEASE([[NSAttributedString alloc]
+                  initWithString: @"consectetur "
+                      attributes: ((i + j) % 2) ? bold : big])];
+            }
+        }
+      [text appendAttributedString: AUTORELEASE([[NSAttributedString alloc]
+        initWithString: @"\n" attributes: plain])];
+    }
+  [text endEditing];
+  return text;
+}
+
+/* Lays out text with a new layout manager and returns the manager. */
+static NSLayoutManager *
+layOut(NSTextStorage *text, BOOL concurrently)
+{
+  NSLayoutManager *lm = AUTORELEASE([NSLayoutManager new]);
+  NSTextContainer *tc;
+
+  tc = AUTORELEASE([[NSTextContainer alloc]
+    initWithContainerSize: NSMakeSize(300, 1e7)]);
+  [lm addTextContainer: tc];
+  [lm setTypesetsParagraphsConcurrently: concurrently];
+  [text addLayoutManager: lm];
+  [lm glyphRangeForTextContainer: tc];
+  return lm;
+}
+
+int
+main(int argc, char **argv)
+{
+  NSTextStorage *text;
+  NSLayoutManager *serial;
+  NSLayoutManager *concurrent;
+  NSUInteger glyphs;
+  NSUInteger i;
+  BOOL sameRects = YES;
+  BOOL sameLocations = YES;
+
+  START_SET("TextSystem GNUstep concurrent layout")
+  CREATE_AUTORELEASE_POOL(arp);
+
+  NS_DURING
+  {
+    [NSApplication sharedApplication];
+  }
+  NS_HANDLER
+  {
+    if ([[localException name] isEqualToString: NSInternalInconsistencyException ])
+       SKIP("It looks like GNUstep backend is not yet installed")
+  }
+  NS_ENDHANDLER
+
+  text = makeText();
+  serial = layOut(text, NO);
+  concurrent = layOut(text, YES);
+  PASS([concurrent typesetsParagraphsConcurrently],
+       "concurrent typesetting is switched on");
+
+  glyphs = [serial numberOfGlyphs];
+  PASS(glyphs > 0 && glyphs == [concurrent numberOfGlyphs],
+       "both layout managers have the same glyphs");
+
+  for (i = 0; i < glyphs; i++)
+    {
+      NSRange r1;
+      NSRange r2;
+      NSRect u1;
+      NSRect u2;
+
+      if (!NSEqualRects([serial lineFragmentRectForGlyphAtIndex: i
+                                                 effectiveRange: &r1],
+                        [concurrent lineFragmentRectForGlyphAtIndex: i
+                                                     effectiveRange: &r2])
+        || !NSEqualRanges(r1, r2))
+        {
+          sameRects = NO;
+          break;
+        }
+      u1 = [serial lineFragmentUsedRectForGlyphAtIndex: i
+                                        effectiveRange: NULL];
+      u2 = [concurrent lineFragmentUsedRectForGlyphAtIndex: i
+                                            effectiveRange: NULL];
+      if (!NSEqualRects(u1, u2))
+        {
+          sameRects = NO;
+          break;
+        }
+      if (!NSEqualPoints([serial locationForGlyphAtIndex: i],
+                         [concurrent locationForGlyphAtIndex: i]))
+        {
+          sameLocations = NO;
+        }
+    }
+  PASS(sameRects, "the line fragment rects are the same");
+  PASS(sameLocations, "the glyph locations are the same");
+  PASS(NSEqualRects([serial extraLineFragmentRect],
+                    [concurrent extraLineFragmentRect]),
+       "the extra line fragment is the same");
+
+  DESTROY(arp);
+  END_SET("TextSystem GNUstep concurrent layout")
+
+  return 0;
+}
@@ -0,0 +1,82 @@
+/*
+  Check that the edit generation of GSLayoutManager, which lets the
+  typesetter keep its glyph cache between calls, changes whenever glyphs
+  are invalidated or the text storage is replaced or edited.  Glyphs are
+  never generated, so no backend is needed.
+*/
+
+#import "Testing.h"
+#import <Foundation/NSAutoreleasePool.h>
+#import <Foundation/NSString.h>
+#import <AppKit/NSTextStorage.h>
+#import <GNUstepGUI/GSLayoutManager.h>
+
+int
+main(int argc, char **argv)
+{
+  GSLayoutManager *lm;
+  GSLayoutManager *other;
+  NSTextStorage *ts;
+  unsigned int generation;
+
+  START_SET("TextSystem GNUstep edit generation")
+  CREATE_AUTORELEASE_POOL(arp);
+
+  lm = AUTORELEASE([GSLayoutManager new]);
+  other = AUTORELEASE([GSLayoutManager new]);
+  generation = [lm _editGeneration];
+  PASS(generation != 0, "a new layout manager has a generation");
+  PASS([lm _editGeneration] == generation,
+       "the generation stays the same while nothing changes");
+  PASS([other _editGeneration] != generation,
+       "two layout managers have different generations");
+
+  ts = AUTORELEASE([[NSTextStorage alloc] initWithString: @"abc def ghi"]);
+  [ts addLayoutManager: lm];
+  PASS([lm _editGeneration] != generation,
+       "setting the text storage changes the generation");
+
+  generation = [lm _editGeneration];
+  [lm invalidateGlyphsForCharacterRange: NSMakeRange(4, 3)
+                         changeInLength: 0
+                   actualCharacterRange: NULL];
+  PASS([lm _editGeneration] != generation,
+       "invalidating glyphs changes the generation");
+
+  generation = [lm _editGeneration];
+  [lm invalidateGlyphsForCharacterRange: NSMakeRange(0, [ts length])
+                         changeInLength: 0
+                   actualCharacterRange: NULL];
+  PASS([lm _editGeneration] != generation,
+       "invalidating all glyphs changes the generation");
+
+  /* What the text storage sends after an edit, without fixing the
+     attributes of the text, which would need fonts. */
+  generation = [lm _editGeneration];
+  [lm textStorage: ts
+           edited: NSTextStorageEditedAttributes
+            range: NSMakeRange(0, 3)
+   changeInLength: 0
+ invalidatedRange: NSMakeRange(0, 3)];
+  PASS([lm _editGeneration] != generation,
+       "an attribute change in the text storage changes the generation");
+
+  generation = [lm _editGeneration];
+  [lm textStorage: ts
+           edited: NSTextStorageEditedCharacters
+            range: NSMakeRange(4, 3)
+   changeInLength: 0
+ invalidatedRange: NSMakeRange(4, 3)];
+  PASS([lm _editGeneration] != generation,
+       "a character change in the text storage changes the generation");
+
+  generation = [lm _editGeneration];
+  [ts removeLayoutManager: lm];
+  PASS([lm _editGeneration] != generation,
+       "removing the text storage changes the generation");
+
+  DESTROY(arp);
+  END_SET("TextSystem GNUstep edit generation")
+
+  return 0;
+}
@@ -0,0 +1,108 @@
+/*
+  Check that the fonts substituted for characters the text's font lacks
+  are cached, and that the cache follows changes of the preferred fonts.
+*/
+
+#import "Testing.h"
+#import <Foundation/NSArray.h>
+#import <Foundation/NSAutoreleasePool.h>
+#import <Foundation/NSCharacterSet.h>
+#import <Foundation/NSDictionary.h>
+#import <Foundation/NSString.h>
+#import <AppKit/NSApplication.h>
+#import <AppKit/NSAttributedString.h>
+#import <AppKit/NSFont.h>
+#import <AppKit/NSFontManager.h>
+
+/* A character few Latin fonts cover */
+#define CHAR 0x4e00
+
+/* Returns the font used for the last character of a string in font,
+   ending in CHAR, after its font attribute has been fixed. */
+static NSFont *
+substituteIn(NSFont *font)
+{
+  unichar chars[] = {'a', CHAR, CHAR};
+  NSMutableAttributedString *s;
+  NSRange r;
+  NSFont *result;
+
+  s = [[NSMutableAttributedString alloc]
+        initWithString: [NSString stringWithCharacters: chars length: 3]
+            attributes: [NSDictionary dictionaryWithObject: font
+                                                   forKey: NSFontAttributeName]];
+  [s fixFontAttributeInRange: NSMakeRange(0, 3)];
+  result = [s attribute: NSFontAttributeName atIndex: 2 effectiveRange: &r];
+  if (!NSEqualRanges(r, NSMakeRange(1, 2)))
+    {
+      result = nil;
+    }
+  RETAIN(result);
+  RELEASE(s);
+  return AUTORELEASE(result);
+}
+
+int
+main(int argc, char **argv)
+{
+  NSFont *font;
+  NSFont *first;
+  NSFont *other = nil;
+  NSArray *preferred;
+  NSEnumerator *e;
+  NSString *name;
+  int tried = 0;
+
+  START_SET("TextSystem GNUstep font substitution")
+  CREATE_AUTORELEASE_POOL(arp);
+
+  NS_DURING
+  {
+    [NSApplication sharedApplication];
+  }
+  NS_HANDLER
+  {
+    if ([[localException name] isEqualToString: NSInternalInconsistencyException ])
+       SKIP("It looks like GNUstep backend is not yet installed")
+  }
+  NS_ENDHANDLER
+
+  font = [NSFont userFontOfSize: 12];
+  if ([[font coveredCharacterSet] characterIsMember: CHAR])
+    SKIP("The user font covers the test character")
+
+  first = substituteIn(font);
+  if (first == nil || [first isEqual: font])
+    SKIP("No font covers the test character")
+
+  PASS([substituteIn(font) isEqual: first],
+       "the same substitute is used again");
+
+  /* Look for another font covering the character */
+  e = [[[NSFontManager sharedFontManager] availableFonts] objectEnumerator];
+  while (other == nil && tried++ < 200 && (name = [e nextObject]) != nil)
+    {
+      NSFont *f = [NSFont fontWithName: name size: 12];
+
+      if (f != nil && ![[f fontName] isEqual: [first fontName]]
+        && [[f coveredCharacterSet] characterIsMember: CHAR])
+        {
+          other = f;
+        }
+    }
+  if (other == nil)
+    SKIP("Only one font covers the test character")
+
+  preferred = RETAIN([NSFont preferredFontNames]);
+  [NSFont setPreferredFontNames:
+    [NSArray arrayWithObject: [other fontName]]];
+  PASS_EQUAL([substituteIn(font) fontName], [other fontName],
+             "a new preferred font is used at once");
+  [NSFont setPreferredFontNames: preferred];
+  RELEASE(preferred);
+
+  DESTROY(arp);
+  END_SET("TextSystem GNUstep font substitution")
+
+  return 0;
+}
@@ -0,0 +1,146 @@
+/*
+  Check the line break opportunities GSHorizontalTypesetter finds against
+  the rules of UAX #14 (Unicode Line Breaking Algorithm).  No backend is
+  needed.
+*/
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#import "Testing.h"
+#import <Foundation/NSAutoreleasePool.h>
+#import <Foundation/NSString.h>
+#import <GNUstepGUI/GSHorizontalTypesetter.h>
+
+/* Private function of GSHorizontalTypesetter.m */
+extern void GSLineBreakOpportunities(const unichar *chars, unsigned int n,
+                                     uint32_t *breaks, uint32_t *spaces);
+
+#define TEST_BIT(bits, i) (((bits)[(i) >> 5] >> ((i) & 31)) & 1)
+
+/* Returns the positions a line may be broken before in s, the end
+   included, as a string like "3 5".  If spacesOut is given, the positions
+   of the spaces are returned in it the same way. */
+static NSString *
+breaksIn(NSString *s, NSString **spacesOut)
+{
+  unsigned int n = [s length];
+  unsigned int words = (n + 1 + 31) / 32;
+  unichar *chars = malloc(sizeof(unichar) * (n + 1));
+  uint32_t *breaks = calloc(words, sizeof(uint32_t));
+  uint32_t *spaces = calloc(words, sizeof(uint32_t));
+  NSMutableString *result = [NSMutableString string];
+  NSMutableString *spaceResult = [NSMutableString string];
+  unsigned int i;
+
+  [s getCharacters: chars];
+  GSLineBreakOpportunities(chars, n, breaks, spaces);
+  for (i = 0; i <= n; i++)
+    {
+      if (TEST_BIT(breaks, i))
+        {
+          [result appendFormat: ([result length] ? @" %u" : @"%u"), i];
+        }
+      if (i < n && TEST_BIT(spaces, i))
+        {
+          [spaceResult appendFormat: ([spaceResult length] ? @" %u" : @"%u"),
+            i];
+        }
+    }
+  free(chars);
+  free(breaks);
+  free(spaces);
+  if (spacesOut != NULL)
+    {
+      *spacesOut = spaceResult;
+    }
+  return result;
+}
+
+static NSString *
+stringOf(unichar *chars, unsigned int n)
+{
+  return [NSString stringWithCharacters: chars length: n];
+}
+
+int
+main(int argc, char **argv)
+{
+  unichar nbsp[] = {'a', 0x00a0, 'b', ' ', 'c'};
+  unichar zwsp[] = {'a', 'b', 0x200b, 'c', 'd'};
+  unichar zwspSpace[] = {'a', 0x200b, ' ', 'b'};
+  unichar nbHyphen[] = {'a', 0x2011, 'b'};
+  unichar hyphen[] = {'a', 0x2010, 'b'};
+  unichar mark[] = {'a', 0x0301, 'b', ' ', 'c'};
+  unichar spaceMark[] = {'a', ' ', 0x0301, 'b'};
+  unichar ideographs[] = {0x4e00, 0x4e01, 0x3002, 0x4e02};
+  unichar brackets[] = {0x300c, 0x4e00, 0x300d, 0x4e01};
+  unichar ideographAlpha[] = {0x4e00, 'a', 'b', 0x4e01};
+  unichar iteration[] = {0x4e00, 0x3005};
+  unichar ideographicSpace[] = {'a', 0x3000, 'b'};
+  NSString *spaces;
+
+  START_SET("TextSystem GNUstep line breaking")
+  CREATE_AUTORELEASE_POOL(arp);
+
+  /* Builds the line break class table */
+  [GSHorizontalTypesetter class];
+
+  PASS_EQUAL(breaksIn(@"ab cd", &spaces), @"3 5",
+             "a line breaks after a space, not before it");
+  PASS_EQUAL(spaces, @"2", "the space is marked");
+  PASS_EQUAL(breaksIn(@"ab  cd", &spaces), @"4 6",
+             "a line breaks after a run of spaces");
+  PASS_EQUAL(spaces, @"2 3", "all the spaces of a run are marked");
+  PASS_EQUAL(breaksIn(@"", NULL), @"0", "empty text has a break at its end");
+
+  PASS_EQUAL(breaksIn(@"well-known", NULL), @"5 10",
+             "a line breaks after a hyphen");
+  PASS_EQUAL(breaksIn(@"a - b", NULL), @"2 4 5",
+             "a hyphen between spaces may start a line");
+  PASS_EQUAL(breaksIn(@"12.5% x", NULL), @"6 7",
+             "numbers with their punctuation are not broken");
+  PASS_EQUAL(breaksIn(@"a?b c", NULL), @"2 4 5",
+             "a line breaks after an exclamation or question mark");
+
+  PASS_EQUAL(breaksIn(@"a (b) c", NULL), @"2 6 7",
+             "no break after opening or before closing punctuation");
+  PASS_EQUAL(breaksIn(@"a) b", NULL), @"3 4",
+             "closing punctuation stays with the text before the space");
+
+  PASS_EQUAL(breaksIn(stringOf(nbsp, 5), NULL), @"4 5",
+             "a no-break space glues its neighbours");
+  PASS_EQUAL(breaksIn(stringOf(nbHyphen, 3), NULL), @"3",
+             "a non-breaking hyphen glues its neighbours");
+  PASS_EQUAL(breaksIn(stringOf(hyphen, 3), NULL), @"2 3",
+             "a line breaks after a hyphen character");
+
+  PASS_EQUAL(breaksIn(stringOf(zwsp, 5), NULL), @"3 5",
+             "a line breaks after a zero width space");
+  PASS_EQUAL(breaksIn(stringOf(zwspSpace, 4), NULL), @"3 4",
+             "a line breaks after spaces following a zero width space");
+
+  PASS_EQUAL(breaksIn(stringOf(mark, 5), NULL), @"4 5",
+             "a combining mark stays with its base character");
+  PASS_EQUAL(breaksIn(stringOf(spaceMark, 4), NULL), @"2 4",
+             "a combining mark after a space acts as a letter");
+
+  PASS_EQUAL(breaksIn(stringOf(ideographs, 4), NULL), @"1 3 4",
+             "a line breaks between ideographs but not before a full stop");
+  PASS_EQUAL(breaksIn(stringOf(brackets, 4), NULL), @"3 4",
+             "CJK brackets stay with the text inside them");
+  PASS_EQUAL(breaksIn(stringOf(ideographAlpha, 4), NULL), @"1 3 4",
+             "a line breaks between ideographs and letters");
+  PASS_EQUAL(breaksIn(stringOf(iteration, 2), NULL), @"2",
+             "no break before an iteration mark");
+  PASS_EQUAL(breaksIn(stringOf(ideographicSpace, 3), NULL), @"2 3",
+             "a line breaks after an ideographic space");
+
+  PASS_EQUAL(breaksIn(@"ab\ncd", NULL), @"3 5",
+             "a line always breaks after a line feed");
+
+  DESTROY(arp);
+  END_SET("TextSystem GNUstep line breaking")
+
+  return 0;
+}
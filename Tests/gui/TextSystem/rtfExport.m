@@ -0,0 +1,103 @@
+/*
+  Check the RTF export of a large attributed string and report the
+  throughput of the export.
+*/
+
+#import "Testing.h"
+#import <Foundation/NSAutoreleasePool.h>
+#import <Foundation/NSData.h>
+#import <Foundation/NSDate.h>
+#import <Foundation/NSString.h>
+#import <AppKit/NSApplication.h>
+#import <AppKit/NSAttributedString.h>
+#import <AppKit/NSColor.h>
+#import <AppKit/NSFont.h>
+
+#define PARAGRAPHS 20000
+
+int
+main(int argc, char **argv)
+{
+  NSMutableAttributedString *text;
+  NSAttributedString *copy;
+  NSDictionary *plain;
+  NSDictionary *styles[3];
+  NSString *rtf;
+  NSDate *start;
+  NSData *data;
+  NSTimeInterval time;
+  NSUInteger i;
+
+  START_SET("TextSystem GNUstep RTF export")
+  CREATE_AUTORELEASE_POOL(arp);
+
+  NS_DURING
+  {
+    [NSApplication sharedApplication];
+  }
+  NS_HANDLER
+  {
+    if ([[localException name] isEqualToString: NSInternalInconsistencyException ])
+       SKIP("It looks like GNUstep backend is not yet installed")
+  }
+  NS_ENDHANDLER
+
+  plain = [NSDictionary dictionaryWithObject: [NSFont userFontOfSize: 12]
+                                      forKey: NSFontAttributeName];
+  styles[0] = plain;
+  styles[1] = [NSDictionary dictionaryWithObjectsAndKeys:
+    [NSFont userFontOfSize: 12], NSFontAttributeName,
+    [NSColor redColor], NSForegroundColorAttributeName, nil];
+  styles[2] = [NSDictionary dictionaryWithObjectsAndKeys:
+    [NSFont userFontOfSize: 14], NSFontAttributeName,
+    [NSNumber numberWithInt: NSUnderlineStyleSingle],
+    NSUnderlineStyleAttributeName, nil];
+
+  text = [[NSMutableAttributedString alloc] init];
+  for (i = 0; i < PARAGRAPHS; i++)
+    {
+      NSAttributedString *run;
+
+      /* Append text in small pieces, equal neighbours should be merged. */
+      run = [[NSAttributedString alloc]
+              initWithString: @"Some text {with} \\special\\ characters "
+                  attributes: plain];
+      [text appendAttributedString: run];
+      RELEASE(run);
+      run = [[NSAttributedString alloc]
+              initWithString: @"and a styled run\n"
+                  attributes: styles[i % 3]];
+      [text appendAttributedString: run];
+      RELEASE(run);
+    }
+
+  start = [NSDate date];
+  data = [text RTFFromRange: NSMakeRange(0, [text length])
+         documentAttributes: nil];
+  time = -[start timeIntervalSinceNow];
+  NSLog(@"RTF export of %lu characters took %f seconds (%f MB/s)",
+        (unsigned long)[text length], time,
+        time > 0.0 ? [data length] / time / (1024.0 * 1024.0) : 0.0);
+
+  PASS(data != nil, "large attributed string is exported");
+
+  rtf = AUTORELEASE([[NSString alloc] initWithData: data
+                                          encoding: NSASCIIStringEncoding]);
+  PASS([rtf hasPrefix: @"{\\rtf1\\ansi"], "output starts with the RTF header");
+  PASS([rtf hasSuffix: @"}"], "output ends with the trailer");
+  PASS([rtf rangeOfString: @"\\{with\\} \\\\special\\\\"].location != NSNotFound,
+       "special characters are escaped");
+  PASS([rtf rangeOfString: @"{\\colortbl;"].location != NSNotFound,
+       "colour table is written");
+
+  copy = [[NSAttributedString alloc] initWithRTF: data
+                              documentAttributes: NULL];
+  PASS_EQUAL([copy string], [text string], "exported text reads back");
+
+  RELEASE(copy);
+  RELEASE(text);
+  DESTROY(arp);
+  END_SET("TextSystem GNUstep RTF export")
+
+  return 0;
+}
@@ -0,0 +1,118 @@
+/*
+  Check the RTF import of a large generated document and report how long
+  the import takes. The document cycles through a few character styles
+  and paragraph styles, like a typical report does.
+*/
+
+#import "Testing.h"
+#import <Foundation/NSAutoreleasePool.h>
+#import <Foundation/NSData.h>
+#import <Foundation/NSDate.h>
+#import <Foundation/NSString.h>
+#import <AppKit/NSApplication.h>
+#import <AppKit/NSAttributedString.h>
+#import <AppKit/NSParagraphStyle.h>
+
+#define PARAGRAPHS 20000
+
+static NSString *runs[] = {
+  @"\\plain Plain text of the report ",
+  @"{\\b bold words} ",
+  @"{\\i italic words} ",
+  @"{\\cf1 coloured words} ",
+  @"{\\ul underlined words} "
+};
+
+int
+main(int argc, char **argv)
+{
+  NSMutableString *rtf;
+  NSMutableString *expected;
+  NSAttributedString *text;
+  NSDictionary *attributes;
+  NSDate *start;
+  NSData *data;
+  NSUInteger tenth = 0;
+  NSUInteger i, j;
+
+  START_SET("TextSystem GNUstep RTF import")
+  CREATE_AUTORELEASE_POOL(arp);
+
+  NS_DURING
+  {
+    [NSApplication sharedApplication];
+  }
+  NS_HANDLER
+  {
+    if ([[localException name] isEqualToString: NSInternalInconsistencyException ])
+       SKIP("It looks like GNUstep backend is not yet installed")
+  }
+  NS_ENDHANDLER
+
+  rtf = [NSMutableString stringWithString:
+    @"{\\rtf1\\ansi{\\fonttbl\\f0\\fswiss Helvetica;}"
+    @"{\\colortbl;\\red255\\green0\\blue0;}\\f0\\fs24\n"];
+  expected = [NSMutableString string];
+  for (i = 0; i < PARAGRAPHS; i++)
+    {
+      if (i == 10)
+        {
+          tenth = [expected length];
+        }
+      [rtf appendString: (i % 2) ? @"\\pard\\qc " : @"\\pard\\ql "];
+      for (j = 0; j < sizeof(runs) / sizeof(runs[0]); j++)
+        {
+          NSString *run = runs[(i + j) % (sizeof(runs) / sizeof(runs[0]))];
+          NSRange r = [run rangeOfString: @" "];
+
+          [rtf appendString: run];
+          if ([run hasPrefix: @"{"])
+            {
+              [expected appendString:
+                [run substringWithRange:
+                  NSMakeRange(NSMaxRange(r), [run length] - NSMaxRange(r) - 2)]];
+              [expected appendString: @" "];
+            }
+          else
+            {
+              [expected appendString: [run substringFromIndex: 7]];
+            }
+        }
+      [rtf appendString: @"\\par\n"];
+      [expected appendString: @"\n"];
+    }
+  [rtf appendString: @"}"];
+  data = [rtf dataUsingEncoding: NSASCIIStringEncoding];
+
+  start = [NSDate date];
+  text = [[NSAttributedString alloc] initWithRTF: data
+                              documentAttributes: NULL];
+  NSLog(@"RTF import of %lu bytes took %f seconds",
+        (unsigned long)[data length], -[start timeIntervalSinceNow]);
+
+  PASS(text != nil, "large RTF document is imported");
+  PASS_EQUAL([text string], expected, "imported text matches the source");
+
+  attributes = [text attributesAtIndex:
+                       [expected rangeOfString: @"underlined"].location
+                        effectiveRange: NULL];
+  PASS([attributes objectForKey: NSUnderlineStyleAttributeName] != nil,
+       "underlined run is underlined");
+  PASS([[attributes objectForKey: NSParagraphStyleAttributeName] alignment]
+       == NSLeftTextAlignment, "first paragraph is left aligned");
+
+  attributes = [text attributesAtIndex: [expected length] - 3
+                        effectiveRange: NULL];
+  PASS([[attributes objectForKey: NSParagraphStyleAttributeName] alignment]
+       == NSCenterTextAlignment, "last paragraph is centered");
+
+  PASS_EQUAL([text attributesAtIndex: 0 effectiveRange: NULL],
+             [text attributesAtIndex: tenth effectiveRange: NULL],
+             "runs with the same style get equal attributes");
+
+  RELEASE(text);
+  DESTROY(arp);
+  END_SET("TextSystem GNUstep RTF import")
+
+  return 0;
+}
@@ -29,9 +29,12 @@
 
 #include <GNUstepGUI/GSTextConverter.h>
 
+@class NSDictionary;
 @class NSMutableDictionary;
 @class NSMutableArray;
 @class NSMutableAttributedString;
+@class NSMutableSet;
+@class NSMutableString;
 
 @interface RTFConsumer: NSObject <GSTextConsumer>
 {
@@ -44,6 +47,11 @@
   NSMutableAttributedString *result;
   Class _class;
   int ignore;
+  NSMutableString *pending;
+  NSDictionary *pendingAttributes;
+  NSMutableDictionary *fontCache;
+  NSMutableSet *paragraphStyles;
+  NSMutableDictionary *attributesCache;
 }
 
 @end
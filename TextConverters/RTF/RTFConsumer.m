@@ -33,27 +33,6 @@
 #import "RTFConsumerFunctions.h"
 #import "RTFProducer.h"
 
-/*  we have to satisfy the scanner with a stream reading function */
-typedef struct {
-  const char	*string;
-  int		position;
-  int		length;
-} StringContext;
-
-static void	
-initStringContext (StringContext *ctxt, NSData *data)
-{
-  ctxt->string = [data bytes];
-  ctxt->position = 0;
-  ctxt->length = [data length];
-}
-
-static int	
-readString (StringContext *ctxt)
-{
-  return ctxt->position < ctxt->length ? ctxt->string[ctxt->position++] : EOF;
-}
-
 // Hold the attributs of the current run
 @interface RTFAttribute: NSObject <NSCopying>
 {
@@ -282,6 +261,8 @@ static BOOL classInheritsFromNSMutableAttributedString (Class c)
 - (void) push;
 - (void) pop;
 - (void) appendString: (NSString*)string;
+- (void) flush;
+- (NSDictionary*) currentAttributes;
 - (void) appendHelpLink: (NSString*)fileName marker: (NSString *)markerName;
 - (void) appendHelpMarker: (NSString*)markerName;
 - (void) appendField: (int)start
@@ -394,6 +375,11 @@ static BOOL classInheritsFromNSMutableAttributedString (Class c)
   attrs = nil;
   colours = nil;
   _class = Nil;
+  pending = nil;
+  pendingAttributes = nil;
+  fontCache = nil;
+  paragraphStyles = nil;
+  attributesCache = nil;
 
   return self;
 }
@@ -405,6 +391,11 @@ static BOOL classInheritsFromNSMutableAttributedString (Class c)
   RELEASE(colours);
   RELEASE(result);
   RELEASE(documentAttributes);
+  RELEASE(pending);
+  RELEASE(pendingAttributes);
+  RELEASE(fontCache);
+  RELEASE(paragraphStyles);
+  RELEASE(attributesCache);
   [super dealloc];
 }
 
@@ -462,8 +453,12 @@ static BOOL classInheritsFromNSMutableAttributedString (Class c)
 
 - (void) appendImage: (NSString*)string
 {
-  int  oldPosition = [result length];
-  NSRange insertionRange = NSMakeRange(oldPosition,0);
+  int  oldPosition;
+  NSRange insertionRange;
+
+  [self flush];
+  oldPosition = [result length];
+  insertionRange = NSMakeRange(oldPosition,0);
 
   if (!ignore)
     {
@@ -544,6 +539,12 @@ static BOOL classInheritsFromNSMutableAttributedString (Class c)
   ASSIGN(colours, [NSMutableArray array]);
   [attrs addObject: attr];
   RELEASE(attr);
+
+  ASSIGN(pending, [NSMutableString string]);
+  DESTROY(pendingAttributes);
+  ASSIGN(fontCache, [NSMutableDictionary dictionary]);
+  ASSIGN(paragraphStyles, [NSMutableSet set]);
+  ASSIGN(attributesCache, [NSMutableDictionary dictionary]);
 }
 
 - (void) setEncoding: (NSStringEncoding)anEncoding
@@ -576,7 +577,6 @@ static BOOL classInheritsFromNSMutableAttributedString (Class c)
 {
   CREATE_AUTORELEASE_POOL(pool);
   RTFscannerCtxt scanner;
-  StringContext stringCtxt;
 
   // We read in the first few characters to find out which
   // encoding we have
@@ -590,8 +590,7 @@ static BOOL classInheritsFromNSMutableAttributedString (Class c)
   _class = class;
   [self reset];
 
-  initStringContext(&stringCtxt, rtfData);
-  lexInitContext(&scanner, &stringCtxt, (int (*)(void*))readString);
+  lexInitBufferContext(&scanner, [rtfData bytes], [rtfData length]);
   [result beginEditing];
   NS_DURING
     GSRTFparse((void *)self, &scanner);
@@ -600,6 +599,7 @@ static BOOL classInheritsFromNSMutableAttributedString (Class c)
 	  [localException reason]);
   //[localException raise];
   NS_ENDHANDLER
+  [self flush];
   [result endEditing];
 
   RELEASE(pool);
@@ -621,71 +621,136 @@ static BOOL classInheritsFromNSMutableAttributedString (Class c)
     }
 }
 
+/* Text is collected in pending as long as the attributes do not change
+ * and only added to the result when a run with different attributes
+ * starts, or when the result is accessed directly. */
 - (void) appendString: (NSString*)string
 {
-  int  oldPosition = [result length];
-  int  textlen = [string length]; 
-  NSRange insertionRange = NSMakeRange(oldPosition,0);
-  NSMutableDictionary *attributes;
-
-  if (!ignore && textlen)
+  if (!ignore && [string length])
     {
       RTFAttribute* attr = [self attr];
-      [result replaceCharactersInRange: insertionRange 
-	      withString: string];
 
       if (attr->changed)
         {
-	  NSParagraphStyle *ps = [attr->paragraph copy];
-	  attributes = [[NSMutableDictionary alloc]
-			 initWithObjectsAndKeys:
-			   [attr currentFont], NSFontAttributeName,
-			   ps, NSParagraphStyleAttributeName,
-			   nil];
-	  DESTROY(ps);
-	  if ([attr underline])
-	    {
-	      [attributes setObject: [attr underline]
-			  forKey: NSUnderlineStyleAttributeName];
-	    }
-	  if ([attr strikethrough])
-	    {
-	      [attributes setObject: [attr strikethrough]
-			  forKey: NSStrikethroughStyleAttributeName];
-	    }
-	  if (attr->script)
-	    {
-	      [attributes setObject: [attr script]
-			  forKey: NSSuperscriptAttributeName];
-	    }
-	  if (attr->fgColour != nil)
-	    {
-	      [attributes setObject: attr->fgColour 
-			  forKey: NSForegroundColorAttributeName];
-	    }
-	  if (attr->bgColour != nil)
-	    {
-	      [attributes setObject: attr->bgColour 
-			  forKey: NSBackgroundColorAttributeName];
-	    }
-	  if (attr->ulColour != nil)
+	  NSDictionary *attributes = [self currentAttributes];
+
+	  if (attributes != pendingAttributes)
 	    {
-	      [attributes setObject: attr->ulColour 
-			  forKey: NSUnderlineColorAttributeName];
+	      [self flush];
+	      ASSIGN(pendingAttributes, attributes);
 	    }
-  
-	  [result setAttributes: attributes 
-		  range: NSMakeRange(oldPosition, textlen)];
-	  DESTROY(attributes);
 	  attr->changed = NO;
 	}
+      [pending appendString: string];
     }
 }
 
+- (void) flush
+{
+  NSUInteger textlen = [pending length];
+
+  if (textlen)
+    {
+      NSUInteger oldPosition = [result length];
+
+      [result replaceCharactersInRange: NSMakeRange(oldPosition, 0)
+			    withString: pending];
+      [result setAttributes: pendingAttributes
+		      range: NSMakeRange(oldPosition, textlen)];
+      [pending setString: @""];
+    }
+}
+
+/* Returns the attributes for the current state. Identical attribute
+ * dictionaries, fonts and paragraph styles are shared across runs, so a
+ * document with few different styles only creates few objects. */
+- (NSDictionary*) currentAttributes
+{
+  RTFAttribute *attr = [self attr];
+  NSMutableDictionary *attributes;
+  NSParagraphStyle *ps;
+  NSString *key;
+  NSFont *font;
+
+  key = [[NSString alloc] initWithFormat: @"%@ %g %d %d",
+			  attr->fontName, attr->fontSize,
+			  attr->bold, attr->italic];
+  font = [fontCache objectForKey: key];
+  if (font == nil)
+    {
+      font = [attr currentFont];
+      [fontCache setObject: font forKey: key];
+    }
+  RELEASE(key);
+
+  ps = [paragraphStyles member: attr->paragraph];
+  if (ps == nil)
+    {
+      ps = [attr->paragraph copy];
+      [paragraphStyles addObject: ps];
+      RELEASE(ps);
+    }
+
+  /* Colours are taken from the colour table, so they can be compared
+   * by identity. */
+  key = [[NSString alloc] initWithFormat: @"%p %p %p %p %p %ld %ld %d",
+			  font, ps, attr->fgColour, attr->bgColour,
+			  attr->ulColour, (long)attr->underline,
+			  (long)attr->strikethrough, attr->script];
+  attributes = [attributesCache objectForKey: key];
+  if (attributes == nil)
+    {
+      attributes = [[NSMutableDictionary alloc]
+		     initWithObjectsAndKeys:
+		       font, NSFontAttributeName,
+		       ps, NSParagraphStyleAttributeName,
+		       nil];
+      if ([attr underline])
+	{
+	  [attributes setObject: [attr underline]
+		      forKey: NSUnderlineStyleAttributeName];
+	}
+      if ([attr strikethrough])
+	{
+	  [attributes setObject: [attr strikethrough]
+		      forKey: NSStrikethroughStyleAttributeName];
+	}
+      if (attr->script)
+	{
+	  [attributes setObject: [attr script]
+		      forKey: NSSuperscriptAttributeName];
+	}
+      if (attr->fgColour != nil)
+	{
+	  [attributes setObject: attr->fgColour 
+		      forKey: NSForegroundColorAttributeName];
+	}
+      if (attr->bgColour != nil)
+	{
+	  [attributes setObject: attr->bgColour 
+		      forKey: NSBackgroundColorAttributeName];
+	}
+      if (attr->ulColour != nil)
+	{
+	  [attributes setObject: attr->ulColour 
+		      forKey: NSUnderlineColorAttributeName];
+	}
+      [attributesCache setObject: attributes forKey: key];
+      RELEASE(attributes);
+    }
+  RELEASE(key);
+
+  return attributes;
+}
+
 - (void) appendHelpLink: (NSString*)fileName marker: (NSString*)markerName
 {
-  int  oldPosition = [result length];
-  NSRange insertionRange = NSMakeRange(oldPosition,0);
+  int  oldPosition;
+  NSRange insertionRange;
+
+  [self flush];
+  oldPosition = [result length];
+  insertionRange = NSMakeRange(oldPosition,0);
 
   if (!ignore)
     {
@@ -724,8 +789,12 @@ static BOOL classInheritsFromNSMutableAttributedString (Class c)
 
 - (void) appendHelpMarker: (NSString*)markerName
 {
-  int  oldPosition = [result length];
-  NSRange insertionRange = NSMakeRange(oldPosition,0);
+  int  oldPosition;
+  NSRange insertionRange;
+
+  [self flush];
+  oldPosition = [result length];
+  insertionRange = NSMakeRange(oldPosition,0);
 
   if (!ignore)
     {
@@ -763,6 +832,7 @@ static BOOL classInheritsFromNSMutableAttributedString (Class c)
 - (void) appendField: (int)start
          instruction: (NSString*)instruction
 {
+  [self flush];
   if (!ignore)
     {
       int  oldPosition = start;
@@ -804,7 +874,7 @@ static BOOL classInheritsFromNSMutableAttributedString (Class c)
 #define COLOURS	((RTFConsumer *)ctxt)->colours
 #define RESULT	((RTFConsumer *)ctxt)->result
 #define IGNORE	((RTFConsumer *)ctxt)->ignore
-#define TEXTPOSITION [RESULT length]
+#define TEXTPOSITION GSRTFgetPosition(ctxt)
 #define DOCUMENTATTRIBUTES ((RTFConsumer*)ctxt)->documentAttributes
 #define ENCODING ((RTFConsumer *)ctxt)->encoding
 
@@ -864,7 +934,8 @@ void GSRTFstop (void *ctxt)
 
 int GSRTFgetPosition(void *ctxt)
 {
-  return [((RTFConsumer *)ctxt)->result length];
+  return [((RTFConsumer *)ctxt)->result length]
+    + [((RTFConsumer *)ctxt)->pending length];
 }
 
 void GSRTFopenBlock (void *ctxt, BOOL ignore)
@@ -894,14 +965,12 @@ void GSRTFcloseBlock (void *ctxt, BOOL ignore)
 
 void GSRTFmangleText (void *ctxt, const char *text)
 {
-  NSData *data = [[NSData alloc] initWithBytes: (void*)text 
-				 length: strlen(text)];
-  NSString *str = [[NSString alloc] initWithData: data
-				    encoding: ENCODING];
+  NSString *str = [[NSString alloc] initWithBytes: text
+					   length: strlen(text)
+					 encoding: ENCODING];
 
   [(RTFConsumer *)ctxt appendString: str];
   DESTROY(str);
-  DESTROY(data);
 }
 
 void GSRTFunicode (void *ctxt, int uchar)
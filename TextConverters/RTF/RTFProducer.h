@@ -37,6 +37,7 @@
 
 @class NSAttributedString;
 @class NSMutableDictionary;
+@class NSMutableData;
 @class NSColor;
 @class NSFont;
 @class NSMutableParagraphStyle;
@@ -57,6 +58,9 @@
   NSDictionary *_attributesOfLastRun; /*" holds the attributes of the last run
     to build the delta "*/
 
+  NSMutableData *output; /*" the RTF being written "*/
+  IMP appendImp; /*" cached -appendBytes:length: of output "*/
+
   BOOL _inlineGraphics; /*" Indicates if graphics should be inlined. "*/
   int unnamedAttachmentCounter; /*" Count the number of unnamed attachments so we can name them uniquely "*/
 }
@@ -48,22 +48,37 @@
 
 #define	points2twips(a)	((int)((a) * 20.0))
 
+/*
+ * The output is written into a single NSMutableData. Control words are
+ * C string literals, so their length is known at compile time.
+ */
+#define APPEND(b, l) \
+  (*appendImp)(output, @selector(appendBytes:length:), (b), (l))
+#define APPEND_TOKEN(t) APPEND((t), sizeof(t) - 1)
+#define APPEND_WORD(t, v) \
+  [self _appendControlWord: (t) length: sizeof(t) - 1 value: (v)]
+
 @interface RTFDProducer (Private)
 
 - (NSArray *)_attachments;
 - (NSDictionary *)_attributesOfLastRun;
 - (void)_setAttributesOfLastRun: (NSDictionary *)aDict;
 
-- (NSString *)_runStringForString: (NSString *)substring
-                       attributes: (NSDictionary *)attributes;
+- (void)_setOutput: (NSMutableData *)data;
+- (void)_appendString: (NSString *)string;
+- (void)_appendControlWord: (const char *)word
+                    length: (NSUInteger)length
+                     value: (int)value;
+- (void)_appendRunWithRange: (NSRange)range
+                 attributes: (NSDictionary *)attributes;
 
 - (NSString *)_ASCIIfiedString: (NSString *)string;
-- (NSString *)_headerString;
-- (NSString *)_trailerString;
-- (NSString *)_bodyString;
-- (NSString *)_RTFDStringFromAttributedString: (NSAttributedString *)aText
-                           documentAttributes: (NSDictionary *)dict
-                               inlineGraphics: (BOOL)inlineGraphics;
+- (void)_appendHeader;
+- (void)_appendTrailer;
+- (void)_appendBody;
+- (NSData *)_RTFDDataFromAttributedString: (NSAttributedString *)aText
+                       documentAttributes: (NSDictionary *)dict
+                           inlineGraphics: (BOOL)inlineGraphics;
 @end
 
 @implementation RTFDProducer
@@ -78,10 +93,9 @@
 
   producer = [[self alloc] init];
 
-  encodedText = [[producer _RTFDStringFromAttributedString: aText
-                                        documentAttributes: dict
-                                            inlineGraphics: NO]
-                   dataUsingEncoding: NSASCIIStringEncoding];
+  encodedText = [producer _RTFDDataFromAttributedString: aText
+                                      documentAttributes: dict
+                                          inlineGraphics: NO];
 
 //  if ([aText containsAttachments])
   if (YES)
@@ -166,6 +180,7 @@
   RELEASE(ulColor);
 
   RELEASE(_attributesOfLastRun);
+  RELEASE(output);
 
   [super dealloc];
 }
@@ -182,10 +197,9 @@
   NSData *data;
 
   producer = [[self alloc] init];
-  data = [[producer _RTFDStringFromAttributedString: aText
-                                 documentAttributes: dict
-                                     inlineGraphics: YES]
-            dataUsingEncoding: NSASCIIStringEncoding];
+  data = [producer _RTFDDataFromAttributedString: aText
+                               documentAttributes: dict
+                                   inlineGraphics: YES];
 
   RELEASE(producer);
 
@@ -221,63 +235,95 @@
   ASSIGN(_attributesOfLastRun, aDict);
 }
 
-- (NSString *)fontTable
+- (void)_setOutput: (NSMutableData *)data
+{
+  ASSIGN(output, data);
+  appendImp = [output methodForSelector: @selector(appendBytes:length:)];
+}
+
+- (void)_appendString: (NSString *)string
+{
+  const char *cString;
+
+  cString = [string cStringUsingEncoding: NSASCIIStringEncoding];
+  if (cString != NULL)
+    {
+      APPEND(cString, strlen(cString));
+    }
+  else
+    {
+      NSData *lossyConversion;
+
+      lossyConversion = [string dataUsingEncoding: NSASCIIStringEncoding
+                             allowLossyConversion: YES];
+      APPEND([lossyConversion bytes], [lossyConversion length]);
+    }
+}
+
+/*" Appends a control word followed by its numeric parameter. "*/
+- (void)_appendControlWord: (const char *)word
+                    length: (NSUInteger)length
+                     value: (int)value
+{
+  char number[16];
+  int numberLength;
+
+  APPEND(word, length);
+  numberLength = snprintf(number, sizeof(number), "%d", value);
+  APPEND(number, numberLength);
+}
+
+- (void)_appendFontTable
 {
   if ([fontDict count])
     {
-      NSMutableString *fontlistString;
       NSEnumerator *fontEnum;
       NSString *currFont;
       NSArray	*keyArray;
 
-      fontlistString = (NSMutableString *)[NSMutableString string];
+      APPEND_TOKEN("{\\fonttbl");
       keyArray = [fontDict allKeys];
       keyArray = [keyArray sortedArrayUsingSelector: @selector(compare:)];
 
       fontEnum = [keyArray objectEnumerator];
       while ((currFont = [fontEnum nextObject]))
         {
-          NSString *fontFamily;
+          [self _appendString: [fontDict objectForKey: currFont]];
 
           // ##FIXME: If we ever have more fonts to map to families, we should
           // use a dictionary
           if ([currFont isEqualToString: @"Symbol"])
             {
-              fontFamily = @"tech";
+              APPEND_TOKEN("\\ftech ");
             }
           else if ([currFont isEqualToString: @"Helvetica"])
             {
-              fontFamily = @"swiss";
+              APPEND_TOKEN("\\fswiss ");
             }
           else if ([currFont isEqualToString: @"Courier"])
             {
-              fontFamily = @"modern";
+              APPEND_TOKEN("\\fmodern ");
             }
           else if ([currFont isEqualToString: @"Times"])
             {
-              fontFamily = @"roman";
+              APPEND_TOKEN("\\froman ");
             }
           else
             {
-              fontFamily = @"nil";
+              APPEND_TOKEN("\\fnil ");
             }
 
-          [fontlistString appendFormat: @"%@\\f%@ %@;",
-              [fontDict objectForKey: currFont], fontFamily, currFont];
+          [self _appendString: currFont];
+          APPEND_TOKEN(";");
         }
-      return [NSString stringWithFormat: @"{\\fonttbl%@}\n", fontlistString];
-    }
-  else
-    {
-      return @"";
+      APPEND_TOKEN("}\n");
     }
 }
 
-- (NSString *)colorTable
+- (void)_appendColorTable
 {
   if ([colorDict count])
     {
-      NSMutableString *result;
       unsigned int count = [colorDict count];
       id list[count];
       NSEnumerator *keyEnum;
@@ -294,8 +340,7 @@
           list[[cn intValue] - 1] = next;
         }
 
-      result = (NSMutableString *)[NSMutableString
-                                   stringWithString: @"{\\colortbl;"];
+      APPEND_TOKEN("{\\colortbl;");
 
       for (i = 0; i < count; i++)
         {
@@ -303,121 +348,98 @@
 
           color = [list[i] colorUsingColorSpaceName: NSCalibratedRGBColorSpace];
 
-          [result appendFormat: @"\\red%d\\green%d\\blue%d;",
-              (short)([color redComponent] * 255),
-              (short)([color greenComponent] * 255),
-              (short)([color blueComponent] * 255)];
+          APPEND_WORD("\\red", (short)([color redComponent] * 255));
+          APPEND_WORD("\\green", (short)([color greenComponent] * 255));
+          APPEND_WORD("\\blue", (short)([color blueComponent] * 255));
+          APPEND_TOKEN(";");
         }
 
-      [result appendString: @"}\n"];
-      return result;
-    }
-  else
-    {
-      return @"";
+      APPEND_TOKEN("}\n");
     }
 }
 
-- (NSString *)documentAttributes
+- (void)_appendDocumentAttributes
 {
   if (docDict)
     {
-      NSMutableString *result;
       NSValue *val;
       NSNumber *num;
 
-      result = (NSMutableString *)[NSMutableString string];
-
       if ((val = [docDict objectForKey: PAPERSIZE]))
         {
           NSSize size = [val sizeValue];
-          [result appendFormat: @"\\paperw%d\\paperh%d",
-              (short)points2twips(size.width),
-              (short)points2twips(size.height)];
+
+          APPEND_WORD("\\paperw", (short)points2twips(size.width));
+          APPEND_WORD("\\paperh", (short)points2twips(size.height));
         }
 
       if ((num = [docDict objectForKey: LEFTMARGIN]))
         {
-          [result appendFormat: @"\\margl%d",
-              (short)points2twips([num floatValue])];
+          APPEND_WORD("\\margl", (short)points2twips([num floatValue]));
         }
 
       if ((num = [docDict objectForKey: RIGHTMARGIN]))
         {
-          [result appendFormat: @"\\margr%d",
-              (short)points2twips([num floatValue])];
+          APPEND_WORD("\\margr", (short)points2twips([num floatValue]));
         }
 
       if ((num = [docDict objectForKey: TOPMARGIN]))
         {
-          [result appendFormat: @"\\margt%d",
-              (short)points2twips([num floatValue])];
+          APPEND_WORD("\\margt", (short)points2twips([num floatValue]));
         }
 
       if ((num = [docDict objectForKey: BUTTOMMARGIN]))
         {
-          [result appendFormat: @"\\margb%d",
-              (short)points2twips([num floatValue])];
+          APPEND_WORD("\\margb", (short)points2twips([num floatValue]));
         }
 
       if ((val = [docDict objectForKey: VIEWSIZE]))
         {
           NSSize size = [val sizeValue];
-          [result appendFormat: @"\\vieww%d\\viewh%d",
-              (short)points2twips(size.width),
-              (short)points2twips(size.height)];
+
+          APPEND_WORD("\\vieww", (short)points2twips(size.width));
+          APPEND_WORD("\\viewh", (short)points2twips(size.height));
         }
 
       if ((num = [docDict objectForKey: VIEWZOOM]))
         {
           float factor = [num floatValue];
-          [result appendFormat: @"\\viewscale%d",
-              (short)factor];
+
+          APPEND_WORD("\\viewscale", (short)factor);
         }
 
       if ((num = [docDict objectForKey: VIEWMODE]))
         {
           int mode = [num intValue];
-          [result appendFormat: @"\\viewkind%d",
-              (short)mode];
+
+          APPEND_WORD("\\viewkind", (short)mode);
         }
 
       if ((num = [docDict objectForKey: HYPHENATIONFACTOR]))
         {
-          [result appendFormat: @"\\hyphauto1\\hyphfactor%d",
-              (short)points2twips([num floatValue]) * 5];
+          APPEND_WORD("\\hyphauto1\\hyphfactor",
+                      (short)points2twips([num floatValue]) * 5);
         }
-
-      return result;
-    }
-  else
-    {
-      return @"";
     }
 }
 
-- (NSString *)_headerString
+- (void)_appendHeader
 /*" It is essential that before this method is called the method
--_bodyString is called! "*/
+-_appendBody is called! "*/
 {
-  NSMutableString *result;
-
   // As 'ugly' as it seems but had to add \cocoartf to let Apple's RTF parser
   // grok paragraph spacing \saN. Should be no problem with other RTF parsers
   // as this command will be ignored. So this is for compatibility with OS X.
-  result = (NSMutableString *)[NSMutableString stringWithString: 
-      @"{\\rtf1\\ansi\\ansicpg1252\\cocoartf102"];
+  APPEND_TOKEN("{\\rtf1\\ansi\\ansicpg1252\\cocoartf102");
 
-  [result appendString: [self fontTable]];
-  [result appendString: [self colorTable]];
-  [result appendString: [self documentAttributes]];
-
-  return result;
+  [self _appendFontTable];
+  [self _appendColorTable];
+  [self _appendDocumentAttributes];
 }
 
-- (NSString *)_trailerString
+- (void)_appendTrailer
 {
-  return @"}";
+  APPEND_TOKEN("}");
 }
 
 - (NSString *)fontToken: (NSString *)fontName
@@ -458,16 +480,15 @@
   return cn;
 }
 
-- (NSString *)paragraphStyle: (NSParagraphStyle *)paraStyle
+- (void)_appendParagraphStyle: (NSParagraphStyle *)paraStyle
 {
-  NSMutableString *result;
   int twips;
 
-  result = (NSMutableString *)[NSMutableString stringWithString: @"\\pard"];
+  APPEND_TOKEN("\\pard");
 
   if (! paraStyle)
     {
-      return result;
+      return;
     }
 
   // tabs
@@ -484,21 +505,20 @@
                 // no tabkind emission needed
                 break;
             case NSRightTabStopType:
-                [result appendString: @"\\tqr"];
+                APPEND_TOKEN("\\tqr");
                 break;
             case NSCenterTabStopType:
-                [result appendString: @"\\tqc"];
+                APPEND_TOKEN("\\tqc");
                 break;
             case NSDecimalTabStopType:
-                [result appendString: @"\\tqdec"];
+                APPEND_TOKEN("\\tqdec");
                 break;
             default:
                 NSLog(@"Unknown tab stop type.");
                 break;
           }
 
-        [result appendString: [NSString stringWithFormat: @"\\tx%d",
-            (short)points2twips([tab location])]];
+        APPEND_WORD("\\tx", (short)points2twips([tab location]));
       }
   }
 
@@ -508,7 +528,7 @@
         // default -> nothing to emit
         break;
       case NSWritingDirectionRightToLeft:
-        [result appendString: @"\\rtlpar"];
+        APPEND_TOKEN("\\rtlpar");
         break;
       default:
         break;
@@ -518,13 +538,13 @@
   twips = points2twips([paraStyle headIndent]);
   if (twips != 0)
     {
-      [result appendFormat: @"\\li%d", (short)twips];
+      APPEND_WORD("\\li", (short)twips);
     }
 
   twips = points2twips([paraStyle firstLineHeadIndent]) - twips;
   if (twips != 0)
     {
-      [result appendFormat: @"\\fi%d", (short)twips];
+      APPEND_WORD("\\fi", (short)twips);
     }
 
   // right indent
@@ -549,92 +569,87 @@
         tailIndentTwips = points2twips([paraStyle tailIndent]);
         paperWidthTwips = points2twips([paperSize sizeValue].width);
 
-        [result appendFormat: @"\\ri%d",
-            (short)(paperWidthTwips - rightMarginTwips
-            - leftMarginTwips - tailIndentTwips)];
+        APPEND_WORD("\\ri", (short)(paperWidthTwips - rightMarginTwips
+                                    - leftMarginTwips - tailIndentTwips));
       }
   }
   
   twips = points2twips([paraStyle paragraphSpacing]);
   if (twips != 0)
     {
-      [result appendFormat: @"\\sa%d", (short)twips];
+      APPEND_WORD("\\sa", (short)twips);
     }
 
   twips = points2twips([paraStyle minimumLineHeight]);
   if (twips != 0)
     {
-      [result appendFormat: @"\\sl%d", (short)twips];
+      APPEND_WORD("\\sl", (short)twips);
     }
 
   twips = points2twips([paraStyle maximumLineHeight]);
   if (twips != 0)
     {
-      [result appendFormat: @"\\sl-%d", (short)twips];
+      APPEND_WORD("\\sl-", (short)twips);
     }
 
   switch ([paraStyle alignment])
     {
       case NSRightTextAlignment:
-          [result appendString: @"\\qr"];
+          APPEND_TOKEN("\\qr");
           break;
       case NSCenterTextAlignment:
-          [result appendString: @"\\qc"];
+          APPEND_TOKEN("\\qc");
           break;
       case NSLeftTextAlignment:
-          [result appendString: @"\\ql"];
+          APPEND_TOKEN("\\ql");
           break;
       case NSJustifiedTextAlignment:
-          [result appendString: @"\\qj"];
+          APPEND_TOKEN("\\qj");
           break;
       default:
-          [result appendString: @"\\ql"];
+          APPEND_TOKEN("\\ql");
           break;
     }
-
-  return result;
 }
 
-- (NSString *)font: (NSFont *)font
+- (void)_appendFont: (NSFont *)font
 {
   NSString *fontName;
   NSFontTraitMask traits, traitsOfLastRun;
-  NSMutableString *result;
+  NSFontManager *fontManager;
   NSFont *fontOfLastRun;
 
   fontOfLastRun = [[self _attributesOfLastRun]
                          objectForKey: NSFontAttributeName];
 
-  result = (NSMutableString *)[NSMutableString string];
-
   // name
   fontName = [font familyName];
   if ((! fontOfLastRun) || (! [fontName isEqualToString: 
       [fontOfLastRun familyName]]))
     {
-      [result appendString: [self fontToken: fontName]];
+      [self _appendString: [self fontToken: fontName]];
     }
 
   // size
   if ((! fontOfLastRun) || ([font pointSize] != [fontOfLastRun pointSize]))
     {
-      [result appendFormat: @"\\fs%d", (short)(int)([font pointSize] * 2)];
+      APPEND_WORD("\\fs", (short)(int)([font pointSize] * 2));
     }
 
   // traits
-  traits = [[NSFontManager sharedFontManager] traitsOfFont: font];
-  traitsOfLastRun = [[NSFontManager sharedFontManager] traitsOfFont: 
-      fontOfLastRun];
+  fontManager = [NSFontManager sharedFontManager];
+  traits = [fontManager traitsOfFont: font];
+  traitsOfLastRun = [fontManager traitsOfFont: fontOfLastRun];
 
   if ((traits & NSItalicFontMask) != (traitsOfLastRun & NSItalicFontMask))
     {
       if (traits & NSItalicFontMask)
         {
-          [result appendString: @"\\i"];
+          APPEND_TOKEN("\\i");
         }
       else
         {
-          [result appendString: @"\\i0"];
+          APPEND_TOKEN("\\i0");
         }
     }
 
@@ -642,46 +657,42 @@
     {
       if (traits & NSBoldFontMask)
         {
-          [result appendString: @"\\b"];
+          APPEND_TOKEN("\\b");
         }
       else
         {
-          [result appendString: @"\\b0"];
+          APPEND_TOKEN("\\b0");
         }
     }
-  return result;
 }
 
-- (NSString *)_removeAttributesString: (NSDictionary *)attributesToRemove
+- (void)_appendRemovedAttributes: (NSDictionary *)attributesToRemove
 {
-  NSMutableString *result;
   NSEnumerator *enumerator;
   NSString *attributeName;
 
-  result = (NSMutableString *)[NSMutableString string];
-
   enumerator = [attributesToRemove keyEnumerator];
   while ((attributeName = [enumerator nextObject]))
     {
       if ([attributeName isEqualToString: NSParagraphStyleAttributeName])
         {
-          [result appendString: @"\\pard\\ql"];
+          APPEND_TOKEN("\\pard\\ql");
         }
       else if ([attributeName isEqualToString: NSForegroundColorAttributeName])
         {
-          [result appendString: @"\\cf0"];
+          APPEND_TOKEN("\\cf0");
         }
       else if ([attributeName isEqualToString: NSBackgroundColorAttributeName])
         {
-          [result appendString: @"\\cb0"];
+          APPEND_TOKEN("\\cb0");
         }
       else if ([attributeName isEqualToString: NSUnderlineStyleAttributeName])
         {
-          [result appendString: @"\\ulnone"];
+          APPEND_TOKEN("\\ulnone");
         }
       else if ([attributeName isEqualToString: NSSuperscriptAttributeName])
         {
-          [result appendString: @"\\nosupersub"];
+          APPEND_TOKEN("\\nosupersub");
         }
       else if ([attributeName isEqualToString: NSBaselineOffsetAttributeName])
         {
@@ -691,16 +702,16 @@
 
           if (svalue >= 0)
             {
-              [result appendString: @"\\up0"];
+              APPEND_TOKEN("\\up0");
             }
           else if (svalue < 0)
             {
-              [result appendString: @"\\dn0"];
+              APPEND_TOKEN("\\dn0");
             }
         }
       else if ([attributeName isEqualToString: NSLigatureAttributeName])
         {
-          [result appendString: @"\\zwnj"];
+          APPEND_TOKEN("\\zwnj");
         }
       else if ([attributeName isEqualToString: NSAttachmentAttributeName])
         {
@@ -710,7 +721,7 @@
         }
       else if ([attributeName isEqualToString: NSLinkAttributeName])
 	{
-	  [result appendString: @"}}"];
+	  APPEND_TOKEN("}}");
 	}
       else
         {
@@ -719,28 +730,30 @@
           // ##TODO: attributes missing e.g. NSKernAttributeName
         }
     }
-
-  return result;
 }
 
-- (NSString *)_stringWithRTFCharacters: (NSString *)string
+/*" Appends the characters in range of string, escaping them as needed.
+    Runs of characters which need no escaping are appended at once. "*/
+- (void)_appendRTFCharactersOfString: (NSString *)string
+                               range: (NSRange)range
 {
-  NSString *result;
-  NSMutableData *resultData;
   unichar *buffer;
-  int length, i;
+  char *plain;
+  NSUInteger length, i;
+  NSUInteger plainLength = 0;
   BOOL uc_flagged = NO;
 
-  if (string == nil)
+  length = range.length;
+  if (length == 0)
     {
-      return nil;
+      return;
     }
-  
-  length = [string length];
-  buffer = NSZoneCalloc([self zone], length, sizeof(unichar));
-  [string getCharacters: buffer];
-  resultData = [[NSMutableData alloc]
-                               initWithCapacity: (int)(length * 1.2)];
+  buffer = NSZoneMalloc([self zone], length * sizeof(unichar));
+  plain = NSZoneMalloc([self zone], length);
+  [string getCharacters: buffer range: range];
+
+#define FLUSH_PLAIN() \
+  if (plainLength) { APPEND(plain, plainLength); plainLength = 0; }
 
   for (i = 0; i < length; i++)
     {
@@ -757,28 +770,35 @@
           switch (ansiChar)
             {
               case '\\':
-                  [resultData appendBytes: "\\\\" length: 2];
+                  FLUSH_PLAIN();
+                  APPEND_TOKEN("\\\\");
                   break;
               case '\n':
-                  [resultData appendBytes: "\\par\n" length: 5];
+                  FLUSH_PLAIN();
+                  APPEND_TOKEN("\\par\n");
                   break;
               case '\t':
-                  [resultData appendBytes: "\\tab " length: 5];
+                  FLUSH_PLAIN();
+                  APPEND_TOKEN("\\tab ");
                   break;
               case '{':
-                  [resultData appendBytes: "\\{" length: 2];
+                  FLUSH_PLAIN();
+                  APPEND_TOKEN("\\{");
                   break;
               case '}':
-                  [resultData appendBytes: "\\}" length: 2];
+                  FLUSH_PLAIN();
+                  APPEND_TOKEN("\\}");
                   break;
               case '`':
-                  [resultData appendBytes: "\\lquote " length: 8];
+                  FLUSH_PLAIN();
+                  APPEND_TOKEN("\\lquote ");
                   break;
               case '\'':
-                  [resultData appendBytes: "\\rquote " length: 8];
+                  FLUSH_PLAIN();
+                  APPEND_TOKEN("\\rquote ");
                   break;
               default:
-                  [resultData appendBytes: &ansiChar length: 1];
+                  plain[plainLength++] = ansiChar;
                   break;                  
             }
         }
@@ -786,42 +806,41 @@
         {
           char unicodeCommand[16];
           
+          FLUSH_PLAIN();
           snprintf(unicodeCommand, 16, "\\'%X", (short)c);
           unicodeCommand[15] = '\0';
 
-          [resultData appendBytes: unicodeCommand
-                           length: strlen(unicodeCommand)];
+          APPEND(unicodeCommand, strlen(unicodeCommand));
 	}
       else if (c == NSAttachmentCharacter)
         {
-          [resultData appendBytes: "\\'AC}" length: 5];
+          FLUSH_PLAIN();
+          APPEND_TOKEN("\\'AC}");
         }
       else
         {
           // write unicode encoding
           char unicodeCommand[16];
 
+          FLUSH_PLAIN();
           if (!uc_flagged)
             {
               // We don't supply an ANSI representation for Unicode characters
-              [resultData appendBytes: "\\uc0 " length: 5];
+              APPEND_TOKEN("\\uc0 ");
               uc_flagged = YES;
             }
 
           snprintf(unicodeCommand, 16, "\\u%d ", (short)c);
           unicodeCommand[15] = '\0';
 
-          [resultData appendBytes: unicodeCommand
-                           length: strlen(unicodeCommand)];       
+          APPEND(unicodeCommand, strlen(unicodeCommand));
         }
     }
+  FLUSH_PLAIN();
+#undef FLUSH_PLAIN
 
+  NSZoneFree([self zone], plain);
   NSZoneFree([self zone], buffer);
-  result = AUTORELEASE([[NSString alloc] initWithData: resultData
-					 encoding: NSASCIIStringEncoding]);
-  RELEASE(resultData);
-
-  return result;
 }
 
 - (NSString *)_ASCIIfiedString: (NSString *)string;
@@ -836,26 +855,23 @@
 					 encoding: NSASCIIStringEncoding]);
 }
 
-- (NSString *)_addAttributesString: (NSDictionary *)attributesToAdd
+- (void)_appendAddedAttributes: (NSDictionary *)attributesToAdd
 {
-  NSMutableString *result;
   NSEnumerator *enumerator;
   NSString *attributeName;
 
-  result = (NSMutableString *)[NSMutableString string];
-
   enumerator = [attributesToAdd keyEnumerator];
   while ((attributeName = [enumerator nextObject]))
     {
       if ([attributeName isEqualToString: NSParagraphStyleAttributeName])
         {
-          [result appendString: [self paragraphStyle:
-              [attributesToAdd objectForKey: NSParagraphStyleAttributeName]]];
+          [self _appendParagraphStyle:
+              [attributesToAdd objectForKey: NSParagraphStyleAttributeName]];
         }
       else if ([attributeName isEqualToString: NSFontAttributeName])
         {
-          [result appendString: [self font:
-              [attributesToAdd objectForKey: NSFontAttributeName]]];
+          [self _appendFont:
+              [attributesToAdd objectForKey: NSFontAttributeName]];
         }
       else if ([attributeName isEqualToString: NSForegroundColorAttributeName])
         {
@@ -863,8 +879,7 @@
               NSForegroundColorAttributeName];
           if (! [color isEqual: fgColor])
             {
-              [result appendFormat: @"\\cf%d",
-                  (short)[self numberForColor: color]];
+              APPEND_WORD("\\cf", (short)[self numberForColor: color]);
             }
         }
       else if ([attributeName isEqualToString: NSBackgroundColorAttributeName])
@@ -874,8 +889,7 @@
 
           if (! [color isEqual: bgColor])
             {
-              [result appendFormat: @"\\cb%d",
-                  (short)[self numberForColor: color]];
+              APPEND_WORD("\\cb", (short)[self numberForColor: color]);
             }
         }
       else if ([attributeName isEqualToString: NSUnderlineColorAttributeName])
@@ -883,8 +897,7 @@
           NSColor *color = [attributesToAdd objectForKey: 
               NSUnderlineColorAttributeName];
 
-          [result appendFormat: @"\\ulc%d",
-              (short)[self numberForColor: color]];
+          APPEND_WORD("\\ulc", (short)[self numberForColor: color]);
         }
       else if ([attributeName isEqualToString: NSUnderlineStyleAttributeName])
         {
@@ -893,61 +906,61 @@
 
 	  if ((styleMask & NSUnderlineByWordMask) == NSUnderlineByWordMask)
 	    {
-	      [result appendString: @"\\ulw"];
+	      APPEND_TOKEN("\\ulw");
 	    }
 
           if (styleMask == NSUnderlineStyleNone)
             {
-              [result appendString: @"\\ulnone"];
+              APPEND_TOKEN("\\ulnone");
             }
 	  else if ((styleMask & NSUnderlineStyleDouble) == NSUnderlineStyleDouble)
 	    {
-	      [result appendString: @"\\uldb"];
+	      APPEND_TOKEN("\\uldb");
 	    }
 	  else if ((styleMask & NSUnderlineStyleThick) == NSUnderlineStyleThick)
 	    {
 	      if ((styleMask & NSUnderlinePatternDot) == NSUnderlinePatternDot)
 		{
-		  [result appendString: @"\\ulthd"];
+		  APPEND_TOKEN("\\ulthd");
 		}
 	      else if ((styleMask & NSUnderlinePatternDash) == NSUnderlinePatternDash)
 		{
-		  [result appendString: @"\\ulthdash"];
+		  APPEND_TOKEN("\\ulthdash");
 		}
 	      else if ((styleMask & NSUnderlinePatternDashDot) == NSUnderlinePatternDashDot)
 		{
-		  [result appendString: @"\\ulthdashd"];
+		  APPEND_TOKEN("\\ulthdashd");
 		}
 	      else if ((styleMask & NSUnderlinePatternDashDotDot) == NSUnderlinePatternDashDotDot)
 		{
-		  [result appendString: @"\\ulthdashdd"];
+		  APPEND_TOKEN("\\ulthdashdd");
 		}
 	      else // Assume NSUnderlinePatternSolid
 		{
-		  [result appendString: @"\\ulth"];
+		  APPEND_TOKEN("\\ulth");
 		}
 	    }
 	  else // Assume NSUnderlineStyleSingle
 	    {
 	      if ((styleMask & NSUnderlinePatternDot) == NSUnderlinePatternDot)
 		{
-		  [result appendString: @"\\uld"];
+		  APPEND_TOKEN("\\uld");
 		}
 	      else if ((styleMask & NSUnderlinePatternDash) == NSUnderlinePatternDash)
 		{
-		  [result appendString: @"\\uldash"];
+		  APPEND_TOKEN("\\uldash");
 		}
 	      else if ((styleMask & NSUnderlinePatternDashDot) == NSUnderlinePatternDashDot)
 		{
-		  [result appendString: @"\\uldashd"];
+		  APPEND_TOKEN("\\uldashd");
 		}
 	      else if ((styleMask & NSUnderlinePatternDashDotDot) == NSUnderlinePatternDashDotDot)
 		{
-		  [result appendString: @"\\uldashdd"];
+		  APPEND_TOKEN("\\uldashdd");
 		}
 	      else // Assume NSUnderlinePatternSolid
 		{
-		  [result appendString: @"\\ul"];
+		  APPEND_TOKEN("\\ul");
 		}
 	    }
         }
@@ -959,18 +972,18 @@
 
           if (svalue > 0)
             {
-              [result appendString: @"\\super"];
+              APPEND_TOKEN("\\super");
               if (svalue > 1)
                 {
-                  [result appendFormat: @"%d", (short)svalue];
+                  APPEND_WORD("", (short)svalue);
                 }
             }
           else if (svalue < 0)
             {
-              [result appendString: @"\\sub"];
+              APPEND_TOKEN("\\sub");
               if (svalue < -1)
                 {
-                  [result appendFormat: @"%d", (short)-svalue];
+                  APPEND_WORD("", (short)-svalue);
                 }
             }
         }
@@ -982,16 +995,16 @@
 
           if (svalue > 0)
             {
-              [result appendFormat: @"\\up%d", (short)svalue];
+              APPEND_WORD("\\up", (short)svalue);
             }
           else if (svalue < 0)
             {
-              [result appendFormat: @"\\dn%d", (short)-svalue];
+              APPEND_WORD("\\dn", (short)-svalue);
             }
         }
       else if ([attributeName isEqualToString: NSLigatureAttributeName])
         {
-          [result appendString: @"\\zwj"];
+          APPEND_TOKEN("\\zwj");
         }
       else if ([attributeName isEqualToString: NSAttachmentAttributeName])
         {
@@ -1009,13 +1022,13 @@
 		  GSHelpLinkAttachment *link =
 		    (GSHelpLinkAttachment *)attachment;
 
-		  [result appendString: @"{{\\NeXTHelpLink"];
-		  [result appendString: @" \\markername "];
-		  [result appendString: @";\\linkFilename "];
-		  [result appendString: [link fileName]];
-		  [result appendString: @";\\linkMarkername "];
-		  [result appendString: [link markerName]];
-		  [result appendString: @";}"];
+		  APPEND_TOKEN("{{\\NeXTHelpLink");
+		  APPEND_TOKEN(" \\markername ");
+		  APPEND_TOKEN(";\\linkFilename ");
+		  [self _appendString: [link fileName]];
+		  APPEND_TOKEN(";\\linkMarkername ");
+		  [self _appendString: [link markerName]];
+		  APPEND_TOKEN(";}");
 		}
 	      else if ([attachment
 			 isKindOfClass: [GSHelpMarkerAttachment class]])
@@ -1023,10 +1036,10 @@
 		  GSHelpMarkerAttachment *marker =
 		    (GSHelpMarkerAttachment *)attachment;
 
-		  [result appendString: @"{{\\NeXTHelpMarker"];
-		  [result appendString: @" \\markername "];
-		  [result appendString: [marker markerName]];
-		  [result appendString: @";}"];
+		  APPEND_TOKEN("{{\\NeXTHelpMarker");
+		  APPEND_TOKEN(" \\markername ");
+		  [self _appendString: [marker markerName]];
+		  APPEND_TOKEN(";}");
 		}
 	      else
 		{
@@ -1079,11 +1092,11 @@
 
 		  cellSize = [[attachment attachmentCell] cellSize];
 
-		  [result appendString: @"{{\\NeXTGraphic "];
-		  [result appendString: [attachmentFilename lastPathComponent]];
-		  [result appendFormat: @" \\width%d \\height%d}",
-			  (short)points2twips(cellSize.width),
-			  (short)points2twips(cellSize.height)];
+		  APPEND_TOKEN("{{\\NeXTGraphic ");
+		  [self _appendString: [attachmentFilename lastPathComponent]];
+		  APPEND_WORD(" \\width", (short)points2twips(cellSize.width));
+		  APPEND_WORD(" \\height", (short)points2twips(cellSize.height));
+		  APPEND_TOKEN("}");
 
 		  [attachmentFileWrapper setFilename: attachmentFilename];
 		  [attachmentFileWrapper
@@ -1113,8 +1126,16 @@
 	  // will be escaped by -absoluteString, so the result is safe to 
 	  // concatenate into the RTF stream
 
-	  [result appendString: 
-		    [NSString stringWithFormat: @"{\\field{\\*\\fldinst HYPERLINK \"%@\"}{\\fldrslt ", destString]];
+	  APPEND_TOKEN("{\\field{\\*\\fldinst HYPERLINK \"");
+	  if (destString != nil)
+	    {
+	      [self _appendString: destString];
+	    }
+	  else
+	    {
+	      APPEND_TOKEN("(null)");
+	    }
+	  APPEND_TOKEN("\"}{\\fldrslt ");
 	}
       else
         {
@@ -1123,19 +1144,17 @@
           // ##TODO: attributes missing e.g. NSKernAttributeName
         }
     }
-  return result;
 }
 
-- (NSString *)_runStringForString: (NSString *)string
-                       attributes: (NSDictionary *)attributes
+- (void)_appendRunWithRange: (NSRange)range
+                 attributes: (NSDictionary *)attributes
 {
-  NSMutableString *result;
   NSMutableDictionary *attributesToAdd, *attributesToRemove;
   NSEnumerator *enumerator;
   NSString *attributeName;
+  NSUInteger start;
 
-  result = (NSMutableString *)[NSMutableString stringWithCapacity:
-                                            [string length] + 15];
+  start = [output length];
   attributesToAdd = [[NSMutableDictionary alloc] init];
   attributesToRemove = [[self _attributesOfLastRun] mutableCopy];
 
@@ -1167,53 +1186,58 @@
         }
     }
 
-  [result appendString: [self _removeAttributesString: attributesToRemove]];
-  [result appendString: [self _addAttributesString: attributesToAdd]];
+  [self _appendRemovedAttributes: attributesToRemove];
+  [self _appendAddedAttributes: attributesToAdd];
   RELEASE(attributesToRemove);
   RELEASE(attributesToAdd);
 
-  if ([result length])
+  if ([output length] > start)
     {
-      unichar c = [result characterAtIndex: [result length] - 1];
+      char c = ((const char *)[output bytes])[[output length] - 1];
 
       if ((c != '}') && (c != ' '))
         {
           // ensure delimiter
-          [result appendString: @" "];
+          APPEND_TOKEN(" ");
         }
     }
 
-  [result appendString: [self _stringWithRTFCharacters: string]];
-
-  return result;
+  [self _appendRTFCharactersOfString: [text string] range: range];
 }
 
-- (NSString *)_bodyString
+- (void)_appendBody
 {
-  NSString *string;
-  NSMutableString *result;
   unsigned length;
   NSRange effectiveRange;
 
-  string = [text string];
-  result = (NSMutableString *)[NSMutableString string];
-  length = [string length];
+  length = [text length];
   effectiveRange = NSMakeRange(0, 0);
 
   while (effectiveRange.location < length)
     {
       NSDictionary *attributes;
+      NSRange range;
       CREATE_AUTORELEASE_POOL(pool);
 
       attributes = [text attributesAtIndex: effectiveRange.location
-                     longestEffectiveRange: &effectiveRange
-                                   inRange: NSMakeRange(effectiveRange.location,
-                                                       length
-                                                    - effectiveRange.location)];
+                            effectiveRange: &effectiveRange];
 
-      [result appendString: [self _runStringForString:
-                           [string substringWithRange: effectiveRange]
-                                           attributes: attributes]];
+      /* Merge the following runs with equal attributes, so that the
+         delta to the last run is only computed once per change. */
+      while (NSMaxRange(effectiveRange) < length)
+        {
+          NSDictionary *next;
+
+          next = [text attributesAtIndex: NSMaxRange(effectiveRange)
+                          effectiveRange: &range];
+          if (next != attributes && ![next isEqualToDictionary: attributes])
+            {
+              break;
+            }
+          effectiveRange.length = NSMaxRange(range) - effectiveRange.location;
+        }
+
+      [self _appendRunWithRange: effectiveRange attributes: attributes];
 
       effectiveRange = NSMakeRange(NSMaxRange(effectiveRange), 0);
 
@@ -1223,36 +1247,35 @@
     }
 
   [self _setAttributesOfLastRun: nil]; // cleanup, should be unneccessary
-
-  return result;
 }
 
-- (NSString *)_RTFDStringFromAttributedString: (NSAttributedString *)aText
-                           documentAttributes: (NSDictionary *)dict
-                               inlineGraphics: (BOOL)inlineGraphics
+- (NSData *)_RTFDDataFromAttributedString: (NSAttributedString *)aText
+                       documentAttributes: (NSDictionary *)dict
+                           inlineGraphics: (BOOL)inlineGraphics
 {
-  NSMutableString *output;
-  NSString *headerString;
-  NSString *trailerString;
-  NSString *bodyString;
+  NSMutableData *body;
+  NSMutableData *result;
 
   ASSIGN(text, aText);
   ASSIGN(docDict, dict);
 
-  output = (NSMutableString *)[NSMutableString string];
   _inlineGraphics = inlineGraphics;
   /*
    * do not change order! (esp. body has to be generated first; builds context)
    */
-  bodyString = [self _bodyString];
-  trailerString = [self _trailerString];
-  headerString = [self _headerString];
-
-  [output appendString: headerString];
-  [output appendString: bodyString];
-  [output appendString: trailerString];
-
-  return output;
+  body = [[NSMutableData alloc] initWithCapacity: [aText length] + 256];
+  [self _setOutput: body];
+  [self _appendBody];
+
+  result = [[NSMutableData alloc] initWithCapacity: [body length] + 1024];
+  [self _setOutput: result];
+  [self _appendHeader];
+  APPEND([body bytes], [body length]);
+  [self _appendTrailer];
+  [self _setOutput: nil];
+
+  RELEASE(body);
+  return AUTORELEASE(result);
 }
 
 @end
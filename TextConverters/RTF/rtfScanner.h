@@ -43,6 +43,8 @@ typedef struct _RTFscannerCtxt {
 	int	streamPosition;
 	int	streamLineNumber;
 	void	*customContext;
+	const char	*buffer;	// set when scanning from memory
+	int	bufferLength;
 } RTFscannerCtxt;
 
 typedef struct {
@@ -60,6 +62,8 @@ typedef enum {
 
 
 void	lexInitContext(RTFscannerCtxt *lctxt, void *customContext, int (*getcharFunction)());
+/*	scan directly from a memory buffer, text runs are then read in bulk */
+void	lexInitBufferContext(RTFscannerCtxt *lctxt, const char *buffer, int length);
 
 /*	external symbols from the grammer	*/
 /*int	GSRTFparse(void *ctxt, RTFscannerCtxt *lctxt);*/
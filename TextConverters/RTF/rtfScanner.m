@@ -82,6 +82,16 @@ void lexInitContext (RTFscannerCtxt *lctxt, void *customContext,
   lctxt->streamPosition = lctxt->pushbackCount = 0;
   lctxt->lgetchar = getcharFunction;
   lctxt->customContext = customContext;
+  lctxt->buffer = 0;
+  lctxt->bufferLength = 0;
+}
+
+void lexInitBufferContext (RTFscannerCtxt *lctxt, const char *buffer,
+			   int length)
+{
+  lexInitContext(lctxt, 0, 0);
+  lctxt->buffer = buffer;
+  lctxt->bufferLength = length;
 }
 
 int lexGetchar (RTFscannerCtxt *lctxt)
@@ -92,6 +102,12 @@ int lexGetchar (RTFscannerCtxt *lctxt)
       lctxt->pushbackCount--;
       c = lctxt->pushbackBuffer[lctxt->pushbackCount];
     }
+  else if (lctxt->buffer)
+    {
+      c = lctxt->streamPosition < lctxt->bufferLength
+	? lctxt->buffer[lctxt->streamPosition] : EOF;
+      lctxt->streamPosition++;
+    }
   else
     {
       lctxt->streamPosition++;
@@ -349,12 +365,86 @@ GSLexError readCommand (RTFscannerCtxt *lctxt,
   return NoError;
 }
 
+/*	Reads a text run straight from the memory buffer. Only pushed
+	back characters go through lexGetchar(), the remainder of the run
+	is located with a single scan and copied at once. */
+static GSLexError readBufferText (RTFscannerCtxt *lctxt, YYSTYPE *lvalp)
+{
+  const char *bf = lctxt->buffer;
+  char pending[4];
+  char *text, *dst;
+  int pendingCount = 0;
+  int start, end, i, c;
+
+  start = end = -1;
+  while (lctxt->pushbackCount)
+    {
+      c = lexGetchar(lctxt);
+      if (c == EOF || c == '{' || c == '}' || c == '\\')
+	{
+	  lexUngetchar(lctxt, c);
+	  start = end = lctxt->streamPosition;
+	  break;
+	}
+      if (c != '\n' && c != '\r')
+	{
+	  pending[pendingCount++] = c;
+	}
+    }
+
+  if (start < 0)
+    {
+      start = end = lctxt->streamPosition;
+      while (end < lctxt->bufferLength)
+	{
+	  c = bf[end];
+	  if (c == '{' || c == '}' || c == '\\')
+	    {
+	      break;
+	    }
+	  end++;
+	}
+    }
+
+  if (!(text = malloc(pendingCount + (end - start) + 1)))
+    {
+      return LEXoutOfMemory;
+    }
+  dst = text;
+  for (i = 0; i < pendingCount; i++)
+    {
+      *dst++ = pending[i];
+    }
+  // <N> newline and cr are ignored if not quoted
+  for (i = start; i < end; i++)
+    {
+      c = bf[i];
+      if (c == '\n')
+	{
+	  lctxt->streamLineNumber++;
+	}
+      else if (c != '\r')
+	{
+	  *dst++ = c;
+	}
+    }
+  *dst = 0;
+  lctxt->streamPosition = end;
+  lvalp->text = text; // release is up to the consumer
+  return NoError;
+}
+
 GSLexError readText (RTFscannerCtxt *lctxt, YYSTYPE *lvalp)
 {
   int c;
   DynamicString text;
   GSLexError error;
   
+  if (lctxt->buffer)
+    {
+      return readBufferText(lctxt, lvalp);
+    }
+
   if ((error = initDynamicString(&text))) 
     {
       return error;
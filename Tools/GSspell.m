@@ -87,6 +87,55 @@
 }
 @end
 
+// A category for NSSpellServer so that NSSpellChecker can get all
+// misspelled words of a text in one message rather than one message
+// for each of them.
+@interface NSSpellServer (MethodsForSpellChecker)
+- (NSRange) _findMisspelledWordInString: (NSString *)stringToCheck
+			       language: (NSString *)language
+			   ignoredWords: (NSArray *)ignoredWords
+			      wordCount: (int *)wordCount
+			      countOnly: (BOOL)countOnly;
+- (bycopy NSArray *) _findMisspelledWordsInString: (NSString *)stringToCheck
+					 language: (NSString *)language
+				     ignoredWords: (NSArray *)ignoredWords;
+@end
+
+@implementation NSSpellServer (MethodsForSpellChecker)
+- (bycopy NSArray *) _findMisspelledWordsInString: (NSString *)stringToCheck
+					 language: (NSString *)language
+				     ignoredWords: (NSArray *)ignoredWords
+{
+  NSMutableArray *ranges = [NSMutableArray array];
+  NSUInteger length = [stringToCheck length];
+  NSUInteger pos = 0;
+
+  while (pos < length)
+    {
+      CREATE_AUTORELEASE_POOL(pool);
+      NSString *rest;
+      NSRange r;
+      int wordCount = 0;
+
+      rest = [stringToCheck substringFromIndex: pos];
+      r = [self _findMisspelledWordInString: rest
+				   language: language
+			       ignoredWords: ignoredWords
+				  wordCount: &wordCount
+				  countOnly: NO];
+      [pool drain];
+      if (r.location == NSNotFound || r.length == 0)
+	{
+	  break;
+	}
+      r.location += pos;
+      [ranges addObject: [NSValue valueWithRange: r]];
+      pos = NSMaxRange(r);
+    }
+  return ranges;
+}
+@end
+
 // The base class.  Its spell checker just provides a dumb spell checker
 // for American English as fallback if aspell is not available.
 
@@ -3,15 +3,105 @@
 
 cst_voice *register_cmu_us_kal16();
 
+/** Number of synthesized utterances that may wait to be played. */
+#define QUEUE_LENGTH 2
+/** Utterances longer than this are split at the next space. */
+#define MAX_UTTERANCE 400
+
+/**
+ * A synthesized piece of the string being spoken.
+ */
+@interface FliteUtterance : NSObject {
+@public
+  /** The samples of the utterance. */
+  cst_wave *wave;
+  /** The range of the utterance in the spoken string. */
+  NSRange range;
+}
+@end
+
+@implementation FliteUtterance
+- (void)dealloc
+{
+  if (NULL != wave)
+    {
+      delete_wave(wave);
+    }
+  [super dealloc];
+}
+@end
+
+/**
+ * Splits aString in sentences, which are synthesized one at a time.
+ */
+static NSArray *utteranceRanges(NSString *aString)
+{
+  NSMutableArray *ranges = [NSMutableArray array];
+  NSCharacterSet *space = [NSCharacterSet whitespaceAndNewlineCharacterSet];
+  NSCharacterSet *text = [space invertedSet];
+  NSUInteger length = [aString length];
+  NSUInteger start = 0;
+  NSUInteger i;
+
+  for (i = 0; i <= length; i++)
+    {
+      BOOL end = (i == length);
+
+      if (!end)
+        {
+          unichar c = [aString characterAtIndex: i];
+
+          if (c == '\n' || c == 0x2029)
+            {
+              end = YES;
+            }
+          else if (c == '.' || c == '!' || c == '?' || c == ';' || c == ':')
+            {
+              end = (i + 1 == length
+                || [space characterIsMember: [aString characterAtIndex: i + 1]]);
+            }
+          else if (i - start >= MAX_UTTERANCE)
+            {
+              end = [space characterIsMember: c];
+            }
+        }
+      if (end)
+        {
+          NSRange r = NSMakeRange(start, MIN(i + 1, length) - start);
+
+          if ([aString rangeOfCharacterFromSet: text
+                                       options: 0
+                                         range: r].location != NSNotFound)
+            {
+              [ranges addObject: [NSValue valueWithRange: r]];
+            }
+          start = i + 1;
+        }
+    }
+  return ranges;
+}
+
 /**
  * Implementation of a speech engine using flite.  This should be the default
  * for resource-constrained platforms.
+ *
+ * The string is split in sentences.  A producer thread synthesizes them
+ * into a short queue while the speaking thread plays the ones already
+ * done, so speech starts as soon as the first sentence is ready.
  */
 @interface FliteSpeechEngine : GSSpeechEngine {
   /** The audio device used for sound output. */
   cst_audiodev *ad;
+  /** File written instead of the audio device, see GSSpeechOutputFile. */
+  FILE *file;
   /** The current voice.  Only one supported at the moment. */
   cst_voice *v;
+  /** Synthesized utterances waiting to be played. */
+  NSMutableArray *queue;
+  /** Protects queue and producing. */
+  NSCondition *queueLock;
+  /** Flag set while the producer thread is synthesizing. */
+  volatile BOOL producing;
   /** Flag set to tell the playback thread to exit. */
   volatile BOOL shouldEndSpeaking;
   /** Flag indicating whether the engine is currently speaking. */
@@ -27,6 +117,8 @@ cst_voice *register_cmu_us_kal16();
 
 - (id)init
 {
+  NSString *path;
+
   if (nil == (self = [super init])) { return nil; }
   
   // Only one voice supported by flite unless others are compiled in.
@@ -37,30 +129,128 @@ cst_voice *register_cmu_us_kal16();
       return nil;
     }
   
-  // Each wave should be the same format.
-  cst_wave *w = flite_text_to_wave("test", v);
-  ad = audio_open(w->sample_rate, w->num_channels, CST_AUDIO_LINEAR16);
-  delete_wave(w);
-  if (NULL == ad)
+  // Raw samples can be written to a file instead, when testing.
+  path = [[NSUserDefaults standardUserDefaults]
+           stringForKey: @"GSSpeechOutputFile"];
+  if (nil != path)
     {
-      [self release];
-      return nil;
+      file = fopen([path fileSystemRepresentation], "ab");
+      if (NULL == file)
+        {
+          [self release];
+          return nil;
+        }
+    }
+  else
+    {
+      // Each wave should be the same format.
+      cst_wave *w = flite_text_to_wave("test", v);
+      ad = audio_open(w->sample_rate, w->num_channels, CST_AUDIO_LINEAR16);
+      delete_wave(w);
+      if (NULL == ad)
+        {
+          [self release];
+          return nil;
+        }
     }
+  queue = [NSMutableArray new];
+  queueLock = [NSCondition new];
   return self;
 }
 
-- (void)sayString: (NSArray*)args
+/**
+ * Producer thread.  Synthesizes the sentences of the string, waiting
+ * while the queue is full, until all are done or speaking is stopped.
+ */
+- (void)synthesizeString: (NSString*)aString
 {
   id pool = [NSAutoreleasePool new];
-  NSString *aString = [args objectAtIndex: 0];
-  int i,n,r;
-  int num_shorts;
-  BOOL didFinish = YES;
-  cst_wave *w = flite_text_to_wave([aString UTF8String], v);
-  
-  num_shorts = w->num_samples * w->num_channels;
-  for (i=0; i < num_shorts; i += r/2)
+  NSEnumerator *e = [utteranceRanges(aString) objectEnumerator];
+  NSValue *r;
+
+  while (nil != (r = [e nextObject]) && !shouldEndSpeaking)
     {
+      FliteUtterance *u = [FliteUtterance new];
+
+      u->range = [r rangeValue];
+      u->wave = flite_text_to_wave(
+        [[aString substringWithRange: u->range] UTF8String], v);
+      [queueLock lock];
+      while ([queue count] >= QUEUE_LENGTH && !shouldEndSpeaking)
+        {
+          [queueLock wait];
+        }
+      if (NULL != u->wave && !shouldEndSpeaking)
+        {
+          [queue addObject: u];
+          [queueLock broadcast];
+        }
+      [queueLock unlock];
+      [u release];
+    }
+  [queueLock lock];
+  producing = NO;
+  [queueLock broadcast];
+  [queueLock unlock];
+  [pool release];
+}
+
+- (void)writeSamples: (short*)samples count: (int)n
+{
+  if (NULL != file)
+    {
+      fwrite(samples, sizeof(short), n, file);
+    }
+  else
+    {
+      audio_write(ad, samples, n*2);
+    }
+}
+
+/**
+ * Plays one utterance, telling the delegate about each word as playback
+ * reaches it.  Flite does not report where words start in the wave, so
+ * this is estimated from their position in the sentence.  Returns NO if
+ * speaking was stopped.
+ */
+- (BOOL)speakUtterance: (FliteUtterance*)u
+              ofString: (NSString*)aString
+              delegate: (id)aDelegate
+{
+  NSCharacterSet *space = [NSCharacterSet whitespaceAndNewlineCharacterSet];
+  cst_wave *w = u->wave;
+  int num_shorts = w->num_samples * w->num_channels;
+  NSUInteger end = NSMaxRange(u->range);
+  NSUInteger word = u->range.location;
+  int i,n;
+
+  NS_DURING
+    [aDelegate willSpeakSentence: u->range ofString: aString];
+  NS_HANDLER
+  NS_ENDHANDLER
+  for (i=0; i < num_shorts; i += n)
+    {
+      while (word < end
+        && (word - u->range.location) * num_shorts / u->range.length <= i)
+        {
+          NSRange r = [aString rangeOfCharacterFromSet: space
+                                               options: 0
+                                                 range: NSMakeRange(word, end - word)];
+
+          if (r.location == NSNotFound)
+            {
+              r.location = end;
+            }
+          if (r.location > word)
+            {
+              NS_DURING
+                [aDelegate willSpeakWord: NSMakeRange(word, r.location - word)
+                                ofString: aString];
+              NS_HANDLER
+              NS_ENDHANDLER
+            }
+          word = r.location + 1;
+        }
       if (num_shorts > i+CST_AUDIOBUFFSIZE)
         {
           n = CST_AUDIOBUFFSIZE;
@@ -69,21 +259,72 @@ cst_voice *register_cmu_us_kal16();
         {
           n = num_shorts-i;
         }
-      r = audio_write(ad, &w->samples[i], n*2);
+      [self writeSamples: &w->samples[i] count: n];
       if (shouldEndSpeaking)
         {
-          didFinish = NO;
+          return NO;
+        }
+    }
+  return YES;
+}
+
+/**
+ * Consumer thread.  Plays synthesized utterances as they become available.
+ */
+- (void)sayString: (NSArray*)args
+{
+  id pool = [NSAutoreleasePool new];
+  NSString *aString = [args objectAtIndex: 0];
+  id aDelegate = [args objectAtIndex: 1];
+  BOOL didFinish = YES;
+
+  while (didFinish)
+    {
+      FliteUtterance *u = nil;
+
+      [queueLock lock];
+      while ([queue count] == 0 && producing && !shouldEndSpeaking)
+        {
+          [queueLock wait];
+        }
+      if ([queue count] > 0 && !shouldEndSpeaking)
+        {
+          u = [[queue objectAtIndex: 0] retain];
+          [queue removeObjectAtIndex: 0];
+          [queueLock broadcast];
+        }
+      [queueLock unlock];
+      if (nil == u)
+        {
+          didFinish = !shouldEndSpeaking;
           break;
         }
+      didFinish = [self speakUtterance: u
+                              ofString: aString
+                              delegate: aDelegate];
+      [u release];
     }
+
+  // Wait for the producer to notice that we stopped.
+  [queueLock lock];
+  while (producing)
+    {
+      [queueLock wait];
+    }
+  [queue removeAllObjects];
+  [queueLock unlock];
+  if (NULL != file)
+    {
+      fflush(file);
+    }
+
   isSpeaking = NO;
   NS_DURING
-    [[args objectAtIndex: 1] didFinishSpeaking: didFinish];
+    [aDelegate didFinishSpeaking: didFinish];
   NS_HANDLER
   NS_ENDHANDLER;
   [args release];
   [pool release];
-  delete_wave(w);
 }
 
 - (void)startSpeaking: (NSString*)aString notifyWhenDone: (id)aDelegate
@@ -92,6 +333,10 @@ cst_voice *register_cmu_us_kal16();
   NSArray *arg = [[NSArray alloc] initWithObjects: aString, aDelegate, nil];
   shouldEndSpeaking = NO;
   isSpeaking = YES;
+  producing = YES;
+  [NSThread detachNewThreadSelector: @selector(synthesizeString:)
+                           toTarget: self
+                         withObject: aString];
   [NSThread detachNewThreadSelector: @selector(sayString:)
                            toTarget: self
                          withObject: arg];
@@ -106,14 +351,30 @@ cst_voice *register_cmu_us_kal16();
 - (void)stopSpeaking
 {
   shouldEndSpeaking = YES;
-  // Spin until the other thread has died.
-  while (isSpeaking) {}
+  [queueLock lock];
+  [queueLock broadcast];
+  [queueLock unlock];
+  // Wait until the other threads have died.  The producer may still be
+  // finishing the sentence it is synthesizing.
+  while (isSpeaking)
+    {
+      [NSThread sleepForTimeInterval: 0.001];
+    }
 }
 
 - (void)dealloc
 {
   [self stopSpeaking];
-  audio_close(ad);
+  if (NULL != file)
+    {
+      fclose(file);
+    }
+  else
+    {
+      audio_close(ad);
+    }
+  [queue release];
+  [queueLock release];
   [super dealloc];
 }
 @end
@@ -43,6 +43,16 @@
  * used to notify the original caller.
  */
 - (void)didFinishSpeaking: (BOOL)didFinish;
+/**
+ * Called when the speech engine starts speaking a sentence, identified by
+ * its range in aString.
+ */
+- (void)willSpeakSentence: (NSRange)aRange ofString: (NSString*)aString;
+/**
+ * Called when the speech engine is about to speak the word at aRange in
+ * aString.
+ */
+- (void)willSpeakWord: (NSRange)aRange ofString: (NSString*)aString;
 @end
 @interface GSSpeechEngine (Default)
 /**
@@ -118,6 +118,34 @@ static int clients;
   NS_ENDHANDLER
 }
 
+- (void)willSpeakSentence: (NSRange)aRange ofString: (NSString*)aString
+{
+  NS_DURING
+    if ([delegate respondsToSelector:
+      @selector(speechSynthesizer:willSpeakSentence:ofString:)])
+      {
+        [delegate speechSynthesizer: self
+                  willSpeakSentence: aRange
+                           ofString: aString];
+      }
+  NS_HANDLER
+  NS_ENDHANDLER
+}
+
+- (void)willSpeakWord: (NSRange)aRange ofString: (NSString*)aString
+{
+  NS_DURING
+    if ([delegate respondsToSelector:
+      @selector(speechSynthesizer:willSpeakWord:ofString:)])
+      {
+        [delegate speechSynthesizer: self
+                      willSpeakWord: aRange
+                           ofString: aString];
+      }
+  NS_HANDLER
+  NS_ENDHANDLER
+}
+
 - (void)stopSpeaking
 {
   [server stopSpeaking];